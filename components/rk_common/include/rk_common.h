@@ -0,0 +1,450 @@
+#ifndef RK_COMMON_H
+#define RK_COMMON_H
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/timers.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Tryb statycznej alokacji zadań, kolejek, timerów i grup zdarzeń.
+// 1 - bufory w .bss (brak fragmentacji sterty przy długiej pracy), 0 - alokacja na stercie
+#ifndef RK_STATIC_ALLOC
+#define RK_STATIC_ALLOC 1
+#endif
+
+// Maksymalny czas oczekiwania rk_*_stop_task na potwierdzenie zakończenia zadania
+#ifndef RK_TASK_STOP_TIMEOUT_MS
+#define RK_TASK_STOP_TIMEOUT_MS 2000
+#endif
+
+// Indeks powiadomienia dla potwierdzeń (rk_join_*) - spóźnione potwierdzenie po
+// timeoucie nie trafia do ulTaskNotifyTake czekającego zadania na indeksie 0
+#define RK_NOTIFY_INDEX_JOIN 1
+#if configTASK_NOTIFICATION_ARRAY_ENTRIES <= RK_NOTIFY_INDEX_JOIN
+#error "rk_common wymaga CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES >= 2"
+#endif
+
+// Pojemność rejestru zadań utworzonych przez rk_task_create (raport rywalizacji o CPU)
+#ifndef RK_TASK_REGISTRY_MAX
+#define RK_TASK_REGISTRY_MAX 16
+#endif
+
+// Maksymalna liczba kroków skoordynowanego wyłączenia
+#ifndef RK_SHUTDOWN_MAX
+#define RK_SHUTDOWN_MAX 8
+#endif
+
+// Rozmieszczenie buforów: 1 - bufory masowe (RK_MEM_BULK) w PSRAM, gdy jest dostępny,
+// 0 - wszystkie w wewnętrznym SRAM
+#ifndef RK_MEM_PSRAM_POLICY
+#define RK_MEM_PSRAM_POLICY 1
+#endif
+
+// Próg rk_mem_calloc_by_size: mniejsze bloki (konteksty, liczby) zostają w SRAM
+#ifndef RK_MEM_BULK_MIN
+#define RK_MEM_BULK_MIN 2048
+#endif
+
+// Rdzenie obejmowane raportem rywalizacji
+#define RK_CONTENTION_MAX_CORES 2
+
+// Okres próbkowania stanów zadań w raporcie rywalizacji
+#ifndef RK_CONTENTION_SAMPLE_MS
+#define RK_CONTENTION_SAMPLE_MS 10
+#endif
+
+// Klasa bufora - decyduje o regionie pamięci
+typedef enum {
+    RK_MEM_INTERNAL,        // Wrażliwy na opóźnienia - wewnętrzny SRAM
+    RK_MEM_DMA,             // Dostęp DMA - wewnętrzny SRAM z MALLOC_CAP_DMA
+    RK_MEM_BULK,            // Bufor masowy (pobieranie, JSON, rekordy TLS) - PSRAM, gdy jest
+} rk_mem_class_t;
+
+// Regiony w raporcie alokacji
+typedef enum {
+    RK_MEM_REGION_INTERNAL,
+    RK_MEM_REGION_PSRAM,
+    RK_MEM_REGION_COUNT
+} rk_mem_region_t;
+
+// Liczba próbek w historii fragmentacji sterty
+#define RK_HEAP_HISTORY_LEN 32
+
+// Deklaracje buforów i argumenty dla funkcji rk_*_create.
+// W trybie dynamicznym bufory znikają, a funkcje dostają NULL.
+#if RK_STATIC_ALLOC
+#define RK_TASK_BUFFER(name, stack_bytes) \
+    static StackType_t name##_stack[(stack_bytes) / sizeof(StackType_t)]; \
+    static StaticTask_t name##_tcb
+#define RK_TASK_STATIC(name) name##_stack, &name##_tcb
+#define RK_TASK_STATIC_CFG(name) name##_stack, sizeof(name##_stack), &name##_tcb
+#define RK_QUEUE_BUFFER(name, length, item_size) \
+    static uint8_t name##_storage[(length) * (item_size)]; \
+    static StaticQueue_t name##_qcb
+#define RK_QUEUE_STATIC(name) name##_storage, &name##_qcb
+#define RK_TIMER_BUFFER(name) static StaticTimer_t name##_tmr
+#define RK_TIMER_STATIC(name) &name##_tmr
+#define RK_EVENT_GROUP_BUFFER(name) static StaticEventGroup_t name##_egb
+#define RK_EVENT_GROUP_STATIC(name) &name##_egb
+#define RK_MUTEX_BUFFER(name) static StaticSemaphore_t name##_smb
+#define RK_MUTEX_STATIC(name) &name##_smb
+#else
+#define RK_TASK_BUFFER(name, stack_bytes) extern int name##_unused
+#define RK_TASK_STATIC(name) NULL, NULL
+#define RK_TASK_STATIC_CFG(name) NULL, 0, NULL
+#define RK_QUEUE_BUFFER(name, length, item_size) extern int name##_unused
+#define RK_QUEUE_STATIC(name) NULL, NULL
+#define RK_TIMER_BUFFER(name) extern int name##_unused
+#define RK_TIMER_STATIC(name) NULL
+#define RK_EVENT_GROUP_BUFFER(name) extern int name##_unused
+#define RK_EVENT_GROUP_STATIC(name) NULL
+#define RK_MUTEX_BUFFER(name) extern int name##_unused
+#define RK_MUTEX_STATIC(name) NULL
+#endif
+
+// Zasoby liczone przez rk_*_create / rk_*_delete (wykrywanie wycieków przy długiej pracy)
+typedef enum {
+    RK_RES_TASK,
+    RK_RES_QUEUE,
+    RK_RES_TIMER,
+    RK_RES_EVENT_GROUP,
+    RK_RES_MUTEX,
+    RK_RES_HTTP_CLIENT,     // Klienci esp_http_client (liczeni przez komponenty)
+    RK_RES_COUNT
+} rk_res_type_t;
+
+// Rdzeń zadania; RK_TASK_CORE_DEFAULT (0) - wybór komponentu
+typedef enum {
+    RK_TASK_CORE_DEFAULT = 0,
+    RK_TASK_CORE_ANY,           // Bez przypięcia - planista wybiera rdzeń
+    RK_TASK_CORE_0,             // PRO_CPU - domyślnie tu działa stos WiFi i lwIP
+    RK_TASK_CORE_1,             // APP_CPU (na układach jednordzeniowych jak ANY)
+} rk_task_core_t;
+
+// Umieszczenie zadania przekazywane do rk_*_start_task. Pola zerowe (i NULL zamiast
+// struktury) przyjmują wartości domyślne komponentu.
+typedef struct {
+    rk_task_core_t core;
+    UBaseType_t priority;
+    uint32_t stack_bytes;       // Ponad bufor statyczny - stos alokowany na stercie
+} rk_task_config_t;
+
+// Zadanie w rejestrze rk_task_create
+typedef struct {
+    TaskHandle_t handle;
+    const char *name;
+    int8_t core;                // -1 - bez przypięcia
+    UBaseType_t priority;       // Priorytet przy utworzeniu
+    uint32_t stack_bytes;
+} rk_task_info_t;
+
+// Rywalizacja o CPU jednego zadania - próbki co RK_CONTENTION_SAMPLE_MS
+typedef struct {
+    rk_task_info_t info;
+    uint32_t running_samples;   // Zadanie miało procesor
+    uint32_t ready_samples;     // Gotowe do pracy, ale bez procesora (czeka na rdzeń)
+    uint32_t preemptions;       // Przejścia z działania do gotowości między próbkami
+} rk_contention_task_t;
+
+// Raport rywalizacji od startu próbkowania lub ostatniego zerowania
+typedef struct {
+    uint32_t window_ms;
+    uint8_t core_count;
+    uint32_t core_samples[RK_CONTENTION_MAX_CORES];   // Takty systemu
+    uint8_t core_load_pct[RK_CONTENTION_MAX_CORES];     // 100 - udział zadania IDLE rdzenia
+    uint8_t task_count;
+    rk_contention_task_t tasks[RK_TASK_REGISTRY_MAX];
+} rk_contention_report_t;
+
+// Próbka stanu sterty
+typedef struct {
+    int64_t timestamp_us;       // Czas pobrania próbki (esp_timer)
+    uint32_t free_bytes;        // Łącznie wolne
+    uint32_t largest_block;     // Największy ciągły wolny blok
+    uint32_t min_free_bytes;    // Minimum wolnej pamięci od startu
+    uint8_t fragmentation_pct;  // 100 - largest_block * 100 / free_bytes
+} rk_heap_sample_t;
+
+// Podsumowanie historii fragmentacji
+typedef struct {
+    uint32_t samples;               // Liczba wszystkich próbek
+    rk_heap_sample_t first;         // Pierwsza próbka (punkt odniesienia)
+    rk_heap_sample_t last;          // Ostatnia próbka
+    uint32_t largest_block_min;     // Najmniejszy największy blok w historii
+    uint8_t fragmentation_max_pct;  // Najwyższa fragmentacja w historii
+} rk_heap_report_t;
+
+/**
+ * @brief Utworzenie zadania - statycznie gdy podano bufory, inaczej na stercie
+ * @param stack Bufor stosu (RK_TASK_STATIC) lub NULL
+ * @param tcb Bufor TCB (RK_TASK_STATIC) lub NULL
+ * @return pdPASS w przypadku sukcesu
+ */
+BaseType_t rk_task_create(TaskFunction_t task_fn, const char *name, uint32_t stack_bytes,
+                          void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                          StackType_t *stack, StaticTask_t *tcb);
+
+/**
+ * @brief Utworzenie zadania z umieszczeniem z konfiguracji (rdzeń, priorytet, stos)
+ * @param config Konfiguracja od aplikacji, NULL - same wartości domyślne
+ * @param defaults Wartości domyślne komponentu (pełne)
+ * @param stack Bufor stosu (RK_TASK_STATIC_CFG) lub NULL
+ * @param stack_capacity Rozmiar bufora stosu w bajtach
+ * @param tcb Bufor TCB lub NULL
+ * @return pdPASS w przypadku sukcesu
+ */
+BaseType_t rk_task_create_config(TaskFunction_t task_fn, const char *name, void *arg,
+                                 const rk_task_config_t *config, const rk_task_config_t *defaults,
+                                 TaskHandle_t *handle, StackType_t *stack, uint32_t stack_capacity,
+                                 StaticTask_t *tcb);
+
+/**
+ * @brief Kopia rejestru zadań utworzonych przez rk_task_create*
+ * @param tasks Tablica wyjściowa
+ * @param max_tasks Rozmiar tablicy
+ * @return Liczba skopiowanych wpisów
+ */
+size_t rk_task_get_registry(rk_task_info_t *tasks, size_t max_tasks);
+
+/**
+ * @brief Start próbkowania rywalizacji o CPU
+ *
+ * Diagnostyka do strojenia rozmieszczenia zadań, nie do stałej pracy: hak taktu na
+ * każdym rdzeniu liczy obciążenie, timer co RK_CONTENTION_SAMPLE_MS odczytuje stany
+ * zadań z rejestru.
+ *
+ * @return ESP_OK w przypadku sukcesu
+ */
+esp_err_t rk_contention_start(void);
+
+/**
+ * @brief Zatrzymanie próbkowania rywalizacji
+ */
+void rk_contention_stop(void);
+
+/**
+ * @brief Raport rywalizacji o CPU
+ * @param report Struktura do wypełnienia
+ * @param reset true - zerowanie liczników (kolejny raport obejmie nowe okno)
+ * @return ESP_ERR_INVALID_STATE gdy próbkowanie nie działa
+ */
+esp_err_t rk_contention_get(rk_contention_report_t *report, bool reset);
+
+/**
+ * @brief Utworzenie kolejki - statycznie gdy podano bufory, inaczej na stercie
+ * @return Uchwyt kolejki lub NULL
+ */
+QueueHandle_t rk_queue_create(UBaseType_t length, UBaseType_t item_size,
+                              uint8_t *storage, StaticQueue_t *queue_buffer);
+
+/**
+ * @brief Utworzenie timera programowego - statycznie gdy podano bufor
+ * @return Uchwyt timera lub NULL
+ */
+TimerHandle_t rk_timer_create(const char *name, TickType_t period, UBaseType_t auto_reload,
+                              void *timer_id, TimerCallbackFunction_t callback,
+                              StaticTimer_t *timer_buffer);
+
+/**
+ * @brief Utworzenie grupy zdarzeń - statycznie gdy podano bufor
+ * @return Uchwyt grupy lub NULL
+ */
+EventGroupHandle_t rk_event_group_create(StaticEventGroup_t *buffer);
+
+/**
+ * @brief Utworzenie mutexu - statycznie gdy podano bufor
+ * @return Uchwyt mutexu lub NULL
+ */
+SemaphoreHandle_t rk_mutex_create(StaticSemaphore_t *buffer);
+
+/**
+ * @brief Usunięcie zadania utworzonego przez rk_task_create
+ * @param task Uchwyt zadania, NULL - zadanie bieżące
+ */
+void rk_task_delete(TaskHandle_t task);
+
+/**
+ * @brief Przygotowanie bieżącego zadania do czekania na potwierdzenie
+ *
+ * Kasuje potwierdzenie spóźnione z poprzedniego oczekiwania. Wołać przed
+ * udostępnieniem uchwytu zadania potwierdzającemu.
+ */
+void rk_join_prepare(void);
+
+/**
+ * @brief Oczekiwanie na potwierdzenie (rk_join_signal) na indeksie RK_NOTIFY_INDEX_JOIN
+ * @return true gdy potwierdzenie nadeszło przed timeoutem
+ */
+bool rk_join_wait(uint32_t timeout_ms);
+
+/**
+ * @brief Potwierdzenie dla zadania czekającego w rk_join_wait
+ * @param waiter Czekające zadanie, NULL - bez efektu
+ */
+void rk_join_signal(TaskHandle_t waiter);
+
+/**
+ * @brief Usunięcie kolejki utworzonej przez rk_queue_create
+ */
+void rk_queue_delete(QueueHandle_t queue);
+
+/**
+ * @brief Usunięcie mutexu utworzonego przez rk_mutex_create
+ */
+void rk_mutex_delete(SemaphoreHandle_t mutex);
+
+/**
+ * @brief Odnotowanie utworzenia zasobu spoza rk_*_create (np. klienta HTTP)
+ */
+void rk_res_acquire(rk_res_type_t type);
+
+/**
+ * @brief Odnotowanie zwolnienia zasobu
+ */
+void rk_res_release(rk_res_type_t type);
+
+/**
+ * @brief Liczba żywych zasobów danego typu
+ */
+int32_t rk_res_live(rk_res_type_t type);
+
+/**
+ * @brief Nazwa typu zasobu (do logów i JSON)
+ */
+const char *rk_res_name(rk_res_type_t type);
+
+/**
+ * @brief Pobranie próbki sterty i zapis do historii fragmentacji
+ * @param sample Struktura do wypełnienia (może być NULL)
+ */
+void rk_heap_sample(rk_heap_sample_t *sample);
+
+/**
+ * @brief Podsumowanie historii fragmentacji sterty
+ * @param report Struktura do wypełnienia
+ */
+void rk_heap_get_report(rk_heap_report_t *report);
+
+/**
+ * @brief Kopia historii próbek (od najstarszej)
+ * @param samples Tablica wyjściowa
+ * @param max_samples Rozmiar tablicy
+ * @return Liczba skopiowanych próbek
+ */
+size_t rk_heap_get_history(rk_heap_sample_t *samples, size_t max_samples);
+
+// Alokacje przez rk_mem_* w jednym regionie
+typedef struct {
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t live_bytes;
+    uint32_t peak_bytes;
+    uint32_t copy_bps;          // Kopiowanie 4 KB z SRAM do regionu (rk_mem_measure, 0 - brak)
+} rk_mem_region_stats_t;
+
+typedef struct {
+    bool psram_available;
+    uint32_t psram_total_bytes;
+    uint32_t psram_free_bytes;
+    uint32_t bulk_fallbacks;    // Bufory masowe w SRAM (brak PSRAM lub miejsca)
+    uint32_t failures;          // Nieudane alokacje
+    rk_mem_region_stats_t regions[RK_MEM_REGION_COUNT];
+} rk_mem_report_t;
+
+/**
+ * @brief Ustalenie dostępności PSRAM - na początku app_main, przed pierwszą alokacją rk_mem_*
+ */
+void rk_mem_init(void);
+
+/**
+ * @brief Alokacja w regionie wynikającym z klasy bufora
+ *
+ * RK_MEM_BULK trafia do PSRAM (RK_MEM_PSRAM_POLICY), a bez PSRAM lub miejsca do SRAM.
+ *
+ * @return Wskaźnik lub NULL
+ */
+void *rk_mem_alloc(size_t size, rk_mem_class_t mem_class);
+
+/**
+ * @brief Jak rk_mem_alloc, z zerowaniem
+ */
+void *rk_mem_calloc(size_t n, size_t size, rk_mem_class_t mem_class);
+
+/**
+ * @brief Alokacja z klasą według rozmiaru: od RK_MEM_BULK_MIN bufor masowy, mniejsze w SRAM
+ *
+ * Sygnatura calloc - do podpięcia jako alokator biblioteki (np. mbedTLS).
+ */
+void *rk_mem_calloc_by_size(size_t n, size_t size);
+
+/**
+ * @brief Zwolnienie bloku z rk_mem_* (NULL ignorowany)
+ */
+void rk_mem_free(void *ptr);
+
+/**
+ * @brief Czy blok leży w PSRAM
+ */
+bool rk_mem_is_psram(const void *ptr);
+
+/**
+ * @brief Pomiar przepustowości kopiowania do każdego dostępnego regionu (kilka ms)
+ *
+ * Na żądanie - wywoływany przez test łącza OTA, nie przy każdym starcie.
+ */
+void rk_mem_measure(void);
+
+/**
+ * @brief Raport alokacji według regionów
+ * @param report Struktura do wypełnienia
+ */
+void rk_mem_get_report(rk_mem_report_t *report);
+
+/**
+ * @brief Nazwa regionu (do logów i JSON)
+ */
+const char *rk_mem_region_name(rk_mem_region_t region);
+
+/**
+ * @brief Krok wyłączania komponentu - kończy się dopiero po zatrzymaniu jego zadań
+ */
+typedef void (*rk_shutdown_fn_t)(void);
+
+/**
+ * @brief Rejestracja kroku wyłączania (ponowna rejestracja tej samej funkcji jest pomijana)
+ * @param name Nazwa do logu (stały napis)
+ * @param fn Funkcja kroku
+ * @return ESP_OK lub ESP_ERR_NO_MEM gdy przekroczono RK_SHUTDOWN_MAX
+ */
+esp_err_t rk_shutdown_register(const char *name, rk_shutdown_fn_t fn);
+
+/**
+ * @brief Skoordynowane wyłączenie i restart
+ *
+ * Wykonuje kroki w odwrotnej kolejności rejestracji, mierzy ich czas
+ * i restartuje układ zaraz po ostatnim - bez stałych opóźnień.
+ *
+ * @param reason Przyczyna (do logu)
+ */
+void rk_shutdown_restart(const char *reason) __attribute__((noreturn));
+
+/**
+ * @brief Czas wyłączenia przed ostatnim restartem
+ * @return Czas w ms, 0 gdy poprzedni start nie był skoordynowanym restartem
+ */
+uint32_t rk_shutdown_last_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RK_COMMON_H
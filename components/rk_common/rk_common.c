@@ -0,0 +1,520 @@
+#include "rk_common.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_freertos_hooks.h"
+#include <string.h>
+
+static const char *TAG = "RK_COMMON";
+
+static rk_heap_sample_t s_history[RK_HEAP_HISTORY_LEN];
+static uint32_t s_samples = 0;
+static rk_heap_sample_t s_first;
+static uint32_t s_largest_block_min = UINT32_MAX;
+static uint8_t s_fragmentation_max = 0;
+static portMUX_TYPE s_heap_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Żywe zasoby wg typu (atomowo - zwalniane także z kończących się zadań)
+static int32_t s_res_live[RK_RES_COUNT];
+
+static const char *s_res_names[RK_RES_COUNT] = {
+    [RK_RES_TASK] = "tasks",
+    [RK_RES_QUEUE] = "queues",
+    [RK_RES_TIMER] = "timers",
+    [RK_RES_EVENT_GROUP] = "event_groups",
+    [RK_RES_MUTEX] = "mutexes",
+    [RK_RES_HTTP_CLIENT] = "http_clients",
+};
+
+void rk_res_acquire(rk_res_type_t type)
+{
+    if (type < RK_RES_COUNT) {
+        __atomic_add_fetch(&s_res_live[type], 1, __ATOMIC_RELAXED);
+    }
+}
+
+void rk_res_release(rk_res_type_t type)
+{
+    if (type < RK_RES_COUNT) {
+        __atomic_sub_fetch(&s_res_live[type], 1, __ATOMIC_RELAXED);
+    }
+}
+
+int32_t rk_res_live(rk_res_type_t type)
+{
+    return type < RK_RES_COUNT ? __atomic_load_n(&s_res_live[type], __ATOMIC_RELAXED) : 0;
+}
+
+const char *rk_res_name(rk_res_type_t type)
+{
+    return type < RK_RES_COUNT ? s_res_names[type] : "?";
+}
+
+// Rejestr zadań z licznikami rywalizacji
+typedef struct {
+    rk_task_info_t info;
+    uint32_t running_samples;
+    uint32_t ready_samples;
+    uint32_t preemptions;
+    bool was_running;
+} task_slot_t;
+
+static task_slot_t s_tasks[RK_TASK_REGISTRY_MAX];
+static portMUX_TYPE s_task_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Próbkowanie rywalizacji: takty z zadaniem IDLE na każdym rdzeniu (każdy rdzeń pisze
+// tylko swoje liczniki - bez blokady w haku) i stany zadań z timera w kontekście zadania
+static bool s_contention_running = false;
+static TaskHandle_t s_idle_tasks[RK_CONTENTION_MAX_CORES];
+static volatile uint32_t s_core_samples[RK_CONTENTION_MAX_CORES];
+static volatile uint32_t s_core_idle[RK_CONTENTION_MAX_CORES];
+static esp_timer_handle_t s_contention_timer = NULL;
+static int64_t s_contention_start_us = 0;
+
+static void task_register(TaskHandle_t handle, const char *name, BaseType_t core_id,
+                          UBaseType_t priority, uint32_t stack_bytes)
+{
+    portENTER_CRITICAL(&s_task_lock);
+    int free_slot = -1;
+    for (int i = 0; i < RK_TASK_REGISTRY_MAX; i++) {
+        // Ten sam uchwyt (bufor statyczny po zakończonym zadaniu) zastępuje stary wpis
+        if (s_tasks[i].info.handle == handle) {
+            free_slot = i;
+            break;
+        }
+        if (free_slot < 0 && s_tasks[i].info.handle == NULL) {
+            free_slot = i;
+        }
+    }
+    if (free_slot >= 0) {
+        task_slot_t *slot = &s_tasks[free_slot];
+        memset(slot, 0, sizeof(*slot));
+        slot->info.handle = handle;
+        slot->info.name = name;
+        slot->info.core = core_id == tskNO_AFFINITY ? -1 : (int8_t)core_id;
+        slot->info.priority = priority;
+        slot->info.stack_bytes = stack_bytes;
+    }
+    portEXIT_CRITICAL(&s_task_lock);
+}
+
+static void task_unregister(TaskHandle_t handle)
+{
+    portENTER_CRITICAL(&s_task_lock);
+    for (int i = 0; i < RK_TASK_REGISTRY_MAX; i++) {
+        if (s_tasks[i].info.handle == handle) {
+            s_tasks[i].info.handle = NULL;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_task_lock);
+}
+
+static BaseType_t task_create(TaskFunction_t task_fn, const char *name, uint32_t stack_bytes,
+                              void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                              StackType_t *stack, StaticTask_t *tcb, BaseType_t core_id)
+{
+    // Licznik przed utworzeniem - zadanie może zakończyć się zanim wrócimy
+    rk_res_acquire(RK_RES_TASK);
+    
+    BaseType_t ret;
+    TaskHandle_t task = NULL;
+    if (stack != NULL && tcb != NULL) {
+        task = xTaskCreateStaticPinnedToCore(task_fn, name, stack_bytes, arg, priority,
+                                             stack, tcb, core_id);
+        if (handle != NULL) {
+            *handle = task;
+        }
+        ret = task != NULL ? pdPASS : pdFAIL;
+    } else {
+        // Uchwyt zapisywany przed pierwszym uruchomieniem zadania
+        ret = xTaskCreatePinnedToCore(task_fn, name, stack_bytes, arg, priority,
+                                      handle != NULL ? handle : &task, core_id);
+        if (handle != NULL) {
+            task = *handle;
+        }
+    }
+    
+    if (ret != pdPASS) {
+        rk_res_release(RK_RES_TASK);
+        return ret;
+    }
+    // Zadanie mogło już się zakończyć - wpis zostaje do ponownego użycia uchwytu
+    task_register(task, name, core_id, priority, stack_bytes);
+    return ret;
+}
+
+BaseType_t rk_task_create(TaskFunction_t task_fn, const char *name, uint32_t stack_bytes,
+                          void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                          StackType_t *stack, StaticTask_t *tcb)
+{
+    return task_create(task_fn, name, stack_bytes, arg, priority, handle, stack, tcb,
+                       tskNO_AFFINITY);
+}
+
+BaseType_t rk_task_create_config(TaskFunction_t task_fn, const char *name, void *arg,
+                                 const rk_task_config_t *config, const rk_task_config_t *defaults,
+                                 TaskHandle_t *handle, StackType_t *stack, uint32_t stack_capacity,
+                                 StaticTask_t *tcb)
+{
+    rk_task_config_t resolved = *defaults;
+    if (config != NULL) {
+        if (config->core != RK_TASK_CORE_DEFAULT) {
+            resolved.core = config->core;
+        }
+        if (config->priority != 0) {
+            resolved.priority = config->priority;
+        }
+        if (config->stack_bytes != 0) {
+            resolved.stack_bytes = config->stack_bytes;
+        }
+    }
+    if (resolved.priority >= configMAX_PRIORITIES) {
+        resolved.priority = configMAX_PRIORITIES - 1;
+    }
+    
+    BaseType_t core_id = tskNO_AFFINITY;
+    if (resolved.core == RK_TASK_CORE_0) {
+        core_id = 0;
+    } else if (resolved.core == RK_TASK_CORE_1 && portNUM_PROCESSORS > 1) {
+        core_id = 1;
+    }
+    
+    // Większy stos nie zmieści się w buforze z RK_TASK_BUFFER - to jedno zadanie na stercie
+    if (stack != NULL && resolved.stack_bytes > stack_capacity) {
+        ESP_LOGW(TAG, "%s: stos %lu B ponad bufor statyczny %lu B - alokacja na stercie",
+                 name, resolved.stack_bytes, stack_capacity);
+        stack = NULL;
+        tcb = NULL;
+    }
+    
+    return task_create(task_fn, name, resolved.stack_bytes, arg, resolved.priority, handle,
+                       stack, tcb, core_id);
+}
+
+void rk_task_delete(TaskHandle_t task)
+{
+    task_unregister(task != NULL ? task : xTaskGetCurrentTaskHandle());
+    rk_res_release(RK_RES_TASK);
+    vTaskDelete(task);
+}
+
+size_t rk_task_get_registry(rk_task_info_t *tasks, size_t max_tasks)
+{
+    size_t count = 0;
+    
+    portENTER_CRITICAL(&s_task_lock);
+    for (int i = 0; i < RK_TASK_REGISTRY_MAX && count < max_tasks; i++) {
+        if (s_tasks[i].info.handle != NULL) {
+            tasks[count++] = s_tasks[i].info;
+        }
+    }
+    portEXIT_CRITICAL(&s_task_lock);
+    return count;
+}
+
+// Hak taktu (ISR, każdy rdzeń): tylko obciążenie rdzenia - czy przerwano zadanie IDLE
+static void IRAM_ATTR contention_tick_hook(void)
+{
+    int core = xPortGetCoreID();
+    if (core >= RK_CONTENTION_MAX_CORES) {
+        return;
+    }
+    s_core_samples[core]++;
+    if (xTaskGetCurrentTaskHandle() == s_idle_tasks[core]) {
+        s_core_idle[core]++;
+    }
+}
+
+// Próbka stanów zadań z rejestru (zadanie esp_timer - eTaskGetState wolno tu wołać).
+// Zadanie timera wypiera to, co działało na jego rdzeniu: spośród gotowych zadań, które
+// mogą tam działać, to o najwyższym priorytecie miałoby procesor - liczone jako działające.
+static void contention_sample(void *arg)
+{
+    TaskHandle_t handles[RK_TASK_REGISTRY_MAX];
+    eTaskState states[RK_TASK_REGISTRY_MAX];
+    int core = xPortGetCoreID();
+    int displaced = -1;
+    
+    portENTER_CRITICAL(&s_task_lock);
+    for (int i = 0; i < RK_TASK_REGISTRY_MAX; i++) {
+        handles[i] = s_tasks[i].info.handle;
+    }
+    portEXIT_CRITICAL(&s_task_lock);
+    
+    for (int i = 0; i < RK_TASK_REGISTRY_MAX; i++) {
+        states[i] = handles[i] != NULL ? eTaskGetState(handles[i]) : eDeleted;
+    }
+    
+    portENTER_CRITICAL(&s_task_lock);
+    for (int i = 0; i < RK_TASK_REGISTRY_MAX; i++) {
+        const task_slot_t *slot = &s_tasks[i];
+        if (slot->info.handle == handles[i] && states[i] == eReady &&
+            (slot->info.core == core || slot->info.core < 0) &&
+            (displaced < 0 || slot->info.priority > s_tasks[displaced].info.priority)) {
+            displaced = i;
+        }
+    }
+    for (int i = 0; i < RK_TASK_REGISTRY_MAX; i++) {
+        task_slot_t *slot = &s_tasks[i];
+        // Wpis zmieniony między odczytami - próbka dotyczy innego zadania
+        if (slot->info.handle == NULL || slot->info.handle != handles[i]) {
+            continue;
+        }
+        eTaskState state = i == displaced ? eRunning : states[i];
+        if (state == eRunning) {
+            slot->running_samples++;
+        } else if (state == eReady) {
+            slot->ready_samples++;
+            if (slot->was_running) {
+                slot->preemptions++;
+            }
+        }
+        slot->was_running = state == eRunning;
+    }
+    portEXIT_CRITICAL(&s_task_lock);
+}
+
+static void contention_reset(void)
+{
+    portENTER_CRITICAL(&s_task_lock);
+    for (int core = 0; core < RK_CONTENTION_MAX_CORES; core++) {
+        s_core_samples[core] = 0;
+        s_core_idle[core] = 0;
+    }
+    for (int i = 0; i < RK_TASK_REGISTRY_MAX; i++) {
+        s_tasks[i].running_samples = 0;
+        s_tasks[i].ready_samples = 0;
+        s_tasks[i].preemptions = 0;
+    }
+    portEXIT_CRITICAL(&s_task_lock);
+    s_contention_start_us = esp_timer_get_time();
+}
+
+esp_err_t rk_contention_start(void)
+{
+    if (s_contention_running) {
+        return ESP_OK;
+    }
+    
+    for (int core = 0; core < portNUM_PROCESSORS && core < RK_CONTENTION_MAX_CORES; core++) {
+        s_idle_tasks[core] = xTaskGetIdleTaskHandleForCore(core);
+    }
+    contention_reset();
+    
+    if (s_contention_timer == NULL) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = contention_sample,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "rk_contention",
+        };
+        esp_err_t err = esp_timer_create(&timer_args, &s_contention_timer);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Timer próbkowania niedostępny: %s", esp_err_to_name(err));
+            return err;
+        }
+    }
+    
+    for (int core = 0; core < portNUM_PROCESSORS && core < RK_CONTENTION_MAX_CORES; core++) {
+        esp_err_t err = esp_register_freertos_tick_hook_for_cpu(contention_tick_hook, core);
+        if (err != ESP_OK) {
+            esp_deregister_freertos_tick_hook(contention_tick_hook);
+            ESP_LOGE(TAG, "Hak taktu niedostępny: %s", esp_err_to_name(err));
+            return err;
+        }
+    }
+    esp_timer_start_periodic(s_contention_timer, RK_CONTENTION_SAMPLE_MS * 1000ULL);
+    
+    s_contention_running = true;
+    return ESP_OK;
+}
+
+void rk_contention_stop(void)
+{
+    if (s_contention_running) {
+        esp_timer_stop(s_contention_timer);
+        esp_deregister_freertos_tick_hook(contention_tick_hook);
+        s_contention_running = false;
+    }
+}
+
+esp_err_t rk_contention_get(rk_contention_report_t *report, bool reset)
+{
+    if (report == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    memset(report, 0, sizeof(*report));
+    if (!s_contention_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    report->window_ms = (uint32_t)((esp_timer_get_time() - s_contention_start_us) / 1000);
+    report->core_count = portNUM_PROCESSORS < RK_CONTENTION_MAX_CORES ?
+                         portNUM_PROCESSORS : RK_CONTENTION_MAX_CORES;
+    
+    portENTER_CRITICAL(&s_task_lock);
+    for (int core = 0; core < report->core_count; core++) {
+        report->core_samples[core] = s_core_samples[core];
+        report->core_load_pct[core] = s_core_samples[core] > 0 ?
+            (uint8_t)(100 - (uint64_t)s_core_idle[core] * 100 / s_core_samples[core]) : 0;
+    }
+    for (int i = 0; i < RK_TASK_REGISTRY_MAX; i++) {
+        if (s_tasks[i].info.handle == NULL) {
+            continue;
+        }
+        rk_contention_task_t *task = &report->tasks[report->task_count++];
+        task->info = s_tasks[i].info;
+        task->running_samples = s_tasks[i].running_samples;
+        task->ready_samples = s_tasks[i].ready_samples;
+        task->preemptions = s_tasks[i].preemptions;
+    }
+    portEXIT_CRITICAL(&s_task_lock);
+    
+    if (reset) {
+        contention_reset();
+    }
+    return ESP_OK;
+}
+
+void rk_join_prepare(void)
+{
+    ulTaskNotifyValueClearIndexed(NULL, RK_NOTIFY_INDEX_JOIN, UINT32_MAX);
+    xTaskNotifyStateClearIndexed(NULL, RK_NOTIFY_INDEX_JOIN);
+}
+
+bool rk_join_wait(uint32_t timeout_ms)
+{
+    return ulTaskNotifyTakeIndexed(RK_NOTIFY_INDEX_JOIN, pdTRUE, pdMS_TO_TICKS(timeout_ms)) > 0;
+}
+
+void rk_join_signal(TaskHandle_t waiter)
+{
+    if (waiter != NULL) {
+        xTaskNotifyGiveIndexed(waiter, RK_NOTIFY_INDEX_JOIN);
+    }
+}
+
+QueueHandle_t rk_queue_create(UBaseType_t length, UBaseType_t item_size,
+                              uint8_t *storage, StaticQueue_t *queue_buffer)
+{
+    QueueHandle_t queue = (storage != NULL && queue_buffer != NULL) ?
+                          xQueueCreateStatic(length, item_size, storage, queue_buffer) :
+                          xQueueCreate(length, item_size);
+    if (queue != NULL) {
+        rk_res_acquire(RK_RES_QUEUE);
+    }
+    return queue;
+}
+
+void rk_queue_delete(QueueHandle_t queue)
+{
+    if (queue != NULL) {
+        rk_res_release(RK_RES_QUEUE);
+        vQueueDelete(queue);
+    }
+}
+
+TimerHandle_t rk_timer_create(const char *name, TickType_t period, UBaseType_t auto_reload,
+                              void *timer_id, TimerCallbackFunction_t callback,
+                              StaticTimer_t *timer_buffer)
+{
+    TimerHandle_t timer = timer_buffer != NULL ?
+                          xTimerCreateStatic(name, period, auto_reload, timer_id, callback, timer_buffer) :
+                          xTimerCreate(name, period, auto_reload, timer_id, callback);
+    if (timer != NULL) {
+        rk_res_acquire(RK_RES_TIMER);
+    }
+    return timer;
+}
+
+EventGroupHandle_t rk_event_group_create(StaticEventGroup_t *buffer)
+{
+    EventGroupHandle_t group = buffer != NULL ? xEventGroupCreateStatic(buffer) : xEventGroupCreate();
+    if (group != NULL) {
+        rk_res_acquire(RK_RES_EVENT_GROUP);
+    }
+    return group;
+}
+
+SemaphoreHandle_t rk_mutex_create(StaticSemaphore_t *buffer)
+{
+    SemaphoreHandle_t mutex = buffer != NULL ? xSemaphoreCreateMutexStatic(buffer) : xSemaphoreCreateMutex();
+    if (mutex != NULL) {
+        rk_res_acquire(RK_RES_MUTEX);
+    }
+    return mutex;
+}
+
+void rk_mutex_delete(SemaphoreHandle_t mutex)
+{
+    if (mutex != NULL) {
+        rk_res_release(RK_RES_MUTEX);
+        vSemaphoreDelete(mutex);
+    }
+}
+
+void rk_heap_sample(rk_heap_sample_t *sample)
+{
+    rk_heap_sample_t s = {
+        .timestamp_us = esp_timer_get_time(),
+        .free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT),
+        .largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+        .min_free_bytes = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+    };
+    if (s.free_bytes > 0) {
+        s.fragmentation_pct = (uint8_t)(100 - (uint64_t)s.largest_block * 100 / s.free_bytes);
+    }
+    
+    portENTER_CRITICAL(&s_heap_lock);
+    if (s_samples == 0) {
+        s_first = s;
+    }
+    s_history[s_samples % RK_HEAP_HISTORY_LEN] = s;
+    s_samples++;
+    if (s.largest_block < s_largest_block_min) {
+        s_largest_block_min = s.largest_block;
+    }
+    if (s.fragmentation_pct > s_fragmentation_max) {
+        s_fragmentation_max = s.fragmentation_pct;
+    }
+    portEXIT_CRITICAL(&s_heap_lock);
+    
+    if (sample != NULL) {
+        *sample = s;
+    }
+}
+
+void rk_heap_get_report(rk_heap_report_t *report)
+{
+    if (report == NULL) {
+        return;
+    }
+    
+    memset(report, 0, sizeof(*report));
+    
+    portENTER_CRITICAL(&s_heap_lock);
+    if (s_samples > 0) {
+        report->samples = s_samples;
+        report->first = s_first;
+        report->last = s_history[(s_samples - 1) % RK_HEAP_HISTORY_LEN];
+        report->largest_block_min = s_largest_block_min;
+        report->fragmentation_max_pct = s_fragmentation_max;
+    }
+    portEXIT_CRITICAL(&s_heap_lock);
+}
+
+size_t rk_heap_get_history(rk_heap_sample_t *samples, size_t max_samples)
+{
+    size_t count = 0;
+    
+    portENTER_CRITICAL(&s_heap_lock);
+    size_t available = s_samples < RK_HEAP_HISTORY_LEN ? s_samples : RK_HEAP_HISTORY_LEN;
+    size_t start = s_samples - available;
+    for (; count < available && count < max_samples; count++) {
+        samples[count] = s_history[(start + count) % RK_HEAP_HISTORY_LEN];
+    }
+    portEXIT_CRITICAL(&s_heap_lock);
+    
+    return count;
+}
@@ -0,0 +1,196 @@
+#include "rk_common.h"
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "RK_MEM";
+
+#define MEASURE_BLOCK   4096
+#define MEASURE_ROUNDS  64
+
+static const char *s_region_names[RK_MEM_REGION_COUNT] = {
+    "internal",
+    "psram",
+};
+
+static rk_mem_region_stats_t s_regions[RK_MEM_REGION_COUNT];
+static uint32_t s_bulk_fallbacks = 0;
+static uint32_t s_failures = 0;
+static bool s_psram_available = false;     // Ustalane raz w rk_mem_init - PSRAM nie znika
+static portMUX_TYPE s_mem_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void rk_mem_init(void)
+{
+    s_psram_available = heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+}
+
+static void account(void *ptr, bool allocated)
+{
+    rk_mem_region_t region = esp_ptr_external_ram(ptr) ? RK_MEM_REGION_PSRAM : RK_MEM_REGION_INTERNAL;
+    uint32_t size = heap_caps_get_allocated_size(ptr);
+    
+    portENTER_CRITICAL(&s_mem_lock);
+    rk_mem_region_stats_t *stats = &s_regions[region];
+    if (allocated) {
+        stats->allocs++;
+        stats->live_bytes += size;
+        if (stats->live_bytes > stats->peak_bytes) {
+            stats->peak_bytes = stats->live_bytes;
+        }
+    } else {
+        stats->frees++;
+        stats->live_bytes -= size;
+    }
+    portEXIT_CRITICAL(&s_mem_lock);
+}
+
+static void *mem_alloc(size_t size, rk_mem_class_t mem_class, bool zero)
+{
+    void *ptr = NULL;
+    
+    if (mem_class == RK_MEM_BULK && RK_MEM_PSRAM_POLICY) {
+        if (s_psram_available) {
+            ptr = zero ? heap_caps_calloc(1, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) :
+                         heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        }
+        if (ptr == NULL) {
+            portENTER_CRITICAL(&s_mem_lock);
+            s_bulk_fallbacks++;
+            portEXIT_CRITICAL(&s_mem_lock);
+        }
+    }
+    if (ptr == NULL) {
+        uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+        if (mem_class == RK_MEM_DMA) {
+            caps |= MALLOC_CAP_DMA;
+        }
+        ptr = zero ? heap_caps_calloc(1, size, caps) : heap_caps_malloc(size, caps);
+    }
+    
+    if (ptr == NULL) {
+        portENTER_CRITICAL(&s_mem_lock);
+        s_failures++;
+        portEXIT_CRITICAL(&s_mem_lock);
+        return NULL;
+    }
+    
+    account(ptr, true);
+    return ptr;
+}
+
+void *rk_mem_alloc(size_t size, rk_mem_class_t mem_class)
+{
+    return mem_alloc(size, mem_class, false);
+}
+
+void *rk_mem_calloc(size_t n, size_t size, rk_mem_class_t mem_class)
+{
+    if (size != 0 && n > SIZE_MAX / size) {
+        return NULL;
+    }
+    return mem_alloc(n * size, mem_class, true);
+}
+
+void *rk_mem_calloc_by_size(size_t n, size_t size)
+{
+    if (size != 0 && n > SIZE_MAX / size) {
+        return NULL;
+    }
+    return mem_alloc(n * size, n * size >= RK_MEM_BULK_MIN ? RK_MEM_BULK : RK_MEM_INTERNAL, true);
+}
+
+void rk_mem_free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    
+    account(ptr, false);
+    heap_caps_free(ptr);
+}
+
+#if CONFIG_MBEDTLS_CUSTOM_MEM_ALLOC
+// Alokator mbedTLS (sdkconfig.defaults.esp32s3): bufory rekordów TLS do PSRAM, małe struktury w SRAM.
+// Bez PSRAM wszystko idzie do SRAM bez rozliczania regionów - wywoływany przy każdej strukturze
+// sesji TLS. Pierwsza sesja TLS startuje po rk_mem_init, więc para calloc/free jest spójna.
+void *esp_mbedtls_mem_calloc(size_t n, size_t size)
+{
+    if (!s_psram_available) {
+        return heap_caps_calloc(n, size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    return rk_mem_calloc_by_size(n, size);
+}
+
+void esp_mbedtls_mem_free(void *ptr)
+{
+    if (!s_psram_available) {
+        heap_caps_free(ptr);
+        return;
+    }
+    rk_mem_free(ptr);
+}
+#endif
+
+bool rk_mem_is_psram(const void *ptr)
+{
+    return ptr != NULL && esp_ptr_external_ram(ptr);
+}
+
+// Kopiowanie z SRAM do bloku regionu - ten sam wzorzec co zapis odebranych danych do bufora
+static uint32_t measure_copy(uint32_t caps)
+{
+    static uint8_t src[MEASURE_BLOCK];
+    uint8_t *dst = heap_caps_malloc(MEASURE_BLOCK, caps);
+    if (dst == NULL) {
+        return 0;
+    }
+    
+    int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < MEASURE_ROUNDS; i++) {
+        memcpy(dst, src, MEASURE_BLOCK);
+        src[i] = dst[MEASURE_BLOCK - 1 - i];    // Zależność - kopia nie zostanie usunięta
+    }
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    heap_caps_free(dst);
+    
+    return elapsed_us > 0 ? (uint32_t)((int64_t)MEASURE_BLOCK * MEASURE_ROUNDS * 1000000 / elapsed_us) : 0;
+}
+
+void rk_mem_measure(void)
+{
+    uint32_t internal_bps = measure_copy(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    uint32_t psram_bps = s_psram_available ? measure_copy(MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : 0;
+    
+    portENTER_CRITICAL(&s_mem_lock);
+    s_regions[RK_MEM_REGION_INTERNAL].copy_bps = internal_bps;
+    s_regions[RK_MEM_REGION_PSRAM].copy_bps = psram_bps;
+    portEXIT_CRITICAL(&s_mem_lock);
+    
+    ESP_LOGI(TAG, "Kopiowanie 4 KB: SRAM %lu KB/s, PSRAM %lu KB/s",
+             internal_bps / 1024, psram_bps / 1024);
+}
+
+void rk_mem_get_report(rk_mem_report_t *report)
+{
+    if (report == NULL) {
+        return;
+    }
+    
+    memset(report, 0, sizeof(*report));
+    report->psram_available = s_psram_available;
+    report->psram_total_bytes = heap_caps_get_total_size(MALLOC_CAP_SPIRAM);
+    report->psram_free_bytes = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    
+    portENTER_CRITICAL(&s_mem_lock);
+    report->bulk_fallbacks = s_bulk_fallbacks;
+    report->failures = s_failures;
+    memcpy(report->regions, s_regions, sizeof(report->regions));
+    portEXIT_CRITICAL(&s_mem_lock);
+}
+
+const char *rk_mem_region_name(rk_mem_region_t region)
+{
+    return (unsigned)region < RK_MEM_REGION_COUNT ? s_region_names[region] : "?";
+}
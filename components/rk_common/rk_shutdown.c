@@ -0,0 +1,112 @@
+#include "rk_common.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "RK_SHUTDOWN";
+
+#define SHUTDOWN_MAGIC 0x52534844   // "RSHD"
+
+typedef struct {
+    const char *name;
+    rk_shutdown_fn_t fn;
+} shutdown_step_t;
+
+// Wynik wyłączenia przeżywa esp_restart (RTC bez inicjalizacji)
+typedef struct {
+    uint32_t magic;
+    uint32_t total_ms;
+} shutdown_record_t;
+
+static RTC_NOINIT_ATTR shutdown_record_t s_record;
+
+static shutdown_step_t s_steps[RK_SHUTDOWN_MAX];
+static uint8_t s_step_count = 0;
+static portMUX_TYPE s_shutdown_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_in_progress = false;
+
+// Odczyt przy pierwszym zapytaniu - rekord unieważniany, by restart po awarii go nie powtórzył
+static bool s_last_loaded = false;
+static uint32_t s_last_ms = 0;
+
+esp_err_t rk_shutdown_register(const char *name, rk_shutdown_fn_t fn)
+{
+    if (fn == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&s_shutdown_lock);
+    bool known = false;
+    for (uint8_t i = 0; i < s_step_count; i++) {
+        if (s_steps[i].fn == fn) {
+            known = true;   // Ponowne uruchomienie komponentu - krok już jest
+            break;
+        }
+    }
+    if (!known) {
+        if (s_step_count < RK_SHUTDOWN_MAX) {
+            s_steps[s_step_count].name = name;
+            s_steps[s_step_count].fn = fn;
+            s_step_count++;
+        } else {
+            ret = ESP_ERR_NO_MEM;
+        }
+    }
+    portEXIT_CRITICAL(&s_shutdown_lock);
+    
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Brak miejsca na krok wyłączania %s", name);
+    }
+    return ret;
+}
+
+void rk_shutdown_restart(const char *reason)
+{
+    portENTER_CRITICAL(&s_shutdown_lock);
+    bool busy = s_in_progress;
+    s_in_progress = true;
+    portEXIT_CRITICAL(&s_shutdown_lock);
+    
+    if (busy) {
+        // Inne zadanie już wyłącza system - restart nastąpi za chwilę
+        while (1) {
+            vTaskDelay(portMAX_DELAY);
+        }
+    }
+    
+    int64_t start_us = esp_timer_get_time();
+    ESP_LOGI(TAG, "Wyłączenie (%s): %u kroków", reason != NULL ? reason : "-", s_step_count);
+    
+    // Odwrotna kolejność rejestracji - komponenty uruchomione najpóźniej kończą pierwsze
+    for (int i = (int)s_step_count - 1; i >= 0; i--) {
+        int64_t step_us = esp_timer_get_time();
+        s_steps[i].fn();
+        ESP_LOGI(TAG, "  %-8s %lu ms", s_steps[i].name,
+                 (uint32_t)((esp_timer_get_time() - step_us) / 1000));
+    }
+    
+    uint32_t total_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    s_record.magic = SHUTDOWN_MAGIC;
+    s_record.total_ms = total_ms;
+    
+    ESP_LOGI(TAG, "Wyłączenie zakończone w %lu ms - restart", total_ms);
+    esp_restart();
+}
+
+uint32_t rk_shutdown_last_ms(void)
+{
+    portENTER_CRITICAL(&s_shutdown_lock);
+    if (!s_last_loaded) {
+        s_last_loaded = true;
+        if (s_record.magic == SHUTDOWN_MAGIC) {
+            s_last_ms = s_record.total_ms;
+        }
+        s_record.magic = 0;
+    }
+    uint32_t last_ms = s_last_ms;
+    portEXIT_CRITICAL(&s_shutdown_lock);
+    
+    return last_ms;
+}
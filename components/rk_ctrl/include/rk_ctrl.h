@@ -0,0 +1,59 @@
+#ifndef RK_CTRL_H
+#define RK_CTRL_H
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Port serwera sterującego
+#ifndef RK_CTRL_PORT
+#define RK_CTRL_PORT 80
+#endif
+
+// Stos zadania serwera - odpowiedzi budowane w buforze statycznym, nie na stosie
+#ifndef RK_CTRL_STACK
+#define RK_CTRL_STACK 3072
+#endif
+
+// Rozmiar bufora odpowiedzi JSON
+#ifndef RK_CTRL_JSON_SIZE
+#define RK_CTRL_JSON_SIZE 3072
+#endif
+
+// Token wymagany w nagłówku X-RK-Token dla wszystkich żądań (pusty - serwer nie startuje)
+#ifndef RK_CTRL_TOKEN
+#define RK_CTRL_TOKEN ""
+#endif
+
+/**
+ * @brief Uruchomienie lokalnego serwera HTTP do sterowania OTA i diagnostyki
+ *
+ * Serwer ma dwa gniazda i mały stos, aby nie konkurować z pobieraniem OTA o RAM.
+ * Każde żądanie wymaga nagłówka X-RK-Token równego RK_CTRL_TOKEN. Endpointy:
+ *   POST /ota/check    - sprawdzenie aktualizacji (RK_OTA_MSG_CHECK_UPDATE)
+ *   POST /ota/update   - wymuszenie aktualizacji (RK_OTA_MSG_FORCE_UPDATE)
+ *   POST /ota/apply    - przełączenie na obraz przygotowany w trybie etapowym
+ *   POST /ota/bench    - test łącza bez zapisu i restartu (RK_OTA_MSG_BENCHMARK)
+ *   POST /ota/bench_flash - test łącza z mierzonym zapisem do nieaktywnej partycji
+ *   GET  /ota/bench    - wynik ostatniego testu łącza (JSON)
+ *   POST /ota/cancel   - anulowanie trwającej aktualizacji
+ *   GET  /ota/stats    - statystyki i postęp OTA (JSON)
+ *   GET  /ota/progress - migawka postępu z licznikiem seq (do odpytywania)
+ *   GET  /metrics      - migawka rk_metrics (JSON)
+ *
+ * @return ESP_OK w przypadku sukcesu, ESP_ERR_INVALID_STATE gdy RK_CTRL_TOKEN jest pusty
+ */
+esp_err_t rk_ctrl_start(void);
+
+/**
+ * @brief Zatrzymanie serwera sterującego
+ */
+void rk_ctrl_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RK_CTRL_H
@@ -0,0 +1,266 @@
+#include "rk_ctrl.h"
+#include "rk_ota.h"
+#include "rk_metrics.h"
+#include "rk_common.h"
+#include "esp_log.h"
+#include "esp_http_server.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "RK_CTRL";
+
+// Zmienne globalne - serwer ma jedno zadanie, więc jeden bufor odpowiedzi wystarcza
+static httpd_handle_t s_server = NULL;
+static char s_json[RK_CTRL_JSON_SIZE];
+
+static bool ota_in_progress(const rk_ota_progress_t *progress)
+{
+    return progress->state == RK_OTA_STATE_CHECKING ||
+           progress->state == RK_OTA_STATE_DOWNLOADING ||
+           progress->state == RK_OTA_STATE_VERIFYING;
+}
+
+static esp_err_t send_json(httpd_req_t *req, const char *status, const char *json)
+{
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_sendstr(req, json);
+}
+
+// Token niepusty - sprawdzone w rk_ctrl_start
+static bool authorized(httpd_req_t *req)
+{
+    char token[64];
+    if (httpd_req_get_hdr_value_str(req, "X-RK-Token", token, sizeof(token)) != ESP_OK ||
+        strcmp(token, RK_CTRL_TOKEN) != 0) {
+        send_json(req, "401 Unauthorized", "{\"error\":\"unauthorized\"}");
+        return false;
+    }
+    return true;
+}
+
+static int format_progress(char *buf, size_t len, const rk_ota_progress_t *progress)
+{
+    return snprintf(buf, len, "{\"state\":\"%s\",\"bytes\":%lu,\"total\":%lu,\"err\":%d,\"seq\":%lu}",
+                    rk_ota_state_name(progress->state), progress->bytes,
+                    progress->total, progress->last_error, progress->seq);
+}
+
+// POST /ota/check, /ota/update, /ota/apply i /ota/bench* - typ wiadomości w user_ctx
+static esp_err_t ota_trigger_handler(httpd_req_t *req)
+{
+    if (!authorized(req)) {
+        return ESP_OK;
+    }
+    
+    rk_ota_progress_t progress;
+    rk_ota_get_progress(&progress);
+    if (ota_in_progress(&progress)) {
+        return send_json(req, HTTPD_409, "{\"error\":\"busy\"}");
+    }
+    
+    rk_ota_message_t msg = {
+        .type = (rk_ota_message_type_t)(intptr_t)req->user_ctx
+    };
+    if (msg.type == RK_OTA_MSG_APPLY && !rk_ota_is_update_staged()) {
+        return send_json(req, HTTPD_409, "{\"error\":\"not_staged\"}");
+    }
+    if (rk_ota_send_message(&msg) != ESP_OK) {
+        return send_json(req, HTTPD_503, "{\"error\":\"queue\"}");
+    }
+    
+    ESP_LOGI(TAG, "OTA zlecone przez %s", req->uri);
+    return send_json(req, HTTPD_202, "{\"queued\":true}");
+}
+
+// POST /ota/cancel
+static esp_err_t ota_cancel_handler(httpd_req_t *req)
+{
+    if (!authorized(req)) {
+        return ESP_OK;
+    }
+    
+    if (!rk_ota_cancel()) {
+        return send_json(req, HTTPD_409, "{\"error\":\"not_running\"}");
+    }
+    
+    ESP_LOGI(TAG, "Anulowanie OTA zlecone");
+    return send_json(req, HTTPD_202, "{\"cancelling\":true}");
+}
+
+// GET /ota/stats
+static esp_err_t ota_stats_handler(httpd_req_t *req)
+{
+    if (!authorized(req)) {
+        return ESP_OK;
+    }
+    
+    rk_ota_stats_t stats;
+    rk_ota_progress_t progress;
+    rk_ota_get_stats(&stats);
+    rk_ota_get_progress(&progress);
+    
+    int pos = snprintf(s_json, sizeof(s_json),
+                       "{\"version\":\"%s\",\"checks\":%lu,\"checks_notify\":%lu,\"not_modified\":%lu,\"notify_up\":%s,"
+                       "\"downloads\":%lu,\"dl_bytes\":%lu,\"dl_ms\":%lu,"
+                       "\"dl_throttle_ms\":%lu,\"dl_conns\":%lu,\"staged\":%s,\"staged_applies\":%lu,"
+                       "\"dns\":{\"lookups\":%lu,\"hits\":%lu,\"misses\":%lu,\"fail\":%lu,\"evict\":%lu,\"rejected\":%lu},"
+                       "\"tls\":{\"pinned\":%lu,\"bundle\":%lu,\"fallbacks\":%lu},"
+                       "\"mirror\":{\"dl\":%lu,\"fallbacks\":%lu,\"sig_fail\":%lu,\"old\":%lu},"
+                       "\"local\":{\"updates\":%lu,\"frames\":%lu,\"retransmits\":%lu,\"crc_errors\":%lu},"
+                       "\"config\":{\"version\":%lu,\"checks\":%lu,\"not_modified\":%lu,"
+                       "\"updates\":%lu,\"rejected\":%lu},\"progress\":",
+                       rk_ota_get_version(), stats.checks, stats.checks_from_notify, stats.firmware_not_modified,
+                       stats.notify_channel_up ? "true" : "false",
+                       stats.downloads, stats.download_bytes_last, stats.download_last_ms,
+                       stats.download_throttle_ms, stats.download_connections,
+                       rk_ota_is_update_staged() ? "true" : "false",
+                       stats.staged_applies,
+                       stats.dns_lookups, stats.dns_hits, stats.dns_misses, stats.dns_failures,
+                       stats.dns_evictions, stats.dns_rejected,
+                       stats.tls_pinned.handshakes, stats.tls_bundle.handshakes, stats.tls_fallbacks,
+                       stats.mirror_downloads, stats.mirror_fallbacks, stats.signature_failures,
+                       stats.mirror_version_rejects,
+                       stats.local_updates, stats.serial_frames, stats.serial_retransmits,
+                       stats.serial_crc_errors,
+                       stats.config_version, stats.config_checks, stats.config_not_modified,
+                       stats.config_updates, stats.config_rejected);
+    if (pos > 0 && (size_t)pos < sizeof(s_json)) {
+        pos += format_progress(s_json + pos, sizeof(s_json) - pos, &progress);
+    }
+    if (pos > 0 && (size_t)pos < sizeof(s_json) - 1) {
+        s_json[pos++] = '}';
+        s_json[pos] = '\0';
+    }
+    
+    return send_json(req, HTTPD_200, s_json);
+}
+
+// GET /ota/bench - wynik ostatniego testu łącza
+static esp_err_t ota_bench_handler(httpd_req_t *req)
+{
+    if (!authorized(req)) {
+        return ESP_OK;
+    }
+    
+    rk_ota_bench_result_t bench;
+    rk_ota_get_benchmark(&bench);
+    
+    char sha[sizeof(bench.sha256) * 2 + 1];
+    for (size_t i = 0; i < sizeof(bench.sha256); i++) {
+        snprintf(sha + i * 2, 3, "%02x", bench.sha256[i]);
+    }
+    
+    snprintf(s_json, sizeof(s_json),
+             "{\"err\":%d,\"flash\":%s,\"redirected\":%s,\"http\":%s,\"signed\":%s,"
+             "\"bytes\":%lu,\"open_ms\":%lu,\"dns_ms\":%lu,\"tls_ms\":%lu,\"download_ms\":%lu,"
+             "\"cpu_ms\":%lu,\"hash_ms\":%lu,\"sig_ms\":%lu,\"flash_ms\":%lu,"
+             "\"bps\":%lu,\"buf_psram\":%s,\"hash_ok\":%s,\"sha256\":\"%s\"}",
+             bench.result, bench.with_flash ? "true" : "false",
+             bench.redirected ? "true" : "false", bench.plain_http ? "true" : "false",
+             bench.signed_image ? "true" : "false", bench.bytes, bench.open_ms,
+             bench.dns_ms, bench.tls_ms, bench.download_ms, bench.cpu_ms, bench.hash_ms,
+             bench.signature_ms, bench.flash_ms, bench.throughput_bps,
+             bench.buffer_psram ? "true" : "false",
+             !bench.hash_appended ? "null" : bench.hash_ok ? "true" : "false", sha);
+    
+    return send_json(req, HTTPD_200, s_json);
+}
+
+// GET /ota/progress - jedna migawka bez blokowania zadania serwera; klient odpytuje
+// i porównuje seq z poprzednią odpowiedzią
+static esp_err_t ota_progress_handler(httpd_req_t *req)
+{
+    if (!authorized(req)) {
+        return ESP_OK;
+    }
+    
+    rk_ota_progress_t progress;
+    rk_ota_get_progress(&progress);
+    format_progress(s_json, sizeof(s_json), &progress);
+    
+    return send_json(req, HTTPD_200, s_json);
+}
+
+// GET /metrics
+static esp_err_t metrics_handler(httpd_req_t *req)
+{
+    if (!authorized(req)) {
+        return ESP_OK;
+    }
+    
+    if (rk_metrics_to_json(s_json, sizeof(s_json)) >= sizeof(s_json)) {
+        ESP_LOGW(TAG, "Migawka metryk obcięta - zwiększ RK_CTRL_JSON_SIZE");
+    }
+    
+    return send_json(req, HTTPD_200, s_json);
+}
+
+static const httpd_uri_t s_handlers[] = {
+    { .uri = "/ota/check",    .method = HTTP_POST, .handler = ota_trigger_handler,
+      .user_ctx = (void *)RK_OTA_MSG_CHECK_UPDATE },
+    { .uri = "/ota/update",   .method = HTTP_POST, .handler = ota_trigger_handler,
+      .user_ctx = (void *)RK_OTA_MSG_FORCE_UPDATE },
+    { .uri = "/ota/apply",    .method = HTTP_POST, .handler = ota_trigger_handler,
+      .user_ctx = (void *)RK_OTA_MSG_APPLY },
+    { .uri = "/ota/bench",    .method = HTTP_POST, .handler = ota_trigger_handler,
+      .user_ctx = (void *)RK_OTA_MSG_BENCHMARK },
+    { .uri = "/ota/bench_flash", .method = HTTP_POST, .handler = ota_trigger_handler,
+      .user_ctx = (void *)RK_OTA_MSG_BENCHMARK_FLASH },
+    { .uri = "/ota/bench_mirror", .method = HTTP_POST, .handler = ota_trigger_handler,
+      .user_ctx = (void *)RK_OTA_MSG_BENCHMARK_MIRROR },
+    { .uri = "/ota/bench",    .method = HTTP_GET,  .handler = ota_bench_handler },
+    { .uri = "/ota/cancel",   .method = HTTP_POST, .handler = ota_cancel_handler },
+    { .uri = "/ota/stats",    .method = HTTP_GET,  .handler = ota_stats_handler },
+    { .uri = "/ota/progress", .method = HTTP_GET,  .handler = ota_progress_handler },
+    { .uri = "/metrics",      .method = HTTP_GET,  .handler = metrics_handler },
+};
+
+esp_err_t rk_ctrl_start(void)
+{
+    if (s_server != NULL) {
+        ESP_LOGW(TAG, "Serwer sterujący już działa");
+        return ESP_OK;
+    }
+    
+    // Serwer może zlecić aktualizację i restart - bez tokenu nie startuje
+    if (strlen(RK_CTRL_TOKEN) == 0) {
+        ESP_LOGE(TAG, "Brak RK_CTRL_TOKEN - serwer sterujący nie zostanie uruchomiony");
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = RK_CTRL_PORT;
+    config.stack_size = RK_CTRL_STACK;
+    config.task_priority = 1;           // Poniżej OTA - diagnostyka nie spowalnia pobierania
+    config.max_open_sockets = 2;        // Drugie gniazdo dla /ota/cancel, gdy pierwsze jest zajęte
+    config.backlog_conn = 2;
+    config.lru_purge_enable = true;     // Nowe połączenie wypiera bezczynne
+    config.max_uri_handlers = sizeof(s_handlers) / sizeof(s_handlers[0]);
+    config.max_resp_headers = 4;
+    
+    esp_err_t ret = httpd_start(&s_server, &config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Nie można uruchomić serwera sterującego: %s", esp_err_to_name(ret));
+        s_server = NULL;
+        return ret;
+    }
+    
+    for (size_t i = 0; i < sizeof(s_handlers) / sizeof(s_handlers[0]); i++) {
+        httpd_register_uri_handler(s_server, &s_handlers[i]);
+    }
+    
+    // Restart zlecają zadania spoza serwera - httpd_stop nie jest wołane z własnego zadania
+    rk_shutdown_register("ctrl", rk_ctrl_stop);
+    ESP_LOGI(TAG, "Serwer sterujący na porcie %d", RK_CTRL_PORT);
+    return ESP_OK;
+}
+
+void rk_ctrl_stop(void)
+{
+    if (s_server != NULL) {
+        httpd_stop(s_server);
+        s_server = NULL;
+    }
+}
@@ -1,17 +1,23 @@
 #ifndef RK_LED_H
 #define RK_LED_H
 
-#include "driver/gpio.h"
+#include "esp_err.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "rk_common.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "driver/gpio.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 // Definicje pinów LED dla różnych modeli ESP32
-#ifdef CONFIG_IDF_TARGET_ESP32
+#if CONFIG_IDF_TARGET_LINUX
+    #define LED_GPIO 2
+#elif CONFIG_IDF_TARGET_ESP32
     #define LED_GPIO GPIO_NUM_2
 #elif CONFIG_IDF_TARGET_ESP32S2
     #define LED_GPIO GPIO_NUM_2
@@ -37,15 +43,48 @@ typedef enum {
     RK_LED_MSG_OTA_SUCCESS,
     RK_LED_MSG_OTA_FAILED,
     RK_LED_MSG_CUSTOM_PATTERN,
+    RK_LED_MSG_PATTERN,
     RK_LED_MSG_STOP
 } rk_led_message_type_t;
 
+// Pełna jasność kroku wzorca (poziomy pośrednie realizuje PWM)
+#define RK_LED_LEVEL_ON 255
+
+// Krok wzorca: czas trwania (0 = utrzymaj do zmiany wzorca) i jasność 0-255
+typedef struct {
+    uint16_t duration_ms;
+    uint8_t level;
+} rk_led_step_t;
+
+// Wzorzec LED - stała tablica kroków, odtwarzana przez sekwencer bez alokacji
+typedef struct {
+    const rk_led_step_t *steps;
+    uint8_t step_count;
+    bool repeat;                // false - po ostatnim kroku zostaje jego poziom
+} rk_led_pattern_t;
+
 typedef struct {
     rk_led_message_type_t type;
     uint32_t on_time_ms;
     uint32_t off_time_ms;
+    const rk_led_pattern_t *pattern;    // Dla RK_LED_MSG_PATTERN (musi żyć stale)
 } rk_led_message_t;
 
+// Wbudowane wzorce
+extern const rk_led_pattern_t rk_led_pattern_heartbeat;
+extern const rk_led_pattern_t rk_led_pattern_double_blink;
+extern const rk_led_pattern_t rk_led_pattern_breathe;
+extern const rk_led_pattern_t rk_led_pattern_error;
+
+// Statystyki LED - koszt wzorców dla CPU
+typedef struct {
+    uint32_t sw_edges;          // Zmiany stanu pinu wykonane przez CPU
+    uint32_t timer_wakeups;     // Wywołania timera programowego
+    uint32_t hw_patterns;       // Wzorce uruchomione w sprzęcie (LEDC)
+    uint32_t sw_patterns;       // Wzorce uruchomione programowo (fallback)
+    bool hw_pattern_active;     // Aktualny wzorzec działa w sprzęcie
+} rk_led_stats_t;
+
 /**
  * @brief Inicjalizacja komponentu LED
  * @return ESP_OK w przypadku sukcesu
@@ -54,9 +93,10 @@ esp_err_t rk_led_init(void);
 
 /**
  * @brief Uruchomienie zadania LED
+ * @param config Rdzeń, priorytet i stos zadania (NULL - bez przypięcia, priorytet 3)
  * @return ESP_OK w przypadku sukcesu
  */
-esp_err_t rk_led_start_task(void);
+esp_err_t rk_led_start_task(const rk_task_config_t *config);
 
 /**
  * @brief Wysłanie wiadomości do zadania LED
@@ -70,6 +110,19 @@ esp_err_t rk_led_send_message(const rk_led_message_t *msg);
  */
 void rk_led_stop_task(void);
 
+/**
+ * @brief Pobranie statystyk LED
+ * @param stats Struktura do wypełnienia
+ */
+void rk_led_get_stats(rk_led_stats_t *stats);
+
+/**
+ * @brief Odtworzenie wzorca przez sekwencer (przełączenie w zadaniu timerów)
+ * @param pattern Wzorzec o statycznym czasie życia, NULL zatrzymuje sekwencer
+ * @return ESP_OK w przypadku sukcesu
+ */
+esp_err_t rk_led_play_pattern(const rk_led_pattern_t *pattern);
+
 // Podstawowe funkcje LED (dla kompatybilności)
 void rk_led_on(void);
 void rk_led_off(void);
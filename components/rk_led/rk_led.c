@@ -1,41 +1,180 @@
 #include "rk_led.h"
+#include "rk_led_hal.h"
+#include "rk_common.h"
+#include "rk_log.h"
 #include "esp_log.h"
 #include "freertos/timers.h"
 
 static const char *TAG = "RK_LED";
 
+// Wbudowane wzorce - stałe tablice kroków, bez alokacji w czasie działania
+static const rk_led_step_t s_startup_steps[] = {
+    {200, RK_LED_LEVEL_ON}, {200, 0}, {200, RK_LED_LEVEL_ON}, {200, 0}, {200, RK_LED_LEVEL_ON}, {200, 0},
+};
+static const rk_led_step_t s_connecting_steps[] = {{500, RK_LED_LEVEL_ON}, {500, 0}};
+static const rk_led_step_t s_disconnected_steps[] = {{100, RK_LED_LEVEL_ON}, {100, 0}};
+static const rk_led_step_t s_ota_steps[] = {{50, RK_LED_LEVEL_ON}, {50, 0}};
+static const rk_led_step_t s_solid_steps[] = {{0, RK_LED_LEVEL_ON}};
+static const rk_led_step_t s_off_steps[] = {{0, 0}};
+static const rk_led_step_t s_heartbeat_steps[] = {
+    {80, RK_LED_LEVEL_ON}, {120, 0}, {80, 160}, {720, 0},
+};
+static const rk_led_step_t s_double_blink_steps[] = {
+    {100, RK_LED_LEVEL_ON}, {100, 0}, {100, RK_LED_LEVEL_ON}, {1700, 0},
+};
+static const rk_led_step_t s_error_steps[] = {
+    {150, RK_LED_LEVEL_ON}, {150, 0}, {150, RK_LED_LEVEL_ON}, {150, 0},
+    {150, RK_LED_LEVEL_ON}, {150, 0}, {600, RK_LED_LEVEL_ON}, {1500, 0},
+};
+static const rk_led_step_t s_breathe_steps[] = {
+    {80, 8}, {80, 24}, {80, 48}, {80, 80}, {80, 120}, {80, 170}, {80, 220}, {160, 255},
+    {80, 220}, {80, 170}, {80, 120}, {80, 80}, {80, 48}, {80, 24}, {80, 8}, {400, 0},
+};
+
+#define PATTERN(steps, repeat) { (steps), sizeof(steps) / sizeof((steps)[0]), (repeat) }
+
+static const rk_led_pattern_t s_startup_pattern = PATTERN(s_startup_steps, false);
+static const rk_led_pattern_t s_connecting_pattern = PATTERN(s_connecting_steps, true);
+static const rk_led_pattern_t s_disconnected_pattern = PATTERN(s_disconnected_steps, true);
+static const rk_led_pattern_t s_ota_pattern = PATTERN(s_ota_steps, true);
+static const rk_led_pattern_t s_solid_pattern = PATTERN(s_solid_steps, false);
+static const rk_led_pattern_t s_off_pattern = PATTERN(s_off_steps, false);
+
+const rk_led_pattern_t rk_led_pattern_heartbeat = PATTERN(s_heartbeat_steps, true);
+const rk_led_pattern_t rk_led_pattern_double_blink = PATTERN(s_double_blink_steps, true);
+const rk_led_pattern_t rk_led_pattern_error = PATTERN(s_error_steps, true);
+const rk_led_pattern_t rk_led_pattern_breathe = PATTERN(s_breathe_steps, true);
+
+#define LED_TASK_STACK 4096
+#define LED_QUEUE_LEN  10
+
+// Bufory statyczne (RK_STATIC_ALLOC)
+RK_TASK_BUFFER(led_task, LED_TASK_STACK);
+RK_QUEUE_BUFFER(led_queue, LED_QUEUE_LEN, sizeof(rk_led_message_t));
+
 // Zmienne globalne
 static QueueHandle_t led_queue = NULL;
 static TaskHandle_t led_task_handle = NULL;
-static TimerHandle_t blink_timer_on = NULL;
-static TimerHandle_t blink_timer_off = NULL;
 static bool led_state = false;
 static bool task_running = false;
+static TaskHandle_t s_stop_waiter = NULL;  // Czeka w rk_led_stop_task na koniec zadania
+
+// Sekwencer: jeden statyczny timer, stan zmieniany wyłącznie w zadaniu timerów
+RK_TIMER_BUFFER(seq_timer);
+static TimerHandle_t seq_timer = NULL;
+static const rk_led_pattern_t *seq_pattern = NULL;
+static uint8_t seq_step = 0;
+static bool hw_pattern_active = false;
+static rk_led_stats_t s_stats = {0};
+
+// Wzorzec on/off z wiadomości - kroki zapisywane tylko w zadaniu timerów (seq_switch_custom)
+static rk_led_step_t s_custom_steps[2];
+static const rk_led_pattern_t s_custom_pattern = { s_custom_steps, 2, true };
 
 // Funkcje pomocnicze
-static void blink_timer_callback(TimerHandle_t xTimer);
-static void asymmetric_on_callback(TimerHandle_t xTimer);
-static void asymmetric_off_callback(TimerHandle_t xTimer);
+static void seq_timer_callback(TimerHandle_t xTimer);
 static void led_task(void *pvParameters);
 
-static void blink_timer_callback(TimerHandle_t xTimer)
+static void seq_apply_step(void)
+{
+    const rk_led_step_t *step = &seq_pattern->steps[seq_step];
+    
+    rk_led_hal_set_brightness(step->level);
+    if ((step->level > 0) != led_state) {
+        s_stats.sw_edges++;
+    }
+    led_state = step->level > 0;
+    
+    // Czas 0 - poziom utrzymywany do zmiany wzorca
+    if (step->duration_ms > 0) {
+        TickType_t ticks = pdMS_TO_TICKS(step->duration_ms);
+        xTimerChangePeriod(seq_timer, ticks > 0 ? ticks : 1, 0);
+    }
+}
+
+static void seq_timer_callback(TimerHandle_t xTimer)
+{
+    s_stats.timer_wakeups++;
+    
+    // Timer mógł wygasnąć przed obsługą polecenia stop (np. gdy xTimerStop nie trafił do kolejki)
+    if (seq_pattern == NULL) {
+        return;
+    }
+    
+    if (++seq_step >= seq_pattern->step_count) {
+        if (!seq_pattern->repeat) {
+            return;  // Wzorzec jednorazowy - zostaje ostatni poziom
+        }
+        seq_step = 0;
+    }
+    seq_apply_step();
+}
+
+// Zwykłe mruganie pełną jasnością: dwa kroki ON/OFF w pętli - kandydat dla LEDC
+static bool is_plain_blink(const rk_led_pattern_t *pattern)
 {
-    rk_led_toggle();
+    return pattern->repeat && pattern->step_count == 2 &&
+           pattern->steps[0].level == RK_LED_LEVEL_ON && pattern->steps[1].level == 0 &&
+           pattern->steps[0].duration_ms > 0 && pattern->steps[1].duration_ms > 0;
 }
 
-static void asymmetric_on_callback(TimerHandle_t xTimer)
+static void seq_stop(void)
 {
-    rk_led_on();
-    if (blink_timer_off != NULL) {
-        xTimerStart(blink_timer_off, 0);
+    if (hw_pattern_active) {
+        rk_led_hal_pattern_stop();
+        hw_pattern_active = false;
+        rk_led_hal_set_level(led_state);
     }
+    
+    xTimerStop(seq_timer, 0);
+    seq_pattern = NULL;
 }
 
-static void asymmetric_off_callback(TimerHandle_t xTimer)
+// Przełączenie wzorca w zadaniu timerów (xTimerPendFunctionCall) - O(1), bez sterty
+static void seq_switch(void *pattern_ptr, uint32_t unused)
 {
-    rk_led_off();
-    if (blink_timer_on != NULL) {
-        xTimerStart(blink_timer_on, 0);
+    const rk_led_pattern_t *pattern = (const rk_led_pattern_t *)pattern_ptr;
+    
+    seq_stop();
+    if (pattern == NULL || pattern->step_count == 0) {
+        return;
+    }
+    
+    if (is_plain_blink(pattern) &&
+        rk_led_hal_pattern_start(pattern->steps[0].duration_ms, pattern->steps[1].duration_ms)) {
+        hw_pattern_active = true;
+        s_stats.hw_patterns++;
+        return;
+    }
+    
+    s_stats.sw_patterns++;
+    seq_pattern = pattern;
+    seq_step = 0;
+    seq_apply_step();
+}
+
+// Czasy przekazane w parametrze polecenia (on << 16 | off) - wzorzec zmieniany tylko tutaj,
+// więc nadawca nie nadpisze kroków, które sekwencer właśnie odczytuje
+static void seq_switch_custom(void *unused, uint32_t times)
+{
+    s_custom_steps[0].duration_ms = times >> 16;
+    s_custom_steps[0].level = RK_LED_LEVEL_ON;
+    s_custom_steps[1].duration_ms = times & 0xFFFF;
+    s_custom_steps[1].level = 0;
+    
+    seq_switch((void *)&s_custom_pattern, 0);
+}
+
+static void custom_blink_start(uint32_t on_time_ms, uint32_t off_time_ms)
+{
+    if (seq_timer == NULL) {
+        return;
+    }
+    
+    uint32_t times = ((on_time_ms > 0xFFFF ? 0xFFFF : on_time_ms) << 16) |
+                     (off_time_ms > 0xFFFF ? 0xFFFF : off_time_ms);
+    if (xTimerPendFunctionCall(seq_switch_custom, NULL, times, pdMS_TO_TICKS(10)) != pdPASS) {
+        ESP_LOGW(TAG, "Kolejka timerów pełna - pominięto zmianę wzorca");
     }
 }
 
@@ -45,64 +184,58 @@ static void led_task(void *pvParameters)
     
     rk_led_message_t msg;
     
-    // Sygnalizacja startu
-    for(int i = 0; i < 3; i++) {
-        rk_led_on();
-        vTaskDelay(pdMS_TO_TICKS(200));
-        rk_led_off();
-        vTaskDelay(pdMS_TO_TICKS(200));
-    }
-    
     while(task_running) {
         if(xQueueReceive(led_queue, &msg, pdMS_TO_TICKS(100)) == pdTRUE) {
-            ESP_LOGI(TAG, "Otrzymano wiadomość typu: %d", msg.type);
-            
-            // Zatrzymaj poprzednie mruganie
-            rk_led_blink_stop();
+            RK_LOGI(LED, LED_MSG, msg.type);
             
             switch(msg.type) {
                 case RK_LED_MSG_STARTUP:
-                    // Już wykonane na początku
+                    // Sygnalizacja startu na timerze - nie blokuje kolejki
+                    rk_led_play_pattern(&s_startup_pattern);
                     break;
                     
                 case RK_LED_MSG_WIFI_CONNECTING:
-                    ESP_LOGI(TAG, "WiFi łączenie - symetryczne mruganie");
-                    rk_led_blink_start(500);
+                    RK_LOGI(LED, LED_WIFI_CONNECTING);
+                    rk_led_play_pattern(&s_connecting_pattern);
                     break;
                     
                 case RK_LED_MSG_WIFI_CONNECTED:
-                    ESP_LOGI(TAG, "WiFi połączone - asymetryczne mruganie");
-                    rk_led_blink_asymmetric_start(msg.on_time_ms, msg.off_time_ms);
+                    RK_LOGI(LED, LED_WIFI_CONNECTED);
+                    custom_blink_start(msg.on_time_ms, msg.off_time_ms);
                     break;
                     
                 case RK_LED_MSG_WIFI_DISCONNECTED:
-                    ESP_LOGI(TAG, "WiFi rozłączone - szybkie mruganie");
-                    rk_led_blink_start(100);
+                    RK_LOGI(LED, LED_WIFI_DISCONNECTED);
+                    rk_led_play_pattern(&s_disconnected_pattern);
                     break;
                     
                 case RK_LED_MSG_OTA_START:
-                    ESP_LOGI(TAG, "OTA rozpoczęte - bardzo szybkie mruganie");
-                    rk_led_blink_start(50);
+                    RK_LOGI(LED, LED_OTA_START);
+                    rk_led_play_pattern(&s_ota_pattern);
                     break;
                     
                 case RK_LED_MSG_OTA_SUCCESS:
-                    ESP_LOGI(TAG, "OTA sukces - stałe świecenie");
-                    rk_led_on();
+                    RK_LOGI(LED, LED_OTA_SUCCESS);
+                    rk_led_play_pattern(&s_solid_pattern);
                     break;
                     
                 case RK_LED_MSG_OTA_FAILED:
-                    ESP_LOGI(TAG, "OTA błąd - powrót do normalnego trybu");
-                    rk_led_blink_asymmetric_start(msg.on_time_ms, msg.off_time_ms);
+                    RK_LOGI(LED, LED_OTA_FAILED);
+                    custom_blink_start(msg.on_time_ms, msg.off_time_ms);
                     break;
                     
                 case RK_LED_MSG_CUSTOM_PATTERN:
-                    ESP_LOGI(TAG, "Własny wzorzec: %lu/%lu ms", msg.on_time_ms, msg.off_time_ms);
-                    rk_led_blink_asymmetric_start(msg.on_time_ms, msg.off_time_ms);
+                    RK_LOGI(LED, LED_CUSTOM, msg.on_time_ms, msg.off_time_ms);
+                    custom_blink_start(msg.on_time_ms, msg.off_time_ms);
+                    break;
+                    
+                case RK_LED_MSG_PATTERN:
+                    rk_led_play_pattern(msg.pattern);
                     break;
                     
                 case RK_LED_MSG_STOP:
                     ESP_LOGI(TAG, "Zatrzymanie LED");
-                    rk_led_off();
+                    rk_led_play_pattern(&s_off_pattern);
                     task_running = false;
                     break;
                     
@@ -114,20 +247,22 @@ static void led_task(void *pvParameters)
     }
     
     ESP_LOGI(TAG, "Zadanie LED zakończone");
-    vTaskDelete(NULL);
+    rk_join_signal(s_stop_waiter);
+    rk_task_delete(NULL);
 }
 
 esp_err_t rk_led_init(void)
 {
-    gpio_config_t io_conf = {
-        .intr_type = GPIO_INTR_DISABLE,
-        .mode = GPIO_MODE_OUTPUT,
-        .pin_bit_mask = (1ULL << LED_GPIO),
-        .pull_down_en = 0,
-        .pull_up_en = 0,
-    };
+    if (seq_timer == NULL) {
+        seq_timer = rk_timer_create("led_seq_timer",
+                                    1,
+                                    pdFALSE,
+                                    NULL,
+                                    seq_timer_callback,
+                                    RK_TIMER_STATIC(seq_timer));
+    }
     
-    esp_err_t ret = gpio_config(&io_conf);
+    esp_err_t ret = rk_led_hal_init(LED_GPIO);
     if (ret == ESP_OK) {
         rk_led_off();
         ESP_LOGI(TAG, "LED zainicjalizowany na GPIO %d", LED_GPIO);
@@ -136,14 +271,20 @@ esp_err_t rk_led_init(void)
     return ret;
 }
 
-esp_err_t rk_led_start_task(void)
+esp_err_t rk_led_start_task(const rk_task_config_t *config)
 {
+    static const rk_task_config_t defaults = {
+        .core = RK_TASK_CORE_ANY,
+        .priority = 3,
+        .stack_bytes = LED_TASK_STACK,
+    };
+    
     if (task_running) {
         ESP_LOGW(TAG, "Zadanie LED już działa");
         return ESP_OK;
     }
     
-    led_queue = xQueueCreate(10, sizeof(rk_led_message_t));
+    led_queue = rk_queue_create(LED_QUEUE_LEN, sizeof(rk_led_message_t), RK_QUEUE_STATIC(led_queue));
     if (led_queue == NULL) {
         ESP_LOGE(TAG, "Nie można utworzyć kolejki LED");
         return ESP_ERR_NO_MEM;
@@ -151,21 +292,18 @@ esp_err_t rk_led_start_task(void)
     
     task_running = true;
     
-    BaseType_t ret = xTaskCreate(led_task, 
-                                "led_task", 
-                                4096, 
-                                NULL, 
-                                3, 
-                                &led_task_handle);
+    BaseType_t ret = rk_task_create_config(led_task, "led_task", NULL, config, &defaults,
+                                          &led_task_handle, RK_TASK_STATIC_CFG(led_task));
     
     if (ret != pdPASS) {
         ESP_LOGE(TAG, "Nie można utworzyć zadania LED");
-        vQueueDelete(led_queue);
+        rk_queue_delete(led_queue);
         led_queue = NULL;
         task_running = false;
         return ESP_ERR_NO_MEM;
     }
     
+    rk_shutdown_register("led", rk_led_stop_task);
     ESP_LOGI(TAG, "Zadanie LED uruchomione");
     return ESP_OK;
 }
@@ -188,17 +326,22 @@ esp_err_t rk_led_send_message(const rk_led_message_t *msg)
 void rk_led_stop_task(void)
 {
     if (task_running) {
+        rk_join_prepare();
+        s_stop_waiter = xTaskGetCurrentTaskHandle();
         rk_led_message_t msg = {.type = RK_LED_MSG_STOP};
         rk_led_send_message(&msg);
         
-        // Poczekaj na zakończenie zadania
-        if (led_task_handle != NULL) {
-            vTaskDelay(pdMS_TO_TICKS(500));
-            led_task_handle = NULL;
+        // Kolejka usuwana dopiero po potwierdzeniu - zadanie mogło jeszcze z niej czytać
+        bool stopped = rk_join_wait(RK_TASK_STOP_TIMEOUT_MS);
+        s_stop_waiter = NULL;
+        if (!stopped) {
+            ESP_LOGE(TAG, "Zadanie LED nie potwierdziło zakończenia - kolejka pozostaje");
+            return;
         }
+        led_task_handle = NULL;
         
         if (led_queue != NULL) {
-            vQueueDelete(led_queue);
+            rk_queue_delete(led_queue);
             led_queue = NULL;
         }
         
@@ -206,74 +349,63 @@ void rk_led_stop_task(void)
     }
 }
 
+void rk_led_get_stats(rk_led_stats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    
+    *stats = s_stats;
+    stats->hw_pattern_active = hw_pattern_active;
+}
+
 // Podstawowe funkcje LED
 void rk_led_on(void)
 {
-    gpio_set_level(LED_GPIO, 1);
+    rk_led_hal_set_level(true);
     led_state = true;
 }
 
 void rk_led_off(void)
 {
-    gpio_set_level(LED_GPIO, 0);
+    rk_led_hal_set_level(false);
     led_state = false;
 }
 
 void rk_led_toggle(void)
 {
-    led_state = !led_state;
-    gpio_set_level(LED_GPIO, led_state ? 1 : 0);
+    if (led_state) {
+        rk_led_off();
+    } else {
+        rk_led_on();
+    }
 }
 
-void rk_led_blink_start(uint32_t period_ms)
+esp_err_t rk_led_play_pattern(const rk_led_pattern_t *pattern)
 {
-    rk_led_blink_stop();
-    
-    blink_timer_on = xTimerCreate("blink_timer",
-                                  pdMS_TO_TICKS(period_ms),
-                                  pdTRUE,
-                                  NULL,
-                                  blink_timer_callback);
+    if (seq_timer == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
     
-    if (blink_timer_on != NULL) {
-        xTimerStart(blink_timer_on, 0);
+    if (xTimerPendFunctionCall(seq_switch, (void *)pattern, 0, pdMS_TO_TICKS(10)) != pdPASS) {
+        ESP_LOGW(TAG, "Kolejka timerów pełna - pominięto zmianę wzorca");
+        return ESP_ERR_TIMEOUT;
     }
+    
+    return ESP_OK;
+}
+
+void rk_led_blink_start(uint32_t period_ms)
+{
+    custom_blink_start(period_ms, period_ms);
 }
 
 void rk_led_blink_asymmetric_start(uint32_t on_time_ms, uint32_t off_time_ms)
 {
-    rk_led_blink_stop();
-    
-    blink_timer_on = xTimerCreate("blink_on_timer",
-                                  pdMS_TO_TICKS(on_time_ms + off_time_ms),
-                                  pdTRUE,
-                                  NULL,
-                                  asymmetric_on_callback);
-    
-    blink_timer_off = xTimerCreate("blink_off_timer",
-                                   pdMS_TO_TICKS(on_time_ms),
-                                   pdFALSE,
-                                   NULL,
-                                   asymmetric_off_callback);
-    
-    if (blink_timer_on != NULL && blink_timer_off != NULL) {
-        rk_led_on();
-        xTimerStart(blink_timer_off, 0);
-        xTimerStart(blink_timer_on, 0);
-    }
+    custom_blink_start(on_time_ms, off_time_ms);
 }
 
 void rk_led_blink_stop(void)
 {
-    if (blink_timer_on != NULL) {
-        xTimerStop(blink_timer_on, 0);
-        xTimerDelete(blink_timer_on, 0);
-        blink_timer_on = NULL;
-    }
-    
-    if (blink_timer_off != NULL) {
-        xTimerStop(blink_timer_off, 0);
-        xTimerDelete(blink_timer_off, 0);
-        blink_timer_off = NULL;
-    }
+    rk_led_play_pattern(NULL);
 }
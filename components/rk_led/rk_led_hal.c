@@ -0,0 +1,158 @@
+#include "rk_led_hal.h"
+#include "esp_log.h"
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "soc/soc_caps.h"
+
+static const char *TAG = "RK_LED_HAL";
+
+#define LED_LEDC_MODE    LEDC_LOW_SPEED_MODE
+#define LED_LEDC_TIMER   LEDC_TIMER_0
+#define LED_LEDC_CHANNEL LEDC_CHANNEL_0
+#define LED_LEDC_SRC_HZ  80000000  // APB - do oszacowania minimalnej rozdzielczości
+#define LED_LEDC_DIV_MAX 1023      // Maksymalny dzielnik zegara timera LEDC
+#define LED_PWM_TIMER    LEDC_TIMER_1
+#define LED_PWM_FREQ_HZ  5000
+#define LED_PWM_BITS     LEDC_TIMER_8_BIT
+
+static int s_gpio = -1;
+static bool s_pattern_active = false;
+static bool s_pwm_active = false;
+
+static esp_err_t configure_gpio(void)
+{
+    gpio_config_t io_conf = {
+        .intr_type = GPIO_INTR_DISABLE,
+        .mode = GPIO_MODE_OUTPUT,
+        .pin_bit_mask = (1ULL << s_gpio),
+        .pull_down_en = 0,
+        .pull_up_en = 0,
+    };
+    
+    return gpio_config(&io_conf);
+}
+
+esp_err_t rk_led_hal_init(int gpio)
+{
+    s_gpio = gpio;
+    return configure_gpio();
+}
+
+static void pwm_stop(void)
+{
+    if (!s_pwm_active) {
+        return;
+    }
+    
+    ledc_stop(LED_LEDC_MODE, LED_LEDC_CHANNEL, 0);
+    configure_gpio();  // Odłącz pin od LEDC
+    s_pwm_active = false;
+}
+
+void rk_led_hal_set_level(bool on)
+{
+    pwm_stop();
+    gpio_set_level(s_gpio, on ? 1 : 0);
+}
+
+void rk_led_hal_set_brightness(uint8_t level)
+{
+    if (level == 0 || level == 255) {
+        rk_led_hal_set_level(level != 0);
+        return;
+    }
+    
+    // Kolejne kroki tylko zmieniają wypełnienie - timer i kanał już skonfigurowane
+    if (s_pwm_active) {
+        ledc_set_duty(LED_LEDC_MODE, LED_LEDC_CHANNEL, level);
+        ledc_update_duty(LED_LEDC_MODE, LED_LEDC_CHANNEL);
+        return;
+    }
+    
+    ledc_timer_config_t timer_conf = {
+        .speed_mode = LED_LEDC_MODE,
+        .duty_resolution = LED_PWM_BITS,
+        .timer_num = LED_PWM_TIMER,
+        .freq_hz = LED_PWM_FREQ_HZ,
+        .clk_cfg = LEDC_AUTO_CLK,
+    };
+    ledc_channel_config_t channel_conf = {
+        .gpio_num = s_gpio,
+        .speed_mode = LED_LEDC_MODE,
+        .channel = LED_LEDC_CHANNEL,
+        .intr_type = LEDC_INTR_DISABLE,
+        .timer_sel = LED_PWM_TIMER,
+        .duty = level,
+        .hpoint = 0,
+    };
+    
+    if (ledc_timer_config(&timer_conf) != ESP_OK || ledc_channel_config(&channel_conf) != ESP_OK) {
+        // Brak PWM - przybliżenie progiem
+        gpio_set_level(s_gpio, level >= 128 ? 1 : 0);
+        return;
+    }
+    s_pwm_active = true;
+}
+
+bool rk_led_hal_pattern_start(uint32_t on_time_ms, uint32_t off_time_ms)
+{
+    pwm_stop();
+    
+    uint32_t period_ms = on_time_ms + off_time_ms;
+    
+    // LEDC przyjmuje tylko całkowitą częstotliwość
+    if (period_ms == 0 || period_ms > 1000 || 1000 % period_ms != 0) {
+        return false;
+    }
+    uint32_t freq_hz = 1000 / period_ms;
+    
+    // Najmniejsza rozdzielczość, przy której dzielnik mieści się w zakresie
+    int min_bits = 1;
+    while (min_bits < SOC_LEDC_TIMER_BIT_WIDTH &&
+           (uint64_t)freq_hz * LED_LEDC_DIV_MAX * (1ULL << min_bits) < LED_LEDC_SRC_HZ) {
+        min_bits++;
+    }
+    
+    for (int bits = min_bits; bits <= SOC_LEDC_TIMER_BIT_WIDTH; bits++) {
+        ledc_timer_config_t timer_conf = {
+            .speed_mode = LED_LEDC_MODE,
+            .duty_resolution = (ledc_timer_bit_t)bits,
+            .timer_num = LED_LEDC_TIMER,
+            .freq_hz = freq_hz,
+            .clk_cfg = LEDC_AUTO_CLK,
+        };
+        if (ledc_timer_config(&timer_conf) != ESP_OK) {
+            continue;
+        }
+        
+        ledc_channel_config_t channel_conf = {
+            .gpio_num = s_gpio,
+            .speed_mode = LED_LEDC_MODE,
+            .channel = LED_LEDC_CHANNEL,
+            .intr_type = LEDC_INTR_DISABLE,
+            .timer_sel = LED_LEDC_TIMER,
+            .duty = (uint32_t)(((uint64_t)on_time_ms << bits) / period_ms),
+            .hpoint = 0,
+        };
+        if (ledc_channel_config(&channel_conf) != ESP_OK) {
+            break;
+        }
+        
+        s_pattern_active = true;
+        ESP_LOGD(TAG, "Wzorzec LEDC %lu/%lu ms (%lu Hz, %d bit)", on_time_ms, off_time_ms, freq_hz, bits);
+        return true;
+    }
+    
+    return false;
+}
+
+void rk_led_hal_pattern_stop(void)
+{
+    if (!s_pattern_active) {
+        return;
+    }
+    
+    ledc_stop(LED_LEDC_MODE, LED_LEDC_CHANNEL, 0);
+    configure_gpio();  // Odłącz pin od LEDC
+    s_pattern_active = false;
+}
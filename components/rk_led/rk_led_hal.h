@@ -0,0 +1,58 @@
+#ifndef RK_LED_HAL_H
+#define RK_LED_HAL_H
+
+// Warstwa sprzętowa LED - na Linuksie zastępowana przez rk_led_hal_linux.c
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Konfiguracja pinu LED jako wyjścia GPIO
+ * @param gpio Numer pinu
+ * @return ESP_OK w przypadku sukcesu
+ */
+esp_err_t rk_led_hal_init(int gpio);
+
+/**
+ * @brief Ustawienie stanu pinu LED
+ * @param on true - LED świeci
+ */
+void rk_led_hal_set_level(bool on);
+
+/**
+ * @brief Ustawienie jasności LED (0 i 255 przez GPIO, pośrednie przez PWM LEDC)
+ * @param level Jasność 0-255
+ */
+void rk_led_hal_set_brightness(uint8_t level);
+
+/**
+ * @brief Uruchomienie wzorca on/off w sprzęcie (LEDC) - bez udziału CPU
+ * @param on_time_ms Czas świecenia
+ * @param off_time_ms Czas wyłączenia
+ * @return true jeśli sprzęt przejął wzorzec, false - potrzebny programowy fallback
+ */
+bool rk_led_hal_pattern_start(uint32_t on_time_ms, uint32_t off_time_ms);
+
+/**
+ * @brief Zatrzymanie wzorca sprzętowego i powrót pinu do trybu GPIO
+ */
+void rk_led_hal_pattern_stop(void);
+
+#if CONFIG_IDF_TARGET_LINUX
+// Podgląd stanu atrapy pinu (tylko target linux)
+bool rk_led_hal_mock_get_level(void);
+uint32_t rk_led_hal_mock_get_edges(void);
+// Hak wołany po każdej zmianie jasności - symulacja wywłaszczenia w trakcie kroku
+void rk_led_hal_mock_set_hook(void (*hook)(void));
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RK_LED_HAL_H
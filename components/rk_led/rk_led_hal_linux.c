@@ -0,0 +1,54 @@
+#include "rk_led_hal.h"
+
+// Atrapa HAL dla targetu linux: stan pinu w pamięci, brak wzorców sprzętowych
+
+static bool s_level = false;
+static uint32_t s_edges = 0;
+static void (*s_level_hook)(void) = NULL;
+
+esp_err_t rk_led_hal_init(int gpio)
+{
+    s_level = false;
+    s_edges = 0;
+    return ESP_OK;
+}
+
+void rk_led_hal_set_level(bool on)
+{
+    if (on != s_level) {
+        s_edges++;
+    }
+    s_level = on;
+}
+
+void rk_led_hal_set_brightness(uint8_t level)
+{
+    rk_led_hal_set_level(level >= 128);
+    if (s_level_hook != NULL) {
+        s_level_hook();
+    }
+}
+
+bool rk_led_hal_pattern_start(uint32_t on_time_ms, uint32_t off_time_ms)
+{
+    return false;
+}
+
+void rk_led_hal_pattern_stop(void)
+{
+}
+
+bool rk_led_hal_mock_get_level(void)
+{
+    return s_level;
+}
+
+uint32_t rk_led_hal_mock_get_edges(void)
+{
+    return s_edges;
+}
+
+void rk_led_hal_mock_set_hook(void (*hook)(void))
+{
+    s_level_hook = hook;
+}
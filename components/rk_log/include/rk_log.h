@@ -0,0 +1,127 @@
+#ifndef RK_LOG_H
+#define RK_LOG_H
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "rk_log_ids.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Liczba rekordów w buforze (potęga dwójki)
+#ifndef RK_LOG_RING_LEN
+#define RK_LOG_RING_LEN 64
+#endif
+
+// Limit wpisów INFO i niższych na tag w ciągu sekundy (WARN i ERROR bez limitu)
+#ifndef RK_LOG_RATE_PER_S
+#define RK_LOG_RATE_PER_S 20
+#endif
+
+// Najwyższy poziom zapisywany do bufora - wyższe znikają już przy kompilacji
+#ifndef RK_LOG_LEVEL
+#define RK_LOG_LEVEL ESP_LOG_INFO
+#endif
+
+// Okres opróżniania bufora przez zadanie logu
+#ifndef RK_LOG_DRAIN_MS
+#define RK_LOG_DRAIN_MS 100
+#endif
+
+// Maksymalny czas opróżniania bufora przy wyłączeniu
+#ifndef RK_LOG_FLUSH_TIMEOUT_MS
+#define RK_LOG_FLUSH_TIMEOUT_MS 500
+#endif
+
+// 0 - zadanie logu formatuje tekst na urządzeniu,
+// 1 - wypisuje rekordy binarne jako linie "#RKL:<hex>" do dekodowania na hoście
+#ifndef RK_LOG_OUTPUT_BINARY
+#define RK_LOG_OUTPUT_BINARY 0
+#endif
+
+#define RK_LOG_MAX_ARGS 4
+
+#define RK_LOG_TAG_ENUM(name, text) RK_LOG_TAG_##name,
+#define RK_LOG_FMT_ENUM(name, text) RK_LOG_FMT_##name,
+
+typedef enum {
+    RK_LOG_TAGS(RK_LOG_TAG_ENUM)
+    RK_LOG_TAG_COUNT
+} rk_log_tag_t;
+
+typedef enum {
+    RK_LOG_FORMATS(RK_LOG_FMT_ENUM)
+    RK_LOG_FMT_COUNT
+} rk_log_fmt_t;
+
+// Rekord logu - tylko identyfikatory i argumenty, tekst powstaje poza gorącą ścieżką
+typedef struct {
+    uint32_t time_ms;               // esp_log_timestamp() w chwili zapisu
+    uint16_t fmt;                   // rk_log_fmt_t
+    uint8_t tag;                    // rk_log_tag_t
+    uint8_t level_argc;             // Poziom (4 starsze bity) i liczba argumentów
+    uint32_t args[RK_LOG_MAX_ARGS];
+} rk_log_record_t;
+
+// Statystyki logu
+typedef struct {
+    uint32_t written;       // Rekordy zapisane do bufora
+    uint32_t dropped;       // Rekordy utracone (bufor pełny)
+    uint32_t suppressed;    // Rekordy odrzucone przez limit tagu
+    uint32_t drained;       // Rekordy wypisane przez zadanie logu
+} rk_log_stats_t;
+
+// Liczba argumentów makra (0-4)
+#define RK_LOG_NARGS(...) RK_LOG_NARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define RK_LOG_NARGS_(_0, _1, _2, _3, _4, N, ...) N
+
+// Odroczony wpis: RK_LOGI(OTA, OTA_HTTP_DATA, len)
+#define RK_LOG(level, tag, fmt, ...) do { \
+        if ((level) <= RK_LOG_LEVEL) { \
+            rk_log_write((level), RK_LOG_TAG_##tag, RK_LOG_FMT_##fmt, \
+                         RK_LOG_NARGS(__VA_ARGS__), ##__VA_ARGS__); \
+        } \
+    } while (0)
+#define RK_LOGE(tag, fmt, ...) RK_LOG(ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define RK_LOGW(tag, fmt, ...) RK_LOG(ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define RK_LOGI(tag, fmt, ...) RK_LOG(ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define RK_LOGD(tag, fmt, ...) RK_LOG(ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+
+/**
+ * @brief Uruchomienie zadania opróżniającego bufor logu
+ *
+ * Zapis działa także przed inicjalizacją - rekordy czekają w buforze.
+ *
+ * @return ESP_OK w przypadku sukcesu
+ */
+esp_err_t rk_log_init(void);
+
+/**
+ * @brief Zapis rekordu do bufora (bez blokad i formatowania, także z ISR)
+ * @param level Poziom logu
+ * @param tag Identyfikator tagu
+ * @param fmt Identyfikator formatu
+ * @param argc Liczba argumentów (najwyżej RK_LOG_MAX_ARGS)
+ */
+void rk_log_write(esp_log_level_t level, rk_log_tag_t tag, rk_log_fmt_t fmt, int argc, ...);
+
+/**
+ * @brief Wypisanie wszystkich rekordów z bufora przed powrotem
+ * @param timeout_ms Maksymalny czas oczekiwania na zadanie logu
+ * @return ESP_OK, ESP_ERR_TIMEOUT lub ESP_ERR_INVALID_STATE (zadanie nie działa)
+ */
+esp_err_t rk_log_flush(uint32_t timeout_ms);
+
+/**
+ * @brief Pobranie statystyk logu
+ * @param stats Struktura do wypełnienia
+ */
+void rk_log_get_stats(rk_log_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RK_LOG_H
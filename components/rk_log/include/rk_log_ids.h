@@ -0,0 +1,29 @@
+#ifndef RK_LOG_IDS_H
+#define RK_LOG_IDS_H
+
+// Tabele identyfikatorów logu binarnego. Identyfikator = pozycja w tabeli.
+// Plik czyta też tools/rk_log_decode.py - jeden wpis X(...) na linię,
+// nowe wpisy tylko na końcu tabeli (stare logi dekodują się dalej).
+
+#define RK_LOG_TAGS(X) \
+    X(OTA,  "RK_OTA") \
+    X(LED,  "RK_LED") \
+    X(WIFI, "RK_WIFI") \
+    X(LOG,  "RK_LOG")
+
+// Formaty przyjmują tylko argumenty całkowite 32-bit (%d, %u, %lu, %x) - najwyżej 4
+#define RK_LOG_FORMATS(X) \
+    X(OTA_HTTP_DATA,         "Pobieranie firmware: %d bajtów") \
+    X(LED_MSG,               "Otrzymano wiadomość typu: %d") \
+    X(LED_WIFI_CONNECTING,   "WiFi łączenie - symetryczne mruganie") \
+    X(LED_WIFI_CONNECTED,    "WiFi połączone - asymetryczne mruganie") \
+    X(LED_WIFI_DISCONNECTED, "WiFi rozłączone - szybkie mruganie") \
+    X(LED_OTA_START,         "OTA rozpoczęte - bardzo szybkie mruganie") \
+    X(LED_OTA_SUCCESS,       "OTA sukces - stałe świecenie") \
+    X(LED_OTA_FAILED,        "OTA błąd - powrót do normalnego trybu") \
+    X(LED_CUSTOM,            "Własny wzorzec: %lu/%lu ms") \
+    X(WIFI_MSG,              "Otrzymano wiadomość WiFi typu: %d") \
+    X(LOG_SUPPRESSED,        "Limit logu: pominięto %lu wpisów tagu %lu") \
+    X(LOG_DROPPED,           "Bufor logu pełny: utracono %lu wpisów")
+
+#endif // RK_LOG_IDS_H
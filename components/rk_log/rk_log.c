@@ -0,0 +1,270 @@
+#include "rk_log.h"
+#include "rk_common.h"
+#include "rk_metrics.h"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "RK_LOG";
+
+#define LOG_TASK_STACK 3072
+#define LOG_RING_MASK  (RK_LOG_RING_LEN - 1)
+
+_Static_assert((RK_LOG_RING_LEN & LOG_RING_MASK) == 0, "RK_LOG_RING_LEN musi być potęgą dwójki");
+
+#define RK_LOG_TAG_TEXT(name, text) text,
+#define RK_LOG_FMT_TEXT(name, text) text,
+
+static const char *const s_tag_text[] = { RK_LOG_TAGS(RK_LOG_TAG_TEXT) };
+static const char *const s_fmt_text[] = { RK_LOG_FORMATS(RK_LOG_FMT_TEXT) };
+
+// Komórka bufora (kolejka Vyukova): turn = numer sekwencji - indeks komórki. turn_of(pos) - wolna
+// do zapisu pozycji pos, turn_of(pos) + 1 - gotowa do odczytu. Liczniki liczone modulo 2^32 (długość
+// jest potęgą dwójki), więc przepełnienie s_head nie psuje porównań. Zerowa inicjalizacja jest
+// poprawnym stanem początkowym, więc zapis działa przed rk_log_init.
+typedef struct {
+    uint32_t turn;
+    rk_log_record_t record;
+} log_cell_t;
+
+// Limit wpisów tagu w oknie jednosekundowym (przybliżony - wyścigi tylko przesuwają granicę)
+typedef struct {
+    uint32_t window_ms;
+    uint32_t count;
+    uint32_t suppressed;
+} tag_limit_t;
+
+RK_TASK_BUFFER(log_task, LOG_TASK_STACK);
+
+// Zmienne globalne
+static log_cell_t s_ring[RK_LOG_RING_LEN];
+static uint32_t s_head = 0;     // Pozycja zapisu (wielu producentów, CAS)
+static uint32_t s_tail = 0;     // Pozycja odczytu (tylko zadanie logu)
+static tag_limit_t s_limits[RK_LOG_TAG_COUNT];
+static rk_log_stats_t s_stats = {0};
+static TaskHandle_t log_task_handle = NULL;
+static TaskHandle_t s_flush_waiter = NULL;     // Czeka w rk_log_flush na opróżnienie bufora
+
+static rk_metric_t *s_metric_dropped = NULL;
+static rk_metric_t *s_metric_suppressed = NULL;
+
+static inline uint32_t turn_of(uint32_t pos)
+{
+    return pos & ~(uint32_t)LOG_RING_MASK;
+}
+
+static bool rate_limited(esp_log_level_t level, rk_log_tag_t tag, uint32_t now_ms)
+{
+    if (level <= ESP_LOG_WARN) {
+        return false;
+    }
+    
+    tag_limit_t *limit = &s_limits[tag];
+    if (now_ms - limit->window_ms >= 1000) {
+        limit->window_ms = now_ms;
+        limit->count = 0;
+    }
+    if (limit->count >= RK_LOG_RATE_PER_S) {
+        __atomic_fetch_add(&limit->suppressed, 1, __ATOMIC_RELAXED);
+        return true;
+    }
+    limit->count++;
+    return false;
+}
+
+void rk_log_write(esp_log_level_t level, rk_log_tag_t tag, rk_log_fmt_t fmt, int argc, ...)
+{
+    if ((unsigned)tag >= RK_LOG_TAG_COUNT || (unsigned)fmt >= RK_LOG_FMT_COUNT) {
+        return;
+    }
+    
+    uint32_t now_ms = esp_log_timestamp();
+    if (rate_limited(level, tag, now_ms)) {
+        __atomic_fetch_add(&s_stats.suppressed, 1, __ATOMIC_RELAXED);
+        rk_metrics_inc(s_metric_suppressed);
+        return;
+    }
+    
+    // Rezerwacja komórki: CAS na pozycji zapisu, bez sekcji krytycznej
+    uint32_t pos = __atomic_load_n(&s_head, __ATOMIC_RELAXED);
+    log_cell_t *cell;
+    for (;;) {
+        cell = &s_ring[pos & LOG_RING_MASK];
+        uint32_t turn = __atomic_load_n(&cell->turn, __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(turn - turn_of(pos));
+        
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&s_head, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Komórka z poprzedniego okrążenia nie została odczytana - bufor pełny
+            __atomic_fetch_add(&s_stats.dropped, 1, __ATOMIC_RELAXED);
+            rk_metrics_inc(s_metric_dropped);
+            return;
+        } else {
+            pos = __atomic_load_n(&s_head, __ATOMIC_RELAXED);
+        }
+    }
+    
+    rk_log_record_t *record = &cell->record;
+    if (argc > RK_LOG_MAX_ARGS) {
+        argc = RK_LOG_MAX_ARGS;
+    }
+    record->time_ms = now_ms;
+    record->fmt = (uint16_t)fmt;
+    record->tag = (uint8_t)tag;
+    record->level_argc = (uint8_t)((level << 4) | argc);
+    
+    va_list args;
+    va_start(args, argc);
+    for (int i = 0; i < argc; i++) {
+        record->args[i] = va_arg(args, uint32_t);
+    }
+    va_end(args);
+    
+    __atomic_store_n(&cell->turn, turn_of(pos) + 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&s_stats.written, 1, __ATOMIC_RELAXED);
+}
+
+static bool ring_pop(rk_log_record_t *record)
+{
+    log_cell_t *cell = &s_ring[s_tail & LOG_RING_MASK];
+    if (__atomic_load_n(&cell->turn, __ATOMIC_ACQUIRE) != turn_of(s_tail) + 1) {
+        return false;
+    }
+    
+    *record = cell->record;
+    __atomic_store_n(&cell->turn, turn_of(s_tail) + RK_LOG_RING_LEN, __ATOMIC_RELEASE);
+    s_tail++;
+    return true;
+}
+
+static void emit(const rk_log_record_t *record)
+{
+    esp_log_level_t level = (esp_log_level_t)(record->level_argc >> 4);
+    int argc = record->level_argc & 0x0F;
+
+#if RK_LOG_OUTPUT_BINARY
+    // Rekord little-endian bez nieużytych argumentów - dekoduje tools/rk_log_decode.py
+    char line[8 + 2 * sizeof(rk_log_record_t)];
+    const uint8_t *raw = (const uint8_t *)record;
+    size_t raw_len = offsetof(rk_log_record_t, args) + argc * sizeof(uint32_t);
+    int pos = snprintf(line, sizeof(line), "#RKL:");
+    for (size_t i = 0; i < raw_len; i++) {
+        pos += snprintf(line + pos, sizeof(line) - pos, "%02x", raw[i]);
+    }
+    printf("%s\n", line);
+    (void)level;  // Poziom jest w rekordzie - filtruje dekoder
+#else
+    char text[160];
+    const uint32_t *a = record->args;
+    // Nadmiarowe argumenty są ignorowane przez snprintf - format zna ich liczbę
+    snprintf(text, sizeof(text), s_fmt_text[record->fmt],
+             argc > 0 ? a[0] : 0, argc > 1 ? a[1] : 0, argc > 2 ? a[2] : 0, argc > 3 ? a[3] : 0);
+    ESP_LOG_LEVEL(level, s_tag_text[record->tag], "[%lu] %s", record->time_ms, text);
+#endif
+}
+
+static void report_losses(void)
+{
+    static uint32_t reported_dropped = 0;
+    
+    for (int tag = 0; tag < RK_LOG_TAG_COUNT; tag++) {
+        uint32_t suppressed = __atomic_exchange_n(&s_limits[tag].suppressed, 0, __ATOMIC_RELAXED);
+        if (suppressed > 0) {
+            RK_LOGW(LOG, LOG_SUPPRESSED, suppressed, tag);
+        }
+    }
+    
+    uint32_t dropped = __atomic_load_n(&s_stats.dropped, __ATOMIC_RELAXED);
+    if (dropped != reported_dropped) {
+        RK_LOGW(LOG, LOG_DROPPED, dropped - reported_dropped);
+        reported_dropped = dropped;
+    }
+}
+
+static void log_task(void *pvParameters)
+{
+    rk_log_record_t record;
+    
+    while (1) {
+        report_losses();
+        
+        while (ring_pop(&record)) {
+            emit(&record);
+            s_stats.drained++;
+        }
+        
+        TaskHandle_t waiter = s_flush_waiter;
+        if (waiter != NULL) {
+            s_flush_waiter = NULL;
+            rk_join_signal(waiter);
+        }
+        
+        // Powiadomienie z rk_log_flush skraca oczekiwanie
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RK_LOG_DRAIN_MS));
+    }
+}
+
+static void log_shutdown(void)
+{
+    if (rk_log_flush(RK_LOG_FLUSH_TIMEOUT_MS) != ESP_OK) {
+        ESP_LOGW(TAG, "Bufor logu nie został opróżniony przed restartem");
+    }
+}
+
+esp_err_t rk_log_init(void)
+{
+    if (log_task_handle != NULL) {
+        return ESP_OK;
+    }
+    
+    s_metric_dropped = rk_metrics_counter("log.dropped");
+    s_metric_suppressed = rk_metrics_counter("log.suppressed");
+    
+    // Najniższy priorytet - UART obsługiwany tylko w wolnym czasie CPU
+    BaseType_t ret = rk_task_create(log_task,
+                                    "log_task",
+                                    LOG_TASK_STACK,
+                                    NULL,
+                                    tskIDLE_PRIORITY + 1,
+                                    &log_task_handle,
+                                    RK_TASK_STATIC(log_task));
+    
+    if (ret != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    
+    // Rejestrowany jako pierwszy - wykonywany jako ostatni krok wyłączenia
+    rk_shutdown_register("log", log_shutdown);
+    return ESP_OK;
+}
+
+esp_err_t rk_log_flush(uint32_t timeout_ms)
+{
+    // Odczyt tylko w zadaniu logu (jeden konsument) - tu wyłącznie budzenie i oczekiwanie
+    if (log_task_handle == NULL || xTaskGetCurrentTaskHandle() == log_task_handle) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    rk_join_prepare();
+    s_flush_waiter = xTaskGetCurrentTaskHandle();
+    xTaskNotifyGive(log_task_handle);
+    bool done = rk_join_wait(timeout_ms);
+    s_flush_waiter = NULL;
+    
+    return done ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void rk_log_get_stats(rk_log_stats_t *stats)
+{
+    if (stats != NULL) {
+        stats->written = __atomic_load_n(&s_stats.written, __ATOMIC_RELAXED);
+        stats->dropped = __atomic_load_n(&s_stats.dropped, __ATOMIC_RELAXED);
+        stats->suppressed = __atomic_load_n(&s_stats.suppressed, __ATOMIC_RELAXED);
+        stats->drained = s_stats.drained;
+    }
+}
@@ -0,0 +1,199 @@
+#ifndef RK_METRICS_H
+#define RK_METRICS_H
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "rk_common.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Rozmiar rejestru metryk (sloty statyczne, rejestracja przy starcie komponentów)
+#ifndef RK_METRICS_MAX
+#define RK_METRICS_MAX 24
+#endif
+
+// Maksymalna liczba koszyków histogramu (ostatni koszyk zbiera wartości powyżej granic)
+#define RK_METRICS_HIST_BUCKETS 8
+
+// Liczba zadań obejmowanych migawką (CPU i zapas stosu)
+#ifndef RK_METRICS_MAX_TASKS
+#define RK_METRICS_MAX_TASKS 20
+#endif
+
+// Dopuszczalny przyrost zużycia sterty między punktem odniesienia a kontrolą testu długotrwałego
+#ifndef RK_SOAK_HEAP_DRIFT_BYTES
+#define RK_SOAK_HEAP_DRIFT_BYTES 4096
+#endif
+
+// Dopuszczalny wzrost p95 histogramów względem punktu odniesienia (krotność)
+#ifndef RK_SOAK_LATENCY_FACTOR
+#define RK_SOAK_LATENCY_FACTOR 2
+#endif
+
+typedef enum {
+    RK_METRIC_COUNTER,      // Licznik rosnący
+    RK_METRIC_GAUGE,        // Wartość chwilowa
+    RK_METRIC_HISTOGRAM,    // Rozkład w stałych koszykach
+} rk_metric_type_t;
+
+// Slot metryki - aktualizacje to pojedyncze operacje atomowe, bez blokad
+typedef struct {
+    const char *name;
+    rk_metric_type_t type;
+    uint32_t value;                             // Licznik / gauge / liczba próbek histogramu
+    uint32_t sum;                               // Suma próbek histogramu
+    uint32_t max;                               // Największa próbka histogramu
+    const uint32_t *bounds;                     // Górne granice koszyków (rosnąco)
+    uint8_t bucket_count;                       // Liczba granic (koszyków = bucket_count + 1)
+    uint32_t buckets[RK_METRICS_HIST_BUCKETS];
+} rk_metric_t;
+
+// Stan zadania w migawce
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    uint32_t stack_free_bytes;      // Najmniejszy zapas stosu od startu zadania
+    uint8_t cpu_pct;                // Udział CPU od poprzedniej migawki
+    UBaseType_t priority;
+} rk_metrics_task_t;
+
+// Punkt odniesienia testu długotrwałego - stan po rozgrzewce
+typedef struct {
+    uint32_t heap_free_bytes;
+    uint32_t heap_largest_block;
+    uint8_t task_count;
+    int32_t res_live[RK_RES_COUNT];
+    uint32_t p95[RK_METRICS_MAX];           // p95 histogramów w kolejności rejestracji
+    uint32_t metric_count;
+} rk_metrics_soak_baseline_t;
+
+// Wynik kontroli dryfu
+typedef struct {
+    int32_t heap_drift_bytes;               // Dodatni - ubyło wolnej sterty
+    int32_t largest_block_drift_bytes;
+    int8_t task_drift;
+    int32_t res_drift[RK_RES_COUNT];
+    const char *slow_metric;                // Pierwszy histogram z p95 ponad progiem lub NULL
+    bool leak;                              // Przekroczony próg sterty albo przyrost zasobów/zadań
+} rk_metrics_soak_report_t;
+
+// Migawka systemu
+typedef struct {
+    int64_t timestamp_us;
+    uint32_t heap_free_bytes;
+    uint32_t heap_min_free_bytes;   // Minimum od startu
+    uint32_t heap_largest_block;
+    uint8_t heap_fragmentation_pct;
+    uint8_t task_count;
+    rk_metrics_task_t tasks[RK_METRICS_MAX_TASKS];
+} rk_metrics_snapshot_t;
+
+/**
+ * @brief Inicjalizacja zbierania migawek (rejestracja metryk działa i bez niej)
+ * @return ESP_OK w przypadku sukcesu
+ */
+esp_err_t rk_metrics_init(void);
+
+/**
+ * @brief Rejestracja licznika
+ * @param name Nazwa (stały napis, np. "ota.checks")
+ * @return Slot metryki lub NULL gdy rejestr jest pełny
+ */
+rk_metric_t *rk_metrics_counter(const char *name);
+
+/**
+ * @brief Rejestracja wartości chwilowej
+ * @param name Nazwa (stały napis)
+ * @return Slot metryki lub NULL gdy rejestr jest pełny
+ */
+rk_metric_t *rk_metrics_gauge(const char *name);
+
+/**
+ * @brief Rejestracja histogramu o stałych koszykach
+ * @param name Nazwa (stały napis)
+ * @param bounds Rosnące górne granice koszyków (stała tablica)
+ * @param bound_count Liczba granic, najwyżej RK_METRICS_HIST_BUCKETS - 1
+ * @return Slot metryki lub NULL gdy rejestr jest pełny albo granic jest za dużo
+ */
+rk_metric_t *rk_metrics_histogram(const char *name, const uint32_t *bounds, uint8_t bound_count);
+
+/**
+ * @brief Dodanie próbki do histogramu
+ */
+void rk_metrics_observe(rk_metric_t *metric, uint32_t value);
+
+/**
+ * @brief Przybliżony percentyl histogramu (górna granica koszyka zawierającego percentyl)
+ * @param metric Histogram
+ * @param pct Percentyl 1-100
+ * @return Granica koszyka; dla ostatniego koszyka największa próbka, 0 gdy brak próbek
+ */
+uint32_t rk_metrics_percentile(const rk_metric_t *metric, uint8_t pct);
+
+// Aktualizacje na gorącej ścieżce - NULL (nieudana rejestracja) jest ignorowany
+static inline void rk_metrics_add(rk_metric_t *metric, uint32_t delta)
+{
+    if (metric != NULL) {
+        __atomic_fetch_add(&metric->value, delta, __ATOMIC_RELAXED);
+    }
+}
+
+static inline void rk_metrics_inc(rk_metric_t *metric)
+{
+    rk_metrics_add(metric, 1);
+}
+
+static inline void rk_metrics_set(rk_metric_t *metric, uint32_t value)
+{
+    if (metric != NULL) {
+        __atomic_store_n(&metric->value, value, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Zebranie migawki: CPU i zapas stosu zadań, stan sterty
+ * @param snapshot Struktura do wypełnienia
+ */
+void rk_metrics_collect(rk_metrics_snapshot_t *snapshot);
+
+/**
+ * @brief Zwarta migawka JSON: sterta, zadania, rywalizacja o CPU i wszystkie metryki
+ * @param buf Bufor wyjściowy
+ * @param len Rozmiar bufora
+ * @return Długość tekstu (bez '\0'); wynik obcięty gdy >= len
+ */
+size_t rk_metrics_to_json(char *buf, size_t len);
+
+/**
+ * @brief Wypisanie migawki do logu
+ *
+ * Przy działającym rk_contention_start dołącza raport rywalizacji i zaczyna
+ * nowe okno - kolejne wywołanie obejmuje czas od poprzedniego.
+ */
+void rk_metrics_log(void);
+
+/**
+ * @brief Zapis punktu odniesienia testu długotrwałego (sterta, zadania, zasoby, p95)
+ * @param baseline Struktura do wypełnienia
+ */
+void rk_metrics_soak_baseline(rk_metrics_soak_baseline_t *baseline);
+
+/**
+ * @brief Porównanie bieżącego stanu z punktem odniesienia i zalogowanie dryfu
+ * @param baseline Punkt odniesienia z rk_metrics_soak_baseline
+ * @param report Wynik kontroli (może być NULL)
+ * @return ESP_OK gdy brak dryfu, ESP_FAIL przy wycieku lub wzroście opóźnień
+ */
+esp_err_t rk_metrics_soak_check(const rk_metrics_soak_baseline_t *baseline,
+                                rk_metrics_soak_report_t *report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RK_METRICS_H
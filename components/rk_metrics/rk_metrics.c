@@ -0,0 +1,475 @@
+#include "rk_metrics.h"
+#include "rk_common.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "RK_METRICS";
+
+#ifdef configRUN_TIME_COUNTER_TYPE
+typedef configRUN_TIME_COUNTER_TYPE run_time_t;
+#else
+typedef uint32_t run_time_t;
+#endif
+
+// Rejestr metryk - sloty statyczne, liczba rośnie tylko przy rejestracji
+static rk_metric_t s_metrics[RK_METRICS_MAX];
+static uint8_t s_metric_count = 0;
+static portMUX_TYPE s_registry_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Stan zbierania migawek (jeden zbierający naraz)
+RK_MUTEX_BUFFER(metrics_mutex);
+static SemaphoreHandle_t s_collect_mutex = NULL;
+static rk_metrics_snapshot_t s_snapshot;
+static rk_contention_report_t s_contention;
+
+uint32_t rk_metrics_percentile(const rk_metric_t *metric, uint8_t pct)
+{
+    if (metric == NULL || metric->bounds == NULL || pct == 0) {
+        return 0;
+    }
+    
+    uint32_t count = __atomic_load_n(&metric->value, __ATOMIC_RELAXED);
+    if (count == 0) {
+        return 0;
+    }
+    
+    // Próbka o randze ceil(count * pct / 100) wyznacza koszyk percentyla
+    uint32_t rank = (uint32_t)(((uint64_t)count * (pct > 100 ? 100 : pct) + 99) / 100);
+    uint32_t seen = 0;
+    for (int b = 0; b < metric->bucket_count; b++) {
+        seen += __atomic_load_n(&metric->buckets[b], __ATOMIC_RELAXED);
+        if (seen >= rank) {
+            return metric->bounds[b];
+        }
+    }
+    return metric->max;
+}
+
+#if configUSE_TRACE_FACILITY
+static TaskStatus_t s_task_status[RK_METRICS_MAX_TASKS];
+
+// Liczniki czasu CPU z poprzedniej migawki - udział liczony z przyrostu
+typedef struct {
+    TaskHandle_t handle;
+    run_time_t run_time;
+} task_run_time_t;
+
+static task_run_time_t s_prev_run_time[RK_METRICS_MAX_TASKS];
+static uint8_t s_prev_count = 0;
+static run_time_t s_prev_total = 0;
+#endif
+
+static rk_metric_t *metric_register(const char *name, rk_metric_type_t type)
+{
+    rk_metric_t *metric = NULL;
+    
+    portENTER_CRITICAL(&s_registry_lock);
+    // Ponowna rejestracja (np. restart zadania) zwraca istniejący slot
+    for (int i = 0; i < s_metric_count; i++) {
+        if (strcmp(s_metrics[i].name, name) == 0) {
+            metric = &s_metrics[i];
+            break;
+        }
+    }
+    if (metric == NULL && s_metric_count < RK_METRICS_MAX) {
+        metric = &s_metrics[s_metric_count];
+        memset(metric, 0, sizeof(*metric));
+        metric->name = name;
+        metric->type = type;
+        s_metric_count++;
+    }
+    portEXIT_CRITICAL(&s_registry_lock);
+    
+    if (metric == NULL) {
+        ESP_LOGW(TAG, "Rejestr metryk pełny - pomijam %s", name);
+    }
+    return metric;
+}
+
+rk_metric_t *rk_metrics_counter(const char *name)
+{
+    return metric_register(name, RK_METRIC_COUNTER);
+}
+
+rk_metric_t *rk_metrics_gauge(const char *name)
+{
+    return metric_register(name, RK_METRIC_GAUGE);
+}
+
+rk_metric_t *rk_metrics_histogram(const char *name, const uint32_t *bounds, uint8_t bound_count)
+{
+    if (bounds == NULL || bound_count == 0 || bound_count >= RK_METRICS_HIST_BUCKETS) {
+        return NULL;
+    }
+    
+    rk_metric_t *metric = metric_register(name, RK_METRIC_HISTOGRAM);
+    if (metric != NULL) {
+        metric->bounds = bounds;
+        metric->bucket_count = bound_count;
+    }
+    return metric;
+}
+
+void rk_metrics_observe(rk_metric_t *metric, uint32_t value)
+{
+    if (metric == NULL || metric->bounds == NULL) {
+        return;
+    }
+    
+    uint8_t bucket = 0;
+    while (bucket < metric->bucket_count && value > metric->bounds[bucket]) {
+        bucket++;
+    }
+    
+    __atomic_fetch_add(&metric->buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&metric->value, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&metric->sum, value, __ATOMIC_RELAXED);
+    // Wyścig przy max tylko zaniża pojedynczą próbkę - bez pętli CAS na gorącej ścieżce
+    if (value > metric->max) {
+        metric->max = value;
+    }
+}
+
+#if configUSE_TRACE_FACILITY
+static void collect_tasks(rk_metrics_snapshot_t *snapshot)
+{
+    uint32_t total_raw = 0;
+    UBaseType_t count = uxTaskGetSystemState(s_task_status, RK_METRICS_MAX_TASKS, &total_raw);
+    run_time_t total = (run_time_t)total_raw;
+    run_time_t total_delta = total - s_prev_total;
+    
+    snapshot->task_count = 0;
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t *status = &s_task_status[i];
+        rk_metrics_task_t *task = &snapshot->tasks[snapshot->task_count++];
+        
+        strncpy(task->name, status->pcTaskName, sizeof(task->name) - 1);
+        task->name[sizeof(task->name) - 1] = '\0';
+        // W ESP-IDF StackType_t to bajt - znak wodny jest w bajtach
+        task->stack_free_bytes = status->usStackHighWaterMark * sizeof(StackType_t);
+        task->priority = status->uxCurrentPriority;
+        task->cpu_pct = 0;
+        
+        run_time_t previous = 0;
+        for (int j = 0; j < s_prev_count; j++) {
+            if (s_prev_run_time[j].handle == status->xHandle) {
+                previous = s_prev_run_time[j].run_time;
+                break;
+            }
+        }
+        if (total_delta > 0) {
+            run_time_t task_delta = (run_time_t)status->ulRunTimeCounter - previous;
+            task->cpu_pct = (uint8_t)((uint64_t)task_delta * 100 / total_delta);
+        }
+    }
+    
+    for (UBaseType_t i = 0; i < count; i++) {
+        s_prev_run_time[i].handle = s_task_status[i].xHandle;
+        s_prev_run_time[i].run_time = (run_time_t)s_task_status[i].ulRunTimeCounter;
+    }
+    s_prev_count = count;
+    s_prev_total = total;
+}
+#endif
+
+static void collect_locked(rk_metrics_snapshot_t *snapshot)
+{
+    rk_heap_sample_t heap;
+    rk_heap_sample(&heap);
+    
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->timestamp_us = heap.timestamp_us;
+    snapshot->heap_free_bytes = heap.free_bytes;
+    snapshot->heap_min_free_bytes = heap.min_free_bytes;
+    snapshot->heap_largest_block = heap.largest_block;
+    snapshot->heap_fragmentation_pct = heap.fragmentation_pct;
+
+#if configUSE_TRACE_FACILITY
+    collect_tasks(snapshot);
+#endif
+}
+
+static bool collect_lock(void)
+{
+    return s_collect_mutex != NULL && xSemaphoreTake(s_collect_mutex, pdMS_TO_TICKS(1000)) == pdTRUE;
+}
+
+esp_err_t rk_metrics_init(void)
+{
+    if (s_collect_mutex != NULL) {
+        return ESP_OK;
+    }
+    
+    s_collect_mutex = rk_mutex_create(RK_MUTEX_STATIC(metrics_mutex));
+    return s_collect_mutex != NULL ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+void rk_metrics_collect(rk_metrics_snapshot_t *snapshot)
+{
+    if (snapshot == NULL || !collect_lock()) {
+        return;
+    }
+    
+    collect_locked(&s_snapshot);
+    *snapshot = s_snapshot;
+    xSemaphoreGive(s_collect_mutex);
+}
+
+// Dopisanie do bufora z obcięciem - pos liczy pełną długość jak snprintf
+static void json_append(char *buf, size_t len, size_t *pos, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static void json_append(char *buf, size_t len, size_t *pos, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(*pos < len ? buf + *pos : NULL, *pos < len ? len - *pos : 0, fmt, args);
+    va_end(args);
+    
+    if (written > 0) {
+        *pos += written;
+    }
+}
+
+size_t rk_metrics_to_json(char *buf, size_t len)
+{
+    size_t pos = 0;
+    
+    if (buf == NULL || len == 0 || !collect_lock()) {
+        return 0;
+    }
+    
+    collect_locked(&s_snapshot);
+    const rk_metrics_snapshot_t *snap = &s_snapshot;
+    
+    json_append(buf, len, &pos,
+                "{\"t\":%lld,\"heap\":{\"free\":%lu,\"min\":%lu,\"lb\":%lu,\"frag\":%u},\"tasks\":[",
+                snap->timestamp_us / 1000, snap->heap_free_bytes, snap->heap_min_free_bytes,
+                snap->heap_largest_block, snap->heap_fragmentation_pct);
+    for (int i = 0; i < snap->task_count; i++) {
+        json_append(buf, len, &pos, "%s{\"n\":\"%s\",\"st\":%lu,\"cpu\":%u}",
+                    i > 0 ? "," : "", snap->tasks[i].name,
+                    snap->tasks[i].stack_free_bytes, snap->tasks[i].cpu_pct);
+    }
+    json_append(buf, len, &pos, "],\"res\":{");
+    for (int r = 0; r < RK_RES_COUNT; r++) {
+        json_append(buf, len, &pos, "%s\"%s\":%ld", r > 0 ? "," : "",
+                    rk_res_name((rk_res_type_t)r), rk_res_live((rk_res_type_t)r));
+    }
+    json_append(buf, len, &pos, "}");
+    
+    // Rywalizacja o CPU: obciążenie rdzeni i próbki gotowości zadań
+    if (rk_contention_get(&s_contention, false) == ESP_OK) {
+        json_append(buf, len, &pos, ",\"contention\":{\"ms\":%lu,\"sample_ms\":%d,\"load\":[",
+                    s_contention.window_ms, RK_CONTENTION_SAMPLE_MS);
+        for (int c = 0; c < s_contention.core_count; c++) {
+            json_append(buf, len, &pos, "%s%u", c > 0 ? "," : "", s_contention.core_load_pct[c]);
+        }
+        json_append(buf, len, &pos, "],\"tasks\":[");
+        for (int i = 0; i < s_contention.task_count; i++) {
+            const rk_contention_task_t *t = &s_contention.tasks[i];
+            json_append(buf, len, &pos,
+                        "%s{\"n\":\"%s\",\"core\":%d,\"prio\":%u,\"run\":%lu,\"ready\":%lu,\"preempt\":%lu}",
+                        i > 0 ? "," : "", t->info.name, t->info.core, t->info.priority,
+                        t->running_samples, t->ready_samples, t->preemptions);
+        }
+        json_append(buf, len, &pos, "]}");
+    }
+    
+    // Rozmieszczenie buforów (rk_mem): PSRAM, powroty do SRAM i ruch w regionach
+    rk_mem_report_t mem;
+    rk_mem_get_report(&mem);
+    json_append(buf, len, &pos, ",\"mem\":{\"psram\":%s,\"psram_total\":%lu,\"psram_free\":%lu,"
+                "\"fallbacks\":%lu,\"failures\":%lu",
+                mem.psram_available ? "true" : "false", mem.psram_total_bytes,
+                mem.psram_free_bytes, mem.bulk_fallbacks, mem.failures);
+    for (int r = 0; r < RK_MEM_REGION_COUNT; r++) {
+        const rk_mem_region_stats_t *region = &mem.regions[r];
+        json_append(buf, len, &pos, ",\"%s\":{\"allocs\":%lu,\"live\":%lu,\"peak\":%lu,\"copy_bps\":%lu}",
+                    rk_mem_region_name((rk_mem_region_t)r), region->allocs,
+                    region->live_bytes, region->peak_bytes, region->copy_bps);
+    }
+    json_append(buf, len, &pos, "}");
+    json_append(buf, len, &pos, ",\"m\":{");
+    
+    for (int i = 0; i < s_metric_count; i++) {
+        const rk_metric_t *m = &s_metrics[i];
+        json_append(buf, len, &pos, "%s\"%s\":", i > 0 ? "," : "", m->name);
+        if (m->type != RK_METRIC_HISTOGRAM) {
+            json_append(buf, len, &pos, "%lu", m->value);
+            continue;
+        }
+        
+        json_append(buf, len, &pos, "{\"n\":%lu,\"sum\":%lu,\"max\":%lu,\"b\":[",
+                    m->value, m->sum, m->max);
+        for (int b = 0; b <= m->bucket_count; b++) {
+            json_append(buf, len, &pos, "%s%lu", b > 0 ? "," : "", m->buckets[b]);
+        }
+        json_append(buf, len, &pos, "]}");
+    }
+    json_append(buf, len, &pos, "}}");
+    
+    xSemaphoreGive(s_collect_mutex);
+    
+    if (pos >= len) {
+        buf[len - 1] = '\0';
+    }
+    return pos;
+}
+
+// Raport rywalizacji za okno od poprzedniego logu. Czas gotowości bez procesora
+// szacowany z próbek, więc dokładność to okres RK_CONTENTION_SAMPLE_MS.
+static void log_contention(void)
+{
+    if (rk_contention_get(&s_contention, true) != ESP_OK) {
+        return;
+    }
+    
+    for (int c = 0; c < s_contention.core_count; c++) {
+        ESP_LOGI(TAG, "Rdzeń %d: obciążenie %u%% (%lu próbek w %lu ms)", c,
+                 s_contention.core_load_pct[c], s_contention.core_samples[c], s_contention.window_ms);
+    }
+    for (int i = 0; i < s_contention.task_count; i++) {
+        const rk_contention_task_t *t = &s_contention.tasks[i];
+        uint32_t samples = t->running_samples + t->ready_samples;
+        ESP_LOGI(TAG, "Rywalizacja %-16s rdzeń=%2d prio=%2u praca=%lu ms gotowe=%lu ms (%lu%%) wywłaszczenia=%lu",
+                 t->info.name, t->info.core, t->info.priority,
+                 t->running_samples * RK_CONTENTION_SAMPLE_MS, t->ready_samples * RK_CONTENTION_SAMPLE_MS,
+                 samples > 0 ? t->ready_samples * 100 / samples : 0, t->preemptions);
+    }
+}
+
+static void log_mem(void)
+{
+    rk_mem_report_t mem;
+    rk_mem_get_report(&mem);
+    
+    if (mem.psram_available) {
+        ESP_LOGI(TAG, "PSRAM: %lu/%lu B wolne, powroty do SRAM=%lu, błędy alokacji=%lu",
+                 mem.psram_free_bytes, mem.psram_total_bytes, mem.bulk_fallbacks, mem.failures);
+    } else {
+        ESP_LOGI(TAG, "PSRAM: brak - bufory RK_MEM_BULK w SRAM, błędy alokacji=%lu", mem.failures);
+    }
+    for (int r = 0; r < RK_MEM_REGION_COUNT; r++) {
+        const rk_mem_region_stats_t *region = &mem.regions[r];
+        ESP_LOGI(TAG, "Bufory %-8s alokacje=%lu zajęte=%lu B szczyt=%lu B kopiowanie=%lu KB/s",
+                 rk_mem_region_name((rk_mem_region_t)r), region->allocs,
+                 region->live_bytes, region->peak_bytes, region->copy_bps / 1024);
+    }
+}
+
+void rk_metrics_log(void)
+{
+    if (!collect_lock()) {
+        return;
+    }
+    
+    collect_locked(&s_snapshot);
+    const rk_metrics_snapshot_t *snap = &s_snapshot;
+    
+    ESP_LOGI(TAG, "Sterta: wolne=%lu B, min=%lu B, największy blok=%lu B, fragmentacja=%u%%",
+             snap->heap_free_bytes, snap->heap_min_free_bytes,
+             snap->heap_largest_block, snap->heap_fragmentation_pct);
+    for (int i = 0; i < snap->task_count; i++) {
+        ESP_LOGI(TAG, "Zadanie %-16s prio=%u CPU=%3u%% zapas stosu=%lu B",
+                 snap->tasks[i].name, snap->tasks[i].priority,
+                 snap->tasks[i].cpu_pct, snap->tasks[i].stack_free_bytes);
+    }
+    log_contention();
+    log_mem();
+    for (int i = 0; i < s_metric_count; i++) {
+        const rk_metric_t *m = &s_metrics[i];
+        if (m->type == RK_METRIC_HISTOGRAM) {
+            ESP_LOGI(TAG, "%s: n=%lu avg=%lu max=%lu", m->name, m->value,
+                     m->value > 0 ? m->sum / m->value : 0, m->max);
+        } else {
+            ESP_LOGI(TAG, "%s: %lu", m->name, m->value);
+        }
+    }
+    
+    xSemaphoreGive(s_collect_mutex);
+}
+
+void rk_metrics_soak_baseline(rk_metrics_soak_baseline_t *baseline)
+{
+    if (baseline == NULL) {
+        return;
+    }
+    
+    rk_heap_sample_t heap;
+    rk_heap_sample(&heap);
+    
+    memset(baseline, 0, sizeof(*baseline));
+    baseline->heap_free_bytes = heap.free_bytes;
+    baseline->heap_largest_block = heap.largest_block;
+    baseline->task_count = (uint8_t)uxTaskGetNumberOfTasks();
+    for (int r = 0; r < RK_RES_COUNT; r++) {
+        baseline->res_live[r] = rk_res_live((rk_res_type_t)r);
+    }
+    
+    baseline->metric_count = s_metric_count;
+    for (int i = 0; i < s_metric_count; i++) {
+        baseline->p95[i] = rk_metrics_percentile(&s_metrics[i], 95);
+    }
+    
+    ESP_LOGI(TAG, "Soak: punkt odniesienia - sterta %lu B, zadania %u",
+             baseline->heap_free_bytes, baseline->task_count);
+}
+
+esp_err_t rk_metrics_soak_check(const rk_metrics_soak_baseline_t *baseline,
+                                rk_metrics_soak_report_t *report)
+{
+    rk_metrics_soak_report_t local;
+    
+    if (baseline == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (report == NULL) {
+        report = &local;
+    }
+    
+    rk_heap_sample_t heap;
+    rk_heap_sample(&heap);
+    
+    memset(report, 0, sizeof(*report));
+    report->heap_drift_bytes = (int32_t)baseline->heap_free_bytes - (int32_t)heap.free_bytes;
+    report->largest_block_drift_bytes = (int32_t)baseline->heap_largest_block - (int32_t)heap.largest_block;
+    report->task_drift = (int8_t)((int)uxTaskGetNumberOfTasks() - baseline->task_count);
+    
+    bool res_leak = false;
+    for (int r = 0; r < RK_RES_COUNT; r++) {
+        report->res_drift[r] = rk_res_live((rk_res_type_t)r) - baseline->res_live[r];
+        if (report->res_drift[r] > 0) {
+            res_leak = true;
+            ESP_LOGE(TAG, "Soak: przybyło %ld zasobów typu %s",
+                     report->res_drift[r], rk_res_name((rk_res_type_t)r));
+        }
+    }
+    
+    // Histogram bez próbek w punkcie odniesienia nie ma z czym się porównać
+    for (int i = 0; i < (int)baseline->metric_count && i < s_metric_count; i++) {
+        uint32_t base = baseline->p95[i];
+        uint32_t now = rk_metrics_percentile(&s_metrics[i], 95);
+        if (base > 0 && now > base * RK_SOAK_LATENCY_FACTOR) {
+            report->slow_metric = s_metrics[i].name;
+            ESP_LOGE(TAG, "Soak: %s p95 %lu -> %lu", s_metrics[i].name, base, now);
+            break;
+        }
+    }
+    
+    report->leak = res_leak || report->task_drift > 0 ||
+                   report->heap_drift_bytes > RK_SOAK_HEAP_DRIFT_BYTES;
+    
+    if (report->leak) {
+        ESP_LOGE(TAG, "Soak: dryf sterty %ld B (największy blok %ld B), zadań %d",
+                 report->heap_drift_bytes, report->largest_block_drift_bytes, report->task_drift);
+    } else {
+        ESP_LOGI(TAG, "Soak: bez dryfu (sterta %ld B, zadania %d)",
+                 report->heap_drift_bytes, report->task_drift);
+    }
+    
+    return report->leak || report->slow_metric != NULL ? ESP_FAIL : ESP_OK;
+}
@@ -6,33 +6,296 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "freertos/event_groups.h"
+#include "rk_common.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Maksymalny czas, przez jaki serwer powiadomień trzyma zapytanie long-poll
+#ifndef RK_OTA_NOTIFY_HOLD_S
+#define RK_OTA_NOTIFY_HOLD_S 120
+#endif
+
+// Odstęp ponownego łączenia kanału powiadomień po błędzie (min/max, rośnie x2)
+#ifndef RK_OTA_NOTIFY_RETRY_MIN_S
+#define RK_OTA_NOTIFY_RETRY_MIN_S 5
+#endif
+#ifndef RK_OTA_NOTIFY_RETRY_MAX_S
+#define RK_OTA_NOTIFY_RETRY_MAX_S 300
+#endif
+
+// Cache DNS hostów OTA: liczba wpisów i zakres akceptowanych TTL
+#ifndef RK_OTA_DNS_CACHE_SIZE
+#define RK_OTA_DNS_CACHE_SIZE 4
+#endif
+#ifndef RK_OTA_DNS_TTL_MIN_S
+#define RK_OTA_DNS_TTL_MIN_S 30
+#endif
+#ifndef RK_OTA_DNS_TTL_MAX_S
+#define RK_OTA_DNS_TTL_MAX_S 3600
+#endif
+// Jak długo po końcu TTL wpis może być używany, gdy odświeżanie w tle się nie udaje
+#ifndef RK_OTA_DNS_STALE_MAX_S
+#define RK_OTA_DNS_STALE_MAX_S 600
+#endif
+
+// Największy dokument konfiguracji zdalnej (JSON, pobierany do bufora na stosie zadania OTA)
+#ifndef RK_OTA_REMOTE_CONFIG_MAX
+#define RK_OTA_REMOTE_CONFIG_MAX 768
+#endif
+
+// Bufor pobierania obrazu (jeden na cały czas pracy, RK_MEM_BULK) - dane z HTTP trafiają z niego prosto do flash
+#ifndef RK_OTA_BUFFER_SIZE
+#define RK_OTA_BUFFER_SIZE 4096
+#endif
+
+// Strumień ramek z obrazem (rk_ota_update_local przez UART lub USB-CDC, tools/rk_ota_serial.py):
+// największa ramka danych (nie większa niż bufor pobierania), domyślna prędkość UART,
+// czas oczekiwania na ramkę i na ramkę startową oraz limit kolejnych błędnych ramek
+#ifndef RK_OTA_SERIAL_FRAME_MAX
+#define RK_OTA_SERIAL_FRAME_MAX 2048
+#endif
+#ifndef RK_OTA_SERIAL_BAUD
+#define RK_OTA_SERIAL_BAUD 921600
+#endif
+#ifndef RK_OTA_SERIAL_FRAME_TIMEOUT_MS
+#define RK_OTA_SERIAL_FRAME_TIMEOUT_MS 1000
+#endif
+#ifndef RK_OTA_SERIAL_START_TIMEOUT_MS
+#define RK_OTA_SERIAL_START_TIMEOUT_MS 30000
+#endif
+#ifndef RK_OTA_SERIAL_RETRIES
+#define RK_OTA_SERIAL_RETRIES 8
+#endif
+
+// Zapis z pominięciem sektorów identycznych z zawartością partycji docelowej
+// (mniej kasowań i zużycia flash przy aktualizacji z poprzedniej wersji)
+#ifndef RK_OTA_DIFF_WRITE
+#define RK_OTA_DIFF_WRITE 1
+#endif
+
+// Kasowanie nieaktywnej partycji w tle po potwierdzeniu startu (rk_ota_confirm_boot),
+// aby pobieranie tylko programowało strony zamiast kasować sektory. Przy RK_OTA_DIFF_WRITE
+// kasowany jest tylko obszar za poprzednim obrazem - obraz zostaje do porównania sektorów.
+#ifndef RK_OTA_PRE_ERASE
+#define RK_OTA_PRE_ERASE 1
+#endif
+
+// Pobieranie równoległe (HTTP Range) dla łączy o dużym RTT: maksymalna liczba połączeń
+// (1 - wyłączone). Faktyczna liczba zależy od wolnej sterty - każde połączenie to sesja TLS.
+#ifndef RK_OTA_SEGMENTS_MAX
+#define RK_OTA_SEGMENTS_MAX 4
+#endif
+
+// Szacowany koszt sterty jednego dodatkowego połączenia (TLS + bufory) i rezerwa dla systemu
+#ifndef RK_OTA_SEGMENT_HEAP_COST
+#define RK_OTA_SEGMENT_HEAP_COST (48 * 1024)
+#endif
+#ifndef RK_OTA_SEGMENT_HEAP_RESERVE
+#define RK_OTA_SEGMENT_HEAP_RESERVE (40 * 1024)
+#endif
+
+// Mniejsze obrazy pobierane są jednym strumieniem (koszt uzgadniania TLS przeważa)
+#ifndef RK_OTA_SEGMENTS_MIN_IMAGE
+#define RK_OTA_SEGMENTS_MIN_IMAGE (256 * 1024)
+#endif
+
+// Tryb weryfikacji certyfikatów TLS
+typedef enum {
+    RK_OTA_TRUST_PINNED,            // Tylko wbudowany zestaw CA (GitHub + mirrory)
+    RK_OTA_TRUST_PINNED_FALLBACK,   // Wbudowany zestaw, przy błędzie weryfikacji pełny bundle
+    RK_OTA_TRUST_BUNDLE,            // Pełny bundle esp_crt_bundle
+} rk_ota_trust_mode_t;
+
+#ifndef RK_OTA_TRUST_MODE
+#define RK_OTA_TRUST_MODE RK_OTA_TRUST_PINNED_FALLBACK
+#endif
+
 typedef struct {
     char github_user[64];
     char github_repo[64];
     char github_branch[32];
     char firmware_file[64];
+    char mirror_url[128];           // Lokalny mirror (np. http://) z podpisem <url>.sig, pusty - brak
+    char config_file[32];           // Dokument konfiguracji zdalnej w repo (JSON), pusty - brak
 } rk_ota_config_t;
 
+// Lokalne źródło obrazu (provisioning fabryczny) - bez WiFi, ta sama ścieżka zapisu co HTTP
+typedef enum {
+    RK_OTA_LOCAL_FILE,          // Plik w systemie plików zamontowanym przez aplikację (SPIFFS/FAT/SD)
+    RK_OTA_LOCAL_UART,          // Ramki przez port UART (sterownik UART, wysoka prędkość)
+    RK_OTA_LOCAL_DEVICE,        // Ramki przez urządzenie VFS: USB-CDC ("/dev/usbserjtag"), na Linuksie pty
+} rk_ota_local_type_t;
+
+typedef struct {
+    rk_ota_local_type_t type;
+    char path[64];                  // FILE i DEVICE
+    int uart_port;                  // UART
+    int tx_pin;                     // UART, -1 - domyślne piny portu
+    int rx_pin;
+    uint32_t baud_rate;             // UART, 0 - RK_OTA_SERIAL_BAUD
+} rk_ota_local_source_t;
+
+// Konfiguracja zdalna - parametry zmieniane bez nowego obrazu.
+// Pola zerowe / puste nie zmieniają bieżącej wartości.
+typedef struct {
+    uint32_t version;               // Rosnący numer dokumentu (starszy lub równy jest pomijany)
+    uint32_t led_on_ms;
+    uint32_t led_off_ms;
+    char wifi_ssid[32];
+    char wifi_pass[64];
+    uint16_t ota_interval_min;      // Okres automatycznego sprawdzania OTA
+    char github_branch[32];
+    char firmware_file[64];
+} rk_ota_remote_config_t;
+
+/**
+ * @brief Zastosowanie nowej konfiguracji zdalnej (wołane z zadania OTA)
+ * @return ESP_OK - konfiguracja zapisywana w NVS; błąd - wersja odrzucona
+ */
+typedef esp_err_t (*rk_ota_remote_config_callback_t)(const rk_ota_remote_config_t *config);
+
 // Typy wiadomości OTA
 typedef enum {
     RK_OTA_MSG_CHECK_UPDATE,
     RK_OTA_MSG_FORCE_UPDATE,
+    RK_OTA_MSG_APPLY,           // Przełączenie na obraz przygotowany w trybie etapowym
+    RK_OTA_MSG_BENCHMARK,       // Test łącza: pobranie i SHA-256 bez zapisu i restartu
+    RK_OTA_MSG_BENCHMARK_FLASH, // Test łącza z mierzonym zapisem do nieaktywnej partycji
+    RK_OTA_MSG_BENCHMARK_MIRROR,// Test łącza przez lokalny mirror (z weryfikacją podpisu)
+    RK_OTA_MSG_LOCAL_UPDATE,    // Aktualizacja ze źródła lokalnego (rk_ota_update_local)
     RK_OTA_MSG_STOP
 } rk_ota_message_type_t;
 
+// Wiadomość niesie tylko typ - konfigurację rejestruje raz rk_ota_set_config
 typedef struct {
     rk_ota_message_type_t type;
-    rk_ota_config_t config;
 } rk_ota_message_t;
 
+// Etap bieżącej aktualizacji
+typedef enum {
+    RK_OTA_STATE_IDLE,
+    RK_OTA_STATE_CHECKING,      // Sprawdzanie pliku (DNS, TLS, przekierowania)
+    RK_OTA_STATE_DOWNLOADING,   // Pobieranie i zapis do flash
+    RK_OTA_STATE_VERIFYING,     // Walidacja obrazu i zmiana partycji startowej
+    RK_OTA_STATE_STAGED,        // Obraz zweryfikowany, czeka na okno serwisowe lub APPLY
+    RK_OTA_STATE_DONE,          // Sukces - restart w toku
+    RK_OTA_STATE_FAILED,
+    RK_OTA_STATE_CANCELLED,
+    RK_OTA_STATE_UP_TO_DATE,    // Serwer potwierdził ETag obrazu (304) - nic do pobrania
+} rk_ota_state_t;
+
+// Postęp aktualizacji
+typedef struct {
+    rk_ota_state_t state;
+    uint32_t bytes;             // Zapisane bajty obrazu
+    uint32_t total;             // Rozmiar obrazu (0 - nieznany)
+    esp_err_t last_error;       // Wynik ostatniej zakończonej próby
+    uint32_t seq;               // Rośnie przy każdej zmianie - do wykrywania aktualizacji
+} rk_ota_progress_t;
+
+// Tryb wdrażania pobranego obrazu
+typedef enum {
+    RK_OTA_APPLY_IMMEDIATE,     // Restart zaraz po pobraniu (domyślnie)
+    RK_OTA_APPLY_STAGED,        // Pobranie w tle, przełączenie w oknie serwisowym lub na polecenie
+} rk_ota_apply_mode_t;
+
+// Parametry trybu etapowego
+typedef struct {
+    rk_ota_apply_mode_t mode;
+    uint32_t bandwidth_limit_bps;   // Limit pobierania w bajtach/s (0 - bez limitu)
+    UBaseType_t download_priority;  // Priorytet zadania OTA na czas pobierania w tle
+    uint8_t window_start_hour;      // Okno serwisowe (czas lokalny, wymaga SNTP);
+    uint8_t window_end_hour;        // start == end - tylko na polecenie RK_OTA_MSG_APPLY
+} rk_ota_staging_t;
+
+// Wynik testu łącza (RK_OTA_MSG_BENCHMARK)
+typedef struct {
+    esp_err_t result;
+    bool with_flash;            // Test z zapisem do nieaktywnej partycji
+    bool redirected;            // Obraz pobrany po przekierowaniu
+    bool plain_http;            // Połączenie bez TLS (mirror)
+    bool signed_image;          // Obraz z podpisem .sig sprawdzonym po pobraniu
+    bool buffer_psram;          // Bufor pobierania w PSRAM (RK_MEM_PSRAM_POLICY)
+    uint32_t bytes;             // Pobrane bajty
+    uint32_t open_ms;           // Do nagłówków odpowiedzi 200 (DNS, TCP, TLS, przekierowania)
+    uint32_t dns_ms;            // Ostatnie rozwiązanie nazwy (cache DNS)
+    uint32_t tls_ms;            // Ostatnie uzgadnianie TCP + TLS
+    uint32_t download_ms;       // Pobranie treści (z SHA-256 i ewentualnym zapisem)
+    uint32_t hash_ms;           // Czas liczenia SHA-256
+    uint32_t flash_ms;          // Czas kasowania i zapisu flash (with_flash)
+    uint32_t signature_ms;      // Weryfikacja podpisu ECDSA (signed_image)
+    uint32_t cpu_ms;            // Czas CPU zadania OTA w trakcie pobierania (odczyt, TLS, skrót)
+    uint32_t throughput_bps;    // Średnia przepustowość pobierania (B/s)
+    bool hash_appended;         // Obraz ma dołączony SHA-256
+    bool hash_ok;               // Dołączony SHA-256 zgodny z treścią
+    uint8_t sha256[32];         // SHA-256 obrazu bez dołączonego skrótu
+} rk_ota_bench_result_t;
+
 // Callback dla zdarzeń OTA
 typedef void (*rk_ota_event_callback_t)(bool ota_started, bool ota_success);
 
+// Statystyki połączeń TLS dla jednego zestawu CA
+typedef struct {
+    uint32_t handshakes;               // Udane połączenia
+    uint32_t handshake_last_ms;        // Czas ostatniego połączenia (TCP + TLS)
+    uint32_t handshake_avg_ms;         // Średni czas połączenia
+    uint32_t heap_peak_bytes;          // Największe zużycie sterty przez połączenie
+} rk_ota_tls_stats_t;
+
+// Statystyki OTA
+typedef struct {
+    uint32_t checks;                   // Wykonane sprawdzenia OTA
+    uint32_t checks_from_notify;       // Sprawdzenia wywołane przez kanał powiadomień
+    uint32_t notify_requests;          // Zapytania long-poll wysłane do serwera
+    uint32_t notify_events;            // Otrzymane powiadomienia o nowej wersji
+    uint32_t notify_errors;            // Błędy kanału powiadomień
+    bool notify_channel_up;            // Kanał powiadomień aktywny
+    uint32_t notify_to_download_ms;    // Czas od powiadomienia do startu pobierania (ostatni)
+    uint32_t dns_lookups;              // Zapytania do cache DNS
+    uint32_t dns_hits;                 // Trafienia (wpis ważny wg TTL)
+    uint32_t dns_stale_hits;           // Trafienia przeterminowane (odświeżane w tle)
+    uint32_t dns_misses;               // Chybienia (rozwiązanie synchroniczne)
+    uint32_t dns_failures;             // Nieudane rozwiązania nazw
+    uint32_t dns_evictions;            // Wpisy usunięte po nieudanym połączeniu pod adres z cache
+    uint32_t dns_rejected;             // Odpowiedzi DNS spoza serwera lub z obcym identyfikatorem
+    uint32_t dns_resolve_last_ms;      // Czas ostatniego rozwiązania nazwy
+    uint32_t dns_resolve_avg_ms;       // Średni czas rozwiązania nazwy
+    uint32_t dns_resolve_max_ms;       // Najdłuższe rozwiązanie nazwy
+    rk_ota_tls_stats_t tls_pinned;     // Połączenia z wbudowanym zestawem CA
+    rk_ota_tls_stats_t tls_bundle;     // Połączenia z pełnym bundle
+    uint32_t tls_fallbacks;            // Przejścia z wbudowanego zestawu na bundle
+    uint32_t downloads;                // Rozpoczęte pobrania obrazu
+    uint32_t download_bytes_last;      // Bajty zapisane w ostatnim pobraniu
+    uint32_t download_last_ms;         // Czas ostatniego pobrania (z zapisem do flash)
+    uint32_t download_throttle_ms;     // Czas oczekiwania na limit pasma w ostatnim pobraniu
+    uint32_t download_connections;     // Połączenia użyte w ostatnim pobraniu (Range)
+    uint32_t download_segment_retries; // Segmenty dokończone ponownym zapytaniem Range
+    uint32_t diff_sectors_skipped;     // Sektory identyczne - bez kasowania i zapisu
+    uint32_t diff_sectors_programmed;  // Sektory zapisane bez kasowania (tylko bity 1->0)
+    uint32_t diff_sectors_written;     // Sektory skasowane i zapisane
+    uint32_t diff_saved_ms;            // Szacowany zaoszczędzony czas kasowania i zapisu
+    uint32_t preerase_sectors;         // Sektory skasowane w tle
+    uint32_t preerase_erase_ms;        // Czas kasowania przeniesiony poza pobieranie
+    uint32_t preerase_clean_bytes;     // Skasowany zakres (od początku partycji lub za starym obrazem)
+    uint32_t staged_applies;           // Przełączenia na obraz przygotowany w tle
+    uint32_t mirror_downloads;         // Obrazy pobrane z lokalnego mirrora
+    uint32_t mirror_fallbacks;         // Przejścia z mirrora na GitHub (brak obrazu lub podpisu)
+    uint32_t mirror_version_rejects;   // Obrazy z mirrora odrzucone - wersja nie nowsza
+    uint32_t signature_failures;       // Obrazy odrzucone przez weryfikację podpisu
+    uint32_t firmware_not_modified;    // Sprawdzenia obrazu zakończone 304 (ETag bez zmian)
+    uint32_t config_checks;            // Zapytania o dokument konfiguracji zdalnej
+    uint32_t config_not_modified;      // Odpowiedzi 304 (ETag bez zmian)
+    uint32_t config_updates;           // Zastosowane nowe wersje konfiguracji
+    uint32_t config_rejected;          // Dokumenty odrzucone (składnia, zakresy, callback)
+    uint32_t config_version;           // Wersja obowiązującej konfiguracji (0 - brak)
+    uint32_t local_updates;            // Obrazy zainstalowane ze źródła lokalnego
+    uint32_t serial_frames;            // Przyjęte ramki strumienia szeregowego
+    uint32_t serial_retransmits;       // Ramki odrzucone i zażądane ponownie (NAK)
+    uint32_t serial_crc_errors;        // Ramki z niezgodnym CRC-32
+} rk_ota_stats_t;
+
 /**
  * @brief Inicjalizacja komponentu OTA
  * @return ESP_OK w przypadku sukcesu
@@ -43,9 +306,31 @@ esp_err_t rk_ota_init(void);
  * @brief Uruchomienie zadania OTA
  * @param wifi_event_group Event Group WiFi do monitorowania połączenia
  * @param callback Funkcja callback dla zdarzeń OTA
+ * @param config Rdzeń, priorytet i stos zadania (NULL - bez przypięcia, priorytet 2)
+ * @return ESP_OK w przypadku sukcesu, ESP_ERR_INVALID_STATE gdy zatrzymane zadanie
+ *         jeszcze kończy pobieranie (ponowić później)
+ */
+esp_err_t rk_ota_start_task(EventGroupHandle_t wifi_event_group, rk_ota_event_callback_t callback,
+                            const rk_task_config_t *config);
+
+/**
+ * @brief Rejestracja konfiguracji OTA używanej przez kolejne sprawdzenia
+ * @param config Konfiguracja OTA (kopiowana raz, nie przechodzi przez kolejkę)
  * @return ESP_OK w przypadku sukcesu
  */
-esp_err_t rk_ota_start_task(EventGroupHandle_t wifi_event_group, rk_ota_event_callback_t callback);
+esp_err_t rk_ota_set_config(const rk_ota_config_t *config);
+
+/**
+ * @brief Konfiguracja zdalna zapisana w NVS (do użycia przy starcie, po nvs_flash_init i rk_ota_init)
+ * @param config Struktura do wypełnienia
+ * @return ESP_OK, ESP_ERR_NOT_FOUND gdy nic nie zapisano
+ */
+esp_err_t rk_ota_remote_config_load(rk_ota_remote_config_t *config);
+
+/**
+ * @brief Rejestracja funkcji stosującej nowe wersje konfiguracji zdalnej na żywo
+ */
+void rk_ota_set_remote_config_callback(rk_ota_remote_config_callback_t callback);
 
 /**
  * @brief Sprawdzenie i wykonanie aktualizacji OTA z GitHub
@@ -54,6 +339,17 @@ esp_err_t rk_ota_start_task(EventGroupHandle_t wifi_event_group, rk_ota_event_ca
  */
 esp_err_t rk_ota_check_update(const rk_ota_config_t *config);
 
+/**
+ * @brief Aktualizacja z pliku lub strumienia szeregowego (w zadaniu OTA, bez WiFi)
+ *
+ * Strumień szeregowy to ramki z CRC-32 potwierdzane pojedynczo (tools/rk_ota_serial.py).
+ * Po poprawnym obrazie następuje restart, jak po aktualizacji z GitHub.
+ *
+ * @param source Źródło obrazu (kopiowane)
+ * @return ESP_OK gdy zlecenie trafiło do kolejki OTA
+ */
+esp_err_t rk_ota_update_local(const rk_ota_local_source_t *source);
+
 /**
  * @brief Wysłanie wiadomości do zadania OTA
  * @param msg Wiadomość do wysłania
@@ -67,8 +363,115 @@ esp_err_t rk_ota_send_message(const rk_ota_message_t *msg);
  */
 const char* rk_ota_get_version(void);
 
+/**
+ * @brief Ustawienie trybu weryfikacji certyfikatów TLS
+ * @param mode Tryb zaufania
+ */
+void rk_ota_set_trust_mode(rk_ota_trust_mode_t mode);
+
+/**
+ * @brief Pobranie trybu weryfikacji certyfikatów TLS
+ * @return Aktualny tryb zaufania
+ */
+rk_ota_trust_mode_t rk_ota_get_trust_mode(void);
+
+/**
+ * @brief Uruchomienie kanału powiadomień o nowej wersji (long-poll HTTP)
+ *
+ * Zadanie wysyła GET <url>?version=<wersja> i czeka na odpowiedź serwera:
+ * 200 - opublikowano nową wersję (natychmiastowe RK_OTA_MSG_CHECK_UPDATE),
+ * 204/304 - brak zmian, kolejne zapytanie. Przy błędach kanał jest
+ * oznaczany jako nieaktywny i aplikacja wraca do cyklicznego sprawdzania.
+ * Sprawdzenie używa ostatniej konfiguracji przekazanej w wiadomości OTA.
+ *
+ * @param url Adres endpointu long-poll
+ * @return ESP_OK w przypadku sukcesu
+ */
+esp_err_t rk_ota_start_notify_channel(const char *url);
+
+/**
+ * @brief Zatrzymanie kanału powiadomień i oczekiwanie na koniec jego zadania
+ *
+ * Trwające zapytanie long-poll kończy się z odpowiedzią serwera; czekanie trwa
+ * najwyżej RK_TASK_STOP_TIMEOUT_MS.
+ *
+ * @return ESP_OK gdy zadanie się zakończyło, ESP_ERR_TIMEOUT gdy jeszcze działa
+ */
+esp_err_t rk_ota_stop_notify_channel(void);
+
+/**
+ * @brief Sprawdzenie czy kanał powiadomień działa
+ * @return true jeśli ostatnie zapytanie long-poll zakończyło się poprawnie
+ */
+bool rk_ota_notify_channel_is_up(void);
+
+/**
+ * @brief Potwierdzenie poprawnego startu obrazu
+ *
+ * Anuluje wycofanie (obraz w stanie PENDING_VERIFY) i zezwala na kasowanie
+ * nieaktywnej partycji w tle. Wywoływać, gdy aplikacja działa poprawnie
+ * (np. po połączeniu z siecią).
+ *
+ * @return ESP_OK w przypadku sukcesu
+ */
+esp_err_t rk_ota_confirm_boot(void);
+
+/**
+ * @brief Ustawienie trybu wdrażania (natychmiastowy lub etapowy)
+ * @param staging Parametry trybu
+ * @return ESP_OK w przypadku sukcesu
+ */
+esp_err_t rk_ota_set_staging(const rk_ota_staging_t *staging);
+
+/**
+ * @brief Sprawdzenie czy obraz czeka na przełączenie
+ * @return true jeśli zweryfikowany obraz jest gotowy w nieaktywnej partycji
+ */
+bool rk_ota_is_update_staged(void);
+
+/**
+ * @brief Wynik ostatniego testu łącza
+ * @param result Struktura do wypełnienia
+ */
+void rk_ota_get_benchmark(rk_ota_bench_result_t *result);
+
+/**
+ * @brief Pobranie postępu bieżącej (lub ostatniej) aktualizacji
+ * @param progress Struktura do wypełnienia
+ */
+void rk_ota_get_progress(rk_ota_progress_t *progress);
+
+/**
+ * @brief Anulowanie trwającej aktualizacji (przed zapisem partycji startowej)
+ * @return true jeśli aktualizacja była w toku
+ */
+bool rk_ota_cancel(void);
+
+/**
+ * @brief Nazwa etapu aktualizacji
+ */
+const char *rk_ota_state_name(rk_ota_state_t state);
+
+/**
+ * @brief Przygotowanie do uśpienia - wstrzymanie kasowania partycji w tle
+ *
+ * Wywoływane przed esp_deep_sleep_start/esp_light_sleep_start. Kasowanie
+ * wznawia kolejne sprawdzenie OTA (po uśpieniu płytkim) lub start układu.
+ */
+void rk_ota_prepare_sleep(void);
+
+/**
+ * @brief Pobranie statystyk OTA
+ * @param stats Struktura do wypełnienia
+ */
+void rk_ota_get_stats(rk_ota_stats_t *stats);
+
 /**
  * @brief Zatrzymanie zadania OTA
+ *
+ * Najpierw zatrzymuje kanał powiadomień - jego zadanie wysyła do kolejki OTA. Kolejka
+ * zostaje, gdy któreś z zadań nie potwierdzi zakończenia. Trwające pobieranie jest
+ * anulowane przy najbliższym odczycie.
  */
 void rk_ota_stop_task(void);
 
@@ -1,13 +1,19 @@
 #include "rk_ota.h"
+#include "rk_ota_priv.h"
+#include "rk_common.h"
+#include "rk_metrics.h"
+#include "rk_log.h"
 #include "esp_log.h"
-#include "esp_https_ota.h"
 #include "esp_http_client.h"
 #include "esp_app_format.h"
 #include "esp_ota_ops.h"
 #include "esp_partition.h"
-#include "esp_crt_bundle.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "freertos/timers.h"
 #include <string.h>
+#include <strings.h>
+#include <time.h>
 
 static const char *TAG = "RK_OTA";
 
@@ -21,15 +27,73 @@ static const char *TAG = "RK_OTA";
 // 4. Skopiuj token i wklej powyżej
 // =====================================
 
+#define OTA_TASK_STACK 8192  // 8KB stosu dla OTA
+#define OTA_QUEUE_LEN  5
+
+// Bufory statyczne (RK_STATIC_ALLOC)
+RK_TASK_BUFFER(ota_task, OTA_TASK_STACK);
+RK_QUEUE_BUFFER(ota_queue, OTA_QUEUE_LEN, sizeof(rk_ota_message_t));
+
+// Bufor danych pobierania - jeden na cały czas pracy, bez alokacji przy każdym OTA.
+// Przydzielany w rk_ota_init jako RK_MEM_BULK (PSRAM, jeśli jest) - zwalnia SRAM dla TLS i WiFi
+static uint8_t *s_ota_buffer = NULL;
+
 // Zmienne globalne
 static QueueHandle_t ota_queue = NULL;
 static TaskHandle_t ota_task_handle = NULL;
 static EventGroupHandle_t wifi_event_group = NULL;
 static rk_ota_event_callback_t event_callback = NULL;
 static bool task_running = false;
+static TaskHandle_t s_stop_waiter = NULL;  // Czeka w rk_ota_stop_task na koniec zadania
+static bool s_stop_pending = false;         // STOP wysłany, zadanie jeszcze kończy pobieranie
+
+// Konfiguracja OTA zarejestrowana przez rk_ota_set_config
+static rk_ota_config_t s_config;
+static bool s_has_config = false;
+static portMUX_TYPE s_config_lock = portMUX_INITIALIZER_UNLOCKED;
+
+rk_ota_stats_t rk_ota_stats = {0};
+
+// Postęp aktualizacji i żądanie anulowania
+static rk_ota_progress_t s_progress = {0};
+static portMUX_TYPE s_progress_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool s_cancel_requested = false;
+static bool s_target_written = false;   // Operacja zapisała partycję docelową (dla kasowania w tle)
+static bool s_force_download = false;   // FORCE - bez zapytania warunkowego o obraz
+static rk_ota_local_source_t s_local_source;    // Źródło dla RK_OTA_MSG_LOCAL_UPDATE
+
+// Tryb etapowy: obraz zweryfikowany w nieaktywnej partycji czeka na przełączenie
+static rk_ota_staging_t s_staging = {
+    .mode = RK_OTA_APPLY_IMMEDIATE,
+    .download_priority = 1,
+};
+static const esp_partition_t *s_staged_partition = NULL;
+
+// Wynik ostatniego testu łącza
+static rk_ota_bench_result_t s_bench = {0};
+static portMUX_TYPE s_bench_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#define OTA_CLOCK_VALID_YEAR 2024  // Wcześniejszy rok - zegar nie zsynchronizowany
+
+// Metryki (rk_metrics)
+static const uint32_t s_tls_ms_bounds[] = {250, 500, 1000, 2000, 4000, 8000};
+static rk_metric_t *s_metric_tls_ms = NULL;
+static rk_metric_t *s_metric_download_bytes = NULL;
+static rk_metric_t *s_metric_heap_min = NULL;
+int64_t rk_ota_notify_received_us = 0;
+
+#define OTA_MAX_REDIRECTS 5
+#define OTA_ETAG_LEN      72
+
+static char s_staged_etag[OTA_ETAG_LEN];    // ETag obrazu czekającego na przełączenie
+static rk_ota_source_t s_staged_origin;     // Źródło tego obrazu
 
-// WiFi event bits (importowane z rk_wifi)
-#define RK_WIFI_CONNECTED_BIT BIT0
+// Kontekst zapytania HTTP (user_data event handlera)
+typedef struct {
+    char location[512];  // Nagłówek Location z odpowiedzi przekierowania
+    bool accept_ranges;  // Serwer obsługuje zapytania Range (Accept-Ranges: bytes)
+    char etag[OTA_ETAG_LEN];    // Nagłówek ETag (zapytania warunkowe o małe pliki)
+} http_request_ctx_t;
 
 static esp_err_t _http_event_handler(esp_http_client_event_t *evt)
 {
@@ -45,11 +109,26 @@ static esp_err_t _http_event_handler(esp_http_client_event_t *evt)
         break;
     case HTTP_EVENT_ON_HEADER:
         ESP_LOGD(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+        if (evt->user_data != NULL && strcasecmp(evt->header_key, "Location") == 0) {
+            http_request_ctx_t *ctx = (http_request_ctx_t *)evt->user_data;
+            strncpy(ctx->location, evt->header_value, sizeof(ctx->location) - 1);
+            ctx->location[sizeof(ctx->location) - 1] = '\0';
+        }
+        if (evt->user_data != NULL && strcasecmp(evt->header_key, "Accept-Ranges") == 0) {
+            http_request_ctx_t *ctx = (http_request_ctx_t *)evt->user_data;
+            ctx->accept_ranges = strcasecmp(evt->header_value, "bytes") == 0;
+        }
+        if (evt->user_data != NULL && strcasecmp(evt->header_key, "ETag") == 0) {
+            http_request_ctx_t *ctx = (http_request_ctx_t *)evt->user_data;
+            strncpy(ctx->etag, evt->header_value, sizeof(ctx->etag) - 1);
+            ctx->etag[sizeof(ctx->etag) - 1] = '\0';
+        }
         break;
     case HTTP_EVENT_ON_DATA:
         ESP_LOGD(TAG, "HTTP_EVENT_ON_DATA, len=%d", evt->data_len);
         if (evt->data_len > 0) {
-            ESP_LOGI(TAG, "Pobieranie firmware: %d bajtów", evt->data_len);
+            // Odroczony wpis binarny - UART nie hamuje pętli pobierania
+            RK_LOGI(OTA, OTA_HTTP_DATA, evt->data_len);
         }
         break;
     case HTTP_EVENT_ON_FINISH:
@@ -65,11 +144,91 @@ static esp_err_t _http_event_handler(esp_http_client_event_t *evt)
     return ESP_OK;
 }
 
+void rk_ota_set_progress(rk_ota_state_t state, uint32_t bytes, uint32_t total)
+{
+    portENTER_CRITICAL(&s_progress_lock);
+    s_progress.state = state;
+    s_progress.bytes = bytes;
+    s_progress.total = total;
+    s_progress.seq++;
+    portEXIT_CRITICAL(&s_progress_lock);
+}
+
+bool rk_ota_cancel_requested(void)
+{
+    return s_cancel_requested;
+}
+
+// ESP_ERR_INVALID_VERSION - obraz bez zmian (304), zwykły wynik sprawdzenia, nie błąd
+static void finish_progress(esp_err_t result)
+{
+    rk_ota_state_t state = result == ESP_OK ? RK_OTA_STATE_DONE :
+                           result == ESP_ERR_INVALID_VERSION ? RK_OTA_STATE_UP_TO_DATE :
+                           s_cancel_requested ? RK_OTA_STATE_CANCELLED : RK_OTA_STATE_FAILED;
+    if (state == RK_OTA_STATE_UP_TO_DATE) {
+        result = ESP_OK;
+    }
+    
+    portENTER_CRITICAL(&s_progress_lock);
+    s_progress.state = state;
+    s_progress.last_error = result;
+    s_progress.seq++;
+    portEXIT_CRITICAL(&s_progress_lock);
+}
+
+static esp_err_t run_benchmark(const rk_ota_config_t *config, bool with_flash, bool mirror);
+static esp_err_t update_local(const rk_ota_local_source_t *local);
+
+// Czy teraz trwa okno serwisowe (czas lokalny z SNTP)
+static bool in_apply_window(void)
+{
+    if (s_staging.window_start_hour == s_staging.window_end_hour) {
+        return false;
+    }
+    
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    if (local.tm_year + 1900 < OTA_CLOCK_VALID_YEAR) {
+        return false;
+    }
+    
+    int hour = local.tm_hour;
+    if (s_staging.window_start_hour < s_staging.window_end_hour) {
+        return hour >= s_staging.window_start_hour && hour < s_staging.window_end_hour;
+    }
+    // Okno przez północ, np. 23-4
+    return hour >= s_staging.window_start_hour || hour < s_staging.window_end_hour;
+}
+
+static void apply_staged(void)
+{
+    if (s_staged_partition == NULL) {
+        ESP_LOGW(TAG, "Brak przygotowanego obrazu do przełączenia");
+        return;
+    }
+    
+    esp_err_t err = esp_ota_set_boot_partition(s_staged_partition);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Nie można ustawić partycji startowej: %s", esp_err_to_name(err));
+        s_staged_partition = NULL;
+        finish_progress(err);
+        return;
+    }
+    
+    rk_ota_stats.staged_applies++;
+    rk_ota_firmware_etag_stage(s_staged_origin, s_staged_etag, s_staged_partition);
+    finish_progress(ESP_OK);
+    ESP_LOGI(TAG, "Przełączenie na obraz z partycji %s - restart", s_staged_partition->label);
+    rk_shutdown_restart("ota_apply");
+}
+
 static void ota_task(void *pvParameters)
 {
     ESP_LOGI(TAG, "Zadanie OTA uruchomione");
     
     rk_ota_message_t msg;
+    static rk_ota_config_t config;  // Migawka konfiguracji na czas sprawdzenia
     
     while(task_running) {
         // Sprawdź czy są wiadomości w kolejce
@@ -88,39 +247,138 @@ static void ota_task(void *pvParameters)
                         }
                     }
                     
+                    // Obraz już czeka - zwykłe sprawdzenie nie pobiera go ponownie
+                    if (s_staged_partition != NULL && msg.type == RK_OTA_MSG_CHECK_UPDATE) {
+                        ESP_LOGI(TAG, "Obraz przygotowany w %s czeka na przełączenie",
+                                 s_staged_partition->label);
+                        break;
+                    }
+                    
+                    if (!rk_ota_get_config(&config)) {
+                        ESP_LOGW(TAG, "Brak konfiguracji OTA (rk_ota_set_config), pomijam OTA");
+                        break;
+                    }
+                    
                     ESP_LOGI(TAG, "Rozpoczynanie sprawdzania OTA...");
+                    rk_ota_stats.checks++;
+                    s_force_download = msg.type == RK_OTA_MSG_FORCE_UPDATE;
+                    s_cancel_requested = false;
+                    s_staged_partition = NULL;  // Ponowne pobranie nadpisze nieaktywną partycję
+                    rk_ota_set_progress(RK_OTA_STATE_CHECKING, 0, 0);
                     
                     // Powiadom callback o rozpoczęciu OTA
                     if (event_callback) {
                         event_callback(true, false);
                     }
                     
-                    esp_err_t ret = rk_ota_check_update(&msg.config);
+                    // Konfiguracja zdalna przed obrazem - zapytanie warunkowe, zwykle 304.
+                    // Nowa wersja może zmienić gałąź lub plik obrazu.
+                    if (rk_ota_remote_config_check(&config) == ESP_OK) {
+                        rk_ota_get_config(&config);
+                    }
+                    
+                    // Partycja docelowa należy teraz do pobierania
+                    s_target_written = false;
+                    rk_ota_preerase_pause();
+                    esp_err_t ret = rk_ota_check_update(&config);
+                    rk_ota_preerase_resume(s_target_written);
+                    if (ret != ESP_OK) {
+                        finish_progress(ret);
+                    }
+                    bool up_to_date = ret == ESP_ERR_INVALID_VERSION;
+                    if (up_to_date) {
+                        ret = ESP_OK;
+                    }
+                    // Minimum sterty od startu - widać, ile zabrało każde podejście do OTA
+                    rk_metrics_set(s_metric_heap_min, heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
                     
                     // Powiadom callback o wyniku
                     if (event_callback) {
                         event_callback(false, ret == ESP_OK);
                     }
                     
-                    if (ret == ESP_OK) {
+                    if (up_to_date) {
+                        ESP_LOGI(TAG, "Obraz aktualny (ETag bez zmian)");
+                    } else if (ret == ESP_OK && s_staged_partition != NULL) {
+                        ESP_LOGI(TAG, "OTA przygotowane - przełączenie w oknie serwisowym lub na polecenie");
+                    } else if (ret == ESP_OK) {
                         ESP_LOGI(TAG, "OTA zakończone pomyślnie - restart nastąpi automatycznie");
                         // Restart nastąpi w funkcji rk_ota_check_update
                     } else {
                         ESP_LOGE(TAG, "OTA nie powiodło się");
                     }
                     break;
+                
+                case RK_OTA_MSG_BENCHMARK:
+                case RK_OTA_MSG_BENCHMARK_FLASH:
+                case RK_OTA_MSG_BENCHMARK_MIRROR:
+                    if (wifi_event_group != NULL &&
+                        !(xEventGroupGetBits(wifi_event_group) & RK_WIFI_CONNECTED_BIT)) {
+                        ESP_LOGW(TAG, "WiFi nie jest połączone, pomijam test łącza");
+                        break;
+                    }
+                    
+                    if (!rk_ota_get_config(&config)) {
+                        ESP_LOGW(TAG, "Brak konfiguracji OTA (rk_ota_set_config), pomijam test łącza");
+                        break;
+                    }
+                    
+                    // Bez callbacku - test nie zmienia stanu urządzenia (LED działa normalnie)
+                    s_cancel_requested = false;
+                    rk_ota_set_progress(RK_OTA_STATE_CHECKING, 0, 0);
+                    s_target_written = false;
+                    rk_ota_preerase_pause();
+                    esp_err_t bench_err = run_benchmark(&config, msg.type == RK_OTA_MSG_BENCHMARK_FLASH,
+                                                        msg.type == RK_OTA_MSG_BENCHMARK_MIRROR);
+                    rk_ota_preerase_resume(s_target_written);
+                    if (bench_err != ESP_OK) {
+                        finish_progress(bench_err);
+                    }
+                    break;
+                
+                case RK_OTA_MSG_LOCAL_UPDATE:
+                    // Bez WiFi i konfiguracji GitHub - linia produkcyjna
+                    ESP_LOGI(TAG, "Aktualizacja ze źródła lokalnego...");
+                    s_cancel_requested = false;
+                    s_staged_partition = NULL;
+                    rk_ota_set_progress(RK_OTA_STATE_CHECKING, 0, 0);
+                    if (event_callback) {
+                        event_callback(true, false);
+                    }
+                    
+                    s_target_written = false;
+                    rk_ota_preerase_pause();
+                    esp_err_t local_err = update_local(&s_local_source);
+                    rk_ota_preerase_resume(s_target_written);
                     
+                    // Sukces kończy się restartem w update_local
+                    finish_progress(local_err);
+                    if (event_callback) {
+                        event_callback(false, false);
+                    }
+                    break;
+                
+                case RK_OTA_MSG_APPLY:
+                    apply_staged();
+                    break;
+                
                 case RK_OTA_MSG_STOP:
                     ESP_LOGI(TAG, "Zatrzymanie zadania OTA");
                     task_running = false;
                     break;
-                    
+                
                 default:
                     ESP_LOGW(TAG, "Nieznany typ wiadomości OTA: %d", msg.type);
                     break;
             }
         }
         
+        // Przygotowany obraz przełączany samoczynnie tylko w oknie serwisowym
+        if (s_staged_partition != NULL && in_apply_window()) {
+            ESP_LOGI(TAG, "Okno serwisowe - przełączam na przygotowany obraz");
+            apply_staged();
+        }
+        
         // Automatyczne sprawdzanie OTA co 5 minut (jeśli WiFi połączone)
         static uint32_t last_check = 0;
         uint32_t current_time = xTaskGetTickCount() / configTICK_RATE_HZ;
@@ -139,13 +397,30 @@ static void ota_task(void *pvParameters)
     }
     
     ESP_LOGI(TAG, "Zadanie OTA zakończone");
-    vTaskDelete(NULL);
+    rk_join_signal(s_stop_waiter);
+    rk_task_delete(NULL);
 }
 
 esp_err_t rk_ota_init(void)
 {
     ESP_LOGI(TAG, "Inicjalizacja komponentu OTA");
     
+    s_metric_tls_ms = rk_metrics_histogram("ota.tls_ms", s_tls_ms_bounds,
+                                           sizeof(s_tls_ms_bounds) / sizeof(s_tls_ms_bounds[0]));
+    s_metric_download_bytes = rk_metrics_counter("ota.download_b");
+    s_metric_heap_min = rk_metrics_gauge("ota.heap_min_b");
+    rk_ota_remote_init();
+    
+    if (s_ota_buffer == NULL) {
+        s_ota_buffer = rk_mem_alloc(RK_OTA_BUFFER_SIZE, RK_MEM_BULK);
+        if (s_ota_buffer == NULL) {
+            ESP_LOGE(TAG, "Brak pamięci na bufor pobierania (%d B)", RK_OTA_BUFFER_SIZE);
+            return ESP_ERR_NO_MEM;
+        }
+        ESP_LOGI(TAG, "Bufor pobierania: %d B w %s", RK_OTA_BUFFER_SIZE,
+                 rk_mem_is_psram(s_ota_buffer) ? "PSRAM" : "SRAM");
+    }
+    
     // Sprawdź czy token jest ustawiony
     if (strlen(GITHUB_TOKEN) == 0 || strcmp(GITHUB_TOKEN, "ghp_TWÓJ_TOKEN_TUTAJ") == 0) {
         ESP_LOGW(TAG, "UWAGA: GitHub token nie jest ustawiony!");
@@ -158,9 +433,32 @@ esp_err_t rk_ota_init(void)
     return ESP_OK;
 }
 
-esp_err_t rk_ota_start_task(EventGroupHandle_t wifi_event_group_handle, rk_ota_event_callback_t callback)
+// Krok wyłączenia: kanał powiadomień, kasowanie w tle i zadanie OTA
+static void ota_shutdown(void)
+{
+    rk_ota_stop_notify_channel();
+    rk_ota_preerase_pause();
+    
+    // Restart zlecony przez samo zadanie OTA - kończy się razem z układem
+    if (xTaskGetCurrentTaskHandle() != ota_task_handle) {
+        rk_ota_stop_task();
+    }
+}
+
+esp_err_t rk_ota_start_task(EventGroupHandle_t wifi_event_group_handle, rk_ota_event_callback_t callback,
+                            const rk_task_config_t *config)
 {
+    static const rk_task_config_t defaults = {
+        .core = RK_TASK_CORE_ANY,
+        .priority = 2,                  // Niski priorytet
+        .stack_bytes = OTA_TASK_STACK,
+    };
+    
     if (task_running) {
+        if (s_stop_pending) {
+            ESP_LOGW(TAG, "Zadanie OTA jeszcze kończy pobieranie po zatrzymaniu");
+            return ESP_ERR_INVALID_STATE;
+        }
         ESP_LOGW(TAG, "Zadanie OTA już działa");
         return ESP_OK;
     }
@@ -168,7 +466,19 @@ esp_err_t rk_ota_start_task(EventGroupHandle_t wifi_event_group_handle, rk_ota_e
     wifi_event_group = wifi_event_group_handle;
     event_callback = callback;
     
-    ota_queue = xQueueCreate(5, sizeof(rk_ota_message_t));
+    if (rk_ota_dns_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Cache DNS niedostępny - nazwy rozwiązuje lwIP");
+    }
+    
+    if (rk_ota_preerase_start() != ESP_OK) {
+        ESP_LOGW(TAG, "Kasowanie w tle niedostępne - sektory kasowane podczas pobierania");
+    }
+    
+    // Kolejka pozostawiona przez zatrzymanie po czasie - zadanie już z niej nie czyta
+    s_stop_pending = false;
+    if (ota_queue == NULL) {
+        ota_queue = rk_queue_create(OTA_QUEUE_LEN, sizeof(rk_ota_message_t), RK_QUEUE_STATIC(ota_queue));
+    }
     if (ota_queue == NULL) {
         ESP_LOGE(TAG, "Nie można utworzyć kolejki OTA");
         return ESP_ERR_NO_MEM;
@@ -176,122 +486,556 @@ esp_err_t rk_ota_start_task(EventGroupHandle_t wifi_event_group_handle, rk_ota_e
     
     task_running = true;
     
-    BaseType_t ret = xTaskCreate(ota_task, 
-                                "ota_task", 
-                                8192,  // 8KB stosu dla OTA
-                                NULL, 
-                                2,     // Niski priorytet
-                                &ota_task_handle);
+    BaseType_t ret = rk_task_create_config(ota_task, "ota_task", NULL, config, &defaults,
+                                          &ota_task_handle, RK_TASK_STATIC_CFG(ota_task));
     
     if (ret != pdPASS) {
         ESP_LOGE(TAG, "Nie można utworzyć zadania OTA");
-        vQueueDelete(ota_queue);
+        rk_queue_delete(ota_queue);
         ota_queue = NULL;
         task_running = false;
         return ESP_ERR_NO_MEM;
     }
     
-    ESP_LOGI(TAG, "Zadanie OTA uruchomione");
+    rk_shutdown_register("ota", ota_shutdown);
+    ESP_LOGI(TAG, "Zadanie OTA uruchomione (kolejka %d x %u B)", OTA_QUEUE_LEN, sizeof(rk_ota_message_t));
     return ESP_OK;
 }
 
-esp_err_t rk_ota_check_update(const rk_ota_config_t *config)
+// Nagłówki wspólne dla sprawdzenia i pobierania
+void rk_ota_set_request_headers(esp_http_client_handle_t client, const char *authority,
+                                bool host_override, bool use_auth)
 {
-    ESP_LOGI(TAG, "Rozpoczynanie OTA z GitHub...");
+    // Połączenie na adres IP z cache DNS - Host musi wskazywać właściwy serwer
+    if (host_override) {
+        esp_http_client_set_header(client, "Host", authority);
+    }
     
-    // Budowanie URL do firmware
-    char firmware_url[512];
+    // Dodaj token do nagłówka jeśli dostępny
+    if (use_auth) {
+        char auth_header[256];
+        snprintf(auth_header, sizeof(auth_header), "token %s", GITHUB_TOKEN);
+        esp_http_client_set_header(client, "Authorization", auth_header);
+        ESP_LOGI(TAG, "Dodano nagłówek Authorization");
+    }
     
-    // Sprawdź czy mamy token - jeśli tak, użyj go
-    bool use_token = (strlen(GITHUB_TOKEN) > 0 && strcmp(GITHUB_TOKEN, "ghp_TWÓJ_TOKEN_TUTAJ") != 0);
+    // Dodaj User-Agent (GitHub tego wymaga)
+    esp_http_client_set_header(client, "User-Agent", "ESP32-OTA-Client/1.0");
+}
+
+// Sprawdzenie czy plik istnieje, z ręczną obsługą przekierowań.
+// Każdy host przechodzi przez cache DNS, a url po powrocie wskazuje końcowy adres pliku.
+// use_bundle wskazuje zestaw CA, z którym połączenie się udało.
+// Przy odpowiedzi 200 połączenie zostaje otwarte w *body_client - treść pobierana jest
+// z tej samej sesji TLS, bez drugiego klienta i drugiego uzgadniania.
+// accept_ranges mówi, czy końcowy serwer pozwala pobierać obraz segmentami.
+// if_none_match (może być NULL) czyni zapytanie warunkowym - 304 wraca jak każdy inny kod,
+// a ETag odpowiedzi trafia do etag.
+static esp_err_t probe_firmware(char *url, size_t url_len, bool use_token,
+                                int *status_code, int *content_length,
+                                bool *redirected, bool *use_bundle, bool *accept_ranges,
+                                const char *if_none_match, char *etag, size_t etag_len,
+                                esp_http_client_handle_t *body_client)
+{
+    *body_client = NULL;
+    static http_request_ctx_t ctx;
+    *redirected = false;
     
-    if (use_token) {
-        // Dla prywatnych repo z tokenem
-        snprintf(firmware_url, sizeof(firmware_url),
-                 "https://raw.githubusercontent.com/%s/%s/%s/%s",
-                 config->github_user,
-                 config->github_repo,
-                 config->github_branch,
-                 config->firmware_file);
-        ESP_LOGI(TAG, "Używam tokenu GitHub dla prywatnego repo");
-    } else {
-        // Dla publicznych repo bez tokenu
-        snprintf(firmware_url, sizeof(firmware_url),
-                 "https://github.com/%s/%s/raw/%s/%s",
-                 config->github_user,
-                 config->github_repo,
-                 config->github_branch,
-                 config->firmware_file);
-        ESP_LOGI(TAG, "Używam publicznego dostępu (bez tokenu)");
+    int hop = 0;
+    while (hop <= OTA_MAX_REDIRECTS) {
+        if (s_cancel_requested) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        
+        char connect_url[512];
+        char host[64];
+        char authority[72];
+        bool host_override = rk_ota_dns_rewrite_url(url, connect_url, sizeof(connect_url),
+                                                    host, sizeof(host),
+                                                    authority, sizeof(authority));
+        
+        esp_http_client_config_t http_config = {
+            .url = connect_url,
+            .common_name = host,
+            .event_handler = _http_event_handler,
+            .user_data = &ctx,
+            .disable_auto_redirect = true,
+            .timeout_ms = 30000,                    // 30 sekund timeout
+        };
+        rk_ota_trust_apply(&http_config, *use_bundle);
+        
+        // Utwórz klienta HTTP
+        esp_http_client_handle_t client = rk_ota_http_init(&http_config);
+        if (client == NULL) {
+            ESP_LOGE(TAG, "Nie można utworzyć klienta HTTP");
+            return ESP_ERR_NO_MEM;
+        }
+        
+        // Token tylko dla pierwotnego hosta GitHub - nie dla celu przekierowania
+        rk_ota_set_request_headers(client, authority, host_override, use_token && hop == 0);
+        if (if_none_match != NULL && if_none_match[0] != '\0') {
+            esp_http_client_set_header(client, "If-None-Match", if_none_match);
+        }
+        
+        ctx.location[0] = '\0';
+        ctx.etag[0] = '\0';
+        ctx.accept_ranges = false;
+        size_t heap_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        size_t heap_min_before = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+        int64_t open_start_us = esp_timer_get_time();
+        
+        esp_err_t err = esp_http_client_open(client, 0);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Nie można otworzyć połączenia HTTP: %s", esp_err_to_name(err));
+            rk_ota_http_cleanup(client);
+            if (host_override) {
+                // Następna próba rozwiąże nazwę od nowa zamiast wybierać martwy adres
+                rk_ota_dns_evict(host);
+            }
+            
+            if (rk_ota_trust_can_fall_back(*use_bundle)) {
+                // Ponowienie tego samego kroku z pełnym bundle
+                ESP_LOGW(TAG, "Ponawiam połączenie z pełnym bundle CA");
+                rk_ota_stats.tls_fallbacks++;
+                *use_bundle = true;
+                continue;
+            }
+            return err;
+        }
+        
+        // Czas połączenia (TCP + TLS) i zużycie sterty przez sesję TLS
+        if (strncmp(connect_url, "https", 5) == 0) {
+            uint32_t open_ms = (uint32_t)((esp_timer_get_time() - open_start_us) / 1000);
+            size_t heap_low = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+            size_t heap_min_after = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+            if (heap_min_after < heap_min_before) {
+                heap_low = heap_min_after;
+            }
+            rk_metrics_observe(s_metric_tls_ms, open_ms);
+            rk_ota_trust_record(*use_bundle, open_ms,
+                                heap_before > heap_low ? (uint32_t)(heap_before - heap_low) : 0);
+        }
+        
+        *content_length = esp_http_client_fetch_headers(client);
+        *status_code = esp_http_client_get_status_code(client);
+        if (etag != NULL && (*status_code == 200 || *status_code == 304)) {
+            strncpy(etag, ctx.etag, etag_len - 1);
+            etag[etag_len - 1] = '\0';
+        }
+        
+        if (*status_code == 200) {
+            *accept_ranges = ctx.accept_ranges;
+            *body_client = client;
+            return ESP_OK;
+        }
+        
+        esp_http_client_close(client);
+        rk_ota_http_cleanup(client);
+        
+        bool is_redirect = *status_code == 301 || *status_code == 302 || *status_code == 303 ||
+                           *status_code == 307 || *status_code == 308;
+        if (!is_redirect) {
+            return ESP_OK;
+        }
+        
+        if (strncmp(ctx.location, "http", 4) != 0) {
+            ESP_LOGE(TAG, "Nieobsługiwane przekierowanie: '%s'", ctx.location);
+            return ESP_FAIL;
+        }
+        
+        ESP_LOGI(TAG, "Przekierowanie %d -> %s", *status_code, ctx.location);
+        strncpy(url, ctx.location, url_len - 1);
+        url[url_len - 1] = '\0';
+        *redirected = true;
+        hop++;
     }
     
-    ESP_LOGI(TAG, "URL firmware: %s", firmware_url);
+    ESP_LOGE(TAG, "Zbyt wiele przekierowań");
+    return ESP_FAIL;
+}
+
+// Sposób zapisu obrazu do partycji
+typedef enum {
+    IMAGE_WRITE_OTA,        // esp_ota_begin / esp_ota_write
+    IMAGE_WRITE_DIFF,       // rk_ota_diff - pominięcie niezmienionych sektorów
+    IMAGE_WRITE_RAW,        // Segmenty zapisywane bezpośrednio przez esp_partition_write
+} image_write_t;
+
+// Domknięcie zapisu: walidacja obrazu (esp_ota_end / rk_ota_diff_end / rk_ota_verify_image
+// liczą SHA-256 całego złożonego obrazu) i zmiana partycji startowej - w trybie etapowym
+// robi to apply_staged.
+static esp_err_t finish_image(esp_ota_handle_t ota_handle, image_write_t mode,
+                              const esp_partition_t *partition,
+                              esp_err_t err, int received, int content_length, bool staged)
+{
+    if (err == ESP_OK && received != content_length) {
+        ESP_LOGE(TAG, "Niepełny obraz: %d z %d bajtów", received, content_length);
+        err = ESP_ERR_INVALID_SIZE;
+    }
     
-    // Konfiguracja HTTP
-    esp_http_client_config_t http_config = {
-        .url = firmware_url,
-        .event_handler = _http_event_handler,
-        .keep_alive_enable = true,
-        .timeout_ms = 30000,                    // 30 sekund timeout
-        .skip_cert_common_name_check = true,    // Pomiń weryfikację nazwy
-        .crt_bundle_attach = esp_crt_bundle_attach, // Użyj wbudowanych certyfikatów
-    };
+    if (err != ESP_OK) {
+        if (mode == IMAGE_WRITE_DIFF) {
+            rk_ota_diff_abort();
+        } else if (mode == IMAGE_WRITE_OTA) {
+            esp_ota_abort(ota_handle);
+        }
+        return err;
+    }
     
-    // Utwórz klienta HTTP
-    esp_http_client_handle_t client = esp_http_client_init(&http_config);
-    if (client == NULL) {
-        ESP_LOGE(TAG, "Nie można utworzyć klienta HTTP");
-        return ESP_ERR_NO_MEM;
+    rk_ota_set_progress(RK_OTA_STATE_VERIFYING, received, content_length);
+    switch (mode) {
+        case IMAGE_WRITE_DIFF:
+            err = rk_ota_diff_end();
+            break;
+        case IMAGE_WRITE_RAW:
+            err = rk_ota_verify_image(partition);
+            break;
+        default:
+            err = esp_ota_end(ota_handle);
+            break;
+    }
+    if (err != ESP_OK || staged) {
+        return err;
     }
     
-    // Dodaj token do nagłówka jeśli dostępny
+    return esp_ota_set_boot_partition(partition);
+}
+
+static int http_stream_read(void *ctx, uint8_t *buf, int len)
+{
+    return esp_http_client_read((esp_http_client_handle_t)ctx, (char *)buf, len);
+}
+
+static bool http_stream_complete(void *ctx)
+{
+    return esp_http_client_is_complete_data_received((esp_http_client_handle_t)ctx);
+}
+
+// Początek obrazu w całości (kilka odczytów) - do sprawdzenia przed pierwszym zapisem
+static int read_image_header(const rk_ota_stream_t *stream, uint8_t *buf, int len)
+{
+    int total = 0;
+    while (total < len) {
+        int n = stream->read(stream->ctx, buf + total, len - total);
+        if (n < 0) {
+            return n;
+        }
+        if (n == 0) {
+            break;
+        }
+        total += n;
+    }
+    return total;
+}
+
+// Strumieniowe pobranie obrazu: źródło (HTTP, plik, ramki szeregowe) -> s_ota_buffer -> partycja OTA.
+// Obraz z mirrora (signed_image) jest skrótowany w locie, a podpis sprawdzany
+// przed esp_ota_end - niepoprawny podpis przerywa zapis bez zmiany partycji startowej.
+// Wersję z jego nagłówka sprawdza rk_ota_sign_check_version przed pierwszym zapisem.
+static esp_err_t download_image(const rk_ota_stream_t *stream,
+                                const esp_partition_t *partition, int content_length,
+                                bool staged, bool signed_image)
+{
+    // Zapis z pominięciem identycznych sektorów albo zwykły esp_ota_write
+    bool diff = rk_ota_diff_supported(partition);
+    esp_ota_handle_t ota_handle = 0;
+    esp_err_t err = diff ? rk_ota_diff_begin(partition, content_length) :
+                    esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_ota_begin nie powiodło się: %s", esp_err_to_name(err));
+        return err;
+    }
+    s_target_written = true;
+    
+    rk_ota_stats.downloads++;
+    if (signed_image) {
+        rk_ota_sign_begin();
+    }
+    int64_t start_us = esp_timer_get_time();
+    int received = 0;
+    int last_percent = -1;
+    int64_t throttle_us = 0;
+    rk_ota_set_progress(RK_OTA_STATE_DOWNLOADING, 0, content_length);
+    
+    // Limit pasma: mniejsze porcje (~4 na sekundę), by nie pobierać skokami
+    uint32_t bandwidth_bps = staged ? s_staging.bandwidth_limit_bps : 0;
+    int chunk = RK_OTA_BUFFER_SIZE;
+    if (bandwidth_bps > 0 && bandwidth_bps / 4 < (uint32_t)chunk) {
+        chunk = bandwidth_bps / 4 > 512 ? bandwidth_bps / 4 : 512;
+    }
+    
+    while (received < content_length) {
+        if (s_cancel_requested) {
+            ESP_LOGW(TAG, "Aktualizacja anulowana po %d bajtach", received);
+            err = ESP_ERR_INVALID_STATE;
+            break;
+        }
+        
+        bool header = signed_image && received == 0;
+        int len = header ? read_image_header(stream, s_ota_buffer, RK_OTA_IMAGE_HEADER_LEN) :
+                  stream->read(stream->ctx, s_ota_buffer, chunk);
+        if (len < 0) {
+            ESP_LOGE(TAG, "Błąd odczytu danych (%s)", stream->name);
+            err = ESP_FAIL;
+            break;
+        }
+        if (len == 0) {
+            if (stream->complete(stream->ctx)) {
+                break;
+            }
+            ESP_LOGE(TAG, "Połączenie przerwane po %d bajtach", received);
+            err = ESP_ERR_TIMEOUT;
+            break;
+        }
+        
+        if (header) {
+            err = rk_ota_sign_check_version(s_ota_buffer, len);
+            if (err != ESP_OK) {
+                break;
+            }
+        }
+        if (signed_image) {
+            rk_ota_sign_update(s_ota_buffer, len);
+        }
+        err = diff ? rk_ota_diff_write(s_ota_buffer, len) :
+              esp_ota_write(ota_handle, s_ota_buffer, len);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Zapis do flash nie powiódł się: %s", esp_err_to_name(err));
+            break;
+        }
+        received += len;
+        rk_metrics_add(s_metric_download_bytes, len);
+        rk_ota_set_progress(RK_OTA_STATE_DOWNLOADING, received, content_length);
+        
+        int percent = (int)((int64_t)received * 100 / content_length);
+        if (percent / 10 != last_percent / 10) {
+            ESP_LOGI(TAG, "Pobrano %d%% (%d/%d bajtów)", percent, received, content_length);
+            last_percent = percent;
+        }
+        
+        // Wstrzymanie odczytu - okno TCP spowalnia serwer, łącze zostaje dla aplikacji
+        if (bandwidth_bps > 0) {
+            int64_t due_us = start_us + (int64_t)received * 1000000 / bandwidth_bps;
+            int64_t wait_us = due_us - esp_timer_get_time();
+            if (wait_us >= portTICK_PERIOD_MS * 1000) {
+                vTaskDelay(pdMS_TO_TICKS(wait_us / 1000));
+                throttle_us += wait_us;
+            }
+        }
+    }
+    
+    rk_ota_stats.download_bytes_last = received;
+    rk_ota_stats.download_last_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    rk_ota_stats.download_throttle_ms = (uint32_t)(throttle_us / 1000);
+    rk_ota_stats.download_connections = 1;
+    ESP_LOGI(TAG, "Odebrano %d B w %lu ms (%s, %lu B/s)", received,
+             rk_ota_stats.download_last_ms, stream->name,
+             rk_ota_stats.download_last_ms > 0 ?
+             (uint32_t)((uint64_t)received * 1000 / rk_ota_stats.download_last_ms) : 0);
+    
+    if (signed_image && err == ESP_OK && received == content_length) {
+        err = rk_ota_sign_verify(NULL);
+    } else if (signed_image) {
+        rk_ota_sign_abort();
+    }
+    
+    return finish_image(ota_handle, diff ? IMAGE_WRITE_DIFF : IMAGE_WRITE_OTA, partition,
+                        err, received, content_length, staged);
+}
+
+// Pobranie segmentami (HTTP Range) - zapisy trafiają pod różne przesunięcia równolegle,
+// więc bez wspólnego uchwytu esp_ota; każdy segment kasuje tylko swoje sektory (z pominięciem
+// skasowanych w tle), zamiast kasowania całego zakresu przez esp_ota_begin.
+static esp_err_t download_image_segmented(esp_http_client_handle_t client, const char *url,
+                                          bool use_bundle, bool use_token,
+                                          const esp_partition_t *partition,
+                                          int content_length, int connections)
+{
+    esp_err_t err = content_length <= (int)partition->size ? rk_ota_check_target(partition) :
+                    ESP_ERR_INVALID_SIZE;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Partycja %s odrzucona: %s", partition->label, esp_err_to_name(err));
+        return err;
+    }
+    s_target_written = true;
+    
+    rk_ota_stats.downloads++;
+    int64_t start_us = esp_timer_get_time();
+    int received = 0;
+    rk_ota_set_progress(RK_OTA_STATE_DOWNLOADING, 0, content_length);
+    
+    err = rk_ota_segments_download(client, url, use_bundle, use_token, partition,
+                                   content_length, connections,
+                                   s_ota_buffer, RK_OTA_BUFFER_SIZE, &received);
+    
+    uint32_t elapsed_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    rk_metrics_add(s_metric_download_bytes, received);
+    rk_ota_stats.download_bytes_last = received;
+    rk_ota_stats.download_last_ms = elapsed_ms;
+    rk_ota_stats.download_throttle_ms = 0;
+    rk_ota_stats.download_connections = connections;
+    ESP_LOGI(TAG, "Pobrano %d B w %lu ms przez %d połączenia (%lu B/s)", received,
+             (unsigned long)elapsed_ms, connections,
+             elapsed_ms > 0 ? (unsigned long)((uint64_t)received * 1000 / elapsed_ms) : 0UL);
+    
+    return finish_image(0, IMAGE_WRITE_RAW, partition, err, received, content_length, false);
+}
+
+static bool have_token(void)
+{
+    return strlen(GITHUB_TOKEN) > 0 && strcmp(GITHUB_TOKEN, "ghp_TWÓJ_TOKEN_TUTAJ") != 0;
+}
+
+// Adres pliku w repo: raw.githubusercontent.com z tokenem (prywatne repo),
+// bez tokenu publiczny github.com/.../raw (przekierowanie na raw)
+static void build_repo_url(const rk_ota_config_t *config, const char *file, bool use_token,
+                           char *url, size_t url_len)
+{
     if (use_token) {
-        char auth_header[256];
-        snprintf(auth_header, sizeof(auth_header), "token %s", GITHUB_TOKEN);
-        esp_http_client_set_header(client, "Authorization", auth_header);
-        ESP_LOGI(TAG, "Dodano nagłówek Authorization");
+        snprintf(url, url_len, "https://raw.githubusercontent.com/%s/%s/%s/%s",
+                 config->github_user, config->github_repo, config->github_branch, file);
+    } else {
+        snprintf(url, url_len, "https://github.com/%s/%s/raw/%s/%s",
+                 config->github_user, config->github_repo, config->github_branch, file);
     }
+}
+
+esp_err_t rk_ota_fetch_file(const rk_ota_config_t *config, const char *file,
+                            const char *etag, char *new_etag, size_t etag_len,
+                            char *body, size_t body_len, bool *modified)
+{
+    static char url[512];
+    bool use_token = have_token();
+    build_repo_url(config, file, use_token, url, sizeof(url));
     
-    // Dodaj User-Agent (GitHub tego wymaga)
-    esp_http_client_set_header(client, "User-Agent", "ESP32-OTA-Client/1.0");
+    int status_code = 0;
+    int content_length = 0;
+    bool redirected = false;
+    bool use_bundle = rk_ota_trust_starts_with_bundle();
+    bool accept_ranges = false;
+    esp_http_client_handle_t client = NULL;
+    *modified = false;
     
-    esp_https_ota_config_t ota_config = {
-        .http_config = &http_config,
-        .http_client_init_cb = NULL,
-        .bulk_flash_erase = false,
-        .partial_http_download = false,
-    };
+    esp_err_t err = probe_firmware(url, sizeof(url), use_token, &status_code, &content_length,
+                                   &redirected, &use_bundle, &accept_ranges,
+                                   etag, new_etag, etag_len, &client);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (status_code == 304) {
+        return ESP_OK;
+    }
+    if (status_code != 200) {
+        ESP_LOGW(TAG, "Plik %s: HTTP %d", file, status_code);
+        return status_code == 404 ? ESP_ERR_NOT_FOUND : ESP_FAIL;
+    }
     
-    ESP_LOGI(TAG, "Próba aktualizacji OTA...");
+    int received = 0;
+    if (content_length >= (int)body_len) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    while (err == ESP_OK && received < (int)body_len - 1) {
+        int len = esp_http_client_read(client, body + received, body_len - 1 - received);
+        if (len < 0) {
+            err = ESP_FAIL;
+        }
+        if (len <= 0) {
+            break;
+        }
+        received += len;
+    }
+    if (err == ESP_OK && !esp_http_client_is_complete_data_received(client)) {
+        err = received >= (int)body_len - 1 ? ESP_ERR_INVALID_SIZE : ESP_ERR_TIMEOUT;
+    }
+    esp_http_client_close(client);
+    rk_ota_http_cleanup(client);
+    
+    body[received] = '\0';
+    *modified = err == ESP_OK;
+    return err;
+}
+
+// Otwarty obraz firmware - końcowy adres po przekierowaniach i odpowiedź 200 z treścią
+typedef struct {
+    char url[512];
+    bool use_token;
+    bool redirected;
+    bool use_bundle;
+    bool accept_ranges;
+    bool signed_image;                  // Mirror - podpis pobrany, do sprawdzenia po obrazie
+    rk_ota_source_t origin;             // Źródło - osobny ETag dla każdego
+    int content_length;
+    char etag[OTA_ETAG_LEN];            // ETag obrazu - zatwierdzany po potwierdzeniu startu
+    const esp_partition_t *partition;   // Partycja docelowa (nieaktywna)
+    esp_http_client_handle_t client;    // Otwarte połączenie - zamyka wywołujący
+} ota_source_t;
+
+// Budowa adresu z konfiguracji, sprawdzenie pliku i jego rozmiaru względem partycji OTA.
+// mirror - lokalny serwer z config->mirror_url; bez podpisu .sig nie jest używany.
+// if_none_match - ETag zainstalowanego obrazu; 304 kończy się ESP_ERR_INVALID_VERSION.
+static esp_err_t open_firmware(const rk_ota_config_t *config, ota_source_t *source, bool mirror,
+                               const char *if_none_match)
+{
+    // Budowanie URL do firmware
+    char *firmware_url = source->url;
+    
+    // Sprawdź czy mamy token - jeśli tak, użyj go (nigdy dla mirrora)
+    bool use_token = !mirror && have_token();
+    
+    if (mirror) {
+        if (!rk_ota_sign_available()) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        strncpy(firmware_url, config->mirror_url, sizeof(source->url) - 1);
+        firmware_url[sizeof(source->url) - 1] = '\0';
+        
+        // Podpis najpierw - bez niego obraz z mirrora nie byłby niczym chroniony
+        esp_err_t err = rk_ota_sign_fetch(firmware_url);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Mirror bez podpisu obrazu: %s", esp_err_to_name(err));
+            return err;
+        }
+        ESP_LOGI(TAG, "Używam lokalnego mirrora (obraz podpisany)");
+    } else {
+        build_repo_url(config, config->firmware_file, use_token, firmware_url, sizeof(source->url));
+        ESP_LOGI(TAG, use_token ? "Używam tokenu GitHub dla prywatnego repo" :
+                                  "Używam publicznego dostępu (bez tokenu)");
+    }
+    
+    ESP_LOGI(TAG, "URL firmware: %s", firmware_url);
     
     // Sprawdź dostępną przestrzeń OTA
     const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
     if (update_partition == NULL) {
         ESP_LOGE(TAG, "Brak dostępnej partycji OTA");
-        esp_http_client_cleanup(client);
         return ESP_ERR_NOT_FOUND;
     }
     
     ESP_LOGI(TAG, "Partycja OTA: %s, rozmiar: %lu bytes", 
              update_partition->label, update_partition->size);
     
-    // Najpierw sprawdź czy plik istnieje
-    esp_err_t err = esp_http_client_open(client, 0);
+    // Najpierw sprawdź czy plik istnieje (i ustal końcowy adres po przekierowaniach)
+    int status_code = 0;
+    int content_length = 0;
+    bool redirected = false;
+    bool use_bundle = rk_ota_trust_starts_with_bundle();
+    bool accept_ranges = false;
+    esp_http_client_handle_t client = NULL;
+    esp_err_t err = probe_firmware(firmware_url, sizeof(source->url), use_token,
+                                   &status_code, &content_length, &redirected, &use_bundle,
+                                   &accept_ranges, if_none_match, source->etag,
+                                   sizeof(source->etag), &client);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Nie można otworzyć połączenia HTTP: %s", esp_err_to_name(err));
-        esp_http_client_cleanup(client);
         return err;
     }
     
-    int content_length = esp_http_client_fetch_headers(client);
-    int status_code = esp_http_client_get_status_code(client);
-    
     ESP_LOGI(TAG, "Status HTTP: %d, Content-Length: %d", status_code, content_length);
     
-    esp_http_client_close(client);
-    esp_http_client_cleanup(client);
-    
-    if (status_code == 404) {
+    if (status_code == 304) {
+        ESP_LOGI(TAG, "Obraz bez zmian (ETag %s)", if_none_match);
+        rk_ota_stats.firmware_not_modified++;
+        return ESP_ERR_INVALID_VERSION;
+    } else if (status_code == 404) {
         ESP_LOGE(TAG, "Plik firmware.bin nie został znaleziony (404)");
         ESP_LOGE(TAG, "Sprawdź czy plik istnieje w repo: %s", firmware_url);
         return ESP_ERR_NOT_FOUND;
@@ -303,20 +1047,198 @@ esp_err_t rk_ota_check_update(const rk_ota_config_t *config)
         return ESP_FAIL;
     }
     
-    if (content_length <= 0) {
+    if (content_length <= 0 || (uint32_t)content_length > update_partition->size) {
         ESP_LOGE(TAG, "Nieprawidłowy rozmiar pliku: %d", content_length);
+        esp_http_client_close(client);
+        rk_ota_http_cleanup(client);
         return ESP_ERR_INVALID_SIZE;
     }
     
     ESP_LOGI(TAG, "Plik firmware znaleziony, rozmiar: %d bajtów", content_length);
     
-    // Teraz wykonaj właściwe OTA
-    esp_err_t ret = esp_https_ota(&ota_config);
+    source->use_token = use_token;
+    source->signed_image = mirror;
+    source->origin = mirror ? RK_OTA_SOURCE_MIRROR : RK_OTA_SOURCE_GITHUB;
+    source->redirected = redirected;
+    source->use_bundle = use_bundle;
+    source->accept_ranges = accept_ranges;
+    source->content_length = content_length;
+    source->partition = update_partition;
+    source->client = client;
+    return ESP_OK;
+}
+
+// Test łącza: ta sama ścieżka sieciowa co OTA, ale obraz tylko liczony (SHA-256)
+// lub zapisywany do nieaktywnej partycji - bez esp_ota_set_boot_partition i restartu.
+static esp_err_t run_benchmark(const rk_ota_config_t *config, bool with_flash, bool mirror)
+{
+    static rk_ota_bench_result_t result;
+    memset(&result, 0, sizeof(result));
+    
+    // Zapis zniszczyłby obraz czekający na przełączenie
+    if (with_flash && s_staged_partition != NULL) {
+        ESP_LOGW(TAG, "Obraz czeka na przełączenie - test bez zapisu do flash");
+        with_flash = false;
+    }
+    result.with_flash = with_flash;
+    result.buffer_psram = rk_mem_is_psram(s_ota_buffer);
+    rk_mem_measure();   // Przepustowość regionów do raportu pamięci obok wyniku testu
+    
+    ESP_LOGI(TAG, "Test łącza OTA%s...", with_flash ? " z zapisem do flash" : "");
+    int64_t start_us = esp_timer_get_time();
+    
+    ota_source_t source;
+    esp_err_t err = mirror && config->mirror_url[0] == '\0' ? ESP_ERR_NOT_FOUND :
+                    open_firmware(config, &source, mirror, NULL);
+    result.open_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    result.dns_ms = rk_ota_stats.dns_resolve_last_ms;
+    
+    if (err == ESP_OK) {
+        result.redirected = source.redirected;
+        result.plain_http = strncmp(source.url, "http://", 7) == 0;
+        if (!result.plain_http) {
+            result.tls_ms = source.use_bundle ? rk_ota_stats.tls_bundle.handshake_last_ms :
+                            rk_ota_stats.tls_pinned.handshake_last_ms;
+        }
+        s_target_written = with_flash;
+        err = rk_ota_bench_download(source.client, source.partition, source.content_length,
+                                    with_flash, source.signed_image, s_ota_buffer, RK_OTA_BUFFER_SIZE, &result);
+        esp_http_client_close(source.client);
+        rk_ota_http_cleanup(source.client);
+    }
+    result.result = err;
+    
+    portENTER_CRITICAL(&s_bench_lock);
+    s_bench = result;
+    portEXIT_CRITICAL(&s_bench_lock);
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Test łącza nie powiódł się: %s", esp_err_to_name(err));
+        return err;
+    }
+    
+    rk_ota_set_progress(RK_OTA_STATE_IDLE, result.bytes, source.content_length);
+    ESP_LOGI(TAG, "Test łącza (%s): %lu B, otwarcie %lu ms (DNS %lu, TLS %lu), pobranie %lu ms, "
+             "CPU %lu ms, SHA-256 %lu ms, podpis %lu ms, flash %lu ms, %lu B/s, skrót %s",
+             result.plain_http ? "http" : "https",
+             result.bytes, result.open_ms, result.dns_ms, result.tls_ms, result.download_ms,
+             result.cpu_ms, result.hash_ms, result.signature_ms, result.flash_ms,
+             result.throughput_bps,
+             !result.hash_appended ? "brak" : result.hash_ok ? "zgodny" : "niezgodny");
+    return ESP_OK;
+}
+
+// Pobranie z otwartego źródła do partycji docelowej; zamyka połączenie
+static esp_err_t download_source(const ota_source_t *source, bool staged)
+{
+    // Tryb etapowy: pobieranie w tle z niższym priorytetem
+    UBaseType_t priority = uxTaskPriorityGet(NULL);
+    if (staged) {
+        vTaskPrioritySet(NULL, s_staging.download_priority);
+    }
+    
+    // Kilka połączeń Range tylko przy pełnej prędkości - tryb etapowy i tak ogranicza pasmo.
+    // Podpis wymaga skrótu w kolejności strumienia, więc mirror zawsze jednym połączeniem.
+    int connections = (!staged && !source->signed_image && source->accept_ranges) ?
+                      rk_ota_segments_plan(source->content_length) : 1;
+    
+    // Teraz wykonaj właściwe OTA - z otwartego połączenia do partycji
+    esp_err_t ret;
+    if (connections > 1) {
+        ret = download_image_segmented(source->client, source->url, source->use_bundle,
+                                       source->use_token && !source->redirected,
+                                       source->partition, source->content_length, connections);
+    } else {
+        rk_ota_stream_t stream = {
+            .name = "HTTP",
+            .read = http_stream_read,
+            .complete = http_stream_complete,
+            .ctx = source->client,
+        };
+        ret = download_image(&stream, source->partition, source->content_length, staged,
+                             source->signed_image);
+        if (source->signed_image && ret == ESP_OK) {
+            rk_ota_stats.mirror_downloads++;
+        }
+    }
+    esp_http_client_close(source->client);
+    rk_ota_http_cleanup(source->client);
+    
+    if (staged) {
+        vTaskPrioritySet(NULL, priority);
+    }
+    return ret;
+}
+
+// ETag do zapytania warunkowego - każde źródło nadaje własne
+static const char *known_etag(rk_ota_source_t origin)
+{
+    return s_force_download ? NULL : rk_ota_firmware_etag(origin);
+}
+
+esp_err_t rk_ota_check_update(const rk_ota_config_t *config)
+{
+    ESP_LOGI(TAG, "Rozpoczynanie OTA z GitHub...");
+    
+    // Lokalny mirror pierwszy - przy braku obrazu lub podpisu zwykła ścieżka HTTPS
+    // Zapytanie warunkowe - przy niezmienionym obrazie odpowiedź 304 bez treści
+    ota_source_t source;
+    bool mirror = config->mirror_url[0] != '\0';
+    esp_err_t err = open_firmware(config, &source, mirror,
+                                  known_etag(mirror ? RK_OTA_SOURCE_MIRROR : RK_OTA_SOURCE_GITHUB));
+    if (err != ESP_OK && mirror && err != ESP_ERR_INVALID_STATE && err != ESP_ERR_INVALID_VERSION) {
+        ESP_LOGW(TAG, "Mirror niedostępny (%s) - pobieranie z GitHub", esp_err_to_name(err));
+        rk_ota_stats.mirror_fallbacks++;
+        err = open_firmware(config, &source, false, known_etag(RK_OTA_SOURCE_GITHUB));
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    
+    ESP_LOGI(TAG, "Próba aktualizacji OTA...");
+    
+    // Czas od powiadomienia o nowej wersji do startu pobierania
+    if (rk_ota_notify_received_us != 0) {
+        rk_ota_stats.notify_to_download_ms =
+            (uint32_t)((esp_timer_get_time() - rk_ota_notify_received_us) / 1000);
+        rk_ota_notify_received_us = 0;
+    }
+    
+    bool staged = s_staging.mode == RK_OTA_APPLY_STAGED;
+    esp_err_t ret = download_source(&source, staged);
+    
+    // Mirror z obrazem nie nowszym (stary lub powtórzony) - źródłem prawdy jest GitHub
+    if (ret == ESP_ERR_INVALID_VERSION && source.signed_image) {
+        ESP_LOGW(TAG, "Obraz z mirrora odrzucony - pobieranie z GitHub");
+        rk_ota_stats.mirror_fallbacks++;
+        err = open_firmware(config, &source, false, known_etag(RK_OTA_SOURCE_GITHUB));
+        if (err != ESP_OK) {
+            return err;
+        }
+        ret = download_source(&source, staged);
+    }
+    
+    const esp_partition_t *update_partition = source.partition;
+    
+    if (ret == ESP_OK && staged) {
+        s_staged_partition = update_partition;
+        memcpy(s_staged_etag, source.etag, sizeof(s_staged_etag));
+        s_staged_origin = source.origin;
+        portENTER_CRITICAL(&s_progress_lock);
+        s_progress.state = RK_OTA_STATE_STAGED;
+        s_progress.last_error = ESP_OK;
+        s_progress.seq++;
+        portEXIT_CRITICAL(&s_progress_lock);
+        ESP_LOGI(TAG, "Obraz zweryfikowany w %s - czeka na okno serwisowe lub polecenie",
+                 update_partition->label);
+        return ESP_OK;
+    }
     
     if (ret == ESP_OK) {
-        ESP_LOGI(TAG, "OTA zakończone pomyślnie! Restart za 3 sekundy...");
-        vTaskDelay(pdMS_TO_TICKS(3000));
-        esp_restart();
+        rk_ota_firmware_etag_stage(source.origin, source.etag, update_partition);
+        finish_progress(ESP_OK);
+        ESP_LOGI(TAG, "OTA zakończone pomyślnie! Restart...");
+        rk_shutdown_restart("ota");
     } else {
         ESP_LOGE(TAG, "OTA nie powiodło się: %s (0x%x)", esp_err_to_name(ret), ret);
         
@@ -349,6 +1271,54 @@ esp_err_t rk_ota_check_update(const rk_ota_config_t *config)
     return ret;
 }
 
+// Aktualizacja z pliku lub strumienia ramek - ta sama ścieżka zapisu i statystyki co HTTP
+static esp_err_t update_local(const rk_ota_local_source_t *local)
+{
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    if (partition == NULL) {
+        ESP_LOGE(TAG, "Brak dostępnej partycji OTA");
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    rk_ota_stream_t stream;
+    int content_length = 0;
+    esp_err_t ret = rk_ota_local_open(local, partition->size, &stream, &content_length);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Źródło lokalne niedostępne: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    ESP_LOGI(TAG, "Obraz lokalny (%s): %d bajtów -> %s", stream.name, content_length,
+             partition->label);
+    ret = download_image(&stream, partition, content_length, false, false);
+    rk_ota_local_close(&stream, ret == ESP_OK);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Aktualizacja lokalna nie powiodła się: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    
+    // ETag opisywał obraz z GitHub - zainstalowany obraz jest inny
+    rk_ota_stats.local_updates++;
+    rk_ota_firmware_etag_clear();
+    finish_progress(ESP_OK);
+    ESP_LOGI(TAG, "Aktualizacja lokalna zakończona - restart");
+    rk_shutdown_restart("ota_local");
+}
+
+esp_err_t rk_ota_update_local(const rk_ota_local_source_t *source)
+{
+    if (source == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    portENTER_CRITICAL(&s_config_lock);
+    s_local_source = *source;
+    portEXIT_CRITICAL(&s_config_lock);
+    
+    rk_ota_message_t msg = {.type = RK_OTA_MSG_LOCAL_UPDATE};
+    return rk_ota_send_message(&msg);
+}
+
 esp_err_t rk_ota_send_message(const rk_ota_message_t *msg)
 {
     if (ota_queue == NULL) {
@@ -364,6 +1334,115 @@ esp_err_t rk_ota_send_message(const rk_ota_message_t *msg)
     return ESP_OK;
 }
 
+esp_err_t rk_ota_set_config(const rk_ota_config_t *config)
+{
+    if (config == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    portENTER_CRITICAL(&s_config_lock);
+    s_config = *config;
+    s_has_config = true;
+    portEXIT_CRITICAL(&s_config_lock);
+    
+    return ESP_OK;
+}
+
+bool rk_ota_get_config(rk_ota_config_t *config)
+{
+    portENTER_CRITICAL(&s_config_lock);
+    bool has_config = s_has_config;
+    if (has_config && config != NULL) {
+        *config = s_config;
+    }
+    portEXIT_CRITICAL(&s_config_lock);
+    
+    return has_config;
+}
+
+EventGroupHandle_t rk_ota_get_wifi_event_group(void)
+{
+    return wifi_event_group;
+}
+
+void rk_ota_get_progress(rk_ota_progress_t *progress)
+{
+    if (progress == NULL) {
+        return;
+    }
+    
+    portENTER_CRITICAL(&s_progress_lock);
+    *progress = s_progress;
+    portEXIT_CRITICAL(&s_progress_lock);
+}
+
+void rk_ota_get_benchmark(rk_ota_bench_result_t *result)
+{
+    portENTER_CRITICAL(&s_bench_lock);
+    *result = s_bench;
+    portEXIT_CRITICAL(&s_bench_lock);
+}
+
+esp_err_t rk_ota_set_staging(const rk_ota_staging_t *staging)
+{
+    if (staging == NULL || staging->window_start_hour > 23 || staging->window_end_hour > 23 ||
+        staging->download_priority >= configMAX_PRIORITIES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    s_staging = *staging;
+    return ESP_OK;
+}
+
+bool rk_ota_is_update_staged(void)
+{
+    return s_staged_partition != NULL;
+}
+
+void rk_ota_prepare_sleep(void)
+{
+    // Kasowanie sektora nie może zostać przerwane uśpieniem w połowie
+    rk_ota_preerase_pause();
+}
+
+bool rk_ota_cancel(void)
+{
+    portENTER_CRITICAL(&s_progress_lock);
+    rk_ota_state_t state = s_progress.state;
+    portEXIT_CRITICAL(&s_progress_lock);
+    
+    // Po walidacji obrazu partycja startowa jest już zmieniana - za późno na anulowanie
+    if (state != RK_OTA_STATE_CHECKING && state != RK_OTA_STATE_DOWNLOADING) {
+        return false;
+    }
+    
+    s_cancel_requested = true;
+    return true;
+}
+
+const char *rk_ota_state_name(rk_ota_state_t state)
+{
+    switch (state) {
+        case RK_OTA_STATE_IDLE:        return "idle";
+        case RK_OTA_STATE_CHECKING:    return "checking";
+        case RK_OTA_STATE_DOWNLOADING: return "downloading";
+        case RK_OTA_STATE_VERIFYING:   return "verifying";
+        case RK_OTA_STATE_STAGED:      return "staged";
+        case RK_OTA_STATE_DONE:        return "done";
+        case RK_OTA_STATE_FAILED:      return "failed";
+        case RK_OTA_STATE_CANCELLED:   return "cancelled";
+        case RK_OTA_STATE_UP_TO_DATE:  return "up_to_date";
+        default:                       return "unknown";
+    }
+}
+
+void rk_ota_get_stats(rk_ota_stats_t *stats)
+{
+    if (stats != NULL) {
+        *stats = rk_ota_stats;
+    }
+}
+
 const char* rk_ota_get_version(void)
 {
     const esp_app_desc_t *app_desc = esp_app_get_description();
@@ -372,14 +1451,31 @@ const char* rk_ota_get_version(void)
 
 void rk_ota_stop_task(void)
 {
+    // Zadanie powiadomień pisze do ota_queue - kolejka nie może zniknąć pod nim
+    bool notify_stopped = rk_ota_stop_notify_channel() == ESP_OK;
+    
     if (task_running && ota_queue != NULL) {
+        // Pobieranie przerwane przy najbliższym odczycie zamiast do końca obrazu
+        rk_ota_cancel();
+        rk_join_prepare();
+        s_stop_waiter = xTaskGetCurrentTaskHandle();
         rk_ota_message_t msg = {.type = RK_OTA_MSG_STOP};
         rk_ota_send_message(&msg);
         
-        vTaskDelay(pdMS_TO_TICKS(500));
+        // Zablokowany odczyt HTTP może trwać dłużej - wtedy kolejka zostaje (brak use-after-free),
+        // a rk_ota_start_task użyje jej ponownie po zakończeniu zadania
+        bool stopped = rk_join_wait(RK_TASK_STOP_TIMEOUT_MS);
+        s_stop_waiter = NULL;
+        if (!stopped) {
+            ESP_LOGE(TAG, "Zadanie OTA nie potwierdziło zakończenia - kolejka pozostaje");
+            s_stop_pending = true;
+            return;
+        }
         
-        if (ota_queue != NULL) {
-            vQueueDelete(ota_queue);
+        if (!notify_stopped) {
+            ESP_LOGE(TAG, "Kanał powiadomień nadal działa - kolejka pozostaje");
+        } else if (ota_queue != NULL) {
+            rk_queue_delete(ota_queue);
             ota_queue = NULL;
         }
         
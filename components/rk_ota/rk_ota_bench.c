@@ -0,0 +1,141 @@
+#include "rk_ota.h"
+#include "rk_ota_priv.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "esp_app_format.h"
+#include "mbedtls/sha256.h"
+#include <string.h>
+
+// Test łącza: pełne pobranie obrazu z liczeniem SHA-256, bez zmiany partycji startowej.
+// Opcjonalnie z mierzonym zapisem do nieaktywnej partycji (kasowanie sektorami + zapis).
+
+static const char *TAG = "RK_OTA_BENCH";
+
+#define IMAGE_HASH_LEN          32
+#define IMAGE_HASH_APPENDED_POS 23      // esp_image_header_t.hash_appended
+
+esp_err_t rk_ota_bench_download(esp_http_client_handle_t client, const esp_partition_t *partition,
+                                int content_length, bool with_flash, bool signed_image,
+                                uint8_t *buffer, size_t buffer_len,
+                                rk_ota_bench_result_t *result)
+{
+    // Ostatnie 32 bajty obrazu to dołączony SHA-256 - liczony jest skrót wszystkiego przed nimi
+    uint8_t appended[IMAGE_HASH_LEN];
+    uint32_t hashed_len = content_length > IMAGE_HASH_LEN ? content_length - IMAGE_HASH_LEN : 0;
+    
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    
+    if (signed_image) {
+        rk_ota_sign_begin();
+    }
+    
+    // Czas CPU tego zadania (licznik run-time w µs) - odczyt z gniazda, TLS i skróty
+#if configGENERATE_RUN_TIME_STATS
+    uint32_t cpu_start = ulTaskGetRunTimeCounter(xTaskGetCurrentTaskHandle());
+#endif
+    int64_t start_us = esp_timer_get_time();
+    int64_t flash_us = 0;
+    int64_t hash_us = 0;
+    uint32_t received = 0;
+    uint32_t erased_end = 0;
+    esp_err_t err = ESP_OK;
+    
+    rk_ota_set_progress(RK_OTA_STATE_DOWNLOADING, 0, content_length);
+    
+    while (received < (uint32_t)content_length) {
+        if (rk_ota_cancel_requested()) {
+            err = ESP_ERR_INVALID_STATE;
+            break;
+        }
+        
+        int len = esp_http_client_read(client, (char *)buffer, buffer_len);
+        if (len < 0) {
+            err = ESP_FAIL;
+            break;
+        }
+        if (len == 0) {
+            err = esp_http_client_is_complete_data_received(client) ? ESP_OK : ESP_ERR_TIMEOUT;
+            break;
+        }
+        if (received + len > (uint32_t)content_length) {
+            err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        
+        if (received == 0) {
+            result->hash_appended = len > IMAGE_HASH_APPENDED_POS &&
+                                    buffer[0] == ESP_IMAGE_HEADER_MAGIC &&
+                                    buffer[IMAGE_HASH_APPENDED_POS] == 1;
+        }
+        
+        int64_t t_us = esp_timer_get_time();
+        if (received < hashed_len) {
+            uint32_t part = hashed_len - received < (uint32_t)len ? hashed_len - received : (uint32_t)len;
+            mbedtls_sha256_update(&sha, buffer, part);
+        }
+        if (received + len > hashed_len) {
+            uint32_t from = received > hashed_len ? received : hashed_len;
+            memcpy(appended + (from - hashed_len), buffer + (from - received), received + len - from);
+        }
+        if (signed_image) {
+            rk_ota_sign_update(buffer, len);
+        }
+        hash_us += esp_timer_get_time() - t_us;
+        
+        if (with_flash) {
+            t_us = esp_timer_get_time();
+            while (err == ESP_OK && erased_end < received + len) {
+                err = esp_partition_erase_range(partition, erased_end, SPI_FLASH_SEC_SIZE);
+                erased_end += SPI_FLASH_SEC_SIZE;
+            }
+            if (err == ESP_OK) {
+                err = esp_partition_write(partition, received, buffer, len);
+            }
+            flash_us += esp_timer_get_time() - t_us;
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Zapis testowy nie powiódł się: %s", esp_err_to_name(err));
+                break;
+            }
+        }
+        
+        received += len;
+        rk_ota_set_progress(RK_OTA_STATE_DOWNLOADING, received, content_length);
+    }
+    
+    uint8_t digest[IMAGE_HASH_LEN];
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+#if configGENERATE_RUN_TIME_STATS
+    result->cpu_ms = (ulTaskGetRunTimeCounter(xTaskGetCurrentTaskHandle()) - cpu_start) / 1000;
+#endif
+    result->bytes = received;
+    result->download_ms = (uint32_t)(elapsed_us / 1000);
+    result->flash_ms = (uint32_t)(flash_us / 1000);
+    result->hash_ms = (uint32_t)(hash_us / 1000);
+    result->throughput_bps = elapsed_us > 0 ? (uint32_t)((int64_t)received * 1000000 / elapsed_us) : 0;
+    memcpy(result->sha256, digest, sizeof(digest));
+    
+    if (err == ESP_OK && received != (uint32_t)content_length) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    if (signed_image) {
+        result->signed_image = true;
+        if (err == ESP_OK) {
+            err = rk_ota_sign_verify(&result->signature_ms);
+        } else {
+            rk_ota_sign_abort();
+        }
+    }
+    if (err == ESP_OK && result->hash_appended) {
+        result->hash_ok = memcmp(digest, appended, sizeof(digest)) == 0;
+        if (!result->hash_ok) {
+            err = ESP_ERR_INVALID_CRC;
+        }
+    }
+    return err;
+}
@@ -0,0 +1,273 @@
+#include "rk_ota.h"
+#include "rk_ota_priv.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "esp_image_format.h"
+#include "esp_app_format.h"
+#include "esp_flash_encrypt.h"
+#include "esp_ota_ops.h"
+#include <string.h>
+
+// Zapis obrazu z pominięciem niezmienionych sektorów.
+// Partycja docelowa zwykle zawiera poprzednią wersję - większość sektorów 4 KB jest
+// identyczna. Każdy sektor nowego obrazu porównywany jest z zawartością flash (mmap):
+//   - identyczny                    -> pominięty (bez kasowania i zapisu)
+//   - tylko zerowanie bitów (1->0)  -> zapis bez kasowania (old & new == new)
+//   - pozostałe                     -> kasowanie i zapis
+// Obraz sprawdza esp_image_verify (SHA-256 i ewentualny podpis), tak jak esp_ota_end.
+
+static const char *TAG = "RK_OTA_DIFF";
+
+#define SECTOR_SIZE         SPI_FLASH_SEC_SIZE
+#define COMPARE_CHUNK       256         // Porównanie przez odczyt, gdy mmap niedostępny
+
+// Typowe czasy dla flash NOR, gdy nic nie zostało jeszcze zmierzone
+#define NOMINAL_ERASE_US    45000
+#define NOMINAL_WRITE_US    12000
+
+typedef enum {
+    SECTOR_SAME,
+    SECTOR_PROGRAM,     // Zapis bez kasowania
+    SECTOR_REWRITE,     // Kasowanie i zapis
+} sector_action_t;
+
+static struct {
+    const esp_partition_t *partition;
+    const uint8_t *mapped;              // Stara zawartość partycji (NULL - odczyt przez API)
+    esp_partition_mmap_handle_t mmap_handle;
+    uint32_t image_size;
+    uint32_t offset;                    // Początek sektora w buforze
+    size_t fill;                        // Bajty w buforze sektora
+    int64_t erase_us;
+    int64_t write_us;
+    uint32_t erases;
+    uint32_t writes;
+    bool active;
+} s_diff;
+
+// Bufor sektora (stały, w .bss) - dane z sieci składane do pełnych 4 KB
+static uint8_t s_sector[SECTOR_SIZE];
+
+esp_err_t rk_ota_check_target(const esp_partition_t *partition)
+{
+    // Te same warunki co w esp_ota_begin - zapis z pominięciem esp_ota_* ich nie sprawdza
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    if (partition == running) {
+        ESP_LOGE(TAG, "Partycja docelowa jest partycją uruchomioną");
+        return ESP_ERR_OTA_PARTITION_CONFLICT;
+    }
+
+#ifdef CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE
+    // Niepotwierdzony obraz: nadpisanie drugiej partycji odebrałoby bootloaderowi cel wycofania
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(running, &state) == ESP_OK &&
+        state == ESP_OTA_IMG_PENDING_VERIFY) {
+        ESP_LOGE(TAG, "Uruchomiony obraz niepotwierdzony (PENDING_VERIFY) - zapis odrzucony");
+        return ESP_ERR_OTA_ROLLBACK_INVALID_STATE;
+    }
+#endif
+    
+    return ESP_OK;
+}
+
+esp_err_t rk_ota_verify_image(const esp_partition_t *partition)
+{
+    esp_partition_pos_t part_pos = {
+        .offset = partition->address,
+        .size = partition->size,
+    };
+    esp_image_metadata_t metadata;
+    if (esp_image_verify(ESP_IMAGE_VERIFY, &part_pos, &metadata) != ESP_OK) {
+        ESP_LOGE(TAG, "Weryfikacja obrazu nie powiodła się");
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    return ESP_OK;
+}
+
+bool rk_ota_diff_supported(const esp_partition_t *partition)
+{
+    // Zapis szyfrowany nie pozwala porównać danych ani programować bez kasowania
+    return RK_OTA_DIFF_WRITE && !partition->encrypted && !esp_flash_encryption_enabled();
+}
+
+static sector_action_t compare_bytes(const uint8_t *old, const uint8_t *new_data, size_t len,
+                                     sector_action_t action)
+{
+    for (size_t i = 0; i < len && action != SECTOR_REWRITE; i++) {
+        if (old[i] != new_data[i]) {
+            action = (old[i] & new_data[i]) == new_data[i] ? SECTOR_PROGRAM : SECTOR_REWRITE;
+        }
+    }
+    return action;
+}
+
+static sector_action_t classify_sector(void)
+{
+    if (s_diff.mapped != NULL) {
+        return compare_bytes(s_diff.mapped + s_diff.offset, s_sector, s_diff.fill, SECTOR_SAME);
+    }
+    
+    uint8_t old[COMPARE_CHUNK];
+    sector_action_t action = SECTOR_SAME;
+    for (size_t pos = 0; pos < s_diff.fill && action != SECTOR_REWRITE; pos += COMPARE_CHUNK) {
+        size_t len = s_diff.fill - pos < COMPARE_CHUNK ? s_diff.fill - pos : COMPARE_CHUNK;
+        if (esp_partition_read(s_diff.partition, s_diff.offset + pos, old, len) != ESP_OK) {
+            return SECTOR_REWRITE;
+        }
+        action = compare_bytes(old, s_sector + pos, len, action);
+    }
+    return action;
+}
+
+static esp_err_t flush_sector(void)
+{
+    if (s_diff.fill == 0) {
+        return ESP_OK;
+    }
+    
+    sector_action_t action = classify_sector();
+    esp_err_t err = ESP_OK;
+    
+    if (action == SECTOR_REWRITE) {
+        int64_t start_us = esp_timer_get_time();
+        err = esp_partition_erase_range(s_diff.partition, s_diff.offset, SECTOR_SIZE);
+        s_diff.erase_us += esp_timer_get_time() - start_us;
+        s_diff.erases++;
+        rk_ota_stats.diff_sectors_written++;
+    } else if (action == SECTOR_PROGRAM) {
+        rk_ota_stats.diff_sectors_programmed++;
+    } else {
+        rk_ota_stats.diff_sectors_skipped++;
+    }
+    
+    if (err == ESP_OK && action != SECTOR_SAME) {
+        int64_t start_us = esp_timer_get_time();
+        err = esp_partition_write(s_diff.partition, s_diff.offset, s_sector, s_diff.fill);
+        s_diff.write_us += esp_timer_get_time() - start_us;
+        s_diff.writes++;
+    }
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Zapis sektora 0x%lx nie powiódł się: %s",
+                 (unsigned long)s_diff.offset, esp_err_to_name(err));
+        return err;
+    }
+    
+    s_diff.offset += s_diff.fill;
+    s_diff.fill = 0;
+    return ESP_OK;
+}
+
+esp_err_t rk_ota_diff_begin(const esp_partition_t *partition, uint32_t image_size)
+{
+    if (image_size == 0 || image_size > partition->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    esp_err_t err = rk_ota_check_target(partition);
+    if (err != ESP_OK) {
+        return err;
+    }
+    
+    memset(&s_diff, 0, sizeof(s_diff));
+    s_diff.partition = partition;
+    s_diff.image_size = image_size;
+    
+    // Mapowanie obszaru obrazu (strony MMU po 64 KB); bez wolnych stron - odczyt przez API
+    uint32_t map_size = (image_size + SPI_FLASH_MMU_PAGE_SIZE - 1) & ~(SPI_FLASH_MMU_PAGE_SIZE - 1);
+    if (map_size > partition->size) {
+        map_size = partition->size;
+    }
+    const void *mapped = NULL;
+    if (esp_partition_mmap(partition, 0, map_size, ESP_PARTITION_MMAP_DATA,
+                           &mapped, &s_diff.mmap_handle) == ESP_OK) {
+        s_diff.mapped = mapped;
+    } else {
+        ESP_LOGW(TAG, "mmap niedostępny - porównanie przez odczyt partycji");
+    }
+    
+    rk_ota_stats.diff_sectors_skipped = 0;
+    rk_ota_stats.diff_sectors_programmed = 0;
+    rk_ota_stats.diff_sectors_written = 0;
+    rk_ota_stats.diff_saved_ms = 0;
+    s_diff.active = true;
+    return ESP_OK;
+}
+
+esp_err_t rk_ota_diff_write(const uint8_t *data, size_t len)
+{
+    if (!s_diff.active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    // Ta sama kontrola co w esp_ota_write - pierwszy bajt to nagłówek obrazu
+    if (s_diff.offset == 0 && s_diff.fill == 0 && len > 0 && data[0] != ESP_IMAGE_HEADER_MAGIC) {
+        ESP_LOGE(TAG, "Nieprawidłowy nagłówek obrazu: 0x%02x", data[0]);
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    
+    if (s_diff.offset + s_diff.fill + len > s_diff.image_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    while (len > 0) {
+        size_t copy = SECTOR_SIZE - s_diff.fill;
+        if (copy > len) {
+            copy = len;
+        }
+        memcpy(s_sector + s_diff.fill, data, copy);
+        s_diff.fill += copy;
+        data += copy;
+        len -= copy;
+        
+        if (s_diff.fill == SECTOR_SIZE) {
+            esp_err_t err = flush_sector();
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+static void diff_release(void)
+{
+    if (s_diff.mapped != NULL) {
+        esp_partition_munmap(s_diff.mmap_handle);
+        s_diff.mapped = NULL;
+    }
+    s_diff.active = false;
+}
+
+void rk_ota_diff_abort(void)
+{
+    diff_release();
+}
+
+esp_err_t rk_ota_diff_end(void)
+{
+    if (!s_diff.active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    esp_err_t err = flush_sector();
+    diff_release();
+    if (err != ESP_OK) {
+        return err;
+    }
+    
+    // Oszczędność wg średnich zmierzonych w tym pobraniu (lub wartości typowych)
+    int64_t erase_avg_us = s_diff.erases > 0 ? s_diff.erase_us / s_diff.erases : NOMINAL_ERASE_US;
+    int64_t write_avg_us = s_diff.writes > 0 ? s_diff.write_us / s_diff.writes : NOMINAL_WRITE_US;
+    int64_t saved_us = rk_ota_stats.diff_sectors_skipped * (erase_avg_us + write_avg_us) +
+                       rk_ota_stats.diff_sectors_programmed * erase_avg_us;
+    rk_ota_stats.diff_saved_ms = (uint32_t)(saved_us / 1000);
+    
+    ESP_LOGI(TAG, "Sektory: pominięte %lu, bez kasowania %lu, kasowane %lu - oszczędność ~%lu ms",
+             rk_ota_stats.diff_sectors_skipped, rk_ota_stats.diff_sectors_programmed,
+             rk_ota_stats.diff_sectors_written, rk_ota_stats.diff_saved_ms);
+    
+    // Weryfikacja złożonego obrazu jak w esp_ota_end
+    return rk_ota_verify_image(s_diff.partition);
+}
@@ -0,0 +1,463 @@
+#include "rk_ota.h"
+#include "rk_ota_priv.h"
+#include "rk_common.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include <string.h>
+
+static const char *TAG = "RK_OTA_DNS";
+
+#define DNS_PORT            53
+#define DNS_QUERY_TIMEOUT_MS 1500
+#define DNS_QUERY_RETRIES   2
+#define DNS_PACKET_SIZE     512
+#define DNS_TASK_STACK      3072
+
+typedef struct {
+    char host[64];
+    uint32_t addr;          // Adres IPv4 (kolejność sieciowa)
+    int64_t expires_us;     // Koniec ważności wg TTL
+    bool valid;
+} dns_entry_t;
+
+// Hosty rozwiązywane z wyprzedzeniem po połączeniu WiFi
+static const char *s_prefetch_hosts[] = {
+    "github.com",
+    "raw.githubusercontent.com",
+    "objects.githubusercontent.com",
+};
+
+// Bufory statyczne (RK_STATIC_ALLOC)
+RK_TASK_BUFFER(dns_task, DNS_TASK_STACK);
+RK_MUTEX_BUFFER(dns_cache_mutex);
+
+// Zmienne globalne
+static dns_entry_t s_cache[RK_OTA_DNS_CACHE_SIZE];
+static SemaphoreHandle_t s_cache_mutex = NULL;
+static TaskHandle_t dns_task_handle = NULL;
+static uint64_t s_resolve_total_ms = 0;
+static uint32_t s_resolve_count = 0;
+
+static int dns_build_query(uint8_t *buf, size_t len, const char *host, uint16_t id)
+{
+    size_t host_len = strlen(host);
+    if (host_len == 0 || host_len + 18 > len) {
+        return -1;
+    }
+    
+    memset(buf, 0, 12);
+    buf[0] = id >> 8;
+    buf[1] = id & 0xFF;
+    buf[2] = 0x01;  // RD - zapytanie rekurencyjne
+    buf[5] = 1;     // QDCOUNT = 1
+    
+    // QNAME: etykiety poprzedzone długością
+    int pos = 12;
+    const char *label = host;
+    while (*label) {
+        const char *dot = strchr(label, '.');
+        size_t label_len = dot ? (size_t)(dot - label) : strlen(label);
+        if (label_len == 0 || label_len > 63) {
+            return -1;
+        }
+        buf[pos++] = (uint8_t)label_len;
+        memcpy(&buf[pos], label, label_len);
+        pos += label_len;
+        label += label_len + (dot ? 1 : 0);
+    }
+    buf[pos++] = 0;
+    
+    buf[pos++] = 0; buf[pos++] = 1;  // QTYPE = A
+    buf[pos++] = 0; buf[pos++] = 1;  // QCLASS = IN
+    return pos;
+}
+
+static int dns_skip_name(const uint8_t *buf, int len, int pos)
+{
+    while (pos < len) {
+        uint8_t label_len = buf[pos];
+        if (label_len == 0) {
+            return pos + 1;
+        }
+        if ((label_len & 0xC0) == 0xC0) {
+            return pos + 2;  // Wskaźnik kompresji kończy nazwę
+        }
+        pos += label_len + 1;
+    }
+    return -1;
+}
+
+// Pierwszy rekord A z odpowiedzi. TTL to minimum po całym łańcuchu (CNAME + A).
+static esp_err_t dns_parse_answer(const uint8_t *buf, int len, uint16_t id,
+                                  uint32_t *addr, uint32_t *ttl_s)
+{
+    if (len < 12 || ((buf[0] << 8) | buf[1]) != id || !(buf[2] & 0x80)) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if ((buf[3] & 0x0F) != 0) {
+        return ESP_ERR_NOT_FOUND;  // RCODE != NOERROR
+    }
+    
+    int qdcount = (buf[4] << 8) | buf[5];
+    int ancount = (buf[6] << 8) | buf[7];
+    int pos = 12;
+    
+    for (int i = 0; i < qdcount && pos > 0; i++) {
+        pos = dns_skip_name(buf, len, pos);
+        if (pos > 0) {
+            pos += 4;
+        }
+    }
+    
+    uint32_t min_ttl = UINT32_MAX;
+    for (int i = 0; i < ancount && pos > 0; i++) {
+        pos = dns_skip_name(buf, len, pos);
+        if (pos < 0 || pos + 10 > len) {
+            break;
+        }
+        
+        uint16_t type = (buf[pos] << 8) | buf[pos + 1];
+        uint16_t rclass = (buf[pos + 2] << 8) | buf[pos + 3];
+        uint32_t ttl = ((uint32_t)buf[pos + 4] << 24) | ((uint32_t)buf[pos + 5] << 16) |
+                       ((uint32_t)buf[pos + 6] << 8) | buf[pos + 7];
+        uint16_t rdlength = (buf[pos + 8] << 8) | buf[pos + 9];
+        pos += 10;
+        if (pos + rdlength > len) {
+            break;
+        }
+        
+        if (ttl < min_ttl) {
+            min_ttl = ttl;
+        }
+        if (type == 1 && rclass == 1 && rdlength == 4) {
+            memcpy(addr, &buf[pos], 4);
+            *ttl_s = min_ttl;
+            return ESP_OK;
+        }
+        pos += rdlength;
+    }
+    
+    return ESP_ERR_NOT_FOUND;
+}
+
+// Zapytanie A bezpośrednio do serwera DNS interfejsu STA - daje dostęp do TTL
+static esp_err_t dns_query(const char *host, uint32_t *addr, uint32_t *ttl_s)
+{
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    esp_netif_dns_info_t dns_info;
+    if (netif == NULL || esp_netif_get_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns_info) != ESP_OK ||
+        dns_info.ip.u_addr.ip4.addr == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    uint8_t buf[DNS_PACKET_SIZE];
+    uint16_t id = (uint16_t)esp_random();
+    int query_len = dns_build_query(buf, sizeof(buf), host, id);
+    if (query_len < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        return ESP_FAIL;
+    }
+    
+    struct timeval timeout = {
+        .tv_sec = DNS_QUERY_TIMEOUT_MS / 1000,
+        .tv_usec = (DNS_QUERY_TIMEOUT_MS % 1000) * 1000,
+    };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    
+    struct sockaddr_in server = {
+        .sin_family = AF_INET,
+        .sin_port = htons(DNS_PORT),
+        .sin_addr.s_addr = dns_info.ip.u_addr.ip4.addr,
+    };
+    
+    // Wolny serwer gubi zapytania - krótki timeout i ponowienie zamiast jednego długiego
+    esp_err_t err = ESP_ERR_TIMEOUT;
+    uint8_t query[DNS_PACKET_SIZE];
+    memcpy(query, buf, query_len);
+    for (int attempt = 0; attempt <= DNS_QUERY_RETRIES && err == ESP_ERR_TIMEOUT; attempt++) {
+        if (sendto(sock, query, query_len, 0, (struct sockaddr *)&server, sizeof(server)) < 0) {
+            err = ESP_FAIL;
+            break;
+        }
+        
+        // Odpowiedź spoza odpytywanego serwera albo na inne zapytanie (spóźniona lub
+        // podrobiona) jest pomijana - czekanie trwa do końca timeoutu tej próby
+        int64_t deadline_us = esp_timer_get_time() + DNS_QUERY_TIMEOUT_MS * 1000LL;
+        while (esp_timer_get_time() < deadline_us) {
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            int len = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+            if (len <= 0) {
+                break;
+            }
+            if (from_len < sizeof(from) || from.sin_addr.s_addr != server.sin_addr.s_addr ||
+                from.sin_port != server.sin_port || len < 2 || ((buf[0] << 8) | buf[1]) != id) {
+                rk_ota_stats.dns_rejected++;
+                continue;
+            }
+            err = dns_parse_answer(buf, len, id, addr, ttl_s);
+            break;
+        }
+    }
+    
+    close(sock);
+    return err;
+}
+
+// Rozwiązanie nazwy z pomiarem czasu; przy braku odpowiedzi z DNS - resolver lwIP
+static esp_err_t dns_resolve(const char *host, uint32_t *addr, uint32_t *ttl_s)
+{
+    int64_t start_us = esp_timer_get_time();
+    
+    esp_err_t err = dns_query(host, addr, ttl_s);
+    if (err != ESP_OK) {
+        struct addrinfo hints = {
+            .ai_family = AF_INET,
+            .ai_socktype = SOCK_STREAM,
+        };
+        struct addrinfo *res = NULL;
+        if (getaddrinfo(host, NULL, &hints, &res) == 0 && res != NULL) {
+            *addr = ((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr;
+            *ttl_s = RK_OTA_DNS_TTL_MIN_S;  // lwIP nie udostępnia TTL
+            freeaddrinfo(res);
+            err = ESP_OK;
+        }
+    }
+    
+    uint32_t elapsed_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    s_resolve_total_ms += elapsed_ms;
+    s_resolve_count++;
+    rk_ota_stats.dns_resolve_last_ms = elapsed_ms;
+    rk_ota_stats.dns_resolve_avg_ms = (uint32_t)(s_resolve_total_ms / s_resolve_count);
+    if (elapsed_ms > rk_ota_stats.dns_resolve_max_ms) {
+        rk_ota_stats.dns_resolve_max_ms = elapsed_ms;
+    }
+    
+    if (err != ESP_OK) {
+        rk_ota_stats.dns_failures++;
+        ESP_LOGW(TAG, "Nie można rozwiązać %s: %s", host, esp_err_to_name(err));
+        return err;
+    }
+    
+    if (*ttl_s < RK_OTA_DNS_TTL_MIN_S) {
+        *ttl_s = RK_OTA_DNS_TTL_MIN_S;
+    } else if (*ttl_s > RK_OTA_DNS_TTL_MAX_S) {
+        *ttl_s = RK_OTA_DNS_TTL_MAX_S;
+    }
+    ESP_LOGD(TAG, "%s -> TTL %lu s, %lu ms", host, *ttl_s, elapsed_ms);
+    return ESP_OK;
+}
+
+static dns_entry_t *cache_find(const char *host)
+{
+    for (int i = 0; i < RK_OTA_DNS_CACHE_SIZE; i++) {
+        if (s_cache[i].valid && strcmp(s_cache[i].host, host) == 0) {
+            return &s_cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void cache_store(const char *host, uint32_t addr, uint32_t ttl_s)
+{
+    xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+    
+    dns_entry_t *entry = cache_find(host);
+    if (entry == NULL) {
+        // Wolny slot lub wpis, który najdawniej stracił ważność
+        entry = &s_cache[0];
+        for (int i = 0; i < RK_OTA_DNS_CACHE_SIZE; i++) {
+            if (!s_cache[i].valid) {
+                entry = &s_cache[i];
+                break;
+            }
+            if (s_cache[i].expires_us < entry->expires_us) {
+                entry = &s_cache[i];
+            }
+        }
+        strncpy(entry->host, host, sizeof(entry->host) - 1);
+        entry->host[sizeof(entry->host) - 1] = '\0';
+    }
+    entry->addr = addr;
+    entry->expires_us = esp_timer_get_time() + (int64_t)ttl_s * 1000000;
+    entry->valid = true;
+    
+    xSemaphoreGive(s_cache_mutex);
+}
+
+static void refresh_host(const char *host)
+{
+    uint32_t addr = 0;
+    uint32_t ttl_s = 0;
+    if (dns_resolve(host, &addr, &ttl_s) == ESP_OK) {
+        cache_store(host, addr, ttl_s);
+    }
+}
+
+static void dns_task(void *pvParameters)
+{
+    bool was_connected = false;
+    
+    while (1) {
+        uint32_t refresh_requested = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+        
+        EventGroupHandle_t wifi_event_group = rk_ota_get_wifi_event_group();
+        bool connected = wifi_event_group != NULL &&
+                         (xEventGroupGetBits(wifi_event_group) & RK_WIFI_CONNECTED_BIT);
+        
+        if (connected && !was_connected) {
+            // Wstępne rozwiązanie nazw zaraz po połączeniu WiFi
+            for (size_t i = 0; i < sizeof(s_prefetch_hosts) / sizeof(s_prefetch_hosts[0]); i++) {
+                refresh_host(s_prefetch_hosts[i]);
+            }
+        } else if (connected && refresh_requested) {
+            // Odświeżenie przeterminowanych wpisów w tle
+            int64_t now = esp_timer_get_time();
+            for (int i = 0; i < RK_OTA_DNS_CACHE_SIZE; i++) {
+                char host[64] = {0};
+                xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+                if (s_cache[i].valid && s_cache[i].expires_us <= now) {
+                    strncpy(host, s_cache[i].host, sizeof(host) - 1);
+                }
+                xSemaphoreGive(s_cache_mutex);
+                
+                if (host[0] != '\0') {
+                    refresh_host(host);
+                }
+            }
+        }
+        
+        was_connected = connected;
+    }
+}
+
+esp_err_t rk_ota_dns_init(void)
+{
+    if (s_cache_mutex != NULL) {
+        return ESP_OK;
+    }
+    
+    s_cache_mutex = rk_mutex_create(RK_MUTEX_STATIC(dns_cache_mutex));
+    if (s_cache_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    
+    BaseType_t ret = rk_task_create(dns_task,
+                                   "ota_dns_task",
+                                   DNS_TASK_STACK,
+                                   NULL,
+                                   2,
+                                   &dns_task_handle,
+                                   RK_TASK_STATIC(dns_task));
+    
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Nie można utworzyć zadania DNS");
+        rk_mutex_delete(s_cache_mutex);
+        s_cache_mutex = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    
+    return ESP_OK;
+}
+
+esp_err_t rk_ota_dns_lookup(const char *host, uint32_t *addr)
+{
+    if (s_cache_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    rk_ota_stats.dns_lookups++;
+    
+    xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+    dns_entry_t *entry = cache_find(host);
+    int64_t now = esp_timer_get_time();
+    // Odświeżanie w tle nie udaje się zbyt długo - adres mógł przestać działać
+    if (entry != NULL && entry->expires_us + RK_OTA_DNS_STALE_MAX_S * 1000000LL <= now) {
+        entry->valid = false;
+        entry = NULL;
+    }
+    bool found = entry != NULL;
+    bool stale = found && entry->expires_us <= now;
+    if (found) {
+        *addr = entry->addr;
+    }
+    xSemaphoreGive(s_cache_mutex);
+    
+    if (found) {
+        if (stale) {
+            // Przeterminowany wpis jest dalej używany, odświeżenie w tle
+            rk_ota_stats.dns_stale_hits++;
+            xTaskNotifyGive(dns_task_handle);
+        } else {
+            rk_ota_stats.dns_hits++;
+        }
+        return ESP_OK;
+    }
+    
+    rk_ota_stats.dns_misses++;
+    uint32_t ttl_s = 0;
+    esp_err_t err = dns_resolve(host, addr, &ttl_s);
+    if (err == ESP_OK) {
+        cache_store(host, *addr, ttl_s);
+    }
+    return err;
+}
+
+void rk_ota_dns_evict(const char *host)
+{
+    if (s_cache_mutex == NULL) {
+        return;
+    }
+    
+    xSemaphoreTake(s_cache_mutex, portMAX_DELAY);
+    dns_entry_t *entry = cache_find(host);
+    if (entry != NULL) {
+        entry->valid = false;
+        rk_ota_stats.dns_evictions++;
+    }
+    xSemaphoreGive(s_cache_mutex);
+    
+    if (entry != NULL) {
+        ESP_LOGW(TAG, "%s: brak połączenia pod adres z cache - wpis usunięty", host);
+    }
+}
+
+bool rk_ota_dns_rewrite_url(const char *url, char *connect_url, size_t url_len,
+                            char *host, size_t host_len,
+                            char *authority, size_t authority_len)
+{
+    // url: schemat://host[:port]/ścieżka
+    const char *host_start = strstr(url, "://");
+    host_start = host_start ? host_start + 3 : url;
+    const char *path = strchr(host_start, '/');
+    if (path == NULL) {
+        path = host_start + strlen(host_start);
+    }
+    const char *port = memchr(host_start, ':', path - host_start);
+    const char *host_end = port ? port : path;
+    
+    snprintf(authority, authority_len, "%.*s", (int)(path - host_start), host_start);
+    snprintf(host, host_len, "%.*s", (int)(host_end - host_start), host_start);
+    
+    // Adres IP w URL nie wymaga rozwiązywania
+    struct in_addr literal;
+    uint32_t addr = 0;
+    if (inet_aton(host, &literal) || rk_ota_dns_lookup(host, &addr) != ESP_OK) {
+        snprintf(connect_url, url_len, "%s", url);
+        return false;
+    }
+    
+    const uint8_t *ip = (const uint8_t *)&addr;
+    snprintf(connect_url, url_len, "%.*s%u.%u.%u.%u%s",
+             (int)(host_start - url), url, ip[0], ip[1], ip[2], ip[3], host_end);
+    return true;
+}
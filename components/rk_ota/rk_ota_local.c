@@ -0,0 +1,383 @@
+#include "rk_ota_priv.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/select.h>
+#if CONFIG_IDF_TARGET_LINUX
+#include <termios.h>
+#else
+#include "driver/uart.h"
+#endif
+
+static const char *TAG = "RK_OTA_LOCAL";
+
+// Ramka nadawcy:  A5 'R' 'K' | typ | numer (u16 LE) | długość (u16 LE) | dane | CRC-32 (u32 LE)
+// Odpowiedź:      A5 'R' 'K' | 'A' / 'N' / 'X' | numer (u16 LE)
+// CRC-32 (jak zlib) obejmuje typ, numer, długość i dane. Ramka startowa (numer 0) niesie
+// rozmiar obrazu (u32 LE), ramki danych są numerowane od 1. Potwierdzenie wychodzi przed
+// zapisem do flash, więc nadawca wysyła kolejną ramkę, gdy trwa zapis poprzedniej.
+#define FRAME_FIELDS    5       // Typ, numer, długość
+#define FRAME_START     'S'
+#define FRAME_DATA      'D'
+#define REPLY_ACK       'A'
+#define REPLY_NAK       'N'
+#define REPLY_ABORT     'X'
+
+_Static_assert(RK_OTA_SERIAL_FRAME_MAX <= RK_OTA_BUFFER_SIZE,
+               "Ramka musi mieścić się w buforze pobierania");
+
+static const uint8_t s_magic[3] = {0xA5, 'R', 'K'};
+
+// Jedno lokalne źródło naraz - otwiera je tylko zadanie OTA
+typedef struct {
+    rk_ota_local_type_t type;
+    FILE *file;
+    int fd;
+    int uart_port;
+    uint32_t size;
+    uint32_t received;
+    uint16_t next_seq;
+} local_ctx_t;
+
+static local_ctx_t s_local;
+
+static int file_read(void *arg, uint8_t *buf, int len)
+{
+    local_ctx_t *ctx = arg;
+    size_t n = fread(buf, 1, len, ctx->file);
+    if (n == 0 && ferror(ctx->file)) {
+        return -1;
+    }
+    ctx->received += n;
+    return (int)n;
+}
+
+static bool local_complete(void *arg)
+{
+    local_ctx_t *ctx = arg;
+    return ctx->received == ctx->size;
+}
+
+static int transport_read(local_ctx_t *ctx, uint8_t *buf, int len, uint32_t timeout_ms)
+{
+#if !CONFIG_IDF_TARGET_LINUX
+    if (ctx->type == RK_OTA_LOCAL_UART) {
+        return uart_read_bytes(ctx->uart_port, buf, len, pdMS_TO_TICKS(timeout_ms));
+    }
+#endif
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(ctx->fd, &fds);
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    int ready = select(ctx->fd + 1, &fds, NULL, NULL, &tv);
+    if (ready <= 0) {
+        return ready;
+    }
+    return (int)read(ctx->fd, buf, len);
+}
+
+static void transport_write(local_ctx_t *ctx, const uint8_t *buf, int len)
+{
+#if !CONFIG_IDF_TARGET_LINUX
+    if (ctx->type == RK_OTA_LOCAL_UART) {
+        uart_write_bytes(ctx->uart_port, buf, len);
+        return;
+    }
+#endif
+    if (write(ctx->fd, buf, len) != len) {
+        ESP_LOGW(TAG, "Niepełny zapis odpowiedzi");
+    }
+}
+
+// Odczyt dokładnie len bajtów w zadanym czasie
+static bool read_exact(local_ctx_t *ctx, uint8_t *buf, int len, uint32_t timeout_ms)
+{
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    int got = 0;
+    
+    while (got < len) {
+        int64_t left_ms = (deadline_us - esp_timer_get_time()) / 1000;
+        if (left_ms <= 0) {
+            return false;
+        }
+        int n = transport_read(ctx, buf + got, len - got, (uint32_t)left_ms);
+        if (n < 0) {
+            return false;
+        }
+        got += n;
+    }
+    return true;
+}
+
+static void reply(local_ctx_t *ctx, uint8_t type, uint16_t seq)
+{
+    uint8_t msg[6] = {s_magic[0], s_magic[1], s_magic[2], type, seq & 0xFF, seq >> 8};
+    transport_write(ctx, msg, sizeof(msg));
+}
+
+// Odbiór ramki: synchronizacja na znaczniku (echo konsoli i śmieci są pomijane), dane prosto do payload
+static esp_err_t frame_receive(local_ctx_t *ctx, uint8_t *type, uint16_t *seq,
+                               uint8_t *payload, int payload_max, int *len, uint32_t timeout_ms)
+{
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    int matched = 0;
+    
+    while (matched < (int)sizeof(s_magic)) {
+        int64_t left_ms = (deadline_us - esp_timer_get_time()) / 1000;
+        uint8_t byte;
+        if (left_ms <= 0) {
+            return ESP_ERR_TIMEOUT;
+        }
+        int n = transport_read(ctx, &byte, 1, (uint32_t)left_ms);
+        if (n < 0) {
+            return ESP_FAIL;
+        }
+        if (n == 1) {
+            matched = byte == s_magic[matched] ? matched + 1 : (byte == s_magic[0] ? 1 : 0);
+        }
+    }
+    
+    uint8_t fields[FRAME_FIELDS];
+    if (!read_exact(ctx, fields, sizeof(fields), RK_OTA_SERIAL_FRAME_TIMEOUT_MS)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    *type = fields[0];
+    *seq = fields[1] | (fields[2] << 8);
+    *len = fields[3] | (fields[4] << 8);
+    if (*len > payload_max) {
+        return ESP_ERR_INVALID_SIZE;    // Reszta ramki zostanie pominięta przy synchronizacji
+    }
+    
+    uint8_t crc_raw[4];
+    if (!read_exact(ctx, payload, *len, RK_OTA_SERIAL_FRAME_TIMEOUT_MS) ||
+        !read_exact(ctx, crc_raw, sizeof(crc_raw), RK_OTA_SERIAL_FRAME_TIMEOUT_MS)) {
+        return ESP_ERR_TIMEOUT;
+    }
+    
+    uint32_t crc = esp_rom_crc32_le(0, fields, sizeof(fields));
+    crc = esp_rom_crc32_le(crc, payload, *len);
+    uint32_t expected = crc_raw[0] | (crc_raw[1] << 8) | (crc_raw[2] << 16) | ((uint32_t)crc_raw[3] << 24);
+    if (crc != expected) {
+        rk_ota_stats.serial_crc_errors++;
+        return ESP_ERR_INVALID_CRC;
+    }
+    return ESP_OK;
+}
+
+static int serial_read(void *arg, uint8_t *buf, int len)
+{
+    local_ctx_t *ctx = arg;
+    uint8_t errors = 0;
+    
+    if (ctx->received >= ctx->size) {
+        return 0;
+    }
+    
+    while (errors < RK_OTA_SERIAL_RETRIES) {
+        uint8_t type = 0;
+        uint16_t seq = 0;
+        int frame_len = 0;
+        esp_err_t err = frame_receive(ctx, &type, &seq, buf, len, &frame_len,
+                                      RK_OTA_SERIAL_FRAME_TIMEOUT_MS);
+        if (err == ESP_FAIL) {
+            break;
+        }
+        
+        if (err == ESP_OK && seq == (uint16_t)(ctx->next_seq - 1)) {
+            // Powtórzona ramka - zgubione potwierdzenie, dane już zapisane
+            reply(ctx, REPLY_ACK, seq);
+            continue;
+        }
+        
+        if (err == ESP_OK && type == FRAME_DATA && seq == ctx->next_seq &&
+            frame_len > 0 && (uint32_t)frame_len <= ctx->size - ctx->received) {
+            reply(ctx, REPLY_ACK, seq);
+            ctx->next_seq++;
+            ctx->received += frame_len;
+            rk_ota_stats.serial_frames++;
+            return frame_len;
+        }
+        
+        errors++;
+        rk_ota_stats.serial_retransmits++;
+        reply(ctx, REPLY_NAK, ctx->next_seq);
+    }
+    
+    ESP_LOGE(TAG, "Strumień przerwany po %lu z %lu bajtów (ramka %u)",
+             ctx->received, ctx->size, ctx->next_seq);
+    return -1;
+}
+
+static esp_err_t serial_open(local_ctx_t *ctx, const rk_ota_local_source_t *source)
+{
+    if (source->type == RK_OTA_LOCAL_UART) {
+#if CONFIG_IDF_TARGET_LINUX
+        return ESP_ERR_NOT_SUPPORTED;   // Na Linuksie pty przez RK_OTA_LOCAL_DEVICE
+#else
+        uart_config_t uart_config = {
+            .baud_rate = source->baud_rate > 0 ? source->baud_rate : RK_OTA_SERIAL_BAUD,
+            .data_bits = UART_DATA_8_BITS,
+            .parity = UART_PARITY_DISABLE,
+            .stop_bits = UART_STOP_BITS_1,
+            .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+            .source_clk = UART_SCLK_DEFAULT,
+        };
+        // Bufor odbioru na dwie ramki - kolejna przychodzi w trakcie zapisu flash
+        esp_err_t err = uart_driver_install(source->uart_port, 2 * (RK_OTA_SERIAL_FRAME_MAX + 16),
+                                            0, 0, NULL, 0);
+        if (err == ESP_OK) {
+            err = uart_param_config(source->uart_port, &uart_config);
+        }
+        if (err == ESP_OK) {
+            err = uart_set_pin(source->uart_port, source->tx_pin, source->rx_pin,
+                               UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "UART%d: %s", source->uart_port, esp_err_to_name(err));
+            uart_driver_delete(source->uart_port);
+            return err;
+        }
+        ctx->uart_port = source->uart_port;
+        return ESP_OK;
+#endif
+    }
+    
+    ctx->fd = open(source->path, O_RDWR | O_NOCTTY);
+    if (ctx->fd < 0) {
+        ESP_LOGE(TAG, "Nie można otworzyć %s", source->path);
+        return ESP_ERR_NOT_FOUND;
+    }
+#if CONFIG_IDF_TARGET_LINUX
+    // Pseudoterminal w trybie surowym - bez echa i zamiany znaków końca linii
+    struct termios tio;
+    if (tcgetattr(ctx->fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(ctx->fd, TCSANOW, &tio);
+    }
+#endif
+    return ESP_OK;
+}
+
+static void serial_close(local_ctx_t *ctx)
+{
+#if !CONFIG_IDF_TARGET_LINUX
+    if (ctx->type == RK_OTA_LOCAL_UART) {
+        uart_driver_delete(ctx->uart_port);
+        return;
+    }
+#endif
+    close(ctx->fd);
+    ctx->fd = -1;
+}
+
+// Ramka startowa z rozmiarem obrazu - czeka, aż nadawca zacznie (linia produkcyjna)
+static esp_err_t serial_start(local_ctx_t *ctx, uint32_t max_size)
+{
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)RK_OTA_SERIAL_START_TIMEOUT_MS * 1000;
+    uint8_t payload[4];
+    
+    ESP_LOGI(TAG, "Oczekiwanie na nadawcę obrazu (%d s)", RK_OTA_SERIAL_START_TIMEOUT_MS / 1000);
+    while (1) {
+        int64_t left_ms = (deadline_us - esp_timer_get_time()) / 1000;
+        if (left_ms <= 0) {
+            return ESP_ERR_TIMEOUT;
+        }
+        
+        uint8_t type = 0;
+        uint16_t seq = 0;
+        int len = 0;
+        esp_err_t err = frame_receive(ctx, &type, &seq, payload, sizeof(payload), &len,
+                                      (uint32_t)left_ms);
+        if (err == ESP_FAIL || err == ESP_ERR_TIMEOUT) {
+            return err;
+        }
+        if (err != ESP_OK || type != FRAME_START || seq != 0 || len != sizeof(payload)) {
+            reply(ctx, REPLY_NAK, 0);
+            continue;
+        }
+        
+        ctx->size = payload[0] | (payload[1] << 8) | (payload[2] << 16) | ((uint32_t)payload[3] << 24);
+        if (ctx->size == 0 || ctx->size > max_size) {
+            ESP_LOGE(TAG, "Nieprawidłowy rozmiar obrazu: %lu (partycja %lu)", ctx->size, max_size);
+            reply(ctx, REPLY_ABORT, 0);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        
+        ctx->next_seq = 1;
+        reply(ctx, REPLY_ACK, 0);
+        return ESP_OK;
+    }
+}
+
+esp_err_t rk_ota_local_open(const rk_ota_local_source_t *source, uint32_t max_size,
+                            rk_ota_stream_t *stream, int *size)
+{
+    local_ctx_t *ctx = &s_local;
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->type = source->type;
+    ctx->fd = -1;
+    
+    stream->ctx = ctx;
+    stream->complete = local_complete;
+    
+    if (source->type == RK_OTA_LOCAL_FILE) {
+        ctx->file = fopen(source->path, "rb");
+        if (ctx->file == NULL) {
+            ESP_LOGE(TAG, "Brak pliku %s", source->path);
+            return ESP_ERR_NOT_FOUND;
+        }
+        fseek(ctx->file, 0, SEEK_END);
+        long file_size = ftell(ctx->file);
+        fseek(ctx->file, 0, SEEK_SET);
+        if (file_size <= 0 || (uint32_t)file_size > max_size) {
+            ESP_LOGE(TAG, "Nieprawidłowy rozmiar pliku: %ld (partycja %lu)", file_size, max_size);
+            fclose(ctx->file);
+            ctx->file = NULL;
+            return ESP_ERR_INVALID_SIZE;
+        }
+        ctx->size = (uint32_t)file_size;
+        stream->name = "plik";
+        stream->read = file_read;
+        *size = (int)ctx->size;
+        return ESP_OK;
+    }
+    
+    esp_err_t err = serial_open(ctx, source);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = serial_start(ctx, max_size);
+    if (err != ESP_OK) {
+        serial_close(ctx);
+        return err;
+    }
+    
+    stream->name = source->type == RK_OTA_LOCAL_UART ? "UART" : source->path;
+    stream->read = serial_read;
+    *size = (int)ctx->size;
+    return ESP_OK;
+}
+
+void rk_ota_local_close(rk_ota_stream_t *stream, bool success)
+{
+    local_ctx_t *ctx = stream->ctx;
+    
+    if (ctx->type == RK_OTA_LOCAL_FILE) {
+        fclose(ctx->file);
+        ctx->file = NULL;
+        return;
+    }
+    
+    // Obraz odrzucony (zapis, walidacja) - nadawca nie czeka na kolejne potwierdzenia
+    if (!success) {
+        reply(ctx, REPLY_ABORT, ctx->next_seq);
+    }
+    serial_close(ctx);
+}
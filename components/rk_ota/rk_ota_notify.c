@@ -0,0 +1,191 @@
+#include "rk_ota.h"
+#include "rk_ota_priv.h"
+#include "rk_common.h"
+#include "esp_log.h"
+#include "esp_http_client.h"
+#include "esp_timer.h"
+#include <string.h>
+
+static const char *TAG = "RK_OTA_NOTIFY";
+
+#define NOTIFY_TASK_STACK 6144  // TLS dla adresów https
+
+RK_TASK_BUFFER(notify_task, NOTIFY_TASK_STACK);
+
+// Zmienne globalne
+static TaskHandle_t notify_task_handle = NULL;
+static TaskHandle_t s_stop_waiter = NULL;  // Czeka w rk_ota_stop_notify_channel na koniec zadania
+static char s_notify_url[256];
+static volatile bool s_notify_running = false;
+static bool s_use_bundle = false;
+
+static void notify_trigger_check(void)
+{
+    rk_ota_message_t msg = {
+        .type = RK_OTA_MSG_CHECK_UPDATE
+    };
+    
+    if (!rk_ota_get_config(NULL)) {
+        ESP_LOGW(TAG, "Brak konfiguracji OTA - pomijam powiadomienie");
+        return;
+    }
+    
+    rk_ota_notify_received_us = esp_timer_get_time();
+    if (rk_ota_send_message(&msg) == ESP_OK) {
+        rk_ota_stats.checks_from_notify++;
+    }
+}
+
+// Jedno zapytanie long-poll. Zwraca kod HTTP lub -1 przy błędzie połączenia.
+static int notify_poll_once(const char *url)
+{
+    esp_http_client_config_t http_config = {
+        .url = url,
+        .timeout_ms = (RK_OTA_NOTIFY_HOLD_S + 15) * 1000,
+    };
+    rk_ota_trust_apply(&http_config, s_use_bundle);
+    
+    esp_http_client_handle_t client = rk_ota_http_init(&http_config);
+    if (client == NULL) {
+        return -1;
+    }
+    esp_http_client_set_header(client, "User-Agent", "ESP32-OTA-Client/1.0");
+    
+    int status_code = -1;
+    rk_ota_stats.notify_requests++;
+    
+    if (esp_http_client_open(client, 0) == ESP_OK) {
+        esp_http_client_fetch_headers(client);
+        status_code = esp_http_client_get_status_code(client);
+        
+        // Odrzuć treść odpowiedzi - liczy się tylko kod
+        char buf[64];
+        while (esp_http_client_read(client, buf, sizeof(buf)) > 0) {
+        }
+        esp_http_client_close(client);
+    } else if (rk_ota_trust_can_fall_back(s_use_bundle)) {
+        // Kolejne zapytania z pełnym bundle CA
+        s_use_bundle = true;
+    }
+    
+    rk_ota_http_cleanup(client);
+    return status_code;
+}
+
+static void notify_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Kanał powiadomień OTA uruchomiony: %s", s_notify_url);
+    
+    char url[320];
+    snprintf(url, sizeof(url), "%s%cversion=%s",
+             s_notify_url, strchr(s_notify_url, '?') ? '&' : '?', rk_ota_get_version());
+    
+    uint32_t retry_s = RK_OTA_NOTIFY_RETRY_MIN_S;
+    s_use_bundle = rk_ota_trust_starts_with_bundle();
+    
+    while (s_notify_running) {
+        // Bez WiFi nie ma sensu łączyć się z serwerem
+        EventGroupHandle_t wifi_event_group = rk_ota_get_wifi_event_group();
+        if (wifi_event_group != NULL) {
+            EventBits_t bits = xEventGroupWaitBits(wifi_event_group, RK_WIFI_CONNECTED_BIT,
+                                                   pdFALSE, pdTRUE, pdMS_TO_TICKS(1000));
+            if (!(bits & RK_WIFI_CONNECTED_BIT)) {
+                rk_ota_stats.notify_channel_up = false;
+                continue;
+            }
+        }
+        
+        int status_code = notify_poll_once(url);
+        
+        if (status_code == 200) {
+            ESP_LOGI(TAG, "Powiadomienie o nowej wersji - sprawdzam OTA");
+            rk_ota_stats.notify_events++;
+            rk_ota_stats.notify_channel_up = true;
+            retry_s = RK_OTA_NOTIFY_RETRY_MIN_S;
+            notify_trigger_check();
+        } else if (status_code == 204 || status_code == 304) {
+            // Serwer zakończył oczekiwanie bez zmian - od razu kolejne zapytanie
+            rk_ota_stats.notify_channel_up = true;
+            retry_s = RK_OTA_NOTIFY_RETRY_MIN_S;
+        } else {
+            ESP_LOGW(TAG, "Kanał powiadomień niedostępny (HTTP %d), ponowienie za %lu s",
+                     status_code, retry_s);
+            rk_ota_stats.notify_errors++;
+            rk_ota_stats.notify_channel_up = false;
+            // Przerywane przez rk_ota_stop_notify_channel
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(retry_s * 1000));
+            retry_s = retry_s * 2 > RK_OTA_NOTIFY_RETRY_MAX_S ? RK_OTA_NOTIFY_RETRY_MAX_S : retry_s * 2;
+        }
+    }
+    
+    rk_ota_stats.notify_channel_up = false;
+    ESP_LOGI(TAG, "Kanał powiadomień OTA zatrzymany");
+    TaskHandle_t waiter = s_stop_waiter;
+    notify_task_handle = NULL;
+    rk_join_signal(waiter);
+    rk_task_delete(NULL);
+}
+
+esp_err_t rk_ota_start_notify_channel(const char *url)
+{
+    if (url == NULL || strlen(url) == 0 || strlen(url) >= sizeof(s_notify_url)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    if (s_notify_running) {
+        ESP_LOGW(TAG, "Kanał powiadomień już działa");
+        return ESP_OK;
+    }
+    
+    // Poprzednie zadanie jeszcze się kończy - jego stos może być statyczny
+    if (notify_task_handle != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    strncpy(s_notify_url, url, sizeof(s_notify_url) - 1);
+    s_notify_running = true;
+    
+    BaseType_t ret = rk_task_create(notify_task,
+                                   "ota_notify_task",
+                                   NOTIFY_TASK_STACK,
+                                   NULL,
+                                   2,
+                                   &notify_task_handle,
+                                   RK_TASK_STATIC(notify_task));
+    
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Nie można utworzyć zadania kanału powiadomień");
+        s_notify_running = false;
+        return ESP_ERR_NO_MEM;
+    }
+    
+    return ESP_OK;
+}
+
+esp_err_t rk_ota_stop_notify_channel(void)
+{
+    s_notify_running = false;
+    
+    TaskHandle_t task = notify_task_handle;
+    if (task == NULL || task == xTaskGetCurrentTaskHandle()) {
+        return ESP_OK;
+    }
+    
+    rk_join_prepare();
+    s_stop_waiter = xTaskGetCurrentTaskHandle();
+    xTaskNotifyGive(task);      // Przerwanie oczekiwania przed ponowieniem
+    
+    // Trwające zapytanie long-poll kończy się dopiero z odpowiedzią serwera lub timeoutem
+    bool stopped = rk_join_wait(RK_TASK_STOP_TIMEOUT_MS) || notify_task_handle == NULL;
+    s_stop_waiter = NULL;
+    if (!stopped) {
+        ESP_LOGW(TAG, "Kanał powiadomień nie zakończył zapytania w %d ms", RK_TASK_STOP_TIMEOUT_MS);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+bool rk_ota_notify_channel_is_up(void)
+{
+    return s_notify_running && rk_ota_stats.notify_channel_up;
+}
@@ -0,0 +1,248 @@
+#include "rk_ota.h"
+#include "rk_ota_priv.h"
+#include "rk_common.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+#include "esp_image_format.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+// Kasowanie nieaktywnej partycji w czasie bezczynności.
+// Kasowanie sektora to najwolniejsza część zapisu obrazu - wykonane z wyprzedzeniem
+// sprawia, że pobieranie tylko programuje strony (rk_ota_diff widzi sektory 0xFF).
+// Gdy dostępny jest zapis różnicowy, poprzedni obraz zostaje nietknięty (rk_ota_diff
+// porównuje z nim sektory nowego) - kasowany jest tylko obszar za jego końcem.
+// Zadanie ma niski priorytet, kasuje po jednym sektorze i oddaje procesor między nimi.
+
+static const char *TAG = "RK_OTA_ERASE";
+
+#define PREERASE_TASK_STACK  2560
+#define PREERASE_POLL_MS     10000      // Sprawdzanie warunków gdy kasowanie wstrzymane
+#define PREERASE_YIELD_MS    50         // Przerwa między sektorami (cache flash wyłączony)
+#define PREERASE_CHECK_CHUNK 256        // Odczyt przy sprawdzaniu, czy sektor jest pusty
+
+RK_TASK_BUFFER(preerase_task, PREERASE_TASK_STACK);
+RK_MUTEX_BUFFER(preerase_lock);
+
+static TaskHandle_t preerase_task_handle = NULL;
+static SemaphoreHandle_t s_lock = NULL;
+static volatile bool s_boot_confirmed = false;
+static bool s_paused = false;
+
+// Czysty (skasowany) zakres [s_clean_start, s_clean_end) partycji s_partition
+static const esp_partition_t *s_partition = NULL;
+static uint32_t s_clean_start = 0;
+static uint32_t s_clean_end = 0;
+
+static bool sector_is_blank(const esp_partition_t *partition, uint32_t offset)
+{
+    uint32_t words[PREERASE_CHECK_CHUNK / sizeof(uint32_t)];
+    for (uint32_t pos = 0; pos < SPI_FLASH_SEC_SIZE; pos += sizeof(words)) {
+        if (esp_partition_read(partition, offset + pos, words, sizeof(words)) != ESP_OK) {
+            return false;
+        }
+        for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+            if (words[i] != 0xFFFFFFFF) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Partycja do skasowania albo NULL, gdy kasowanie jest teraz niedozwolone
+static const esp_partition_t *erase_target(void)
+{
+    if (!s_boot_confirmed || s_paused || rk_ota_is_update_staged()) {
+        return NULL;
+    }
+    
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    const esp_partition_t *target = esp_ota_get_next_update_partition(NULL);
+    if (target == NULL || running == NULL || target->address == running->address) {
+        return NULL;
+    }
+    
+    // Po udanym OTA partycja startowa wskazuje nowy obraz - czeka na restart
+    const esp_partition_t *boot = esp_ota_get_boot_partition();
+    if (boot != NULL && boot->address == target->address) {
+        return NULL;
+    }
+    
+    return target;
+}
+
+// Początek kasowania: za poprzednim obrazem, gdy zapis różnicowy może go wykorzystać
+static uint32_t clean_start(const esp_partition_t *target)
+{
+    if (!rk_ota_diff_supported(target)) {
+        return 0;
+    }
+    
+    esp_partition_pos_t part_pos = {
+        .offset = target->address,
+        .size = target->size,
+    };
+    esp_image_metadata_t metadata;
+    if (esp_image_verify(ESP_IMAGE_VERIFY_SILENT, &part_pos, &metadata) != ESP_OK) {
+        return 0;   // Brak poprawnego obrazu - nie ma z czym porównywać
+    }
+    
+    uint32_t start = (metadata.image_len + SPI_FLASH_SEC_SIZE - 1) & ~(uint32_t)(SPI_FLASH_SEC_SIZE - 1);
+    ESP_LOGI(TAG, "Obraz %lu B na %s zostaje dla zapisu różnicowego - kasowanie od 0x%lx",
+             (unsigned long)metadata.image_len, target->label, (unsigned long)start);
+    return start < target->size ? start : target->size;
+}
+
+// Jeden krok: sprawdzenie i ewentualne skasowanie kolejnego sektora pod blokadą
+static bool erase_step(void)
+{
+    bool more = false;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    
+    const esp_partition_t *target = erase_target();
+    if (target != NULL) {
+        if (target != s_partition) {
+            s_partition = target;
+            s_clean_start = clean_start(target);
+            s_clean_end = s_clean_start;
+        }
+        
+        if (s_clean_end < target->size) {
+            if (!sector_is_blank(target, s_clean_end)) {
+                int64_t start_us = esp_timer_get_time();
+                esp_err_t err = esp_partition_erase_range(target, s_clean_end, SPI_FLASH_SEC_SIZE);
+                if (err != ESP_OK) {
+                    ESP_LOGE(TAG, "Kasowanie 0x%lx nie powiodło się: %s",
+                             (unsigned long)s_clean_end, esp_err_to_name(err));
+                    xSemaphoreGive(s_lock);
+                    return false;
+                }
+                rk_ota_stats.preerase_sectors++;
+                rk_ota_stats.preerase_erase_ms += (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+            }
+            s_clean_end += SPI_FLASH_SEC_SIZE;
+            rk_ota_stats.preerase_clean_bytes = s_clean_end - s_clean_start;
+            
+            if (s_clean_end >= target->size) {
+                ESP_LOGI(TAG, "Partycja %s skasowana w tle (%lu sektorów, %lu ms)",
+                         target->label, rk_ota_stats.preerase_sectors,
+                         rk_ota_stats.preerase_erase_ms);
+            }
+            more = s_clean_end < target->size;
+        }
+    }
+    
+    xSemaphoreGive(s_lock);
+    return more;
+}
+
+static void preerase_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Zadanie kasowania w tle uruchomione");
+    
+    while (1) {
+        bool more = erase_step();
+        
+        // Powiadomienie budzi zadanie po potwierdzeniu startu lub po zakończeniu OTA
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(more ? PREERASE_YIELD_MS : PREERASE_POLL_MS));
+    }
+}
+
+esp_err_t rk_ota_preerase_start(void)
+{
+    if (!RK_OTA_PRE_ERASE || preerase_task_handle != NULL) {
+        return ESP_OK;
+    }
+    
+    s_lock = rk_mutex_create(RK_MUTEX_STATIC(preerase_lock));
+    if (s_lock == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    
+    BaseType_t ret = rk_task_create(preerase_task,
+                                   "ota_erase_task",
+                                   PREERASE_TASK_STACK,
+                                   NULL,
+                                   tskIDLE_PRIORITY + 1,
+                                   &preerase_task_handle,
+                                   RK_TASK_STATIC(preerase_task));
+    
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Nie można utworzyć zadania kasowania");
+        rk_mutex_delete(s_lock);
+        s_lock = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    
+    return ESP_OK;
+}
+
+void rk_ota_preerase_pause(void)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    
+    // Po oddaniu blokady żaden sektor nie jest już kasowany
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_paused = true;
+    xSemaphoreGive(s_lock);
+}
+
+void rk_ota_preerase_resume(bool written)
+{
+    if (s_lock == NULL) {
+        return;
+    }
+    
+    // Zapis zmienił partycję - czysty zakres (i koniec obrazu) ustalane od nowa.
+    // Bez zapisu (304, test łącza bez flash) skasowany zakres pozostaje ważny.
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_paused = false;
+    if (written) {
+        s_partition = NULL;
+        s_clean_start = 0;
+        s_clean_end = 0;
+        rk_ota_stats.preerase_clean_bytes = 0;
+    }
+    xSemaphoreGive(s_lock);
+    xTaskNotifyGive(preerase_task_handle);
+}
+
+bool rk_ota_preerase_is_clean(const esp_partition_t *partition, uint32_t offset)
+{
+    if (s_lock == NULL) {
+        return false;
+    }
+    
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool clean = s_partition != NULL && s_partition->address == partition->address &&
+                 offset >= s_clean_start && offset < s_clean_end;
+    xSemaphoreGive(s_lock);
+    return clean;
+}
+
+esp_err_t rk_ota_confirm_boot(void)
+{
+    esp_ota_img_states_t state;
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    if (running != NULL && esp_ota_get_state_partition(running, &state) == ESP_OK &&
+        state == ESP_OTA_IMG_PENDING_VERIFY) {
+        esp_err_t err = esp_ota_mark_app_valid_cancel_rollback();
+        if (err != ESP_OK) {
+            return err;
+        }
+        ESP_LOGI(TAG, "Obraz %s potwierdzony - wycofanie anulowane", running->label);
+    }
+    rk_ota_firmware_etag_commit(running);
+    
+    // Poprzedni obraz nie jest już potrzebny do wycofania - można kasować
+    s_boot_confirmed = true;
+    if (preerase_task_handle != NULL) {
+        xTaskNotifyGive(preerase_task_handle);
+    }
+    return ESP_OK;
+}
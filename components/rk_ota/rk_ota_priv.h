@@ -0,0 +1,368 @@
+#ifndef RK_OTA_PRIV_H
+#define RK_OTA_PRIV_H
+
+// Elementy wewnętrzne komponentu OTA współdzielone między plikami .c
+
+#include "rk_ota.h"
+#include "rk_common.h"
+#include "esp_http_client.h"
+#include "esp_ota_ops.h"
+#include "esp_app_format.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// WiFi event bits (importowane z rk_wifi)
+#define RK_WIFI_CONNECTED_BIT BIT0
+
+// Statystyki OTA (aktualizowane przez zadania komponentu)
+extern rk_ota_stats_t rk_ota_stats;
+
+// Znacznik czasu ostatniego powiadomienia o nowej wersji (0 - brak)
+extern int64_t rk_ota_notify_received_us;
+
+// Klient HTTP liczony w rk_res - wyciek na ścieżce błędu widać w licznikach
+static inline esp_http_client_handle_t rk_ota_http_init(const esp_http_client_config_t *config)
+{
+    esp_http_client_handle_t client = esp_http_client_init(config);
+    if (client != NULL) {
+        rk_res_acquire(RK_RES_HTTP_CLIENT);
+    }
+    return client;
+}
+
+static inline void rk_ota_http_cleanup(esp_http_client_handle_t client)
+{
+    rk_res_release(RK_RES_HTTP_CLIENT);
+    esp_http_client_cleanup(client);
+}
+
+// Źródło strumienia obrazu dla wspólnej ścieżki zapisu (skrót podpisu, zapis różnicowy, flash)
+typedef struct {
+    const char *name;                                   // Do logów
+    int (*read)(void *ctx, uint8_t *buf, int len);      // Liczba bajtów, 0 - koniec, < 0 - błąd
+    bool (*complete)(void *ctx);                        // Po odczycie 0: czy strumień jest pełny
+    void *ctx;
+} rk_ota_stream_t;
+
+/**
+ * @brief Otwarcie lokalnego źródła obrazu (plik lub strumień ramek)
+ * @param source Źródło
+ * @param max_size Rozmiar partycji docelowej - większy obraz jest odrzucany
+ * @param stream Strumień do wypełnienia
+ * @param size Rozmiar obrazu
+ * @return ESP_OK, ESP_ERR_NOT_FOUND, ESP_ERR_TIMEOUT (brak ramki startowej), ESP_ERR_INVALID_SIZE
+ */
+esp_err_t rk_ota_local_open(const rk_ota_local_source_t *source, uint32_t max_size,
+                            rk_ota_stream_t *stream, int *size);
+
+/**
+ * @brief Zamknięcie lokalnego źródła (nadawca dostaje przerwanie, gdy obraz niepełny)
+ */
+void rk_ota_local_close(rk_ota_stream_t *stream, bool success);
+
+/**
+ * @brief Kopia zarejestrowanej konfiguracji OTA
+ * @param config Struktura do wypełnienia (może być NULL - tylko sprawdzenie)
+ * @return true jeśli konfiguracja została zarejestrowana
+ */
+bool rk_ota_get_config(rk_ota_config_t *config);
+
+/**
+ * @brief Warunkowe pobranie małego pliku z repo tą samą ścieżką co obraz (DNS, TLS, token)
+ * @param file Nazwa pliku w repo
+ * @param etag ETag poprzedniej wersji (If-None-Match), pusty - bezwarunkowo
+ * @param new_etag Bufor na ETag odpowiedzi 200
+ * @param body Bufor na treść (zakończona '\0')
+ * @param modified false - odpowiedź 304, treść bez zmian
+ * @return ESP_OK, ESP_ERR_NOT_FOUND dla 404, ESP_ERR_INVALID_SIZE gdy treść za duża
+ */
+esp_err_t rk_ota_fetch_file(const rk_ota_config_t *config, const char *file,
+                            const char *etag, char *new_etag, size_t etag_len,
+                            char *body, size_t body_len, bool *modified);
+
+/**
+ * @brief Instalacja alokatora cJSON (rk_mem) - raz, z rk_ota_init
+ */
+void rk_ota_remote_init(void);
+
+/**
+ * @brief Sprawdzenie dokumentu konfiguracji zdalnej i zastosowanie nowej wersji
+ * @return ESP_OK gdy zastosowano nową wersję, ESP_ERR_NOT_FOUND gdy bez zmian
+ */
+esp_err_t rk_ota_remote_config_check(const rk_ota_config_t *config);
+
+// Źródło obrazu - ETagi są przechowywane osobno dla każdego
+typedef enum {
+    RK_OTA_SOURCE_GITHUB,
+    RK_OTA_SOURCE_MIRROR,
+    RK_OTA_SOURCE_COUNT,
+} rk_ota_source_t;
+
+/**
+ * @brief ETag obrazu zainstalowanego z danego źródła (pusty gdy nieznany)
+ *
+ * Kopia w pamięci RTC przetrwa uśpienie głębokie - bez odczytu NVS przy każdym
+ * wybudzeniu.
+ */
+const char *rk_ota_firmware_etag(rk_ota_source_t source);
+
+/**
+ * @brief Usunięcie ETagów wszystkich źródeł i oczekującego (obraz spoza OTA sieciowego)
+ */
+void rk_ota_firmware_etag_clear(void);
+
+/**
+ * @brief Zapis ETagu obrazu jako oczekującego przed restartem do nowego obrazu
+ * @param source Źródło, z którego pobrano obraz
+ * @param partition Partycja, na którą zapisano obraz
+ */
+void rk_ota_firmware_etag_stage(rk_ota_source_t source, const char *etag,
+                                const esp_partition_t *partition);
+
+/**
+ * @brief Zatwierdzenie oczekującego ETagu po potwierdzeniu startu
+ *
+ * ETag staje się bieżącym tylko wtedy, gdy działa obraz z zapisanej partycji;
+ * po wycofaniu jest odrzucany.
+ */
+void rk_ota_firmware_etag_commit(const esp_partition_t *running);
+
+/**
+ * @brief Czy zlecono anulowanie bieżącej aktualizacji
+ */
+bool rk_ota_cancel_requested(void);
+
+/**
+ * @brief Aktualizacja postępu widocznego przez rk_ota_get_progress
+ */
+void rk_ota_set_progress(rk_ota_state_t state, uint32_t bytes, uint32_t total);
+
+/**
+ * @brief Nagłówki zapytania o obraz (Host przy adresie z cache DNS, token, User-Agent)
+ * @param use_auth Dodanie tokenu GitHub (tylko dla pierwotnego hosta)
+ */
+void rk_ota_set_request_headers(esp_http_client_handle_t client, const char *authority,
+                                bool host_override, bool use_auth);
+
+/**
+ * @brief Event Group WiFi przekazany do rk_ota_start_task
+ */
+EventGroupHandle_t rk_ota_get_wifi_event_group(void);
+
+/**
+ * @brief Uruchomienie cache DNS i zadania odświeżającego wpisy w tle
+ * @return ESP_OK w przypadku sukcesu
+ */
+esp_err_t rk_ota_dns_init(void);
+
+/**
+ * @brief Adres IPv4 hosta z cache DNS
+ *
+ * Przeterminowany wpis jest zwracany i odświeżany w tle, ale najwyżej
+ * RK_OTA_DNS_STALE_MAX_S po końcu TTL - później rozwiązanie synchroniczne.
+ *
+ * @param host Nazwa hosta
+ * @param addr Adres w kolejności sieciowej
+ * @return ESP_OK w przypadku sukcesu
+ */
+esp_err_t rk_ota_dns_lookup(const char *host, uint32_t *addr);
+
+/**
+ * @brief Usunięcie wpisu hosta z cache DNS - po nieudanym połączeniu pod adres z cache
+ * @param host Nazwa hosta
+ */
+void rk_ota_dns_evict(const char *host);
+
+/**
+ * @brief Zamiana hosta w URL na adres z cache DNS
+ * @param url Oryginalny URL
+ * @param connect_url Bufor na URL z adresem IP (lub kopię oryginału)
+ * @param host Bufor na nazwę hosta (do weryfikacji certyfikatu / SNI)
+ * @param authority Bufor na host[:port] (do nagłówka Host)
+ * @return true jeśli host został zastąpiony adresem IP
+ */
+bool rk_ota_dns_rewrite_url(const char *url, char *connect_url, size_t url_len,
+                            char *host, size_t host_len,
+                            char *authority, size_t authority_len);
+
+/**
+ * @brief Liczba połączeń dla pobierania segmentami (wg sterty i rozmiaru obrazu)
+ * @param content_length Rozmiar obrazu
+ * @return 1 - pobieranie jednym strumieniem, 2..RK_OTA_SEGMENTS_MAX - równolegle
+ */
+int rk_ota_segments_plan(int content_length);
+
+/**
+ * @brief Równoległe pobranie obrazu zakresami HTTP Range do partycji OTA
+ *
+ * Pierwszy segment czytany jest z już otwartej odpowiedzi 200 (first_client),
+ * kolejne przez osobne połączenia. Segmenty zapisują partycję bezpośrednio pod własne
+ * przesunięcia i kasują swoje sektory przed zapisem (pomijając skasowane w tle).
+ * Wywołujący sprawdza partycję (rk_ota_check_target) i weryfikuje obraz po zapisie.
+ *
+ * @param url Końcowy adres obrazu (po przekierowaniach)
+ * @param partition Partycja docelowa
+ * @param received Suma zapisanych bajtów
+ * @return ESP_OK gdy wszystkie segmenty zostały zapisane
+ */
+esp_err_t rk_ota_segments_download(esp_http_client_handle_t first_client, const char *url,
+                                   bool use_bundle, bool use_token,
+                                   const esp_partition_t *partition, int content_length,
+                                   int connections, uint8_t *buffer, size_t buffer_len,
+                                   int *received);
+
+/**
+ * @brief Kontrola partycji przed zapisem z pominięciem esp_ota_begin (jak w esp_ota_begin)
+ * @return ESP_OK, ESP_ERR_OTA_PARTITION_CONFLICT dla partycji uruchomionej,
+ *         ESP_ERR_OTA_ROLLBACK_INVALID_STATE gdy uruchomiony obraz czeka na potwierdzenie
+ */
+esp_err_t rk_ota_check_target(const esp_partition_t *partition);
+
+/**
+ * @brief Weryfikacja obrazu zapisanego z pominięciem esp_ota_end (esp_image_verify)
+ * @return ESP_OK gdy obraz jest poprawny, ESP_ERR_OTA_VALIDATE_FAILED
+ */
+esp_err_t rk_ota_verify_image(const esp_partition_t *partition);
+
+/**
+ * @brief Czy zapis z pominięciem identycznych sektorów jest możliwy dla partycji
+ */
+bool rk_ota_diff_supported(const esp_partition_t *partition);
+
+/**
+ * @brief Rozpoczęcie zapisu obrazu sektorami porównywanymi z zawartością partycji
+ * @param image_size Rozmiar obrazu (Content-Length)
+ * @return ESP_OK w przypadku sukcesu, błąd rk_ota_check_target
+ */
+esp_err_t rk_ota_diff_begin(const esp_partition_t *partition, uint32_t image_size);
+
+/**
+ * @brief Kolejny fragment obrazu (zapis sektorami 4 KB)
+ * @return ESP_OK w przypadku sukcesu
+ */
+esp_err_t rk_ota_diff_write(const uint8_t *data, size_t len);
+
+/**
+ * @brief Zapis ostatniego sektora i weryfikacja obrazu (esp_image_verify)
+ * @return ESP_OK gdy obraz jest poprawny
+ */
+esp_err_t rk_ota_diff_end(void);
+
+/**
+ * @brief Przerwanie zapisu (zwolnienie mapowania partycji)
+ */
+void rk_ota_diff_abort(void);
+
+/**
+ * @brief Uruchomienie zadania kasującego nieaktywną partycję w czasie bezczynności
+ * @return ESP_OK w przypadku sukcesu
+ */
+esp_err_t rk_ota_preerase_start(void);
+
+/**
+ * @brief Wstrzymanie kasowania w tle (po powrocie żaden sektor nie jest kasowany)
+ */
+void rk_ota_preerase_pause(void);
+
+/**
+ * @brief Wznowienie kasowania po OTA
+ * @param written Operacja zapisała partycję docelową - czysty zakres sprawdzany od nowa
+ */
+void rk_ota_preerase_resume(bool written);
+
+/**
+ * @brief Czy sektor pod offset jest skasowany przez zadanie w tle (wywoływane w czasie pauzy)
+ */
+bool rk_ota_preerase_is_clean(const esp_partition_t *partition, uint32_t offset);
+
+/**
+ * @brief Pobranie całego obrazu z SHA-256 (i opcjonalnie zapisem) bez zmiany partycji startowej
+ * @param with_flash Mierzony zapis do partycji (kasowanie sektorami i zapis)
+ * @param signed_image Weryfikacja podpisu pobranego przez rk_ota_sign_fetch
+ * @param result Wypełniane: bajty, czasy, przepustowość, skrót
+ * @return ESP_OK gdy obraz pobrany w całości i skrót zgodny
+ */
+esp_err_t rk_ota_bench_download(esp_http_client_handle_t client, const esp_partition_t *partition,
+                                int content_length, bool with_flash, bool signed_image,
+                                uint8_t *buffer, size_t buffer_len,
+                                rk_ota_bench_result_t *result);
+
+/**
+ * @brief Czy wbudowany klucz publiczny pozwala weryfikować obrazy z mirrora
+ */
+bool rk_ota_sign_available(void);
+
+/**
+ * @brief Pobranie podpisu obrazu (<image_url>.sig) przed pobraniem obrazu
+ * @return ESP_OK, ESP_ERR_NOT_FOUND gdy mirror nie ma podpisu
+ */
+esp_err_t rk_ota_sign_fetch(const char *image_url);
+
+/**
+ * @brief Początek liczenia skrótu pobieranego obrazu
+ */
+void rk_ota_sign_begin(void);
+
+/**
+ * @brief Kolejny fragment obrazu (w kolejności strumienia)
+ */
+void rk_ota_sign_update(const uint8_t *data, size_t len);
+
+/**
+ * @brief Porzucenie skrótu po błędzie pobierania
+ */
+void rk_ota_sign_abort(void);
+
+// Początek obrazu do esp_app_desc_t włącznie (nagłówek obrazu i pierwszego segmentu)
+#define RK_OTA_IMAGE_HEADER_LEN (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + \
+                                 sizeof(esp_app_desc_t))
+
+/**
+ * @brief Odrzucenie obrazu z mirrora, który nie jest nowszy od działającego
+ *
+ * Wersja i secure_version z esp_app_desc_t na początku strumienia; podpis sprawdzany
+ * po całym obrazie potwierdza, że nagłówek nie został podmieniony.
+ *
+ * @param header Początek obrazu
+ * @param len Długość - co najmniej nagłówki i esp_app_desc_t
+ * @return ESP_OK, ESP_ERR_INVALID_VERSION gdy wersja nie jest nowsza
+ */
+esp_err_t rk_ota_sign_check_version(const uint8_t *header, size_t len);
+
+/**
+ * @brief Sprawdzenie podpisu nad skrótem całego obrazu - przed zmianą partycji startowej
+ * @param verify_ms Czas weryfikacji ECDSA (może być NULL)
+ * @return ESP_OK, ESP_ERR_OTA_VALIDATE_FAILED przy niezgodnym podpisie
+ */
+esp_err_t rk_ota_sign_verify(uint32_t *verify_ms);
+
+/**
+ * @brief Czy pierwsze połączenie ma używać pełnego bundle CA
+ */
+bool rk_ota_trust_starts_with_bundle(void);
+
+/**
+ * @brief Czy po błędzie połączenia można ponowić z pełnym bundle
+ * @param use_bundle Czy nieudane połączenie używało już bundle
+ */
+bool rk_ota_trust_can_fall_back(bool use_bundle);
+
+/**
+ * @brief Ustawienie zestawu CA i weryfikacji nazwy hosta w konfiguracji HTTP
+ * @param http_config Konfiguracja klienta HTTP
+ * @param use_bundle true - pełny bundle, false - wbudowany zestaw CA
+ */
+void rk_ota_trust_apply(esp_http_client_config_t *http_config, bool use_bundle);
+
+/**
+ * @brief Zapisanie pomiaru połączenia TLS w statystykach
+ */
+void rk_ota_trust_record(bool use_bundle, uint32_t handshake_ms, uint32_t heap_bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RK_OTA_PRIV_H
@@ -0,0 +1,409 @@
+#include "rk_ota.h"
+#include "rk_ota_priv.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "nvs.h"
+#include "cJSON.h"
+#include <string.h>
+
+// Konfiguracja zdalna: mały dokument JSON w repo obok obrazu, np.
+//   {"version":3,"led":{"on_ms":200,"off_ms":800},"wifi":{"ssid":"...","pass":"..."},
+//    "ota":{"interval_min":15,"branch":"main","file":"firmware.bin"}}
+// Sprawdzany zapytaniem warunkowym (ETag) przy każdym sprawdzeniu OTA, po walidacji
+// stosowany przez callback aplikacji i zapisywany w NVS (tekst dokumentu + ETag).
+
+static const char *TAG = "RK_OTA_REMOTE";
+
+#define NVS_NAMESPACE   "rk_ota_cfg"
+#define NVS_KEY_DOC     "doc"
+#define NVS_KEY_ETAG    "etag"
+#define NVS_KEY_SKIP    "skip_ver"  // Wersja odrzucona przez callback - nie stosować ponownie
+#define NVS_KEY_FW_ETAG "fw_etag"   // ETag obrazu zainstalowanego z GitHub
+#define NVS_KEY_FW_ETAG_M "fw_etag_m" // ETag obrazu zainstalowanego z mirrora
+#define NVS_KEY_FW_PEND "fw_etag_p" // ETag obrazu czekającego na potwierdzenie startu
+#define NVS_KEY_FW_PART "fw_part_p" // Adres partycji, na którą zapisano ten obraz
+#define NVS_KEY_FW_SRC  "fw_src_p"  // Źródło tego obrazu (rk_ota_source_t)
+#define ETAG_LEN        72
+#define FW_ETAG_MAGIC   0x52454732  // "REG2"
+
+// Zakresy akceptowanych wartości
+#define LED_MS_MIN          10
+#define LED_MS_MAX          10000
+#define OTA_INTERVAL_MAX    (24 * 60)
+
+static rk_ota_remote_config_callback_t s_callback = NULL;
+static char s_etag[ETAG_LEN];
+static bool s_etag_loaded = false;
+
+// ETagi obrazu osobno dla każdego źródła - serwery nadają je niezależnie, więc ETag
+// mirrora wysłany do GitHub zawsze dawałby 200. NVS jest źródłem, kopia RTC oszczędza
+// odczyt po każdym wybudzeniu.
+typedef struct {
+    uint32_t magic;
+    char etag[RK_OTA_SOURCE_COUNT][ETAG_LEN];
+} fw_etag_cache_t;
+
+static RTC_DATA_ATTR fw_etag_cache_t s_fw_etag;
+
+void rk_ota_set_remote_config_callback(rk_ota_remote_config_callback_t callback)
+{
+    s_callback = callback;
+}
+
+static bool copy_string(const cJSON *parent, const char *key, char *out, size_t out_len,
+                        size_t min_len)
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(parent, key);
+    if (item == NULL) {
+        return true;    // Brak pola - bez zmiany
+    }
+    if (!cJSON_IsString(item) || strlen(item->valuestring) < min_len ||
+        strlen(item->valuestring) >= out_len) {
+        ESP_LOGE(TAG, "Niepoprawne pole \"%s\"", key);
+        return false;
+    }
+    strcpy(out, item->valuestring);
+    return true;
+}
+
+static bool copy_number(const cJSON *parent, const char *key, uint32_t min, uint32_t max,
+                        uint32_t *out)
+{
+    const cJSON *item = cJSON_GetObjectItemCaseSensitive(parent, key);
+    if (item == NULL) {
+        return true;
+    }
+    // Tylko liczby całkowite - 2.5 nie jest obcinane do 2
+    if (!cJSON_IsNumber(item) || item->valuedouble < min || item->valuedouble > max ||
+        item->valuedouble != (uint32_t)item->valuedouble) {
+        ESP_LOGE(TAG, "Pole \"%s\" poza zakresem %lu-%lu", key, min, max);
+        return false;
+    }
+    *out = (uint32_t)item->valuedouble;
+    return true;
+}
+
+// Alokator cJSON: węzły w SRAM, duże teksty (RK_MEM_BULK_MIN) w PSRAM, jeśli jest
+static void *json_malloc(size_t size)
+{
+    return rk_mem_alloc(size, size >= RK_MEM_BULK_MIN ? RK_MEM_BULK : RK_MEM_INTERNAL);
+}
+
+// Jedyny użytkownik cJSON w projekcie - haki globalne ustawiane raz, w rk_ota_init
+void rk_ota_remote_init(void)
+{
+    cJSON_Hooks hooks = {
+        .malloc_fn = json_malloc,
+        .free_fn = rk_mem_free,
+    };
+    cJSON_InitHooks(&hooks);
+}
+
+// Parsowanie i walidacja - dokument jest przyjmowany w całości albo wcale
+static esp_err_t parse_document(const char *doc, rk_ota_remote_config_t *config)
+{
+    memset(config, 0, sizeof(*config));
+    
+    cJSON *root = cJSON_Parse(doc);
+    if (root == NULL || !cJSON_IsObject(root)) {
+        ESP_LOGE(TAG, "Dokument konfiguracji nie jest obiektem JSON");
+        cJSON_Delete(root);
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    bool ok = copy_number(root, "version", 1, UINT32_MAX, &config->version) &&
+              config->version > 0;
+    
+    const cJSON *led = cJSON_GetObjectItemCaseSensitive(root, "led");
+    if (ok && led != NULL) {
+        ok = copy_number(led, "on_ms", LED_MS_MIN, LED_MS_MAX, &config->led_on_ms) &&
+             copy_number(led, "off_ms", LED_MS_MIN, LED_MS_MAX, &config->led_off_ms);
+    }
+    
+    // WPA2: hasło 8-63 znaki
+    const cJSON *wifi = cJSON_GetObjectItemCaseSensitive(root, "wifi");
+    if (ok && wifi != NULL) {
+        ok = copy_string(wifi, "ssid", config->wifi_ssid, sizeof(config->wifi_ssid), 1) &&
+             copy_string(wifi, "pass", config->wifi_pass, sizeof(config->wifi_pass), 8) &&
+             (config->wifi_ssid[0] != '\0') == (config->wifi_pass[0] != '\0');
+    }
+    
+    const cJSON *ota = cJSON_GetObjectItemCaseSensitive(root, "ota");
+    if (ok && ota != NULL) {
+        uint32_t interval = 0;
+        ok = copy_number(ota, "interval_min", 1, OTA_INTERVAL_MAX, &interval) &&
+             copy_string(ota, "branch", config->github_branch, sizeof(config->github_branch), 1) &&
+             copy_string(ota, "file", config->firmware_file, sizeof(config->firmware_file), 1);
+        config->ota_interval_min = (uint16_t)interval;
+    }
+    
+    cJSON_Delete(root);
+    if (!ok) {
+        ESP_LOGE(TAG, "Dokument konfiguracji odrzucony");
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t load_document(char *doc, size_t doc_len)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs);
+    if (err != ESP_OK) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    err = nvs_get_str(nvs, NVS_KEY_DOC, doc, &doc_len);
+    nvs_close(nvs);
+    return err == ESP_OK ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t rk_ota_remote_config_load(rk_ota_remote_config_t *config)
+{
+    char doc[RK_OTA_REMOTE_CONFIG_MAX];
+    
+    if (config == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    esp_err_t err = load_document(doc, sizeof(doc));
+    if (err == ESP_OK) {
+        err = parse_document(doc, config);
+    }
+    if (err == ESP_OK) {
+        rk_ota_stats.config_version = config->version;
+        ESP_LOGI(TAG, "Konfiguracja zdalna z NVS: wersja %lu", config->version);
+    }
+    return err;
+}
+
+static void load_state(uint32_t *skip_version)
+{
+    nvs_handle_t nvs;
+    
+    *skip_version = 0;
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        s_etag_loaded = true;
+        return;
+    }
+    if (!s_etag_loaded) {
+        size_t len = sizeof(s_etag);
+        if (nvs_get_str(nvs, NVS_KEY_ETAG, s_etag, &len) != ESP_OK) {
+            s_etag[0] = '\0';
+        }
+        s_etag_loaded = true;
+    }
+    nvs_get_u32(nvs, NVS_KEY_SKIP, skip_version);
+    nvs_close(nvs);
+}
+
+// Zapis wyniku: przyjęty dokument z ETagiem albo tylko ETag i odrzucona wersja
+static void save_state(const char *doc, const char *etag, uint32_t skip_version)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS niedostępne: %s", esp_err_to_name(err));
+        return;
+    }
+    
+    if (doc != NULL) {
+        err = nvs_set_str(nvs, NVS_KEY_DOC, doc);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_str(nvs, NVS_KEY_ETAG, etag);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_u32(nvs, NVS_KEY_SKIP, skip_version);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Zapis konfiguracji w NVS nie powiódł się: %s", esp_err_to_name(err));
+        return;
+    }
+    strncpy(s_etag, etag, sizeof(s_etag) - 1);
+    s_etag[sizeof(s_etag) - 1] = '\0';
+}
+
+static const char *s_fw_etag_keys[RK_OTA_SOURCE_COUNT] = {
+    [RK_OTA_SOURCE_GITHUB] = NVS_KEY_FW_ETAG,
+    [RK_OTA_SOURCE_MIRROR] = NVS_KEY_FW_ETAG_M,
+};
+
+static void fw_etag_cache_set(rk_ota_source_t source, const char *etag)
+{
+    strncpy(s_fw_etag.etag[source], etag, sizeof(s_fw_etag.etag[source]) - 1);
+    s_fw_etag.etag[source][sizeof(s_fw_etag.etag[source]) - 1] = '\0';
+}
+
+const char *rk_ota_firmware_etag(rk_ota_source_t source)
+{
+    if (s_fw_etag.magic == FW_ETAG_MAGIC) {
+        return s_fw_etag.etag[source];
+    }
+    
+    nvs_handle_t nvs;
+    bool opened = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) == ESP_OK;
+    for (int i = 0; i < RK_OTA_SOURCE_COUNT; i++) {
+        size_t len = sizeof(s_fw_etag.etag[i]);
+        if (!opened || nvs_get_str(nvs, s_fw_etag_keys[i], s_fw_etag.etag[i], &len) != ESP_OK) {
+            s_fw_etag.etag[i][0] = '\0';
+        }
+    }
+    if (opened) {
+        nvs_close(nvs);
+    }
+    s_fw_etag.magic = FW_ETAG_MAGIC;
+    return s_fw_etag.etag[source];
+}
+
+void rk_ota_firmware_etag_clear(void)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        // Oczekujący ETag też opisuje inny obraz niż zainstalowany teraz
+        nvs_erase_key(nvs, NVS_KEY_FW_PEND);
+        nvs_erase_key(nvs, NVS_KEY_FW_PART);
+        nvs_erase_key(nvs, NVS_KEY_FW_SRC);
+        for (int i = 0; i < RK_OTA_SOURCE_COUNT; i++) {
+            nvs_erase_key(nvs, s_fw_etag_keys[i]);
+        }
+        err = nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Usunięcie ETagów obrazu nie powiodło się: %s", esp_err_to_name(err));
+    }
+    
+    for (int i = 0; i < RK_OTA_SOURCE_COUNT; i++) {
+        s_fw_etag.etag[i][0] = '\0';
+    }
+    s_fw_etag.magic = FW_ETAG_MAGIC;
+}
+
+void rk_ota_firmware_etag_stage(rk_ota_source_t source, const char *etag,
+                                const esp_partition_t *partition)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err == ESP_OK) {
+        err = nvs_set_str(nvs, NVS_KEY_FW_PEND, etag);
+        if (err == ESP_OK) {
+            err = nvs_set_u32(nvs, NVS_KEY_FW_PART, partition->address);
+        }
+        if (err == ESP_OK) {
+            err = nvs_set_u8(nvs, NVS_KEY_FW_SRC, (uint8_t)source);
+        }
+        if (err == ESP_OK) {
+            err = nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Zapis oczekującego ETagu nie powiódł się: %s", esp_err_to_name(err));
+    }
+}
+
+void rk_ota_firmware_etag_commit(const esp_partition_t *running)
+{
+    nvs_handle_t nvs;
+    if (running == NULL || nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    
+    char etag[ETAG_LEN];
+    size_t len = sizeof(etag);
+    uint32_t address = 0;
+    uint8_t source = 0;
+    if (nvs_get_str(nvs, NVS_KEY_FW_PEND, etag, &len) != ESP_OK ||
+        nvs_get_u32(nvs, NVS_KEY_FW_PART, &address) != ESP_OK ||
+        nvs_get_u8(nvs, NVS_KEY_FW_SRC, &source) != ESP_OK || source >= RK_OTA_SOURCE_COUNT) {
+        nvs_close(nvs);
+        return;     // Brak oczekującego ETagu - zwykły start
+    }
+    
+    // Start z innej partycji (wycofanie, nieudane przełączenie) - ETag nie opisuje
+    // działającego obrazu, następne sprawdzenie pobierze obraz ponownie.
+    // ETag drugiego źródła zostaje - opisuje jego własną wersję pliku.
+    bool match = (address == running->address);
+    esp_err_t err = ESP_OK;
+    if (match) {
+        err = nvs_set_str(nvs, s_fw_etag_keys[source], etag);
+    }
+    nvs_erase_key(nvs, NVS_KEY_FW_PEND);
+    nvs_erase_key(nvs, NVS_KEY_FW_PART);
+    nvs_erase_key(nvs, NVS_KEY_FW_SRC);
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Zatwierdzenie ETagu obrazu nie powiodło się: %s", esp_err_to_name(err));
+        return;
+    }
+    if (match) {
+        rk_ota_firmware_etag((rk_ota_source_t)source);     // Wczytanie kopii RTC
+        fw_etag_cache_set((rk_ota_source_t)source, etag);
+        ESP_LOGI(TAG, "ETag obrazu %s zatwierdzony (%s)", running->label,
+                 source == RK_OTA_SOURCE_MIRROR ? "mirror" : "GitHub");
+    } else {
+        ESP_LOGW(TAG, "Start z %s zamiast zapisanej partycji - ETag odrzucony", running->label);
+    }
+}
+
+esp_err_t rk_ota_remote_config_check(const rk_ota_config_t *config)
+{
+    if (config->config_file[0] == '\0' || s_callback == NULL) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    
+    uint32_t skip_version;
+    load_state(&skip_version);
+    
+    char doc[RK_OTA_REMOTE_CONFIG_MAX];
+    char etag[ETAG_LEN];
+    bool modified = false;
+    
+    rk_ota_stats.config_checks++;
+    esp_err_t err = rk_ota_fetch_file(config, config->config_file, s_etag, etag, sizeof(etag),
+                                      doc, sizeof(doc), &modified);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Pobranie %s nie powiodło się: %s", config->config_file, esp_err_to_name(err));
+        return err;
+    }
+    if (!modified) {
+        rk_ota_stats.config_not_modified++;
+        return ESP_ERR_NOT_FOUND;
+    }
+    
+    rk_ota_remote_config_t remote;
+    err = parse_document(doc, &remote);
+    if (err == ESP_OK && (remote.version <= rk_ota_stats.config_version ||
+                          remote.version == skip_version)) {
+        // Ta sama lub starsza wersja (np. cofnięty commit) - tylko nowy ETag
+        ESP_LOGI(TAG, "Wersja %lu już znana - pomijam", remote.version);
+        save_state(NULL, etag, skip_version);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Nowa konfiguracja zdalna: wersja %lu", remote.version);
+        err = s_callback(&remote);
+    }
+    
+    if (err != ESP_OK) {
+        // Bez ETagu błędny dokument byłby pobierany przy każdym sprawdzeniu
+        rk_ota_stats.config_rejected++;
+        save_state(NULL, etag, remote.version);
+        return err;
+    }
+    
+    rk_ota_stats.config_updates++;
+    rk_ota_stats.config_version = remote.version;
+    save_state(doc, etag, 0);
+    return ESP_OK;
+}
@@ -0,0 +1,296 @@
+#include "rk_ota.h"
+#include "rk_ota_priv.h"
+#include "rk_common.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_flash_encrypt.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Pobieranie obrazu równoległymi zakresami HTTP Range.
+// Na łączach o dużym RTT pojedynczy strumień TCP nie otwiera okna na tyle, by wypełnić
+// pasmo - kilka połączeń pobiera rozłączne segmenty i zapisuje je pod ich przesunięcia.
+// Segmenty piszą bezpośrednio do partycji (bez wspólnego uchwytu esp_ota): każdy kasuje
+// tylko własne sektory, a operacje flash szereguje sterownik. Poprawność złożonego obrazu
+// sprawdza rk_ota_verify_image (SHA-256 całego obrazu).
+
+static const char *TAG = "RK_OTA_SEG";
+
+#define SEGMENT_TASK_STACK   6144
+#define SEGMENT_TIMEOUT_MS   30000
+#define SEGMENT_PROGRESS_MS  500
+#define SEGMENT_ALIGN        4096           // Granice segmentów na granicach sektorów flash
+#define SEGMENT_BLOCK_MIN    (20 * 1024)    // Ciągły blok na bufor wejściowy TLS
+
+typedef struct {
+    const char *url;
+    bool use_bundle;
+    bool use_token;
+    const esp_partition_t *partition;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t erased_end;                // Koniec skasowanych sektorów segmentu
+    volatile uint32_t received;
+    esp_err_t result;
+    bool started;
+    TaskHandle_t parent;
+} ota_segment_t;
+
+// Segmenty bieżącego pobrania (jedno OTA naraz - zadanie OTA)
+static ota_segment_t s_segments[RK_OTA_SEGMENTS_MAX];
+static int s_segment_count = 0;
+
+int rk_ota_segments_plan(int content_length)
+{
+    if (RK_OTA_SEGMENTS_MAX < 2 || content_length < RK_OTA_SEGMENTS_MIN_IMAGE) {
+        return 1;
+    }
+    
+    // Zapis szyfrowany wymaga bloków wyrównanych do 16 bajtów - segmenty tego nie gwarantują
+    if (esp_flash_encryption_enabled()) {
+        return 1;
+    }
+    
+    // Pierwsze połączenie jest już otwarte - liczymy tylko dodatkowe
+    size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    if (free_bytes <= RK_OTA_SEGMENT_HEAP_RESERVE || largest_block < SEGMENT_BLOCK_MIN) {
+        return 1;
+    }
+    
+    int connections = 1 + (int)((free_bytes - RK_OTA_SEGMENT_HEAP_RESERVE) / RK_OTA_SEGMENT_HEAP_COST);
+    if (connections > RK_OTA_SEGMENTS_MAX) {
+        connections = RK_OTA_SEGMENTS_MAX;
+    }
+    
+    ESP_LOGI(TAG, "Sterta %u B (blok %u B) - połączeń: %d",
+             (unsigned)free_bytes, (unsigned)largest_block, connections);
+    return connections;
+}
+
+static uint32_t segments_received(void)
+{
+    uint32_t total = 0;
+    for (int i = 0; i < s_segment_count; i++) {
+        total += s_segments[i].received;
+    }
+    return total;
+}
+
+// Zapytanie o pozostałą część segmentu (od offset + received) - wymaga odpowiedzi 206
+static esp_err_t open_range(ota_segment_t *seg, esp_http_client_handle_t *out)
+{
+    char connect_url[512];
+    char host[64];
+    char authority[72];
+    bool host_override = rk_ota_dns_rewrite_url(seg->url, connect_url, sizeof(connect_url),
+                                                host, sizeof(host),
+                                                authority, sizeof(authority));
+    
+    esp_http_client_config_t http_config = {
+        .url = connect_url,
+        .common_name = host,
+        .disable_auto_redirect = true,
+        .timeout_ms = SEGMENT_TIMEOUT_MS,
+    };
+    rk_ota_trust_apply(&http_config, seg->use_bundle);
+    
+    esp_http_client_handle_t client = rk_ota_http_init(&http_config);
+    if (client == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    
+    uint32_t from = seg->offset + seg->received;
+    uint32_t to = seg->offset + seg->length - 1;
+    char range[48];
+    snprintf(range, sizeof(range), "bytes=%lu-%lu", (unsigned long)from, (unsigned long)to);
+    rk_ota_set_request_headers(client, authority, host_override, seg->use_token);
+    esp_http_client_set_header(client, "Range", range);
+    
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Segment %s: brak połączenia (%s)", range, esp_err_to_name(err));
+        rk_ota_http_cleanup(client);
+        if (host_override) {
+            rk_ota_dns_evict(host);
+        }
+        return err;
+    }
+    
+    int64_t length = esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    if (status != 206 || length != (int64_t)(to - from + 1)) {
+        ESP_LOGE(TAG, "Segment %s: HTTP %d, długość %lld", range, status, length);
+        esp_http_client_close(client);
+        rk_ota_http_cleanup(client);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    
+    *out = client;
+    return ESP_OK;
+}
+
+// Zapis pod przesunięcie segmentu; sektory kasowane przed pierwszym zapisem,
+// chyba że kasowanie w tle zostawiło je czyste
+static esp_err_t write_segment(ota_segment_t *seg, const uint8_t *data, size_t len)
+{
+    uint32_t pos = seg->offset + seg->received;
+    
+    while (seg->erased_end < pos + len) {
+        if (!rk_ota_preerase_is_clean(seg->partition, seg->erased_end)) {
+            esp_err_t err = esp_partition_erase_range(seg->partition, seg->erased_end,
+                                                      SPI_FLASH_SEC_SIZE);
+            if (err != ESP_OK) {
+                return err;
+            }
+        }
+        seg->erased_end += SPI_FLASH_SEC_SIZE;
+    }
+    
+    return esp_partition_write(seg->partition, pos, data, len);
+}
+
+static esp_err_t read_segment(esp_http_client_handle_t client, ota_segment_t *seg,
+                              uint8_t *buffer, size_t buffer_len, int total)
+{
+    while (seg->received < seg->length) {
+        if (rk_ota_cancel_requested()) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        
+        size_t want = seg->length - seg->received;
+        if (want > buffer_len) {
+            want = buffer_len;
+        }
+        
+        int len = esp_http_client_read(client, (char *)buffer, want);
+        if (len < 0) {
+            return ESP_FAIL;
+        }
+        if (len == 0) {
+            return ESP_ERR_TIMEOUT;     // Połączenie zamknięte przed końcem segmentu
+        }
+        
+        esp_err_t err = write_segment(seg, buffer, len);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Zapis segmentu nie powiódł się: %s", esp_err_to_name(err));
+            return err;
+        }
+        seg->received += len;
+        
+        // Postęp raportuje tylko zadanie OTA (total > 0)
+        if (total > 0) {
+            rk_ota_set_progress(RK_OTA_STATE_DOWNLOADING, segments_received(), total);
+        }
+    }
+    return ESP_OK;
+}
+
+// Pobranie segmentu przez nowe połączenie (zadanie pomocnicze lub ponowienie)
+static esp_err_t fetch_segment(ota_segment_t *seg, uint8_t *buffer, size_t buffer_len, int total)
+{
+    esp_http_client_handle_t client = NULL;
+    esp_err_t err = open_range(seg, &client);
+    if (err != ESP_OK) {
+        return err;
+    }
+    
+    err = read_segment(client, seg, buffer, buffer_len, total);
+    esp_http_client_close(client);
+    rk_ota_http_cleanup(client);
+    return err;
+}
+
+// Zadanie krótkotrwałe - stos i bufor na stercie, zwalniane po segmencie
+static void segment_task(void *pvParameters)
+{
+    ota_segment_t *seg = (ota_segment_t *)pvParameters;
+    
+    uint8_t *buffer = rk_mem_alloc(RK_OTA_BUFFER_SIZE, RK_MEM_BULK);
+    seg->result = buffer != NULL ? fetch_segment(seg, buffer, RK_OTA_BUFFER_SIZE, 0) : ESP_ERR_NO_MEM;
+    rk_mem_free(buffer);
+    
+    xTaskNotifyGive(seg->parent);
+    rk_task_delete(NULL);
+}
+
+esp_err_t rk_ota_segments_download(esp_http_client_handle_t first_client, const char *url,
+                                   bool use_bundle, bool use_token,
+                                   const esp_partition_t *partition, int content_length,
+                                   int connections, uint8_t *buffer, size_t buffer_len,
+                                   int *received)
+{
+    uint32_t segment_len = ((uint32_t)content_length + connections - 1) / connections;
+    segment_len = (segment_len + SEGMENT_ALIGN - 1) & ~(uint32_t)(SEGMENT_ALIGN - 1);
+    
+    s_segment_count = 0;
+    for (int i = 0; i < connections && (uint32_t)i * segment_len < (uint32_t)content_length; i++) {
+        ota_segment_t *seg = &s_segments[i];
+        memset(seg, 0, sizeof(*seg));
+        seg->url = url;
+        seg->use_bundle = use_bundle;
+        seg->use_token = use_token;
+        seg->partition = partition;
+        seg->offset = i * segment_len;
+        seg->erased_end = seg->offset;
+        seg->length = content_length - seg->offset < segment_len ?
+                      content_length - seg->offset : segment_len;
+        seg->result = ESP_FAIL;
+        seg->parent = xTaskGetCurrentTaskHandle();
+        s_segment_count++;
+    }
+    
+    // Segmenty 1..N-1 w zadaniach pomocniczych o priorytecie zadania OTA
+    int pending = 0;
+    UBaseType_t priority = uxTaskPriorityGet(NULL);
+    for (int i = 1; i < s_segment_count; i++) {
+        s_segments[i].started = rk_task_create(segment_task, "ota_seg", SEGMENT_TASK_STACK,
+                                               &s_segments[i], priority, NULL,
+                                               NULL, NULL) == pdPASS;
+        if (s_segments[i].started) {
+            pending++;
+        }
+    }
+    ESP_LOGI(TAG, "Pobieranie %d segmentami po %lu B (zadań pomocniczych: %d)",
+             s_segment_count, (unsigned long)segment_len, pending);
+    
+    // Segment 0 z już otwartej odpowiedzi 200 - bez dodatkowego uzgadniania TLS
+    esp_err_t err = read_segment(first_client, &s_segments[0], buffer, buffer_len, content_length);
+    s_segments[0].result = err;
+    
+    while (pending > 0) {
+        if (ulTaskNotifyTake(pdFALSE, pdMS_TO_TICKS(SEGMENT_PROGRESS_MS)) > 0) {
+            pending--;
+        }
+        rk_ota_set_progress(RK_OTA_STATE_DOWNLOADING, segments_received(), content_length);
+    }
+    
+    // Segmenty nieuruchomione lub przerwane - dokończenie od miejsca przerwania
+    for (int i = 0; i < s_segment_count && !rk_ota_cancel_requested(); i++) {
+        ota_segment_t *seg = &s_segments[i];
+        if (seg->received == seg->length) {
+            seg->result = ESP_OK;
+            continue;
+        }
+        ESP_LOGW(TAG, "Segment %d: %lu/%lu B (%s) - ponawiam", i,
+                 (unsigned long)seg->received, (unsigned long)seg->length,
+                 esp_err_to_name(seg->result));
+        rk_ota_stats.download_segment_retries++;
+        seg->result = fetch_segment(seg, buffer, buffer_len, content_length);
+    }
+    
+    err = ESP_OK;
+    for (int i = 0; i < s_segment_count; i++) {
+        if (s_segments[i].result != ESP_OK) {
+            err = rk_ota_cancel_requested() ? ESP_ERR_INVALID_STATE : s_segments[i].result;
+            break;
+        }
+    }
+    
+    *received = (int)segments_received();
+    return err;
+}
@@ -0,0 +1,223 @@
+#include "rk_ota.h"
+#include "rk_ota_priv.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/sha256.h"
+#include <string.h>
+
+// Podpis obrazu z lokalnego mirrora: ECDSA P-256 (DER) nad SHA-256 całego pliku,
+// w osobnym pliku <url obrazu>.sig. Integralność daje podpis, nie TLS - dlatego
+// mirror może działać po zwykłym http:// bez kosztu uzgadniania i deszyfrowania.
+// Podpis nie chroni przed powtórką starszego, poprawnie podpisanego obrazu - dlatego
+// wersja z esp_app_desc_t (objęta podpisem) musi być nowsza od działającej.
+
+static const char *TAG = "RK_OTA_SIGN";
+
+// Klucz publiczny (certs/rk_ota_sign_pub.pem, EMBED_TXTFILES - zakończony '\0')
+extern const char rk_ota_sign_pub_pem_start[] asm("_binary_rk_ota_sign_pub_pem_start");
+extern const char rk_ota_sign_pub_pem_end[] asm("_binary_rk_ota_sign_pub_pem_end");
+
+// Opis aplikacji leży za nagłówkiem obrazu i nagłówkiem pierwszego segmentu
+#define APP_DESC_OFFSET (sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t))
+
+// Podpis ECDSA P-256 w DER ma najwyżej 72 bajty
+#define SIG_MAX_LEN 72
+#define SIG_URL_LEN 520
+
+static mbedtls_pk_context s_pub_key;
+static bool s_key_checked = false;
+static bool s_key_ok = false;
+
+// Stan bieżącego pobrania - używane tylko przez zadanie OTA
+static mbedtls_sha256_context s_sha;
+static bool s_sha_active = false;
+static uint8_t s_sig[SIG_MAX_LEN];
+static size_t s_sig_len = 0;
+
+bool rk_ota_sign_available(void)
+{
+    if (s_key_checked) {
+        return s_key_ok;
+    }
+    s_key_checked = true;
+    
+    mbedtls_pk_init(&s_pub_key);
+    int ret = mbedtls_pk_parse_public_key(&s_pub_key, (const unsigned char *)rk_ota_sign_pub_pem_start,
+                                          rk_ota_sign_pub_pem_end - rk_ota_sign_pub_pem_start);
+    if (ret != 0 || !mbedtls_pk_can_do(&s_pub_key, MBEDTLS_PK_ECDSA)) {
+        ESP_LOGW(TAG, "Brak klucza publicznego ECDSA (-0x%x) - mirror wyłączony", -ret);
+        mbedtls_pk_free(&s_pub_key);
+        return false;
+    }
+    
+    s_key_ok = true;
+    return true;
+}
+
+esp_err_t rk_ota_sign_fetch(const char *image_url)
+{
+    char url[SIG_URL_LEN];
+    int n = snprintf(url, sizeof(url), "%s.sig", image_url);
+    if (n <= 0 || (size_t)n >= sizeof(url)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    esp_http_client_config_t http_config = {
+        .url = url,
+        .timeout_ms = 10000,
+    };
+    esp_http_client_handle_t client = rk_ota_http_init(&http_config);
+    if (client == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_http_client_set_header(client, "User-Agent", "ESP32-OTA-Client/1.0");
+    
+    s_sig_len = 0;
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err == ESP_OK) {
+        int64_t length = esp_http_client_fetch_headers(client);
+        int status = esp_http_client_get_status_code(client);
+        if (status != 200 || length <= 0 || length > SIG_MAX_LEN) {
+            ESP_LOGW(TAG, "Podpis %s: HTTP %d, długość %lld", url, status, length);
+            err = status == 404 ? ESP_ERR_NOT_FOUND : ESP_ERR_INVALID_RESPONSE;
+        } else {
+            while (s_sig_len < (size_t)length) {
+                int len = esp_http_client_read(client, (char *)s_sig + s_sig_len, length - s_sig_len);
+                if (len <= 0) {
+                    err = ESP_ERR_TIMEOUT;
+                    break;
+                }
+                s_sig_len += len;
+            }
+        }
+        esp_http_client_close(client);
+    }
+    rk_ota_http_cleanup(client);
+    
+    if (err != ESP_OK) {
+        s_sig_len = 0;
+    }
+    return err;
+}
+
+void rk_ota_sign_begin(void)
+{
+    mbedtls_sha256_init(&s_sha);
+    mbedtls_sha256_starts(&s_sha, 0);
+    s_sha_active = true;
+}
+
+void rk_ota_sign_update(const uint8_t *data, size_t len)
+{
+    if (s_sha_active) {
+        mbedtls_sha256_update(&s_sha, data, len);
+    }
+}
+
+void rk_ota_sign_abort(void)
+{
+    if (s_sha_active) {
+        mbedtls_sha256_free(&s_sha);
+        s_sha_active = false;
+    }
+}
+
+// Koniec liczby w wersji: kropka, przyrostek ("-dirty", "+build") albo koniec napisu
+static bool version_part_end(char c)
+{
+    return c == '\0' || c == '.' || c == '-' || c == '+' || c == ' ';
+}
+
+// Porównanie wersji "1.2.3" (opcjonalne "v", przyrostek po liczbach pomijany).
+// false gdy któraś wersja nie jest liczbowa (np. skrót commita z git describe) -
+// nowszej nie da się wtedy wykazać.
+static bool version_newer(const char *candidate, const char *running)
+{
+    const char *a = candidate + (candidate[0] == 'v' || candidate[0] == 'V');
+    const char *b = running + (running[0] == 'v' || running[0] == 'V');
+    if (*a < '0' || *a > '9' || *b < '0' || *b > '9') {
+        return false;
+    }
+    
+    while (true) {
+        uint32_t x = 0;
+        uint32_t y = 0;
+        while (*a >= '0' && *a <= '9') {
+            x = x * 10 + (*a++ - '0');
+        }
+        while (*b >= '0' && *b <= '9') {
+            y = y * 10 + (*b++ - '0');
+        }
+        if (!version_part_end(*a) || !version_part_end(*b)) {
+            return false;
+        }
+        if (x != y) {
+            return x > y;
+        }
+        
+        bool more_a = a[0] == '.' && a[1] >= '0' && a[1] <= '9';
+        bool more_b = b[0] == '.' && b[1] >= '0' && b[1] <= '9';
+        if (!more_a || !more_b) {
+            return more_a;      // 1.2.1 > 1.2, równe - nie nowsza
+        }
+        a++;
+        b++;
+    }
+}
+
+esp_err_t rk_ota_sign_check_version(const uint8_t *header, size_t len)
+{
+    if (len < RK_OTA_IMAGE_HEADER_LEN) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    
+    esp_app_desc_t desc;
+    memcpy(&desc, header + APP_DESC_OFFSET, sizeof(desc));
+    if (desc.magic_word != ESP_APP_DESC_MAGIC_WORD) {
+        ESP_LOGE(TAG, "Obraz bez opisu aplikacji");
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    desc.version[sizeof(desc.version) - 1] = '\0';
+    
+    const esp_app_desc_t *running = esp_app_get_description();
+    if (desc.secure_version < running->secure_version ||
+        !version_newer(desc.version, running->version)) {
+        ESP_LOGW(TAG, "Obraz %s (secure %lu) nie jest nowszy od %s (secure %lu) - odrzucony",
+                 desc.version, desc.secure_version, running->version, running->secure_version);
+        rk_ota_stats.mirror_version_rejects++;
+        return ESP_ERR_INVALID_VERSION;
+    }
+    return ESP_OK;
+}
+
+esp_err_t rk_ota_sign_verify(uint32_t *verify_ms)
+{
+    if (!s_sha_active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    uint8_t digest[32];
+    mbedtls_sha256_finish(&s_sha, digest);
+    rk_ota_sign_abort();
+    
+    if (!s_key_ok || s_sig_len == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    int64_t start_us = esp_timer_get_time();
+    int ret = mbedtls_pk_verify(&s_pub_key, MBEDTLS_MD_SHA256, digest, sizeof(digest),
+                                s_sig, s_sig_len);
+    if (verify_ms != NULL) {
+        *verify_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    }
+    
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Podpis obrazu niepoprawny (-0x%x)", -ret);
+        rk_ota_stats.signature_failures++;
+        return ESP_ERR_OTA_VALIDATE_FAILED;
+    }
+    
+    ESP_LOGI(TAG, "Podpis obrazu poprawny");
+    return ESP_OK;
+}
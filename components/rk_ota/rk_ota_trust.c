@@ -0,0 +1,60 @@
+#include "rk_ota.h"
+#include "rk_ota_priv.h"
+#include "esp_log.h"
+#include "esp_crt_bundle.h"
+
+static const char *TAG = "RK_OTA_TRUST";
+
+// Wbudowany zestaw CA (certs/rk_ota_trust.pem, EMBED_TXTFILES)
+extern const char rk_ota_trust_pem_start[] asm("_binary_rk_ota_trust_pem_start");
+
+static rk_ota_trust_mode_t s_trust_mode = RK_OTA_TRUST_MODE;
+static uint64_t s_handshake_total_ms[2] = {0};
+
+void rk_ota_set_trust_mode(rk_ota_trust_mode_t mode)
+{
+    ESP_LOGI(TAG, "Tryb zaufania TLS: %d", mode);
+    s_trust_mode = mode;
+}
+
+rk_ota_trust_mode_t rk_ota_get_trust_mode(void)
+{
+    return s_trust_mode;
+}
+
+bool rk_ota_trust_starts_with_bundle(void)
+{
+    return s_trust_mode == RK_OTA_TRUST_BUNDLE;
+}
+
+bool rk_ota_trust_can_fall_back(bool use_bundle)
+{
+    return !use_bundle && s_trust_mode == RK_OTA_TRUST_PINNED_FALLBACK;
+}
+
+void rk_ota_trust_apply(esp_http_client_config_t *http_config, bool use_bundle)
+{
+    // Weryfikacja nazwy hosta zawsze włączona
+    http_config->skip_cert_common_name_check = false;
+    
+    if (use_bundle) {
+        http_config->cert_pem = NULL;
+        http_config->crt_bundle_attach = esp_crt_bundle_attach;
+    } else {
+        http_config->cert_pem = rk_ota_trust_pem_start;
+        http_config->crt_bundle_attach = NULL;
+    }
+}
+
+void rk_ota_trust_record(bool use_bundle, uint32_t handshake_ms, uint32_t heap_bytes)
+{
+    rk_ota_tls_stats_t *tls = use_bundle ? &rk_ota_stats.tls_bundle : &rk_ota_stats.tls_pinned;
+    
+    s_handshake_total_ms[use_bundle ? 1 : 0] += handshake_ms;
+    tls->handshakes++;
+    tls->handshake_last_ms = handshake_ms;
+    tls->handshake_avg_ms = (uint32_t)(s_handshake_total_ms[use_bundle ? 1 : 0] / tls->handshakes);
+    if (heap_bytes > tls->heap_peak_bytes) {
+        tls->heap_peak_bytes = heap_bytes;
+    }
+}
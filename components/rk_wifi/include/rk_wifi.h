@@ -7,11 +7,23 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "freertos/event_groups.h"
+#include "rk_common.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Szybkie łączenie po uśpieniu: BSSID, kanał i adres IP z poprzedniego połączenia
+// zachowane w pamięci RTC (bez skanowania i DHCP). 0 - zawsze pełne łączenie.
+#ifndef RK_WIFI_FAST_CONNECT
+#define RK_WIFI_FAST_CONNECT 1
+#endif
+
+// Najdłuższy czas ponownego użycia adresu IP bez DHCP (dzierżawa mogła wygasnąć)
+#ifndef RK_WIFI_IP_REUSE_MAX_S
+#define RK_WIFI_IP_REUSE_MAX_S 3600
+#endif
+
 // Event bits
 #define RK_WIFI_CONNECTED_BIT BIT0
 #define RK_WIFI_FAIL_BIT      BIT1
@@ -24,15 +36,30 @@ typedef enum {
     RK_WIFI_MSG_STOP
 } rk_wifi_message_type_t;
 
+// Wiadomość niesie tylko typ - dane logowania zapisuje raz rk_wifi_connect
 typedef struct {
     rk_wifi_message_type_t type;
-    char ssid[32];
-    char password[64];
 } rk_wifi_message_t;
 
-// Callback dla zdarzeń WiFi
+// Callback dla zdarzeń WiFi (wywoływany z zadania WiFi, nie z pętli zdarzeń systemu)
 typedef void (*rk_wifi_event_callback_t)(bool connected);
 
+// Statystyki obsługi zdarzeń systemowych WiFi/IP
+typedef struct {
+    uint32_t handler_calls;            // Liczba wywołań event handlera
+    uint32_t handler_last_us;          // Czas ostatniej obsługi w pętli zdarzeń
+    uint32_t handler_max_us;           // Najdłuższa obsługa w pętli zdarzeń
+    uint32_t handler_avg_us;           // Średni czas obsługi
+    uint32_t notifications_posted;     // Powiadomienia wysłane do zadania WiFi
+    uint32_t notifications_coalesced;  // Powiadomienia scalone (nieodebrany poprzedni stan)
+    uint32_t notifications_dropped;    // Powiadomienia odrzucone (brak zadania WiFi)
+    uint32_t callback_max_us;          // Najdłuższe wywołanie callbacku w zadaniu WiFi
+    uint32_t connect_last_ms;          // Od RK_WIFI_MSG_CONNECT do adresu IP (ostatnie)
+    bool fast_connect_last;            // Ostatnie połączenie przez dane z pamięci RTC
+    uint32_t fast_connects;            // Udane szybkie połączenia (od zimnego startu)
+    uint32_t fast_connect_fallbacks;   // Szybkie połączenia zastąpione pełnym łączeniem
+} rk_wifi_event_stats_t;
+
 /**
  * @brief Inicjalizacja komponentu WiFi
  * @return ESP_OK w przypadku sukcesu
@@ -42,9 +69,10 @@ esp_err_t rk_wifi_init(void);
 /**
  * @brief Uruchomienie zadania WiFi
  * @param callback Funkcja callback dla zdarzeń WiFi
+ * @param config Rdzeń, priorytet i stos zadania (NULL - bez przypięcia, priorytet 4)
  * @return ESP_OK w przypadku sukcesu
  */
-esp_err_t rk_wifi_start_task(rk_wifi_event_callback_t callback);
+esp_err_t rk_wifi_start_task(rk_wifi_event_callback_t callback, const rk_task_config_t *config);
 
 /**
  * @brief Połączenie z siecią WiFi
@@ -72,6 +100,18 @@ bool rk_wifi_is_connected(void);
  */
 EventGroupHandle_t rk_wifi_get_event_group(void);
 
+/**
+ * @brief Pobranie statystyk obsługi zdarzeń WiFi
+ * @param stats Struktura do wypełnienia
+ */
+void rk_wifi_get_event_stats(rk_wifi_event_stats_t *stats);
+
+/**
+ * @brief Rozłączenie i zatrzymanie radia przed uśpieniem (dane szybkiego łączenia zostają w RTC)
+ * @return ESP_OK w przypadku sukcesu
+ */
+esp_err_t rk_wifi_prepare_sleep(void);
+
 /**
  * @brief Zatrzymanie zadania WiFi
  */
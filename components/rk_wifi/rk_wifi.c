@@ -1,13 +1,30 @@
 #include "rk_wifi.h"
+#include "rk_common.h"
+#include "rk_metrics.h"
+#include "rk_log.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
 #include <string.h>
+#include <time.h>
 
 static const char *TAG = "RK_WIFI";
 
 #define WIFI_MAXIMUM_RETRY 5
+#define WIFI_TASK_STACK    6144
+#define WIFI_QUEUE_LEN     5
+
+// Bity powiadomień zadania WiFi (xTaskNotify, eSetBits)
+#define WIFI_NOTIFY_MSG   BIT0  // W kolejce czeka wiadomość
+#define WIFI_NOTIFY_STATE BIT1  // Zmiana stanu połączenia do przekazania do callbacku
+
+// Bufory statyczne (RK_STATIC_ALLOC)
+RK_TASK_BUFFER(wifi_task, WIFI_TASK_STACK);
+RK_QUEUE_BUFFER(wifi_queue, WIFI_QUEUE_LEN, sizeof(rk_wifi_message_t));
+RK_EVENT_GROUP_BUFFER(wifi_event_group);
 
 // Zmienne globalne
 static EventGroupHandle_t s_wifi_event_group = NULL;
@@ -16,19 +33,158 @@ static TaskHandle_t wifi_task_handle = NULL;
 static int s_retry_num = 0;
 static bool s_wifi_connected = false;
 static bool s_wifi_initialized = false;
+static bool s_wifi_started = false;
 static bool task_running = false;
+static TaskHandle_t s_stop_waiter = NULL;  // Czeka w rk_wifi_stop_task na koniec zadania
 static rk_wifi_event_callback_t event_callback = NULL;
+static esp_netif_t *s_sta_netif = NULL;
+
+#define WIFI_FAST_MAGIC 0x52574631  // "RWF1"
+
+// Dane szybkiego łączenia - przetrwają uśpienie głębokie (RTC), nie reset zasilania
+typedef struct {
+    uint32_t magic;
+    char ssid[32];
+    uint8_t bssid[6];
+    uint8_t channel;
+    esp_netif_ip_info_t ip_info;
+    esp_ip4_addr_t dns;
+    time_t ip_time;                 // Czas uzyskania adresu (zegar RTC, ciągły przez uśpienie)
+    bool ip_reuse;                  // Ustawiane przed uśpieniem - po restarcie zawsze DHCP
+    uint32_t fast_connects;
+    uint32_t fast_connect_fallbacks;
+} wifi_fast_state_t;
+
+static RTC_DATA_ATTR wifi_fast_state_t s_fast;
+static bool s_fast_attempt = false;         // Bieżące łączenie używa danych z RTC
+static bool s_static_ip = false;            // DHCP wyłączone na rzecz adresu z RTC
+static volatile bool s_sleep_pending = false;   // Rozłączenie przed uśpieniem - bez ponawiania
+static int64_t s_connect_start_us = 0;
+
+// Dane logowania zarejestrowane przez rk_wifi_connect - nie przechodzą przez kolejkę
+static char s_ssid[32];
+static char s_password[64];
+static portMUX_TYPE s_credentials_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Ostatni stan zgłoszony przez event handler - najnowszy wygrywa
+static volatile bool s_pending_state = false;
+static rk_wifi_event_stats_t s_event_stats = {0};
+static uint64_t s_handler_total_us = 0;
+
+// Metryki (rk_metrics)
+static const uint32_t s_handler_us_bounds[] = {50, 100, 250, 500, 1000, 5000};
+static rk_metric_t *s_metric_handler_us = NULL;
+static rk_metric_t *s_metric_disconnects = NULL;
 
 // Deklaracja funkcji zadania
 static void wifi_task(void *pvParameters);
 
+// Przekazanie stanu do zadania WiFi bez blokowania pętli zdarzeń.
+// Jeśli poprzednie powiadomienie nie zostało jeszcze odebrane, stany się scalają.
+static void notify_state(bool connected)
+{
+    s_pending_state = connected;
+    
+    if (wifi_task_handle == NULL) {
+        s_event_stats.notifications_dropped++;
+        return;
+    }
+    
+    uint32_t previous = 0;
+    xTaskNotifyAndQuery(wifi_task_handle, WIFI_NOTIFY_STATE, eSetBits, &previous);
+    s_event_stats.notifications_posted++;
+    if (previous & WIFI_NOTIFY_STATE) {
+        s_event_stats.notifications_coalesced++;
+    }
+}
+
+// Zapis danych do szybkiego łączenia po uzyskaniu adresu
+static void save_fast_state(const esp_netif_ip_info_t *ip_info)
+{
+    s_event_stats.connect_last_ms = (uint32_t)((esp_timer_get_time() - s_connect_start_us) / 1000);
+    s_event_stats.fast_connect_last = s_fast_attempt;
+    if (s_fast_attempt) {
+        s_fast.fast_connects++;
+        s_fast_attempt = false;
+        return;     // Adres z RTC - czas dzierżawy liczony od ostatniego DHCP
+    }
+    
+#if RK_WIFI_FAST_CONNECT
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+    
+    esp_netif_dns_info_t dns = {0};
+    esp_netif_get_dns_info(s_sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+    
+    portENTER_CRITICAL(&s_credentials_lock);
+    memcpy(s_fast.ssid, s_ssid, sizeof(s_fast.ssid));
+    portEXIT_CRITICAL(&s_credentials_lock);
+    memcpy(s_fast.bssid, ap.bssid, sizeof(s_fast.bssid));
+    s_fast.channel = ap.primary;
+    s_fast.ip_info = *ip_info;
+    s_fast.dns = dns.ip.u_addr.ip4;
+    s_fast.ip_time = time(NULL);
+    s_fast.magic = WIFI_FAST_MAGIC;
+#endif
+}
+
+// Szybkie łączenie: znany AP i kanał (bez skanowania), adres bez DHCP jeśli dzierżawa świeża
+static bool apply_fast_state(wifi_config_t *wifi_config)
+{
+#if RK_WIFI_FAST_CONNECT
+    if (s_fast.magic != WIFI_FAST_MAGIC ||
+        strncmp(s_fast.ssid, (const char *)wifi_config->sta.ssid, sizeof(s_fast.ssid)) != 0) {
+        return false;
+    }
+    
+    wifi_config->sta.bssid_set = true;
+    memcpy(wifi_config->sta.bssid, s_fast.bssid, sizeof(s_fast.bssid));
+    wifi_config->sta.channel = s_fast.channel;
+    
+    // Adres bez DHCP tylko w cyklu uśpienia - urządzenie działające stale odnawia dzierżawę
+    time_t age = time(NULL) - s_fast.ip_time;
+    bool ip_reuse = s_fast.ip_reuse;
+    s_fast.ip_reuse = false;
+    if (ip_reuse && age >= 0 && age < RK_WIFI_IP_REUSE_MAX_S && s_sta_netif != NULL &&
+        esp_netif_dhcpc_stop(s_sta_netif) == ESP_OK) {
+        esp_netif_set_ip_info(s_sta_netif, &s_fast.ip_info);
+        esp_netif_dns_info_t dns = {0};
+        dns.ip.u_addr.ip4 = s_fast.dns;
+        esp_netif_set_dns_info(s_sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+        s_static_ip = true;
+    }
+    return true;
+#else
+    (void)wifi_config;
+    return false;
+#endif
+}
+
 static void event_handler(void* arg, esp_event_base_t event_base,
                          int32_t event_id, void* event_data)
 {
+    int64_t start_us = esp_timer_get_time();
+    
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         ESP_LOGI(TAG, "WiFi STA uruchomione");
+        // Łączymy od razu po starcie STA - bez stałych opóźnień
+        esp_wifi_connect();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < WIFI_MAXIMUM_RETRY) {
+        rk_metrics_inc(s_metric_disconnects);
+        if (s_sleep_pending) {
+            // Rozłączenie przed uśpieniem - bez ponawiania
+        } else if (s_fast_attempt) {
+            // AP zmienił kanał lub BSSID - pełne łączenie w zadaniu WiFi
+            s_fast_attempt = false;
+            s_fast.magic = 0;
+            s_fast.fast_connect_fallbacks++;
+            rk_wifi_message_t retry = {.type = RK_WIFI_MSG_CONNECT};
+            if (wifi_queue != NULL && xQueueSend(wifi_queue, &retry, 0) == pdTRUE) {
+                xTaskNotify(wifi_task_handle, WIFI_NOTIFY_MSG, eSetBits);
+            }
+        } else if (s_retry_num < WIFI_MAXIMUM_RETRY) {
             esp_wifi_connect();
             s_retry_num++;
             ESP_LOGI(TAG, "Ponowna próba połączenia z AP, próba %d", s_retry_num);
@@ -36,20 +192,43 @@ static void event_handler(void* arg, esp_event_base_t event_base,
             xEventGroupSetBits(s_wifi_event_group, RK_WIFI_FAIL_BIT);
         }
         s_wifi_connected = false;
-        if (event_callback) {
-            event_callback(false);
-        }
+        notify_state(false);
         ESP_LOGI(TAG, "Nie udało się połączyć z AP");
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "Otrzymano IP:" IPSTR, IP2STR(&event->ip_info.ip));
+        save_fast_state(&event->ip_info);
         s_retry_num = 0;
         s_wifi_connected = true;
-        if (event_callback) {
-            event_callback(true);
-        }
+        notify_state(true);
         xEventGroupSetBits(s_wifi_event_group, RK_WIFI_CONNECTED_BIT);
     }
+    
+    // Pomiar czasu obsługi zdarzenia w zadaniu pętli zdarzeń
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+    s_handler_total_us += elapsed_us;
+    s_event_stats.handler_calls++;
+    s_event_stats.handler_last_us = elapsed_us;
+    if (elapsed_us > s_event_stats.handler_max_us) {
+        s_event_stats.handler_max_us = elapsed_us;
+    }
+    rk_metrics_observe(s_metric_handler_us, elapsed_us);
+}
+
+// Wywołanie callbacku z kontekstu zadania WiFi - może blokować bez wpływu na pętlę zdarzeń
+static void deliver_state(void)
+{
+    if (event_callback == NULL) {
+        return;
+    }
+    
+    int64_t start_us = esp_timer_get_time();
+    event_callback(s_pending_state);
+    
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+    if (elapsed_us > s_event_stats.callback_max_us) {
+        s_event_stats.callback_max_us = elapsed_us;
+    }
 }
 
 static void wifi_task(void *pvParameters)
@@ -59,32 +238,52 @@ static void wifi_task(void *pvParameters)
     rk_wifi_message_t msg;
     
     while(task_running) {
-        if(xQueueReceive(wifi_queue, &msg, pdMS_TO_TICKS(1000)) == pdTRUE) {
-            ESP_LOGI(TAG, "Otrzymano wiadomość WiFi typu: %d", msg.type);
+        uint32_t notified = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &notified, pdMS_TO_TICKS(1000));
+        
+        if (notified & WIFI_NOTIFY_STATE) {
+            deliver_state();
+        }
+        
+        while(task_running && xQueueReceive(wifi_queue, &msg, 0) == pdTRUE) {
+            RK_LOGI(WIFI, WIFI_MSG, msg.type);
             
             switch(msg.type) {
                 case RK_WIFI_MSG_CONNECT:
-                    ESP_LOGI(TAG, "Łączenie z WiFi: %s", msg.ssid);
-                    
-                    esp_wifi_stop();
-                    vTaskDelay(pdMS_TO_TICKS(100));
+                    if (s_wifi_started) {
+                        esp_wifi_stop();
+                        s_wifi_started = false;
+                    }
                     
                     wifi_config_t wifi_config = {0};
                     wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
                     wifi_config.sta.pmf_cfg.capable = true;
                     wifi_config.sta.pmf_cfg.required = false;
                     
-                    strncpy((char*)wifi_config.sta.ssid, msg.ssid, sizeof(wifi_config.sta.ssid) - 1);
-                    strncpy((char*)wifi_config.sta.password, msg.password, sizeof(wifi_config.sta.password) - 1);
+                    portENTER_CRITICAL(&s_credentials_lock);
+                    memcpy(wifi_config.sta.ssid, s_ssid, sizeof(s_ssid));
+                    memcpy(wifi_config.sta.password, s_password, sizeof(s_password));
+                    portEXIT_CRITICAL(&s_credentials_lock);
+                    
+                    // Adres z poprzedniej próby szybkiej - wracamy do DHCP
+                    if (s_static_ip) {
+                        esp_netif_dhcpc_start(s_sta_netif);
+                        s_static_ip = false;
+                    }
+                    s_sleep_pending = false;
+                    s_connect_start_us = esp_timer_get_time();
+                    s_fast_attempt = apply_fast_state(&wifi_config);
+                    
+                    ESP_LOGI(TAG, "Łączenie z WiFi: %.32s%s", (char*)wifi_config.sta.ssid,
+                             s_fast_attempt ? " (szybkie, dane z RTC)" : "");
                     
                     xEventGroupClearBits(s_wifi_event_group, RK_WIFI_CONNECTED_BIT | RK_WIFI_FAIL_BIT);
                     s_retry_num = 0;
                     
                     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+                    // esp_wifi_connect() wywoła event handler po WIFI_EVENT_STA_START
                     ESP_ERROR_CHECK(esp_wifi_start());
-                    
-                    vTaskDelay(pdMS_TO_TICKS(100));
-                    ESP_ERROR_CHECK(esp_wifi_connect());
+                    s_wifi_started = true;
                     break;
                     
                 case RK_WIFI_MSG_DISCONNECT:
@@ -119,7 +318,8 @@ static void wifi_task(void *pvParameters)
     }
     
     ESP_LOGI(TAG, "Zadanie WiFi zakończone");
-    vTaskDelete(NULL);
+    rk_join_signal(s_stop_waiter);
+    rk_task_delete(NULL);
 }
 
 esp_err_t rk_wifi_init(void)
@@ -129,7 +329,11 @@ esp_err_t rk_wifi_init(void)
         return ESP_OK;
     }
 
-    s_wifi_event_group = xEventGroupCreate();
+    s_metric_handler_us = rk_metrics_histogram("wifi.handler_us", s_handler_us_bounds,
+                                               sizeof(s_handler_us_bounds) / sizeof(s_handler_us_bounds[0]));
+    s_metric_disconnects = rk_metrics_counter("wifi.disconnects");
+    
+    s_wifi_event_group = rk_event_group_create(RK_EVENT_GROUP_STATIC(wifi_event_group));
     if (s_wifi_event_group == NULL) {
         ESP_LOGE(TAG, "Nie można utworzyć Event Group");
         return ESP_ERR_NO_MEM;
@@ -137,7 +341,7 @@ esp_err_t rk_wifi_init(void)
 
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    s_sta_netif = esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -162,8 +366,23 @@ esp_err_t rk_wifi_init(void)
     return ESP_OK;
 }
 
-esp_err_t rk_wifi_start_task(rk_wifi_event_callback_t callback)
+// Krok wyłączenia: najpierw zadanie (zdarzenia rozłączenia trafiają już w pustkę), potem radio
+static void wifi_shutdown(void)
 {
+    rk_wifi_stop_task();
+    if (s_wifi_started) {
+        rk_wifi_prepare_sleep();
+    }
+}
+
+esp_err_t rk_wifi_start_task(rk_wifi_event_callback_t callback, const rk_task_config_t *config)
+{
+    static const rk_task_config_t defaults = {
+        .core = RK_TASK_CORE_ANY,
+        .priority = 4,
+        .stack_bytes = WIFI_TASK_STACK,
+    };
+    
     if (task_running) {
         ESP_LOGW(TAG, "Zadanie WiFi już działa");
         return ESP_OK;
@@ -171,7 +390,7 @@ esp_err_t rk_wifi_start_task(rk_wifi_event_callback_t callback)
     
     event_callback = callback;
     
-    wifi_queue = xQueueCreate(5, sizeof(rk_wifi_message_t));
+    wifi_queue = rk_queue_create(WIFI_QUEUE_LEN, sizeof(rk_wifi_message_t), RK_QUEUE_STATIC(wifi_queue));
     if (wifi_queue == NULL) {
         ESP_LOGE(TAG, "Nie można utworzyć kolejki WiFi");
         return ESP_ERR_NO_MEM;
@@ -179,22 +398,19 @@ esp_err_t rk_wifi_start_task(rk_wifi_event_callback_t callback)
     
     task_running = true;
     
-    BaseType_t ret = xTaskCreate(wifi_task, 
-                                "wifi_task", 
-                                6144, 
-                                NULL, 
-                                4, 
-                                &wifi_task_handle);
+    BaseType_t ret = rk_task_create_config(wifi_task, "wifi_task", NULL, config, &defaults,
+                                          &wifi_task_handle, RK_TASK_STATIC_CFG(wifi_task));
     
     if (ret != pdPASS) {
         ESP_LOGE(TAG, "Nie można utworzyć zadania WiFi");
-        vQueueDelete(wifi_queue);
+        rk_queue_delete(wifi_queue);
         wifi_queue = NULL;
         task_running = false;
         return ESP_ERR_NO_MEM;
     }
     
-    ESP_LOGI(TAG, "Zadanie WiFi uruchomione");
+    rk_shutdown_register("wifi", wifi_shutdown);
+    ESP_LOGI(TAG, "Zadanie WiFi uruchomione (kolejka %d x %u B)", WIFI_QUEUE_LEN, sizeof(rk_wifi_message_t));
     return ESP_OK;
 }
 
@@ -205,21 +421,44 @@ esp_err_t rk_wifi_connect(const char* ssid, const char* password)
         return ESP_ERR_INVALID_STATE;
     }
     
+    portENTER_CRITICAL(&s_credentials_lock);
+    memset(s_ssid, 0, sizeof(s_ssid));
+    memset(s_password, 0, sizeof(s_password));
+    strncpy(s_ssid, ssid, sizeof(s_ssid) - 1);
+    strncpy(s_password, password, sizeof(s_password) - 1);
+    portEXIT_CRITICAL(&s_credentials_lock);
+    
     rk_wifi_message_t msg = {
         .type = RK_WIFI_MSG_CONNECT
     };
     
-    strncpy(msg.ssid, ssid, sizeof(msg.ssid) - 1);
-    strncpy(msg.password, password, sizeof(msg.password) - 1);
-    
     if (xQueueSend(wifi_queue, &msg, pdMS_TO_TICKS(1000)) != pdTRUE) {
         ESP_LOGE(TAG, "Nie można wysłać wiadomości połączenia");
         return ESP_ERR_TIMEOUT;
     }
+    xTaskNotify(wifi_task_handle, WIFI_NOTIFY_MSG, eSetBits);
     
     return ESP_OK;
 }
 
+esp_err_t rk_wifi_prepare_sleep(void)
+{
+    if (!s_wifi_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    // Radio wyłączane synchronicznie - uśpienie następuje zaraz po powrocie
+    s_sleep_pending = true;
+    s_fast_attempt = false;
+    s_fast.ip_reuse = s_fast.magic == WIFI_FAST_MAGIC;
+    s_wifi_connected = false;
+    xEventGroupClearBits(s_wifi_event_group, RK_WIFI_CONNECTED_BIT);
+    esp_wifi_disconnect();
+    esp_err_t err = esp_wifi_stop();
+    s_wifi_started = false;
+    return err;
+}
+
 esp_err_t rk_wifi_disconnect(void)
 {
     if (wifi_queue == NULL) {
@@ -227,7 +466,9 @@ esp_err_t rk_wifi_disconnect(void)
     }
     
     rk_wifi_message_t msg = {.type = RK_WIFI_MSG_DISCONNECT};
-    xQueueSend(wifi_queue, &msg, pdMS_TO_TICKS(100));
+    if (xQueueSend(wifi_queue, &msg, pdMS_TO_TICKS(100)) == pdTRUE) {
+        xTaskNotify(wifi_task_handle, WIFI_NOTIFY_MSG, eSetBits);
+    }
     
     return ESP_OK;
 }
@@ -242,16 +483,40 @@ EventGroupHandle_t rk_wifi_get_event_group(void)
     return s_wifi_event_group;
 }
 
+void rk_wifi_get_event_stats(rk_wifi_event_stats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    
+    *stats = s_event_stats;
+    stats->handler_avg_us = s_event_stats.handler_calls > 0
+                          ? (uint32_t)(s_handler_total_us / s_event_stats.handler_calls)
+                          : 0;
+    stats->fast_connects = s_fast.fast_connects;
+    stats->fast_connect_fallbacks = s_fast.fast_connect_fallbacks;
+}
+
 void rk_wifi_stop_task(void)
 {
     if (task_running && wifi_queue != NULL) {
+        rk_join_prepare();
+        s_stop_waiter = xTaskGetCurrentTaskHandle();
         rk_wifi_message_t msg = {.type = RK_WIFI_MSG_STOP};
-        xQueueSend(wifi_queue, &msg, pdMS_TO_TICKS(100));
+        if (xQueueSend(wifi_queue, &msg, pdMS_TO_TICKS(100)) == pdTRUE) {
+            xTaskNotify(wifi_task_handle, WIFI_NOTIFY_MSG, eSetBits);
+        }
         
-        vTaskDelay(pdMS_TO_TICKS(500));
+        // Kolejka usuwana dopiero po potwierdzeniu - zadanie mogło jeszcze z niej czytać
+        bool stopped = rk_join_wait(RK_TASK_STOP_TIMEOUT_MS);
+        s_stop_waiter = NULL;
+        if (!stopped) {
+            ESP_LOGE(TAG, "Zadanie WiFi nie potwierdziło zakończenia - kolejka pozostaje");
+            return;
+        }
         
         if (wifi_queue != NULL) {
-            vQueueDelete(wifi_queue);
+            rk_queue_delete(wifi_queue);
             wifi_queue = NULL;
         }
         
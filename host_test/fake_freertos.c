@@ -0,0 +1,927 @@
+#include "host_test.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_freertos_hooks.h"
+#include "freertos/event_groups.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stdarg.h>
+#include <string.h>
+#include <ucontext.h>
+
+#define FAKE_TIMERS_MAX   8
+#define FAKE_PENDING_MAX  16     // Jak kolejka poleceń timerów (CONFIG_FREERTOS_TIMER_QUEUE_LENGTH)
+#define FAKE_TASKS_MAX    12
+#define FAKE_QUEUES_MAX   8
+#define FAKE_GROUPS_MAX   4
+#define FAKE_STACK_SIZE   (256 * 1024)  // Stos na hoście - ramki większe niż na ESP32
+
+struct host_timer {
+    TimerCallbackFunction_t callback;
+    void *id;
+    TickType_t period;
+    TickType_t expiry;
+    bool auto_reload;
+    bool active;
+};
+
+typedef enum {
+    TASK_FREE,
+    TASK_READY,         // Nowe lub obudzone - sprawdza warunek oczekiwania od nowa
+    TASK_BLOCKED,       // Czeka na obiekt (wait_obj) lub do wake_at
+    TASK_DONE,          // Zakończone - slot i stos do ponownego użycia
+} task_state_t;
+
+// Zadanie kooperacyjne: przełączane tylko wtedy, gdy bieżące czeka (jeden rdzeń,
+// bez wywłaszczania). Wątek testu to zadanie główne bez własnego stosu.
+typedef struct {
+    TaskFunction_t fn;
+    void *arg;
+    task_state_t state;
+    bool started;
+    const void *wait_obj;       // Obiekt, którego zmiana budzi zadanie (NULL - tylko czas)
+    bool timed;
+    TickType_t wake_at;
+    bool wait_idle;             // fake_task_run_ready: wznowienie, gdy inne zadania czekają
+    uint32_t notify[configTASK_NOTIFICATION_ARRAY_ENTRIES];
+    bool notify_pending[configTASK_NOTIFICATION_ARRAY_ENTRIES];
+    UBaseType_t priority;
+    ucontext_t ctx;
+    void *stack;
+} fake_task_t;
+
+// Kolejka kopiująca elementy jak FreeRTOS (memcpy item_size przy wysłaniu i odbiorze)
+typedef struct {
+    bool used;
+    bool owns_storage;          // xQueueCreate - pamięć z malloc
+    uint8_t *storage;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+} fake_queue_t;
+
+typedef struct {
+    bool used;
+    EventBits_t bits;
+} fake_group_t;
+
+typedef struct {
+    PendedFunction_t fn;
+    void *param1;
+    uint32_t param2;
+} pending_call_t;
+
+int host_test_failures = 0;
+
+static TickType_t s_now;
+static struct host_timer s_timers[FAKE_TIMERS_MAX];
+static int s_timer_count;
+static TimerHandle_t s_last_timer;
+static pending_call_t s_pending[FAKE_PENDING_MAX];
+static size_t s_pending_count;
+static bool s_drop_stop;
+static bool s_hold_pending;
+static int64_t s_extra_us;          // Czas operacji bez taktów (np. kasowanie flash)
+static fake_task_t s_main_task;     // Wątek testu
+static fake_task_t s_tasks[FAKE_TASKS_MAX];
+static fake_task_t *s_current = &s_main_task;
+static int s_next_task;             // Kolejka zadań gotowych po kolei (round robin)
+static bool s_woken;                // Zadanie obudzone w trakcie upływu czasu
+static fake_queue_t s_queues[FAKE_QUEUES_MAX];
+static fake_group_t s_groups[FAKE_GROUPS_MAX];
+
+static void schedule(void);
+
+void fake_rtos_reset(void)
+{
+    // Timery zostają - komponenty tworzą je raz i trzymają uchwyty w zmiennych statycznych
+    for (int i = 0; i < s_timer_count; i++) {
+        s_timers[i].active = false;
+    }
+    s_now = 0;
+    s_pending_count = 0;
+    s_drop_stop = false;
+    s_hold_pending = false;
+    s_extra_us = 0;
+    // Zadania z poprzedniego testu porzucone - stosy zostają do ponownego użycia
+    for (int i = 0; i < FAKE_TASKS_MAX; i++) {
+        s_tasks[i].state = TASK_FREE;
+    }
+    memset(&s_main_task, 0, sizeof(s_main_task));
+    s_main_task.state = TASK_READY;
+    s_main_task.started = true;
+    s_main_task.priority = 5;
+    s_current = &s_main_task;
+}
+
+void fake_rtos_run_pending(void)
+{
+    // Wywołanie może dodać kolejne - obsługiwane w tej samej pętli, jak w zadaniu timerów
+    for (size_t i = 0; i < s_pending_count; i++) {
+        pending_call_t call = s_pending[i];
+        call.fn(call.param1, call.param2);
+    }
+    s_pending_count = 0;
+}
+
+size_t fake_rtos_pending_count(void)
+{
+    return s_pending_count;
+}
+
+// Najbliższy termin timera po s_now (0 - brak aktywnych)
+static TickType_t next_timer_expiry(void)
+{
+    TickType_t next = 0;
+    for (int i = 0; i < s_timer_count; i++) {
+        const struct host_timer *timer = &s_timers[i];
+        if (timer->active && (int32_t)(timer->expiry - s_now) > 0 &&
+            (next == 0 || (int32_t)(timer->expiry - next) < 0)) {
+            next = timer->expiry;
+        }
+    }
+    return next;
+}
+
+static void tick(void)
+{
+    s_now++;
+    for (int i = 0; i < s_timer_count; i++) {
+        struct host_timer *timer = &s_timers[i];
+        if (timer->active && timer->expiry == s_now) {
+            if (timer->auto_reload) {
+                timer->expiry = s_now + timer->period;
+            } else {
+                timer->active = false;
+            }
+            timer->callback(timer);
+        }
+    }
+    if (!s_hold_pending) {
+        fake_rtos_run_pending();
+    }
+}
+
+// Upływ czasu do target; takty bez timerów i poleceń przeskakiwane.
+// stop_on_wake - koniec wcześniej, gdy timer lub polecenie obudziło zadanie.
+static void advance_to(TickType_t target, bool stop_on_wake)
+{
+    s_woken = false;
+    while ((int32_t)(target - s_now) > 0 && !(stop_on_wake && s_woken)) {
+        if (s_pending_count == 0 || s_hold_pending) {
+            TickType_t next = next_timer_expiry();
+            TickType_t skip_to = (next == 0 || (int32_t)(next - target) > 0) ? target : next;
+            s_now = skip_to - 1;
+        }
+        tick();
+    }
+}
+
+void fake_rtos_advance_ticks(TickType_t ticks)
+{
+    advance_to(s_now + ticks, false);
+}
+
+TickType_t fake_timer_period(TimerHandle_t timer)
+{
+    return timer->period;
+}
+
+bool fake_timer_active(TimerHandle_t timer)
+{
+    return timer->active;
+}
+
+TimerHandle_t fake_timer_last(void)
+{
+    return s_last_timer;
+}
+
+void fake_timer_add_us(int64_t us)
+{
+    s_extra_us += us;
+}
+
+void fake_rtos_hold_pending(bool hold)
+{
+    s_hold_pending = hold;
+}
+
+void fake_timer_drop_stop(bool drop)
+{
+    s_drop_stop = drop;
+}
+
+TimerHandle_t xTimerCreateStatic(const char *name, TickType_t period, UBaseType_t auto_reload,
+                                 void *timer_id, TimerCallbackFunction_t callback,
+                                 StaticTimer_t *buffer)
+{
+    if (s_timer_count >= FAKE_TIMERS_MAX) {
+        return NULL;
+    }
+    struct host_timer *timer = &s_timers[s_timer_count++];
+    memset(timer, 0, sizeof(*timer));
+    timer->callback = callback;
+    timer->id = timer_id;
+    timer->period = period;
+    timer->auto_reload = auto_reload;
+    s_last_timer = timer;
+    return timer;
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload,
+                           void *timer_id, TimerCallbackFunction_t callback)
+{
+    return xTimerCreateStatic(name, period, auto_reload, timer_id, callback, NULL);
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticks)
+{
+    timer->period = period;
+    timer->expiry = s_now + period;
+    timer->active = true;
+    return pdPASS;
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks)
+{
+    if (s_drop_stop) {
+        return pdFAIL;
+    }
+    timer->active = false;
+    return pdPASS;
+}
+
+BaseType_t xTimerPendFunctionCall(PendedFunction_t fn, void *param1, uint32_t param2,
+                                  TickType_t ticks)
+{
+    if (s_pending_count >= FAKE_PENDING_MAX) {
+        return pdFAIL;
+    }
+    s_pending[s_pending_count++] = (pending_call_t){fn, param1, param2};
+    return pdPASS;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return s_now;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t)s_now * portTICK_PERIOD_MS * 1000 + s_extra_us;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return s_now * portTICK_PERIOD_MS;
+}
+
+// ===== Zadania =====
+
+static void task_entry(void)
+{
+    fake_task_t *self = s_current;
+    self->fn(self->arg);
+    // Funkcja zadania wróciła bez vTaskDelete (zamienniki rk_task_delete w fake_rk_common.c)
+    vTaskDelete(NULL);
+}
+
+static void switch_to(fake_task_t *next)
+{
+    fake_task_t *prev = s_current;
+    if (!next->started) {
+        next->started = true;
+        if (next->stack == NULL) {
+            next->stack = malloc(FAKE_STACK_SIZE);
+        }
+        getcontext(&next->ctx);
+        next->ctx.uc_stack.ss_sp = next->stack;
+        next->ctx.uc_stack.ss_size = FAKE_STACK_SIZE;
+        next->ctx.uc_link = NULL;
+        makecontext(&next->ctx, task_entry, 0);
+    }
+    s_current = next;
+    swapcontext(&prev->ctx, &next->ctx);
+}
+
+static fake_task_t *pick_ready(void)
+{
+    // Zadania pomocnicze po kolei, wątek testu na końcu cyklu
+    for (int n = 0; n <= FAKE_TASKS_MAX; n++) {
+        int i = (s_next_task + n) % (FAKE_TASKS_MAX + 1);
+        fake_task_t *task = i == FAKE_TASKS_MAX ? &s_main_task : &s_tasks[i];
+        if (task->state == TASK_READY) {
+            s_next_task = (i + 1) % (FAKE_TASKS_MAX + 1);
+            return task;
+        }
+    }
+    return NULL;
+}
+
+static void wake(fake_task_t *task)
+{
+    if (task->state == TASK_BLOCKED) {
+        task->state = TASK_READY;
+        s_woken = true;
+    }
+}
+
+// Obudzenie zadań czekających na obiekt - same sprawdzają, czy warunek jest spełniony
+static void wake_waiters(const void *obj)
+{
+    for (int i = 0; i < FAKE_TASKS_MAX; i++) {
+        if (s_tasks[i].wait_obj == obj) {
+            wake(&s_tasks[i]);
+        }
+    }
+    if (s_main_task.wait_obj == obj) {
+        wake(&s_main_task);
+    }
+}
+
+static bool any_waiting_on(const void *obj)
+{
+    for (int i = 0; i < FAKE_TASKS_MAX; i++) {
+        if (s_tasks[i].state == TASK_BLOCKED && s_tasks[i].wait_obj == obj) {
+            return true;
+        }
+    }
+    return s_main_task.state == TASK_BLOCKED && s_main_task.wait_obj == obj;
+}
+
+static bool earliest_deadline(TickType_t *deadline)
+{
+    bool found = false;
+    for (int i = 0; i <= FAKE_TASKS_MAX; i++) {
+        const fake_task_t *task = i == FAKE_TASKS_MAX ? &s_main_task : &s_tasks[i];
+        if (task->state == TASK_BLOCKED && task->timed &&
+            (!found || (int32_t)(task->wake_at - *deadline) < 0)) {
+            *deadline = task->wake_at;
+            found = true;
+        }
+    }
+    return found;
+}
+
+// Bieżące zadanie czeka: najpierw zadania gotowe, potem polecenia timerów,
+// potem upływ czasu do najbliższego terminu oczekiwania
+static void schedule(void)
+{
+    for (;;) {
+        fake_task_t *next = pick_ready();
+        if (next != NULL) {
+            next->state = TASK_READY;
+            if (next != s_current) {
+                switch_to(next);
+            }
+            return;
+        }
+        
+        if (s_pending_count > 0 && !s_hold_pending) {
+            fake_rtos_run_pending();
+            continue;
+        }
+        
+        TickType_t deadline;
+        if (earliest_deadline(&deadline)) {
+            advance_to(deadline, true);
+            for (int i = 0; i <= FAKE_TASKS_MAX; i++) {
+                fake_task_t *task = i == FAKE_TASKS_MAX ? &s_main_task : &s_tasks[i];
+                if (task->state == TASK_BLOCKED && task->timed &&
+                    (int32_t)(task->wake_at - s_now) <= 0) {
+                    wake(task);
+                }
+            }
+            continue;
+        }
+        
+        if (s_main_task.state == TASK_BLOCKED && s_main_task.wait_idle) {
+            wake(&s_main_task);
+            continue;
+        }
+        
+        fprintf(stderr, "fake_freertos: wszystkie zadania czekają bez limitu czasu (takt %lu)\n",
+                (unsigned long)s_now);
+        abort();
+    }
+}
+
+// Jedno oczekiwanie bieżącego zadania; false - minął termin (ticks == 0: bez czekania)
+static bool wait_for(const void *obj, TickType_t ticks, TickType_t deadline)
+{
+    if (ticks == 0 || (ticks != portMAX_DELAY && (int32_t)(deadline - s_now) <= 0)) {
+        return false;
+    }
+    fake_task_t *self = s_current;
+    self->state = TASK_BLOCKED;
+    self->wait_obj = obj;
+    self->timed = ticks != portMAX_DELAY;
+    self->wake_at = deadline;
+    schedule();
+    self->wait_obj = NULL;
+    self->timed = false;
+    return true;
+}
+
+static fake_task_t *task_of(TaskHandle_t handle)
+{
+    return handle != NULL ? (fake_task_t *)handle : s_current;
+}
+
+TaskHandle_t fake_task_spawn(TaskFunction_t fn, void *arg)
+{
+    for (int i = 0; i < FAKE_TASKS_MAX; i++) {
+        fake_task_t *task = &s_tasks[i];
+        if (task == s_current || (task->state != TASK_FREE && task->state != TASK_DONE)) {
+            continue;
+        }
+        void *stack = task->stack;
+        memset(task, 0, sizeof(*task));
+        task->stack = stack;
+        task->fn = fn;
+        task->arg = arg;
+        task->priority = 5;
+        task->state = TASK_READY;
+        return (TaskHandle_t)task;
+    }
+    return NULL;
+}
+
+void fake_task_run_ready(void)
+{
+    s_current->wait_idle = true;
+    s_current->state = TASK_BLOCKED;
+    schedule();
+    s_current->wait_idle = false;
+}
+
+bool fake_task_is_main(void)
+{
+    return s_current == &s_main_task;
+}
+
+UBaseType_t fake_task_live_count(void)
+{
+    UBaseType_t count = 0;
+    for (int i = 0; i < FAKE_TASKS_MAX; i++) {
+        count += s_tasks[i].state == TASK_READY || s_tasks[i].state == TASK_BLOCKED;
+    }
+    return count;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_bytes,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core_id)
+{
+    TaskHandle_t task = fake_task_spawn(fn, arg);
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    ((fake_task_t *)task)->priority = priority;
+    if (handle != NULL) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name,
+                                           uint32_t stack_bytes, void *arg, UBaseType_t priority,
+                                           StackType_t *stack, StaticTask_t *tcb,
+                                           BaseType_t core_id)
+{
+    TaskHandle_t task = NULL;
+    xTaskCreatePinnedToCore(fn, name, stack_bytes, arg, priority, &task, core_id);
+    return task;
+}
+
+void vTaskDelete(TaskHandle_t handle)
+{
+    fake_task_t *task = task_of(handle);
+    if (task == &s_main_task) {
+        fprintf(stderr, "fake_freertos: vTaskDelete wątku testu\n");
+        abort();
+    }
+    task->state = TASK_DONE;
+    task->wait_obj = NULL;
+    if (task == s_current) {
+        schedule();     // Nie wraca - zadanie zakończone nie jest już wybierane
+    }
+}
+
+// Wątek testu i zadania działające (test metryk podstawia własną)
+__attribute__((weak)) UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    return 1 + fake_task_live_count();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return (TaskHandle_t)s_current;
+}
+
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t core_id)
+{
+    return NULL;
+}
+
+eTaskState eTaskGetState(TaskHandle_t handle)
+{
+    const fake_task_t *task = task_of(handle);
+    if (task == s_current) {
+        return eRunning;
+    }
+    return task->state == TASK_READY ? eReady : task->state == TASK_BLOCKED ? eBlocked : eDeleted;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t handle)
+{
+    return task_of(handle)->priority;
+}
+
+void vTaskPrioritySet(TaskHandle_t handle, UBaseType_t priority)
+{
+    task_of(handle)->priority = priority;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (ticks == 0) {
+        // Oddanie procesora innym gotowym zadaniom (taskYIELD)
+        s_current->state = TASK_READY;
+        schedule();
+        return;
+    }
+    TickType_t deadline = s_now + ticks;
+    while (wait_for(NULL, ticks, deadline)) {
+    }
+}
+
+// ===== Powiadomienia zadań =====
+
+BaseType_t xTaskGenericNotify(TaskHandle_t handle, UBaseType_t index, uint32_t value,
+                              eNotifyAction action, uint32_t *previous)
+{
+    if (handle == NULL) {
+        fprintf(stderr, "fake_freertos: powiadomienie zadania NULL\n");
+        abort();
+    }
+    fake_task_t *task = (fake_task_t *)handle;
+    if (previous != NULL) {
+        *previous = task->notify[index];
+    }
+    BaseType_t ret = pdPASS;
+    switch (action) {
+        case eSetBits:
+            task->notify[index] |= value;
+            break;
+        case eIncrement:
+            task->notify[index]++;
+            break;
+        case eSetValueWithOverwrite:
+            task->notify[index] = value;
+            break;
+        case eSetValueWithoutOverwrite:
+            if (task->notify_pending[index]) {
+                ret = pdFAIL;
+            } else {
+                task->notify[index] = value;
+            }
+            break;
+        case eNoAction:
+            break;
+    }
+    task->notify_pending[index] = true;
+    wake_waiters(task);
+    return ret;
+}
+
+BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t task, UBaseType_t index)
+{
+    return xTaskGenericNotify(task, index, 0, eIncrement, NULL);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return xTaskNotifyGiveIndexed(task, 0);
+}
+
+uint32_t ulTaskNotifyTakeIndexed(UBaseType_t index, BaseType_t clear, TickType_t ticks)
+{
+    fake_task_t *self = s_current;
+    TickType_t deadline = s_now + ticks;
+    while (self->notify[index] == 0 && wait_for(self, ticks, deadline)) {
+    }
+    uint32_t value = self->notify[index];
+    if (value > 0) {
+        self->notify[index] = clear ? 0 : value - 1;
+    }
+    self->notify_pending[index] = false;
+    return value;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    return ulTaskNotifyTakeIndexed(0, clear, ticks);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value,
+                           TickType_t ticks)
+{
+    fake_task_t *self = s_current;
+    TickType_t deadline = s_now + ticks;
+    if (!self->notify_pending[0]) {
+        self->notify[0] &= ~clear_on_entry;
+        while (!self->notify_pending[0] && wait_for(self, ticks, deadline)) {
+        }
+    }
+    if (value != NULL) {
+        *value = self->notify[0];
+    }
+    if (!self->notify_pending[0]) {
+        return pdFALSE;
+    }
+    self->notify[0] &= ~clear_on_exit;
+    self->notify_pending[0] = false;
+    return pdTRUE;
+}
+
+uint32_t ulTaskNotifyValueClearIndexed(TaskHandle_t handle, UBaseType_t index, uint32_t bits)
+{
+    fake_task_t *task = task_of(handle);
+    uint32_t value = task->notify[index];
+    task->notify[index] &= ~bits;
+    return value;
+}
+
+BaseType_t xTaskNotifyStateClearIndexed(TaskHandle_t handle, UBaseType_t index)
+{
+    fake_task_t *task = task_of(handle);
+    bool pending = task->notify_pending[index];
+    task->notify_pending[index] = false;
+    return pending ? pdTRUE : pdFALSE;
+}
+
+// ===== Kolejki =====
+
+static QueueHandle_t queue_create(UBaseType_t length, UBaseType_t item_size, uint8_t *storage)
+{
+    for (int i = 0; i < FAKE_QUEUES_MAX; i++) {
+        fake_queue_t *queue = &s_queues[i];
+        if (queue->used) {
+            continue;
+        }
+        queue->owns_storage = storage == NULL;
+        queue->storage = storage != NULL ? storage : malloc(length * item_size);
+        if (queue->storage == NULL) {
+            return NULL;
+        }
+        queue->used = true;
+        queue->length = length;
+        queue->item_size = item_size;
+        queue->head = 0;
+        queue->count = 0;
+        return (QueueHandle_t)queue;
+    }
+    return NULL;
+}
+
+QueueHandle_t fake_queue_create(UBaseType_t length, UBaseType_t item_size)
+{
+    return queue_create(length, item_size, NULL);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    return queue_create(length, item_size, NULL);
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t item_size, uint8_t *storage,
+                                 StaticQueue_t *queue_buffer)
+{
+    return queue_create(length, item_size, storage);
+}
+
+// Usunięcie kolejki, na której czeka zadanie, to błąd użycia po zwolnieniu - przerywa test
+void vQueueDelete(QueueHandle_t handle)
+{
+    fake_queue_t *queue = (fake_queue_t *)handle;
+    if (any_waiting_on(queue)) {
+        fprintf(stderr, "fake_freertos: vQueueDelete kolejki, na którą czeka zadanie\n");
+        abort();
+    }
+    if (queue->owns_storage) {
+        free(queue->storage);
+    }
+    queue->storage = NULL;
+    queue->used = false;
+}
+
+void fake_queue_delete(QueueHandle_t handle)
+{
+    vQueueDelete(handle);
+}
+
+UBaseType_t fake_queue_live_count(void)
+{
+    UBaseType_t count = 0;
+    for (int i = 0; i < FAKE_QUEUES_MAX; i++) {
+        count += s_queues[i].used;
+    }
+    return count;
+}
+
+static fake_queue_t *find_queue(QueueHandle_t handle)
+{
+    for (int i = 0; i < FAKE_QUEUES_MAX; i++) {
+        if (handle == (QueueHandle_t)&s_queues[i] && s_queues[i].used) {
+            return &s_queues[i];
+        }
+    }
+    return NULL;
+}
+
+// Kolejki spoza atrapy (rk_queue_create w fake_rk_common.c zwraca NULL) - zawsze pełne i puste
+BaseType_t xQueueSend(QueueHandle_t handle, const void *item, TickType_t ticks)
+{
+    fake_queue_t *queue = find_queue(handle);
+    if (queue == NULL) {
+        return pdFAIL;
+    }
+    TickType_t deadline = s_now + ticks;
+    while (queue->count == queue->length && wait_for(queue, ticks, deadline)) {
+    }
+    if (queue->count == queue->length) {
+        return pdFAIL;
+    }
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    memcpy(queue->storage + tail * queue->item_size, item, queue->item_size);
+    queue->count++;
+    wake_waiters(queue);
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t handle, void *item, TickType_t ticks)
+{
+    fake_queue_t *queue = find_queue(handle);
+    if (queue == NULL) {
+        return pdFAIL;
+    }
+    TickType_t deadline = s_now + ticks;
+    while (queue->count == 0 && wait_for(queue, ticks, deadline)) {
+    }
+    if (queue->count == 0) {
+        return pdFAIL;
+    }
+    memcpy(item, queue->storage + queue->head * queue->item_size, queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    wake_waiters(queue);
+    return pdPASS;
+}
+
+// ===== Grupy zdarzeń =====
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *buffer)
+{
+    for (int i = 0; i < FAKE_GROUPS_MAX; i++) {
+        if (!s_groups[i].used) {
+            s_groups[i].used = true;
+            s_groups[i].bits = 0;
+            return (EventGroupHandle_t)&s_groups[i];
+        }
+    }
+    return NULL;
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    return xEventGroupCreateStatic(NULL);
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    ((fake_group_t *)group)->used = false;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    fake_group_t *g = (fake_group_t *)group;
+    g->bits |= bits;
+    wake_waiters(g);
+    return g->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    fake_group_t *g = (fake_group_t *)group;
+    EventBits_t previous = g->bits;
+    g->bits &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    return ((fake_group_t *)group)->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear,
+                                BaseType_t all, TickType_t ticks)
+{
+    fake_group_t *g = (fake_group_t *)group;
+    TickType_t deadline = s_now + ticks;
+    for (;;) {
+        EventBits_t set = g->bits & bits;
+        bool satisfied = all ? set == bits : set != 0;
+        if (satisfied) {
+            EventBits_t value = g->bits;
+            if (clear) {
+                g->bits &= ~bits;
+            }
+            return value;
+        }
+        if (!wait_for(g, ticks, deadline)) {
+            return g->bits;
+        }
+    }
+}
+
+// ===== Semafory (jeden rdzeń, bez wywłaszczania - sekcja nigdy nie jest zajęta) =====
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer)
+{
+    return (SemaphoreHandle_t)buffer;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    static StaticSemaphore_t buffer;
+    return (SemaphoreHandle_t)&buffer;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return pdTRUE;
+}
+
+// ===== esp_timer i haki taktu (próbkowanie rywalizacji w rk_common.c - nieaktywne) =====
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_register_freertos_tick_hook_for_cpu(esp_freertos_tick_cb_t hook, UBaseType_t cpu)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void esp_deregister_freertos_tick_hook(esp_freertos_tick_cb_t hook)
+{
+}
+
+void host_log(esp_log_level_t level, const char *tag, const char *fmt, ...)
+{
+    const char *verbose = getenv("HOST_TEST_VERBOSE");
+    if (verbose == NULL || verbose[0] != '1') {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "[%s] ", tag);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    return code == ESP_OK ? "ESP_OK" : "ESP_ERR";
+}
@@ -0,0 +1,243 @@
+#include "fake_partition.h"
+#include "host_test.h"
+#include "esp_image_format.h"
+#include "esp_flash_encrypt.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define FAKE_PARTITIONS_MAX 4
+
+typedef struct {
+    esp_partition_t partition;
+    uint8_t *data;
+    fake_sector_stats_t *sectors;
+} fake_partition_t;
+
+static fake_partition_t s_partitions[FAKE_PARTITIONS_MAX];
+static const esp_partition_t *s_running;
+static esp_ota_img_states_t s_running_state = ESP_OTA_IMG_VALID;
+static bool s_fail_mmap;
+
+static fake_partition_t *find(const esp_partition_t *partition)
+{
+    for (int i = 0; i < FAKE_PARTITIONS_MAX; i++) {
+        if (s_partitions[i].data != NULL && &s_partitions[i].partition == partition) {
+            return &s_partitions[i];
+        }
+    }
+    return NULL;
+}
+
+static fake_partition_t *find_address(uint32_t address)
+{
+    for (int i = 0; i < FAKE_PARTITIONS_MAX; i++) {
+        if (s_partitions[i].data != NULL && s_partitions[i].partition.address == address) {
+            return &s_partitions[i];
+        }
+    }
+    return NULL;
+}
+
+esp_partition_t *fake_partition_create(const char *label, uint32_t address, uint32_t size)
+{
+    fake_partition_t *fake = NULL;
+    for (int i = 0; i < FAKE_PARTITIONS_MAX && fake == NULL; i++) {
+        if (s_partitions[i].data == NULL) {
+            fake = &s_partitions[i];
+        }
+    }
+    if (fake == NULL) {
+        return NULL;
+    }
+    
+    char path[] = "/tmp/rk_flash_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return NULL;
+    }
+    unlink(path);
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    
+    memset(data, 0xFF, size);
+    memset(fake, 0, sizeof(*fake));
+    fake->data = data;
+    fake->sectors = calloc(size / SPI_FLASH_SEC_SIZE, sizeof(fake_sector_stats_t));
+    fake->partition.address = address;
+    fake->partition.size = size;
+    fake->partition.erase_size = SPI_FLASH_SEC_SIZE;
+    strncpy(fake->partition.label, label, sizeof(fake->partition.label) - 1);
+    return &fake->partition;
+}
+
+void fake_partition_destroy(esp_partition_t *partition)
+{
+    fake_partition_t *fake = find(partition);
+    if (fake != NULL) {
+        munmap(fake->data, fake->partition.size);
+        free(fake->sectors);
+        memset(fake, 0, sizeof(*fake));
+    }
+}
+
+uint8_t *fake_partition_data(const esp_partition_t *partition)
+{
+    return find(partition)->data;
+}
+
+const fake_sector_stats_t *fake_partition_sector(const esp_partition_t *partition, uint32_t sector)
+{
+    return &find(partition)->sectors[sector];
+}
+
+void fake_partition_reset_stats(const esp_partition_t *partition)
+{
+    fake_partition_t *fake = find(partition);
+    memset(fake->sectors, 0, fake->partition.size / SPI_FLASH_SEC_SIZE * sizeof(fake_sector_stats_t));
+}
+
+void fake_partition_fail_mmap(bool fail)
+{
+    s_fail_mmap = fail;
+}
+
+void fake_ota_set_running(const esp_partition_t *partition, esp_ota_img_states_t state)
+{
+    s_running = partition;
+    s_running_state = state;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset,
+                             void *dst, size_t size)
+{
+    fake_partition_t *fake = find(partition);
+    if (fake == NULL || src_offset + size > partition->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(dst, fake->data + src_offset, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset,
+                              const void *src, size_t size)
+{
+    fake_partition_t *fake = find(partition);
+    if (fake == NULL || dst_offset + size > partition->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // NOR: zapis może tylko zerować bity
+    const uint8_t *bytes = src;
+    for (size_t i = 0; i < size; i++) {
+        fake->data[dst_offset + i] &= bytes[i];
+    }
+    for (size_t sector = dst_offset / SPI_FLASH_SEC_SIZE;
+         sector <= (dst_offset + size - 1) / SPI_FLASH_SEC_SIZE; sector++) {
+        fake->sectors[sector].writes++;
+    }
+    fake_timer_add_us((int64_t)FAKE_WRITE_US * size / SPI_FLASH_SEC_SIZE);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    fake_partition_t *fake = find(partition);
+    if (fake == NULL || offset + size > partition->size ||
+        offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(fake->data + offset, 0xFF, size);
+    for (size_t sector = offset / SPI_FLASH_SEC_SIZE; sector < (offset + size) / SPI_FLASH_SEC_SIZE; sector++) {
+        fake->sectors[sector].erases++;
+    }
+    fake_timer_add_us((int64_t)FAKE_ERASE_US * (size / SPI_FLASH_SEC_SIZE));
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle)
+{
+    fake_partition_t *fake = find(partition);
+    if (s_fail_mmap) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (fake == NULL || offset + size > partition->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out_ptr = fake->data + offset;
+    *out_handle = partition->address;
+    return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle)
+{
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return s_running;
+}
+
+esp_err_t esp_ota_get_state_partition(const esp_partition_t *partition, esp_ota_img_states_t *state)
+{
+    if (partition == NULL || partition != s_running) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *state = s_running_state;
+    return ESP_OK;
+}
+
+bool esp_flash_encryption_enabled(void)
+{
+    return false;
+}
+
+static uint32_t fnv1a(const uint8_t *data, uint32_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < len; i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void fake_image_seal(uint8_t *image, uint32_t len)
+{
+    image[0] = ESP_IMAGE_HEADER_MAGIC;
+    memcpy(image + 4, &len, sizeof(len));
+    uint32_t hash = fnv1a(image, len - 4);
+    memcpy(image + len - 4, &hash, sizeof(hash));
+}
+
+esp_err_t esp_image_verify(esp_image_load_mode_t mode, const esp_partition_pos_t *part,
+                           esp_image_metadata_t *data)
+{
+    fake_partition_t *fake = find_address(part->offset);
+    if (fake == NULL || fake->data[0] != ESP_IMAGE_HEADER_MAGIC) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    uint32_t len;
+    memcpy(&len, fake->data + 4, sizeof(len));
+    if (len < 12 || len > part->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint32_t hash;
+    memcpy(&hash, fake->data + len - 4, sizeof(hash));
+    if (hash != fnv1a(fake->data, len - 4)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    data->start_addr = part->offset;
+    data->image_len = len;
+    return ESP_OK;
+}
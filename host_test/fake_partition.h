@@ -0,0 +1,26 @@
+#pragma once
+// Partycje flash na pliku tymczasowym (mmap) z semantyką NOR: kasowanie sektorami do 0xFF,
+// zapis tylko zeruje bity. Czas operacji doliczany do esp_timer_get_time.
+
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+
+#define FAKE_ERASE_US   45000       // Kasowanie sektora 4 KB
+#define FAKE_WRITE_US   12000       // Zapis 4 KB
+
+typedef struct {
+    uint32_t erases;
+    uint32_t writes;
+} fake_sector_stats_t;
+
+esp_partition_t *fake_partition_create(const char *label, uint32_t address, uint32_t size);
+void fake_partition_destroy(esp_partition_t *partition);
+uint8_t *fake_partition_data(const esp_partition_t *partition);
+const fake_sector_stats_t *fake_partition_sector(const esp_partition_t *partition, uint32_t sector);
+void fake_partition_reset_stats(const esp_partition_t *partition);
+void fake_partition_fail_mmap(bool fail);
+
+void fake_ota_set_running(const esp_partition_t *partition, esp_ota_img_states_t state);
+
+// Obraz testowy: magic, długość w bajtach 4..7, FNV-1a całości w ostatnich 4 bajtach
+void fake_image_seal(uint8_t *image, uint32_t len);
@@ -0,0 +1,83 @@
+#include "host_test.h"
+#include "rk_common.h"
+#include "rk_log.h"
+
+// Zamienniki rk_common i rk_log: obiekty RTOS z atrapy, bez rejestru zasobów i bufora logu
+
+TimerHandle_t rk_timer_create(const char *name, TickType_t period, UBaseType_t auto_reload,
+                              void *timer_id, TimerCallbackFunction_t callback,
+                              StaticTimer_t *timer_buffer)
+{
+    static StaticTimer_t buffer;
+    return xTimerCreateStatic(name, period, auto_reload, timer_id, callback,
+                              timer_buffer != NULL ? timer_buffer : &buffer);
+}
+
+QueueHandle_t rk_queue_create(UBaseType_t length, UBaseType_t item_size,
+                              uint8_t *storage, StaticQueue_t *queue_buffer)
+{
+    return NULL;
+}
+
+SemaphoreHandle_t rk_mutex_create(StaticSemaphore_t *buffer)
+{
+    return (SemaphoreHandle_t)buffer;
+}
+
+BaseType_t rk_task_create(TaskFunction_t task_fn, const char *name, uint32_t stack_bytes,
+                          void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                          StackType_t *stack, StaticTask_t *tcb)
+{
+    TaskHandle_t task = fake_task_spawn(task_fn, arg);
+    if (handle != NULL) {
+        *handle = task;
+    }
+    return task != NULL ? pdPASS : pdFAIL;
+}
+
+BaseType_t rk_task_create_config(TaskFunction_t task_fn, const char *name, void *arg,
+                                 const rk_task_config_t *config, const rk_task_config_t *defaults,
+                                 TaskHandle_t *handle, StackType_t *stack, uint32_t stack_capacity,
+                                 StaticTask_t *tcb)
+{
+    return pdFAIL;
+}
+
+void rk_task_delete(TaskHandle_t task)
+{
+}
+
+void rk_queue_delete(QueueHandle_t queue)
+{
+}
+
+void rk_res_acquire(rk_res_type_t type)
+{
+}
+
+void rk_res_release(rk_res_type_t type)
+{
+}
+
+esp_err_t rk_shutdown_register(const char *name, rk_shutdown_fn_t fn)
+{
+    return ESP_OK;
+}
+
+// Słaba - test bufora logu dołącza prawdziwy rk_log.c
+__attribute__((weak)) void rk_log_write(esp_log_level_t level, rk_log_tag_t tag, rk_log_fmt_t fmt, int argc, ...)
+{
+}
+
+void rk_join_prepare(void)
+{
+}
+
+bool rk_join_wait(uint32_t timeout_ms)
+{
+    return true;
+}
+
+void rk_join_signal(TaskHandle_t waiter)
+{
+}
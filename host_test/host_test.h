@@ -0,0 +1,60 @@
+#pragma once
+// Wspólne elementy testów na hoście: asercje i sterowanie atrapą FreeRTOS
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+extern int host_test_failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) nie spełnione\n", __FILE__, __LINE__, #cond); \
+            host_test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(expected, actual) do { \
+        long long e_ = (long long)(expected), a_ = (long long)(actual); \
+        if (e_ != a_) { \
+            fprintf(stderr, "%s:%d: %s == %lld, oczekiwano %lld\n", __FILE__, __LINE__, \
+                    #actual, a_, e_); \
+            host_test_failures++; \
+        } \
+    } while (0)
+
+#define RUN_TEST(fn) do { \
+        int before_ = host_test_failures; \
+        fake_rtos_reset(); \
+        fn(); \
+        printf("%s %s\n", host_test_failures == before_ ? "OK  " : "FAIL", #fn); \
+    } while (0)
+
+#define TEST_EXIT() (host_test_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE)
+
+// Atrapa FreeRTOS (fake_freertos.c). Kolejność w jednym takcie jak w zadaniu timerów:
+// najpierw timery, którym minął okres, potem polecenia z kolejki (wywołania odroczone).
+void fake_rtos_reset(void);
+void fake_rtos_advance_ticks(TickType_t ticks);
+void fake_rtos_run_pending(void);
+size_t fake_rtos_pending_count(void);
+void fake_rtos_hold_pending(bool hold);            // Polecenia czekają do fake_rtos_run_pending
+TickType_t fake_timer_period(TimerHandle_t timer);
+bool fake_timer_active(TimerHandle_t timer);
+TimerHandle_t fake_timer_last(void);                // Ostatnio utworzony timer
+void fake_timer_drop_stop(bool drop);               // xTimerStop gubi polecenie (pełna kolejka)
+void fake_timer_add_us(int64_t us);                 // Upływ czasu esp_timer bez taktów
+
+// Zadania kooperacyjne (jeden rdzeń, bez wywłaszczania): przełączenie, gdy bieżące
+// zadanie czeka (powiadomienie, kolejka, grupa zdarzeń, vTaskDelay). Gdy wszystkie czekają,
+// czas przeskakuje do najbliższego terminu - timery i polecenia obsługiwane po drodze.
+TaskHandle_t fake_task_spawn(TaskFunction_t fn, void *arg);
+void fake_task_run_ready(void);                     // Wątek testu czeka, aż reszta zadań utknie
+bool fake_task_is_main(void);                       // Bieżący kod to wątek testu
+UBaseType_t fake_task_live_count(void);             // Zadania poza wątkiem testu
+
+// Kolejka z kopiowaniem elementów (xQueueSend/xQueueReceive z czekaniem jak w FreeRTOS)
+QueueHandle_t fake_queue_create(UBaseType_t length, UBaseType_t item_size);
+void fake_queue_delete(QueueHandle_t queue);
+UBaseType_t fake_queue_live_count(void);
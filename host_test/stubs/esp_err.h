@@ -0,0 +1,33 @@
+#pragma once
+// Atrapa ESP-IDF dla testów na hoście - tylko elementy używane przez testowane pliki
+
+#include <stdint.h>
+#include <stdio.h>     // Jak w ESP-IDF: NULL i printf dostępne po esp_err.h
+#include <stdlib.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK                              0
+#define ESP_FAIL                            -1
+#define ESP_ERR_NO_MEM                      0x101
+#define ESP_ERR_INVALID_ARG                 0x102
+#define ESP_ERR_INVALID_STATE               0x103
+#define ESP_ERR_INVALID_SIZE                0x104
+#define ESP_ERR_NOT_FOUND                   0x105
+#define ESP_ERR_NOT_SUPPORTED               0x106
+#define ESP_ERR_TIMEOUT                     0x107
+#define ESP_ERR_INVALID_VERSION             0x10A
+#define ESP_ERR_OTA_BASE                    0x1500
+#define ESP_ERR_OTA_PARTITION_CONFLICT      (ESP_ERR_OTA_BASE + 0x01)
+#define ESP_ERR_OTA_VALIDATE_FAILED         (ESP_ERR_OTA_BASE + 0x03)
+#define ESP_ERR_OTA_ROLLBACK_INVALID_STATE  (ESP_ERR_OTA_BASE + 0x07)
+
+const char *esp_err_to_name(esp_err_t code);
+
+#define ESP_ERROR_CHECK(x) do { \
+        esp_err_t err_rc_ = (x); \
+        if (err_rc_ != ESP_OK) { \
+            fprintf(stderr, "%s:%d: ESP_ERROR_CHECK(%s) = %d\n", __FILE__, __LINE__, #x, err_rc_); \
+            abort(); \
+        } \
+    } while (0)
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdint.h>
+
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum {
+    ESP_TIMER_TASK,
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void *arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char *name;
+} esp_timer_create_args_t;
+
+// Czas symulowany (fake_freertos.c) - takty przeliczone na mikrosekundy
+int64_t esp_timer_get_time(void);
+
+// Timery esp_timer niedostępne na hoście (ESP_ERR_NOT_SUPPORTED)
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
@@ -0,0 +1,53 @@
+#pragma once
+// Atrapa FreeRTOS dla testów na hoście: czas symulowany, timery, wywołania odroczone
+// i zadania kooperacyjne (jeden rdzeń) obsługiwane przez fake_freertos.c
+
+#include "esp_attr.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint8_t StackType_t;
+typedef void *TaskHandle_t;
+typedef void *QueueHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef void *EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+typedef struct host_timer *TimerHandle_t;
+
+typedef struct { void *unused[4]; } StaticTask_t;
+typedef struct { void *unused[4]; } StaticQueue_t;
+typedef struct { void *unused[8]; } StaticTimer_t;
+typedef struct { void *unused[4]; } StaticEventGroup_t;
+typedef StaticQueue_t StaticSemaphore_t;
+
+typedef void (*TaskFunction_t)(void *);
+
+typedef struct { int unused; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+#define portENTER_CRITICAL(mux) (void)(mux)
+#define portEXIT_CRITICAL(mux) (void)(mux)
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xFFFFFFFFu
+
+// Wartość domyślna ESP-IDF (CONFIG_FREERTOS_HZ)
+#define configTICK_RATE_HZ 100
+#define configMAX_TASK_NAME_LEN 16
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES 2
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define configMAX_PRIORITIES 25
+#define portNUM_PROCESSORS 1
+#define tskIDLE_PRIORITY 0
+#define configUSE_TRACE_FACILITY 0
+#define BIT0 0x01
+#define BIT1 0x02
+#define BIT2 0x04
+#define BIT3 0x08
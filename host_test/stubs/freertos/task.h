@@ -0,0 +1,55 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+typedef enum {
+    eNoAction,
+    eSetBits,
+    eIncrement,
+    eSetValueWithOverwrite,
+    eSetValueWithoutOverwrite,
+} eNotifyAction;
+
+typedef enum {
+    eRunning,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+    eInvalid,
+} eTaskState;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_bytes,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core_id);
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name,
+                                           uint32_t stack_bytes, void *arg, UBaseType_t priority,
+                                           StackType_t *stack, StaticTask_t *tcb,
+                                           BaseType_t core_id);
+void vTaskDelete(TaskHandle_t task);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TaskHandle_t xTaskGetIdleTaskHandleForCore(BaseType_t core_id);
+eTaskState eTaskGetState(TaskHandle_t task);
+BaseType_t xPortGetCoreID(void);
+void vTaskDelay(TickType_t ticks);
+UBaseType_t uxTaskGetNumberOfTasks(void);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority);
+
+BaseType_t xTaskGenericNotify(TaskHandle_t task, UBaseType_t index, uint32_t value,
+                              eNotifyAction action, uint32_t *previous);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t task, UBaseType_t index);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+uint32_t ulTaskNotifyTakeIndexed(UBaseType_t index, BaseType_t clear, TickType_t ticks);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value,
+                           TickType_t ticks);
+uint32_t ulTaskNotifyValueClearIndexed(TaskHandle_t task, UBaseType_t index, uint32_t bits);
+BaseType_t xTaskNotifyStateClearIndexed(TaskHandle_t task, UBaseType_t index);
+
+#define xTaskNotify(task, value, action) xTaskGenericNotify((task), 0, (value), (action), NULL)
+#define xTaskNotifyAndQuery(task, value, action, previous) \
+        xTaskGenericNotify((task), 0, (value), (action), (previous))
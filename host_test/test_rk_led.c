@@ -0,0 +1,177 @@
+#include "host_test.h"
+#include "rk_led.h"
+#include "rk_led_hal.h"
+#include "freertos/task.h"
+#include <string.h>
+
+// Czasy zboczy sekwencera LED na atrapie pinu i symulowanym zegarze taktów
+
+#define MAX_EVENTS 256
+
+typedef struct {
+    TickType_t tick;
+    bool level;
+} level_event_t;
+
+static level_event_t s_events[MAX_EVENTS];
+static size_t s_event_count;
+
+static void record_level(void)
+{
+    if (s_event_count < MAX_EVENTS) {
+        s_events[s_event_count++] = (level_event_t){xTaskGetTickCount(), rk_led_hal_mock_get_level()};
+    }
+}
+
+static void led_idle(void)
+{
+    rk_led_hal_mock_set_hook(NULL);
+    rk_led_play_pattern(NULL);
+    fake_rtos_run_pending();
+    rk_led_off();
+    s_event_count = 0;
+}
+
+static TickType_t step_ticks(const rk_led_step_t *step)
+{
+    TickType_t ticks = pdMS_TO_TICKS(step->duration_ms);
+    return ticks > 0 ? ticks : 1;
+}
+
+// Poziom pinu po każdym kroku i zbocza dokładnie na granicach kroków z tablicy wzorca
+static void check_pattern_timing(const rk_led_pattern_t *pattern, int cycles)
+{
+    led_idle();
+    rk_led_hal_mock_set_hook(record_level);
+    uint32_t edges_before = rk_led_hal_mock_get_edges();
+    
+    CHECK_EQ(ESP_OK, rk_led_play_pattern(pattern));
+    fake_rtos_run_pending();
+    
+    TickType_t start = xTaskGetTickCount();
+    TickType_t t = start;
+    bool level = false;
+    uint32_t expected_edges = 0;
+    size_t event = 0;
+    
+    for (int cycle = 0; cycle < cycles; cycle++) {
+        for (size_t i = 0; i < pattern->step_count; i++) {
+            const rk_led_step_t *step = &pattern->steps[i];
+            bool on = step->level >= 128;
+            
+            CHECK(event < s_event_count);
+            if (event < s_event_count) {
+                CHECK_EQ(t, s_events[event].tick);
+                CHECK_EQ(on, s_events[event].level);
+            }
+            event++;
+            expected_edges += on != level;
+            level = on;
+            
+            TickType_t ticks = step_ticks(step);
+            fake_rtos_advance_ticks(ticks - 1);
+            CHECK_EQ(on, rk_led_hal_mock_get_level());   // Bez zmian w trakcie kroku
+            fake_rtos_advance_ticks(1);
+            t += ticks;
+        }
+    }
+    
+    // Ostatnie przesunięcie zegara rozpoczęło już kolejny cykl
+    expected_edges += (pattern->steps[0].level >= 128) != level;
+    CHECK_EQ(expected_edges, rk_led_hal_mock_get_edges() - edges_before);
+    led_idle();
+}
+
+static void test_builtin_patterns(void)
+{
+    check_pattern_timing(&rk_led_pattern_heartbeat, 5);
+    check_pattern_timing(&rk_led_pattern_double_blink, 5);
+    check_pattern_timing(&rk_led_pattern_error, 3);
+    check_pattern_timing(&rk_led_pattern_breathe, 3);
+}
+
+// Czasy niebędące wielokrotnością taktu: błąd kroku mniejszy niż jeden takt
+static void test_sub_tick_durations(void)
+{
+    static const rk_led_step_t steps[] = {{25, RK_LED_LEVEL_ON}, {35, 0}, {5, RK_LED_LEVEL_ON}, {15, 0}};
+    static const rk_led_pattern_t pattern = {steps, 4, true};
+    
+    led_idle();
+    rk_led_play_pattern(&pattern);
+    fake_rtos_run_pending();
+    
+    for (size_t i = 0; i < 8; i++) {
+        const rk_led_step_t *step = &steps[i % 4];
+        TickType_t period = fake_timer_period(fake_timer_last());
+        int32_t error_ms = (int32_t)(period * portTICK_PERIOD_MS) - (int32_t)step->duration_ms;
+        CHECK(period >= 1);
+        CHECK(error_ms > -(int32_t)portTICK_PERIOD_MS && error_ms < (int32_t)portTICK_PERIOD_MS);
+        fake_rtos_advance_ticks(period);
+    }
+    led_idle();
+}
+
+// led_task wywłaszcza sekwencer w trakcie kroku i zleca dwa kolejne wzorce on/off
+static void preempt_with_two_patterns(void)
+{
+    rk_led_hal_mock_set_hook(NULL);
+    rk_led_blink_asymmetric_start(300, 300);
+    rk_led_blink_asymmetric_start(900, 700);
+}
+
+static void test_custom_pattern_handover(void)
+{
+    led_idle();
+    rk_led_blink_asymmetric_start(100, 200);
+    fake_rtos_run_pending();
+    CHECK_EQ(pdMS_TO_TICKS(100), fake_timer_period(fake_timer_last()));
+    
+    // Krok OFF wzorca A aplikowany z wywołania timera; polecenia B i C czekają w kolejce
+    fake_rtos_hold_pending(true);
+    rk_led_hal_mock_set_hook(preempt_with_two_patterns);
+    fake_rtos_advance_ticks(pdMS_TO_TICKS(100));
+    CHECK(!rk_led_hal_mock_get_level());
+    CHECK_EQ(2, fake_rtos_pending_count());
+    CHECK_EQ(pdMS_TO_TICKS(200), fake_timer_period(fake_timer_last()));   // Kroki A nienaruszone
+    
+    // Po obsłudze kolejki gra ostatni zlecony wzorzec
+    fake_rtos_hold_pending(false);
+    fake_rtos_run_pending();
+    CHECK(rk_led_hal_mock_get_level());
+    CHECK_EQ(pdMS_TO_TICKS(900), fake_timer_period(fake_timer_last()));
+    fake_rtos_advance_ticks(pdMS_TO_TICKS(900));
+    CHECK(!rk_led_hal_mock_get_level());
+    CHECK_EQ(pdMS_TO_TICKS(700), fake_timer_period(fake_timer_last()));
+    led_idle();
+}
+
+// Zgubione polecenie stop: timer wygasa już po wyczyszczeniu wzorca
+static void test_dropped_stop(void)
+{
+    led_idle();
+    rk_led_play_pattern(&rk_led_pattern_heartbeat);
+    fake_rtos_run_pending();
+    
+    fake_timer_drop_stop(true);
+    rk_led_blink_stop();
+    fake_rtos_run_pending();
+    CHECK(fake_timer_active(fake_timer_last()));
+    
+    uint32_t edges = rk_led_hal_mock_get_edges();
+    fake_rtos_advance_ticks(pdMS_TO_TICKS(2000));
+    CHECK_EQ(edges, rk_led_hal_mock_get_edges());
+    fake_timer_drop_stop(false);
+    led_idle();
+}
+
+int main(void)
+{
+    CHECK_EQ(ESP_OK, rk_led_init());
+    
+    RUN_TEST(test_builtin_patterns);
+    RUN_TEST(test_sub_tick_durations);
+    RUN_TEST(test_custom_pattern_handover);
+    RUN_TEST(test_dropped_stop);
+    
+    return TEST_EXIT();
+}
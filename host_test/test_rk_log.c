@@ -0,0 +1,195 @@
+#include "host_test.h"
+#include "rk_metrics.h"
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+// Bufor logu binarnego (rk_log.c dołączony do testu - dostęp do pozycji i odczytu):
+// przejście liczników przez 2^32, wielu producentów naraz, koszt zapisu w gorącej
+// ścieżce względem synchronicznego ESP_LOGI na UART 115200 bodów
+#include "../components/rk_log/rk_log.c"
+
+#define PRODUCERS           4
+#define PER_PRODUCER        50000
+#define UART_BAUD           115200
+#define UART_BITS_PER_CHAR  10          // 8N1
+#define HTTP_CHUNK          1460        // HTTP_EVENT_ON_DATA - jeden wpis na fragment
+#define BENCH_CALLS         1000000
+
+rk_metric_t *rk_metrics_counter(const char *name)
+{
+    return NULL;
+}
+
+static void ring_reset(uint32_t start)
+{
+    memset(s_ring, 0, sizeof(s_ring));
+    memset(&s_stats, 0, sizeof(s_stats));
+    memset(s_limits, 0, sizeof(s_limits));
+    s_head = start;
+    s_tail = start;
+    // Komórki wolne dla okrążenia pozycji start (jak po starcie od zera)
+    for (uint32_t i = 0; i < RK_LOG_RING_LEN; i++) {
+        uint32_t pos = start + ((i - start) & LOG_RING_MASK);
+        s_ring[i].turn = turn_of(pos);
+    }
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Pozycje zapisu i odczytu przechodzą przez 2^32 przy częściowo pełnym buforze:
+// kolejność zachowana, nic nie ginie poza odrzuconymi przy pełnym buforze
+static void test_wrap_at_u32_boundary(void)
+{
+    for (uint32_t offset = 0; offset < 3; offset++) {
+        ring_reset(0xFFFFFFFFu - 200 + offset * 7);
+        
+        uint32_t attempts = 0;
+        uint32_t read = 0;
+        uint32_t last_seq = 0;
+        bool ordered = true;
+        rk_log_record_t record;
+        for (int k = 0; k < 1000; k++) {
+            for (int j = 0; j < (k % 5) + 1; j++) {
+                rk_log_write(ESP_LOG_ERROR, RK_LOG_TAG_OTA, RK_LOG_FMT_OTA_HTTP_DATA, 1,
+                             ++attempts);
+            }
+            for (int j = 0; j < (k % 3) + 1 && ring_pop(&record); j++) {
+                ordered &= read == 0 || record.args[0] > last_seq;
+                last_seq = record.args[0];
+                read++;
+            }
+        }
+        while (ring_pop(&record)) {
+            ordered &= record.args[0] > last_seq;
+            last_seq = record.args[0];
+            read++;
+        }
+        
+        CHECK(ordered);
+        CHECK(s_stats.dropped > 0);             // Bufor był pełny - ścieżka odrzucenia
+        CHECK_EQ(attempts, s_stats.written + s_stats.dropped);
+        CHECK_EQ(s_stats.written, read);
+        CHECK_EQ(s_head, s_tail);
+        CHECK(s_head < 0x1000);                 // Licznik przeszedł przez zero
+    }
+}
+
+static void *producer(void *arg)
+{
+    uint32_t id = (uint32_t)(uintptr_t)arg;
+    for (uint32_t seq = 1; seq <= PER_PRODUCER; seq++) {
+        // Przybliżone ograniczenie tempa - producenci ścigają się o komórki, a nie o miejsce
+        while (__atomic_load_n(&s_head, __ATOMIC_RELAXED) -
+               __atomic_load_n(&s_tail, __ATOMIC_RELAXED) >= RK_LOG_RING_LEN) {
+            sched_yield();
+        }
+        rk_log_write(ESP_LOG_ERROR, RK_LOG_TAG_OTA, RK_LOG_FMT_LOG_SUPPRESSED, 2, seq, id);
+    }
+    return NULL;
+}
+
+// Wielu producentów (CAS na pozycji zapisu) i jeden konsument: każdy rekord odczytany
+// raz, w kolejności zapisu danego producenta, od pozycji tuż przed przejściem przez 2^32
+static void test_concurrent_producers(void)
+{
+    ring_reset(0xFFFFFFFFu - 1000);
+    
+    pthread_t threads[PRODUCERS];
+    for (uintptr_t i = 0; i < PRODUCERS; i++) {
+        pthread_create(&threads[i], NULL, producer, (void *)i);
+    }
+    
+    // Każdy rekord jest albo odczytany, albo policzony jako odrzucony
+    uint32_t last_seq[PRODUCERS] = {0};
+    uint32_t read = 0;
+    bool ordered = true;
+    rk_log_record_t record;
+    while (read + __atomic_load_n(&s_stats.dropped, __ATOMIC_RELAXED) < PRODUCERS * PER_PRODUCER) {
+        if (ring_pop(&record)) {
+            uint32_t id = record.args[1];
+            ordered &= id < PRODUCERS && record.args[0] > last_seq[id];
+            last_seq[id] = record.args[0];
+            read++;
+        } else {
+            sched_yield();
+        }
+    }
+    for (int i = 0; i < PRODUCERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    CHECK(ordered);
+    CHECK(s_stats.written > s_stats.dropped);
+    CHECK_EQ(PRODUCERS * PER_PRODUCER, s_stats.written + s_stats.dropped);
+    CHECK_EQ(s_stats.written, read);
+    CHECK_EQ(s_head, s_tail);
+    printf("  producentów %d: zapisane %lu, odrzucone (bufor pełny) %lu\n", PRODUCERS,
+           (unsigned long)s_stats.written, (unsigned long)s_stats.dropped);
+}
+
+// Dawna ścieżka: ESP_LOGI formatuje linię w zadaniu pobierania, a konsola czeka na UART,
+// gdy FIFO nadajnika jest pełne (ciągły strumień wpisów) - czas nadania linii wliczony
+static double old_log_ns(size_t *line_len)
+{
+    char line[128];
+    int64_t start = now_ns();
+    int len = 0;
+    for (int i = 0; i < BENCH_CALLS; i++) {
+        len = snprintf(line, sizeof(line), "I (%lu) %s: " "Pobieranie firmware: %d bajtów" "\n",
+                       (unsigned long)esp_log_timestamp(), "RK_OTA", HTTP_CHUNK + (i & 1));
+    }
+    double format_ns = (double)(now_ns() - start) / BENCH_CALLS;
+    *line_len = (size_t)len;
+    return format_ns + (double)len * UART_BITS_PER_CHAR * 1e9 / UART_BAUD;
+}
+
+// Nowa ścieżka: rekord binarny w buforze; konsument nadąża (zadanie logu)
+static double new_log_ns(esp_log_level_t level)
+{
+    ring_reset(0);
+    rk_log_record_t record;
+    int64_t start = now_ns();
+    for (int i = 0; i < BENCH_CALLS; i++) {
+        RK_LOG(level, OTA, OTA_HTTP_DATA, HTTP_CHUNK + (i & 1));
+        if ((i & 31) == 31) {
+            while (ring_pop(&record)) {
+            }
+        }
+    }
+    return (double)(now_ns() - start) / BENCH_CALLS;
+}
+
+static void test_hot_path_cost(void)
+{
+    size_t line_len;
+    double old_ns = old_log_ns(&line_len);
+    double ring_ns = new_log_ns(ESP_LOG_ERROR);     // Bez limitu - każdy wpis w buforze
+    uint32_t written = s_stats.written;
+    double limited_ns = new_log_ns(ESP_LOG_INFO);   // Jak RK_LOGI w pętli pobierania
+    uint32_t suppressed = s_stats.suppressed;
+    
+    CHECK_EQ(BENCH_CALLS, written);
+    CHECK_EQ(BENCH_CALLS - RK_LOG_RATE_PER_S, suppressed);
+    CHECK(ring_ns * 100 < old_ns);
+    CHECK(limited_ns * 100 < old_ns);
+    
+    // Pułap pobierania, gdyby logowanie było jedynym kosztem fragmentu HTTP
+    printf("  ESP_LOGI (%u znaków, UART %d): %.0f ns/wpis, pułap %.0f KB/s\n",
+           (unsigned)line_len, UART_BAUD, old_ns, HTTP_CHUNK * 1e9 / old_ns / 1024);
+    printf("  rk_log_write: %.1f ns/wpis, z limitem tagu %.1f ns/wpis (host)\n",
+           ring_ns, limited_ns);
+}
+
+int main(void)
+{
+    RUN_TEST(test_wrap_at_u32_boundary);
+    RUN_TEST(test_concurrent_producers);
+    RUN_TEST(test_hot_path_cost);
+    return TEST_EXIT();
+}
@@ -0,0 +1,262 @@
+#include "host_test.h"
+#include "rk_metrics.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Czyste części rk_metrics.c: percentyle histogramów i kontrola dryfu testu długotrwałego.
+// Sterta, zasoby i liczba zadań pochodzą z atrap sterowanych przez test.
+
+static uint32_t s_heap_free = 200000;
+static uint32_t s_largest_block = 100000;
+static int32_t s_res_live[RK_RES_COUNT];
+static UBaseType_t s_task_count = 12;
+
+void rk_heap_sample(rk_heap_sample_t *sample)
+{
+    memset(sample, 0, sizeof(*sample));
+    sample->free_bytes = s_heap_free;
+    sample->largest_block = s_largest_block;
+    sample->min_free_bytes = s_heap_free;
+}
+
+int32_t rk_res_live(rk_res_type_t type)
+{
+    return s_res_live[type];
+}
+
+const char *rk_res_name(rk_res_type_t type)
+{
+    return "res";
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    return s_task_count;
+}
+
+esp_err_t rk_contention_get(rk_contention_report_t *report, bool reset)
+{
+    return ESP_ERR_INVALID_STATE;
+}
+
+void rk_mem_get_report(rk_mem_report_t *report)
+{
+    memset(report, 0, sizeof(*report));
+}
+
+const char *rk_mem_region_name(rk_mem_region_t region)
+{
+    return "sram";
+}
+
+static const uint32_t s_bounds[] = {1, 2, 5, 10, 20, 50, 100};
+#define BOUND_COUNT (sizeof(s_bounds) / sizeof(s_bounds[0]))
+
+static uint32_t s_rand = 1;
+
+static uint32_t next_rand(void)
+{
+    s_rand = s_rand * 1103515245u + 12345u;
+    return s_rand >> 8;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Koszyk dokładnego percentyla (ranga ceil(n * p / 100)) z posortowanych próbek
+static uint32_t expected_percentile(const uint32_t *sorted, uint32_t n, uint8_t pct, uint32_t max)
+{
+    uint32_t rank = (uint32_t)(((uint64_t)n * pct + 99) / 100);
+    uint32_t value = sorted[rank - 1];
+    for (size_t b = 0; b < BOUND_COUNT; b++) {
+        if (value <= s_bounds[b]) {
+            return s_bounds[b];
+        }
+    }
+    return max;
+}
+
+// Kilka milionów próbek o rozkładzie z długim ogonem - percentyl zgodny z sortowaniem
+static void test_percentile_matches_sorted(void)
+{
+    rk_metric_t *hist = rk_metrics_histogram("lat_ms", s_bounds, BOUND_COUNT);
+    CHECK(hist != NULL);
+    
+    const uint32_t n = 3000000;
+    uint32_t *samples = malloc(n * sizeof(uint32_t));
+    uint32_t max = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t r = next_rand();
+        uint32_t value = r % 100 < 90 ? r % 12 : r % 100 < 99 ? r % 90 : r % 400;
+        samples[i] = value;
+        max = value > max ? value : max;
+        rk_metrics_observe(hist, value);
+    }
+    qsort(samples, n, sizeof(uint32_t), compare_u32);
+    
+    CHECK_EQ(n, hist->value);
+    CHECK_EQ(max, hist->max);
+    for (int pct = 1; pct <= 100; pct++) {
+        CHECK_EQ(expected_percentile(samples, n, pct, max), rk_metrics_percentile(hist, pct));
+    }
+    CHECK_EQ(0, rk_metrics_percentile(hist, 0));
+    CHECK_EQ(rk_metrics_percentile(hist, 100), rk_metrics_percentile(hist, 200));
+    free(samples);
+}
+
+static void test_percentile_edges(void)
+{
+    rk_metric_t *empty = rk_metrics_histogram("empty_ms", s_bounds, BOUND_COUNT);
+    CHECK_EQ(0, rk_metrics_percentile(empty, 50));
+    CHECK_EQ(0, rk_metrics_percentile(NULL, 50));
+    CHECK_EQ(0, rk_metrics_percentile(rk_metrics_counter("not_hist"), 50));
+    CHECK(rk_metrics_histogram("too_many", s_bounds, RK_METRICS_HIST_BUCKETS) == NULL);
+    
+    // Wszystkie próbki powyżej granic - percentyl to największa próbka
+    rk_metric_t *over = rk_metrics_histogram("over_ms", s_bounds, BOUND_COUNT);
+    rk_metrics_observe(over, 150);
+    rk_metrics_observe(over, 700);
+    CHECK_EQ(700, rk_metrics_percentile(over, 50));
+    
+    // Ranga zaokrąglana w górę: p95 z 10 próbek to dziesiąta, nie dziewiąta
+    rk_metric_t *small = rk_metrics_histogram("small_ms", s_bounds, BOUND_COUNT);
+    for (int i = 0; i < 9; i++) {
+        rk_metrics_observe(small, 1);
+    }
+    rk_metrics_observe(small, 40);
+    CHECK_EQ(1, rk_metrics_percentile(small, 90));
+    CHECK_EQ(50, rk_metrics_percentile(small, 95));
+    
+    // Ponowna rejestracja zwraca ten sam slot
+    CHECK(rk_metrics_histogram("over_ms", s_bounds, BOUND_COUNT) == over);
+}
+
+static void reset_system(void)
+{
+    s_heap_free = 200000;
+    s_largest_block = 100000;
+    memset(s_res_live, 0, sizeof(s_res_live));
+    s_task_count = 12;
+}
+
+static void test_soak_drift_thresholds(void)
+{
+    rk_metrics_soak_baseline_t baseline;
+    rk_metrics_soak_report_t report;
+    reset_system();
+    s_res_live[RK_RES_HTTP_CLIENT] = 1;
+    rk_metrics_soak_baseline(&baseline);
+    
+    CHECK_EQ(ESP_OK, rk_metrics_soak_check(&baseline, &report));
+    CHECK(!report.leak && report.slow_metric == NULL);
+    
+    // Dryf sterty na granicy progu jest dopuszczalny, powyżej - wyciek
+    s_heap_free -= RK_SOAK_HEAP_DRIFT_BYTES;
+    CHECK_EQ(ESP_OK, rk_metrics_soak_check(&baseline, &report));
+    CHECK_EQ(RK_SOAK_HEAP_DRIFT_BYTES, report.heap_drift_bytes);
+    s_heap_free -= 1;
+    CHECK_EQ(ESP_FAIL, rk_metrics_soak_check(&baseline, &report));
+    CHECK(report.leak);
+    reset_system();
+    s_res_live[RK_RES_HTTP_CLIENT] = 1;
+    
+    // Zasób: przybyło - wyciek; ubyło - nie
+    s_res_live[RK_RES_HTTP_CLIENT] = 2;
+    CHECK_EQ(ESP_FAIL, rk_metrics_soak_check(&baseline, &report));
+    CHECK_EQ(1, report.res_drift[RK_RES_HTTP_CLIENT]);
+    s_res_live[RK_RES_HTTP_CLIENT] = 0;
+    CHECK_EQ(ESP_OK, rk_metrics_soak_check(&baseline, &report));
+    s_res_live[RK_RES_HTTP_CLIENT] = 1;
+    
+    s_task_count++;
+    CHECK_EQ(ESP_FAIL, rk_metrics_soak_check(&baseline, &report));
+    CHECK_EQ(1, report.task_drift);
+    s_task_count--;
+    CHECK_EQ(ESP_ERR_INVALID_ARG, rk_metrics_soak_check(NULL, &report));
+}
+
+// p95 powyżej RK_SOAK_LATENCY_FACTOR x punkt odniesienia wskazuje histogram
+static void test_soak_latency(void)
+{
+    static const uint32_t bounds[] = {10, 20, 40, 80, 160};
+    rk_metric_t *hist = rk_metrics_histogram("soak_ms", bounds, 5);
+    rk_metrics_soak_baseline_t baseline;
+    rk_metrics_soak_report_t report;
+    reset_system();
+    
+    for (int i = 0; i < 1000; i++) {
+        rk_metrics_observe(hist, 15);
+    }
+    rk_metrics_soak_baseline(&baseline);
+    
+    // p95 w koszyku 40 - dwukrotność nie przekracza progu
+    for (int i = 0; i < 1200; i++) {
+        rk_metrics_observe(hist, 35);
+    }
+    CHECK_EQ(ESP_OK, rk_metrics_soak_check(&baseline, &report));
+    
+    for (int i = 0; i < 5000; i++) {
+        rk_metrics_observe(hist, 70);
+    }
+    CHECK_EQ(ESP_FAIL, rk_metrics_soak_check(&baseline, &report));
+    CHECK(report.slow_metric != NULL && strcmp(report.slow_metric, "soak_ms") == 0);
+    CHECK(!report.leak);
+}
+
+// Przyspieszony test długotrwały: cykle z pracą i kontrolą co SOAK_EVERY cykli, wstrzyknięty
+// wyciek 8 B na cykl wykrywany na pierwszej kontroli po przekroczeniu progu
+#define SOAK_CYCLES 2000
+#define SOAK_EVERY  10
+#define LEAK_BYTES  8
+#define LEAK_FROM   300
+
+static void test_soak_detects_injected_leak(void)
+{
+    rk_metrics_soak_baseline_t baseline;
+    rk_metrics_soak_report_t report;
+    reset_system();
+    rk_metrics_soak_baseline(&baseline);
+    
+    int detected_at = -1;
+    uint32_t leaked = 0;
+    for (int cycle = 1; cycle <= SOAK_CYCLES && detected_at < 0; cycle++) {
+        // Praca cyklu oddaje zasoby i stertę; pozostaje szum sterty +-512 B i wstrzyknięty wyciek
+        s_res_live[RK_RES_HTTP_CLIENT]++;
+        s_heap_free -= 30000;
+        s_res_live[RK_RES_HTTP_CLIENT]--;
+        if (cycle >= LEAK_FROM) {
+            leaked += LEAK_BYTES;
+        }
+        int32_t noise = (int32_t)(next_rand() % 1025) - 512;
+        s_heap_free = 200000 - leaked + noise;
+        
+        // Bez wycieku kontrola nie może zgłosić dryfu
+        
+        if (cycle % SOAK_EVERY == 0 && rk_metrics_soak_check(&baseline, &report) != ESP_OK) {
+            detected_at = cycle;
+            CHECK(cycle >= LEAK_FROM);
+        }
+    }
+    
+    // Wyciek przekracza próg po (4096 + szum) / 8 cyklach od LEAK_FROM
+    int earliest = LEAK_FROM + (RK_SOAK_HEAP_DRIFT_BYTES - 512) / LEAK_BYTES;
+    int latest = LEAK_FROM + (RK_SOAK_HEAP_DRIFT_BYTES + 512) / LEAK_BYTES + SOAK_EVERY;
+    CHECK(detected_at >= earliest && detected_at <= latest);
+    CHECK(report.leak);
+}
+
+int main(void)
+{
+    CHECK_EQ(ESP_OK, rk_metrics_init());
+    
+    RUN_TEST(test_percentile_matches_sorted);
+    RUN_TEST(test_percentile_edges);
+    RUN_TEST(test_soak_drift_thresholds);
+    RUN_TEST(test_soak_latency);
+    RUN_TEST(test_soak_detects_injected_leak);
+    
+    return TEST_EXIT();
+}
@@ -0,0 +1,165 @@
+#include "host_test.h"
+#include "rk_ota.h"
+#include "rk_wifi.h"
+#include <string.h>
+#include <time.h>
+
+// Mikrobenchmark wiadomości zadań OTA i WiFi: pamięć kolejek i czas wysłania z odbiorem
+// dla dawnego układu (konfiguracja i dane logowania w wiadomości) i obecnego (sam typ,
+// konfiguracja rejestrowana raz). Kolejka kopiuje elementy jak FreeRTOS.
+
+#define QUEUE_LEN       5           // OTA_QUEUE_LEN, WIFI_QUEUE_LEN
+#define ROUNDS          5           // Wynik: najlepsza runda (najmniej zakłóceń)
+#define ITERATIONS      200000
+
+// Dawne wiadomości (przed rejestracją konfiguracji)
+typedef struct {
+    rk_ota_message_type_t type;
+    rk_ota_config_t config;
+} legacy_ota_message_t;
+
+typedef struct {
+    rk_wifi_message_type_t type;
+    char ssid[32];
+    char password[64];
+} legacy_wifi_message_t;
+
+static rk_ota_config_t s_config;            // Konfiguracja aplikacji
+static rk_ota_config_t s_registered;        // Kopia w komponencie (rk_ota_set_config)
+static volatile uint32_t s_sink;            // Odbiorca używa danych - bez eliminacji kopii
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Dawna ścieżka: nadawca kopiuje konfigurację do wiadomości, kolejka kopiuje całość dwa razy
+static void ota_legacy_round(QueueHandle_t queue)
+{
+    for (int i = 0; i < ITERATIONS; i++) {
+        legacy_ota_message_t msg = {
+            .type = RK_OTA_MSG_CHECK_UPDATE,
+        };
+        memcpy(&msg.config, &s_config, sizeof(msg.config));
+        xQueueSend(queue, &msg, 0);
+        
+        legacy_ota_message_t received;
+        xQueueReceive(queue, &received, 0);
+        s_sink += (uint8_t)received.config.github_user[i & 7];
+    }
+}
+
+// Obecna ścieżka: w kolejce sam typ, zadanie OTA bierze kopię zarejestrowanej konfiguracji
+// przed sprawdzeniem (rk_ota_get_config)
+static void ota_current_round(QueueHandle_t queue)
+{
+    for (int i = 0; i < ITERATIONS; i++) {
+        rk_ota_message_t msg = {
+            .type = RK_OTA_MSG_CHECK_UPDATE,
+        };
+        xQueueSend(queue, &msg, 0);
+        
+        rk_ota_message_t received;
+        xQueueReceive(queue, &received, 0);
+        rk_ota_config_t config;
+        memcpy(&config, &s_registered, sizeof(config));
+        s_sink += (uint8_t)config.github_user[i & 7] + received.type;
+    }
+}
+
+static void wifi_legacy_round(QueueHandle_t queue)
+{
+    for (int i = 0; i < ITERATIONS; i++) {
+        legacy_wifi_message_t msg = {
+            .type = RK_WIFI_MSG_RECONNECT,
+        };
+        strncpy(msg.ssid, s_config.github_user, sizeof(msg.ssid) - 1);
+        strncpy(msg.password, s_config.github_repo, sizeof(msg.password) - 1);
+        xQueueSend(queue, &msg, 0);
+        
+        legacy_wifi_message_t received;
+        xQueueReceive(queue, &received, 0);
+        s_sink += (uint8_t)received.ssid[i & 7];
+    }
+}
+
+// Obecna ścieżka: RECONNECT bez danych logowania (zadanie WiFi czyta zarejestrowane)
+static void wifi_current_round(QueueHandle_t queue)
+{
+    for (int i = 0; i < ITERATIONS; i++) {
+        rk_wifi_message_t msg = {
+            .type = RK_WIFI_MSG_RECONNECT,
+        };
+        xQueueSend(queue, &msg, 0);
+        
+        rk_wifi_message_t received;
+        xQueueReceive(queue, &received, 0);
+        s_sink += received.type;
+    }
+}
+
+// Najlepszy czas jednej pary wysłanie + odbiór [ns]
+static double measure(void (*round)(QueueHandle_t), size_t item_size)
+{
+    QueueHandle_t queue = fake_queue_create(QUEUE_LEN, item_size);
+    CHECK(queue != NULL);
+    
+    int64_t best = INT64_MAX;
+    for (int r = 0; r < ROUNDS; r++) {
+        int64_t start = now_ns();
+        round(queue);
+        int64_t elapsed = now_ns() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    fake_queue_delete(queue);
+    return (double)best / ITERATIONS;
+}
+
+static void report(const char *name, size_t legacy_size, size_t current_size,
+                   double legacy_ns, double current_ns)
+{
+    printf("  %s: kolejka %u x %u B = %u B -> %u x %u B = %u B, "
+           "wysłanie+odbiór %.1f ns -> %.1f ns\n",
+           name, QUEUE_LEN, (unsigned)legacy_size, (unsigned)(QUEUE_LEN * legacy_size),
+           QUEUE_LEN, (unsigned)current_size, (unsigned)(QUEUE_LEN * current_size),
+           legacy_ns, current_ns);
+}
+
+static void test_ota_queue(void)
+{
+    memset(&s_config, 'a', sizeof(s_config));
+    memcpy(&s_registered, &s_config, sizeof(s_config));
+    
+    // Pamięć: element kolejki to sam typ wiadomości
+    CHECK_EQ(sizeof(rk_ota_message_type_t), sizeof(rk_ota_message_t));
+    CHECK(sizeof(legacy_ota_message_t) >= sizeof(rk_ota_config_t));
+    
+    double legacy_ns = measure(ota_legacy_round, sizeof(legacy_ota_message_t));
+    double current_ns = measure(ota_current_round, sizeof(rk_ota_message_t));
+    report("OTA", sizeof(legacy_ota_message_t), sizeof(rk_ota_message_t), legacy_ns, current_ns);
+    
+    // Jedna kopia konfiguracji zamiast trzech
+    CHECK(current_ns < legacy_ns);
+}
+
+static void test_wifi_queue(void)
+{
+    CHECK_EQ(sizeof(rk_wifi_message_type_t), sizeof(rk_wifi_message_t));
+    
+    double legacy_ns = measure(wifi_legacy_round, sizeof(legacy_wifi_message_t));
+    double current_ns = measure(wifi_current_round, sizeof(rk_wifi_message_t));
+    report("WiFi", sizeof(legacy_wifi_message_t), sizeof(rk_wifi_message_t), legacy_ns, current_ns);
+    
+    CHECK(current_ns < legacy_ns);
+}
+
+int main(void)
+{
+    RUN_TEST(test_ota_queue);
+    RUN_TEST(test_wifi_queue);
+    return TEST_EXIT();
+}
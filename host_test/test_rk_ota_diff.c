@@ -0,0 +1,202 @@
+#include "host_test.h"
+#include "fake_partition.h"
+#include "rk_ota_priv.h"
+#include "esp_timer.h"
+#include <string.h>
+
+// Zapis różnicowy (rk_ota_diff.c) na partycji z pliku: klasyfikacja sektorów, wynik zapisu,
+// kontrola partycji docelowej i zysk czasu względem kasowania całego obrazu
+
+#define SECTOR          SPI_FLASH_SEC_SIZE
+#define PART_SIZE       (64 * SECTOR)
+#define IMAGE_LEN       (16 * SECTOR + 1000)
+#define IMAGE_SECTORS   ((IMAGE_LEN + SECTOR - 1) / SECTOR)
+#define CHUNK           1460        // Typowy rozmiar odczytu z TCP - sektory składane z kawałków
+
+rk_ota_stats_t rk_ota_stats;
+
+static esp_partition_t *s_running;
+static esp_partition_t *s_target;
+static uint8_t s_old[IMAGE_LEN];
+static uint8_t s_new[IMAGE_LEN];
+
+static void make_image(uint8_t *image, uint32_t seed)
+{
+    for (uint32_t i = 0; i < IMAGE_LEN; i++) {
+        seed = seed * 1103515245u + 12345u;
+        image[i] = (uint8_t)(seed >> 16);
+    }
+    fake_image_seal(image, IMAGE_LEN);
+}
+
+static void flash_old_image(void)
+{
+    esp_partition_erase_range(s_target, 0, PART_SIZE);
+    esp_partition_write(s_target, 0, s_old, IMAGE_LEN);
+    fake_partition_reset_stats(s_target);
+}
+
+static esp_err_t diff_write_image(const uint8_t *image, uint32_t len)
+{
+    esp_err_t err = rk_ota_diff_begin(s_target, len);
+    for (uint32_t pos = 0; err == ESP_OK && pos < len; pos += CHUNK) {
+        err = rk_ota_diff_write(image + pos, len - pos < CHUNK ? len - pos : CHUNK);
+    }
+    if (err != ESP_OK) {
+        rk_ota_diff_abort();
+        return err;
+    }
+    return rk_ota_diff_end();
+}
+
+// Ustawienie bitu 0->1 - sektor wymaga kasowania
+static void set_zero_bit(uint32_t pos)
+{
+    while (s_old[pos] == 0xFF) {
+        pos++;
+    }
+    s_new[pos] = s_old[pos] | (uint8_t)(~s_old[pos] & (s_old[pos] + 1));
+}
+
+// Nowa wersja: sektor 3 tylko zeruje bity, 7 i 10 ustawiają bity, reszta bez zmian
+static void make_new_image(void)
+{
+    memcpy(s_new, s_old, IMAGE_LEN);
+    for (uint32_t i = 3 * SECTOR + 100; i < 3 * SECTOR + 400; i++) {
+        s_new[i] &= 0x0F;
+    }
+    set_zero_bit(7 * SECTOR + 5);
+    set_zero_bit(10 * SECTOR + 4000);
+    fake_image_seal(s_new, IMAGE_LEN);
+}
+
+static void check_sector_actions(void)
+{
+    // Ostatni sektor zawiera skrót obrazu - zmienia się zawsze, klasyfikacja zależy od bitów
+    uint32_t last = IMAGE_SECTORS - 1;
+    for (uint32_t sector = 1; sector < last; sector++) {
+        const fake_sector_stats_t *stats = fake_partition_sector(s_target, sector);
+        bool rewrite = sector == 7 || sector == 10;
+        CHECK_EQ(rewrite ? 1 : 0, stats->erases);
+        CHECK_EQ(rewrite || sector == 3 ? 1 : 0, stats->writes);
+    }
+    
+    CHECK_EQ(IMAGE_SECTORS, rk_ota_stats.diff_sectors_skipped + rk_ota_stats.diff_sectors_programmed +
+                            rk_ota_stats.diff_sectors_written);
+    CHECK(rk_ota_stats.diff_sectors_programmed >= 1);
+    CHECK(rk_ota_stats.diff_sectors_written >= 2 && rk_ota_stats.diff_sectors_written <= 4);
+    CHECK(rk_ota_stats.diff_sectors_skipped >= IMAGE_SECTORS - 5);
+    CHECK_EQ(0, memcmp(fake_partition_data(s_target), s_new, IMAGE_LEN));
+}
+
+static void test_diff_over_old_image(void)
+{
+    flash_old_image();
+    make_new_image();
+    
+    CHECK_EQ(ESP_OK, diff_write_image(s_new, IMAGE_LEN));
+    check_sector_actions();
+    CHECK(rk_ota_stats.diff_saved_ms > 0);
+}
+
+// Bez wolnych stron MMU porównanie idzie przez esp_partition_read - te same decyzje
+static void test_diff_without_mmap(void)
+{
+    flash_old_image();
+    make_new_image();
+    
+    fake_partition_fail_mmap(true);
+    CHECK_EQ(ESP_OK, diff_write_image(s_new, IMAGE_LEN));
+    fake_partition_fail_mmap(false);
+    check_sector_actions();
+}
+
+// Partycja wymazana: wszystkie sektory tylko programowane, bez kasowania
+static void test_diff_over_blank(void)
+{
+    esp_partition_erase_range(s_target, 0, PART_SIZE);
+    fake_partition_reset_stats(s_target);
+    
+    CHECK_EQ(ESP_OK, diff_write_image(s_new, IMAGE_LEN));
+    CHECK_EQ(IMAGE_SECTORS, rk_ota_stats.diff_sectors_programmed);
+    CHECK_EQ(0, rk_ota_stats.diff_sectors_written);
+    for (uint32_t sector = 0; sector < IMAGE_SECTORS; sector++) {
+        CHECK_EQ(0, fake_partition_sector(s_target, sector)->erases);
+    }
+    CHECK_EQ(0, memcmp(fake_partition_data(s_target), s_new, IMAGE_LEN));
+}
+
+static void test_corrupt_image_rejected(void)
+{
+    flash_old_image();
+    make_new_image();
+    s_new[5 * SECTOR] ^= 0x01;     // Zmiana po wyliczeniu skrótu
+    
+    CHECK_EQ(ESP_ERR_OTA_VALIDATE_FAILED, diff_write_image(s_new, IMAGE_LEN));
+    
+    uint8_t bad_header[16] = {0x00};
+    CHECK_EQ(ESP_OK, rk_ota_diff_begin(s_target, IMAGE_LEN));
+    CHECK_EQ(ESP_ERR_OTA_VALIDATE_FAILED, rk_ota_diff_write(bad_header, sizeof(bad_header)));
+    rk_ota_diff_abort();
+}
+
+// Ta sama ochrona co w esp_ota_begin: obraz niepotwierdzony i partycja uruchomiona
+static void test_target_guard(void)
+{
+    flash_old_image();
+    make_new_image();
+    
+    fake_ota_set_running(s_running, ESP_OTA_IMG_PENDING_VERIFY);
+    CHECK_EQ(ESP_ERR_OTA_ROLLBACK_INVALID_STATE, rk_ota_diff_begin(s_target, IMAGE_LEN));
+    CHECK_EQ(ESP_ERR_INVALID_STATE, rk_ota_diff_write(s_new, CHUNK));
+    CHECK_EQ(0, memcmp(fake_partition_data(s_target), s_old, IMAGE_LEN));   // Cel wycofania nietknięty
+    
+    fake_ota_set_running(s_running, ESP_OTA_IMG_VALID);
+    CHECK_EQ(ESP_ERR_OTA_PARTITION_CONFLICT, rk_ota_diff_begin(s_running, IMAGE_LEN));
+    CHECK_EQ(ESP_OK, rk_ota_check_target(s_target));
+}
+
+// Czas zapisu (symulowane kasowanie i zapis) wobec pełnego kasowania i zapisu obrazu
+static void test_speedup(void)
+{
+    flash_old_image();
+    make_new_image();
+    
+    int64_t start_us = esp_timer_get_time();
+    CHECK_EQ(ESP_OK, diff_write_image(s_new, IMAGE_LEN));
+    int64_t diff_us = esp_timer_get_time() - start_us;
+    
+    flash_old_image();
+    start_us = esp_timer_get_time();
+    esp_partition_erase_range(s_target, 0, IMAGE_SECTORS * SECTOR);
+    esp_partition_write(s_target, 0, s_new, IMAGE_LEN);
+    int64_t full_us = esp_timer_get_time() - start_us;
+    
+    printf("     zapis pełny %lld ms, różnicowy %lld ms (x%.1f), szacunek oszczędności %lu ms\n",
+           (long long)(full_us / 1000), (long long)(diff_us / 1000), (double)full_us / diff_us,
+           (unsigned long)rk_ota_stats.diff_saved_ms);
+    CHECK(diff_us * 3 < full_us);
+    // Szacunek z rk_ota_diff_end zgodny z faktyczną różnicą co do jednego sektora
+    int64_t error_ms = (full_us - diff_us) / 1000 - rk_ota_stats.diff_saved_ms;
+    CHECK(error_ms > -(FAKE_ERASE_US + FAKE_WRITE_US) / 1000 && error_ms < (FAKE_ERASE_US + FAKE_WRITE_US) / 1000);
+}
+
+int main(void)
+{
+    s_running = fake_partition_create("ota_0", 0x10000, PART_SIZE);
+    s_target = fake_partition_create("ota_1", 0x10000 + PART_SIZE, PART_SIZE);
+    fake_ota_set_running(s_running, ESP_OTA_IMG_VALID);
+    make_image(s_old, 1);
+    make_new_image();
+    
+    RUN_TEST(test_diff_over_old_image);
+    RUN_TEST(test_diff_without_mmap);
+    RUN_TEST(test_diff_over_blank);
+    RUN_TEST(test_corrupt_image_rejected);
+    RUN_TEST(test_target_guard);
+    RUN_TEST(test_speedup);
+    
+    fake_partition_destroy(s_target);
+    fake_partition_destroy(s_running);
+    return TEST_EXIT();
+}
@@ -0,0 +1,253 @@
+#include "host_test.h"
+#include "rk_ota_priv.h"
+#include "esp_timer.h"
+#include <string.h>
+
+// Kanał powiadomień (rk_ota_notify.c) przeciw serwerowi long-poll w czasie symulowanym:
+// opóźnienie od publikacji wersji do sprawdzenia OTA i liczba zapytań na godzinę
+// w porównaniu z odpytywaniem co OTA_CHECK_INTERVAL_MIN (main.c), przerwa serwera
+
+#define HOUR_US             (3600LL * 1000000)
+#define RTT_US              80000           // Odpowiedź serwera po publikacji
+#define CONNECT_FAIL_US     3000000         // Nieudane połączenie (odmowa/timeout TCP)
+#define POLL_INTERVAL_S     (5 * 60)        // OTA_CHECK_INTERVAL_MIN w main.c
+#define PUBLISH_MAX         8
+
+rk_ota_stats_t rk_ota_stats;
+int64_t rk_ota_notify_received_us;
+
+// Serwer: publikacje wersji i przerwa, w której połączenia są odrzucane
+static int64_t s_publish_us[PUBLISH_MAX];
+static int s_publish_count;
+static int s_delivered;                     // Publikacje zgłoszone urządzeniu
+static int64_t s_outage_from_us;
+static int64_t s_outage_to_us;
+static int64_t s_stop_at_us;                // Koniec symulacji - zatrzymanie kanału
+static int s_status;                        // Odpowiedź bieżącego zapytania
+
+// Urządzenie: chwile zlecenia sprawdzenia OTA
+static int64_t s_check_us[PUBLISH_MAX];
+static int s_check_count;
+
+static int64_t now_us(void)
+{
+    return esp_timer_get_time();
+}
+
+static void server_reset(void)
+{
+    memset(&rk_ota_stats, 0, sizeof(rk_ota_stats));
+    s_publish_count = 0;
+    s_delivered = 0;
+    s_outage_from_us = -1;
+    s_outage_to_us = -1;
+    s_check_count = 0;
+}
+
+static void publish_at(int64_t at_us)
+{
+    s_publish_us[s_publish_count++] = at_us;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    return (esp_http_client_handle_t)&s_status;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key,
+                                     const char *value)
+{
+    return ESP_OK;
+}
+
+// Zapytanie trzymane do publikacji lub RK_OTA_NOTIFY_HOLD_S; czas płynie w trakcie
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    int64_t start = now_us();
+    if (start >= s_stop_at_us) {
+        rk_ota_stop_notify_channel();
+    }
+    if (start >= s_outage_from_us && start < s_outage_to_us) {
+        fake_timer_add_us(CONNECT_FAIL_US);
+        return ESP_FAIL;
+    }
+    
+    int64_t hold_end = start + RK_OTA_NOTIFY_HOLD_S * 1000000LL;
+    if (s_delivered < s_publish_count && s_publish_us[s_delivered] < hold_end) {
+        int64_t at = s_publish_us[s_delivered] > start ? s_publish_us[s_delivered] : start;
+        fake_timer_add_us(at - start + RTT_US);
+        s_delivered++;
+        s_status = 200;
+    } else {
+        fake_timer_add_us(hold_end - start);
+        s_status = 204;
+    }
+    return ESP_OK;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    return 0;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return s_status;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    return 0;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    return ESP_OK;
+}
+
+void rk_ota_trust_apply(esp_http_client_config_t *http_config, bool use_bundle)
+{
+}
+
+bool rk_ota_trust_can_fall_back(bool use_bundle)
+{
+    return false;
+}
+
+bool rk_ota_trust_starts_with_bundle(void)
+{
+    return false;
+}
+
+bool rk_ota_get_config(rk_ota_config_t *config)
+{
+    return true;
+}
+
+const char *rk_ota_get_version(void)
+{
+    return "1.0.0";
+}
+
+// WiFi stale połączone
+EventGroupHandle_t rk_ota_get_wifi_event_group(void)
+{
+    static EventGroupHandle_t group = NULL;
+    if (group == NULL) {
+        group = xEventGroupCreate();
+        xEventGroupSetBits(group, RK_WIFI_CONNECTED_BIT);
+    }
+    return group;
+}
+
+esp_err_t rk_ota_send_message(const rk_ota_message_t *msg)
+{
+    if (msg->type == RK_OTA_MSG_CHECK_UPDATE && s_check_count < PUBLISH_MAX) {
+        s_check_us[s_check_count++] = now_us();
+    }
+    return ESP_OK;
+}
+
+static void run_channel_until(int64_t stop_at_us)
+{
+    s_stop_at_us = stop_at_us;
+    CHECK_EQ(ESP_OK, rk_ota_start_notify_channel("http://notify.local/wait"));
+    fake_task_run_ready();
+    CHECK(!rk_ota_notify_channel_is_up());
+}
+
+// Odpytywanie: publikacja widoczna przy pierwszym sprawdzeniu po niej
+static int64_t polling_latency_us(int64_t publish_us)
+{
+    int64_t interval = POLL_INTERVAL_S * 1000000LL;
+    return (publish_us / interval + 1) * interval - publish_us;
+}
+
+static void test_latency_and_requests_per_hour(void)
+{
+    server_reset();
+    publish_at(7 * 60 * 1000000LL + 300000);
+    publish_at(19 * 60 * 1000000LL + 41000000);
+    publish_at(33 * 60 * 1000000LL + 5000000);
+    publish_at(41 * 60 * 1000000LL + 58000000);
+    publish_at(52 * 60 * 1000000LL + 12000000);
+    
+    run_channel_until(HOUR_US);
+    
+    CHECK_EQ(s_publish_count, s_check_count);
+    CHECK_EQ(s_publish_count, rk_ota_stats.checks_from_notify);
+    CHECK_EQ(s_publish_count, rk_ota_stats.notify_events);
+    CHECK_EQ(0, rk_ota_stats.notify_errors);
+    
+    int64_t notify_max = 0;
+    int64_t notify_sum = 0;
+    int64_t poll_sum = 0;
+    for (int i = 0; i < s_check_count; i++) {
+        int64_t latency = s_check_us[i] - s_publish_us[i];
+        notify_sum += latency;
+        poll_sum += polling_latency_us(s_publish_us[i]);
+        if (latency > notify_max) {
+            notify_max = latency;
+        }
+    }
+    CHECK(notify_max <= RTT_US);
+    CHECK(poll_sum / s_publish_count > 60 * 1000000LL);
+    
+    // Zapytania: puste long-poll co RK_OTA_NOTIFY_HOLD_S plus jedno na publikację;
+    // API wydań tylko po powiadomieniu zamiast co POLL_INTERVAL_S
+    uint32_t polls_per_hour = 3600 / POLL_INTERVAL_S;
+    uint32_t idle_requests = 3600 / RK_OTA_NOTIFY_HOLD_S;
+    CHECK(rk_ota_stats.notify_requests >= idle_requests);
+    CHECK(rk_ota_stats.notify_requests <= idle_requests + s_publish_count + 1);
+    CHECK(rk_ota_stats.checks_from_notify < polls_per_hour);
+    
+    printf("  publikacja -> sprawdzenie: long-poll śr. %lld ms (maks. %lld ms), "
+           "odpytywanie co %d s śr. %lld s\n",
+           notify_sum / s_publish_count / 1000, notify_max / 1000, POLL_INTERVAL_S,
+           poll_sum / s_publish_count / 1000000);
+    printf("  na godzinę: zapytania long-poll %lu, sprawdzenia API %lu "
+           "(odpytywanie: %lu sprawdzeń API)\n",
+           (unsigned long)rk_ota_stats.notify_requests,
+           (unsigned long)rk_ota_stats.checks_from_notify, (unsigned long)polls_per_hour);
+}
+
+// Przerwa serwera: ponowienia z wydłużanym odstępem, publikacja z przerwy
+// dostarczona najpóźniej RK_OTA_NOTIFY_RETRY_MAX_S po powrocie serwera
+static void test_server_outage_backoff(void)
+{
+    server_reset();
+    s_outage_from_us = 10 * 60 * 1000000LL;
+    s_outage_to_us = 20 * 60 * 1000000LL;
+    publish_at(15 * 60 * 1000000LL);
+    publish_at(40 * 60 * 1000000LL);
+    
+    run_channel_until(HOUR_US);
+    
+    CHECK_EQ(2, s_check_count);
+    CHECK(s_check_us[0] >= s_outage_to_us);
+    CHECK(s_check_us[0] - s_outage_to_us <=
+          (RK_OTA_NOTIFY_RETRY_MAX_S + RK_OTA_NOTIFY_HOLD_S) * 1000000LL);
+    CHECK(s_check_us[1] - s_publish_us[1] <= RTT_US);
+    
+    // Odstępy 5, 10, 20 ... 300 s: w 10 minutach przerwy kilka prób, nie setki
+    uint32_t outage_s = (uint32_t)((s_outage_to_us - s_outage_from_us) / 1000000);
+    CHECK(rk_ota_stats.notify_errors >= 3);
+    CHECK(rk_ota_stats.notify_errors <= 10);
+    CHECK(rk_ota_stats.notify_errors < outage_s / RK_OTA_NOTIFY_RETRY_MIN_S);
+    
+    printf("  przerwa %lu s: nieudanych prób %lu, publikacja z przerwy po %lld s\n",
+           (unsigned long)outage_s, (unsigned long)rk_ota_stats.notify_errors,
+           (s_check_us[0] - s_publish_us[0]) / 1000000);
+}
+
+int main(void)
+{
+    RUN_TEST(test_latency_and_requests_per_hour);
+    RUN_TEST(test_server_outage_backoff);
+    return TEST_EXIT();
+}
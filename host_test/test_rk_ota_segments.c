@@ -0,0 +1,299 @@
+#include "host_test.h"
+#include "fake_partition.h"
+#include "rk_ota_priv.h"
+#include "esp_heap_caps.h"
+#include <string.h>
+
+// Pobieranie segmentami (rk_ota_segments.c) z serwera Range o dużym RTT: przepustowość
+// dla 1..RK_OTA_SEGMENTS_MAX połączeń, złożenie obrazu, wznowienie zerwanego segmentu.
+// Każde połączenie ma własny zegar (połączenia działają równolegle): strumień TCP
+// dostarcza okno odbiorcze na RTT, otwarcie kosztuje uzgodnienie TCP + TLS i opóźnienie
+// serwera. Czas zapisu flash pominięty - mierzona jest tylko sieć.
+
+#define IMAGE_LEN           (1024 * 1024)
+#define PART_SIZE           (IMAGE_LEN + 16 * SPI_FLASH_SEC_SIZE)
+#define RTT_US              150000
+#define TCP_WINDOW          5744            // CONFIG_LWIP_TCP_WND_DEFAULT (4 x MSS)
+#define HANDSHAKE_RTTS      3               // TCP + TLS 1.2
+#define SERVER_DELAY_US     200000          // Serwer do pierwszego bajtu odpowiedzi
+#define CONN_MAX            8
+
+rk_ota_stats_t rk_ota_stats;
+
+typedef struct {
+    bool used;
+    int64_t clock_us;           // Zegar połączenia od początku pobierania
+    uint32_t from;              // Zakres z nagłówka Range (bez nagłówka - cały obraz)
+    uint32_t to;
+    bool ranged;
+    uint32_t pos;
+    uint32_t window_left;
+    int status;
+    uint32_t drop_at;           // Zerwanie połączenia po tym bajcie (0 - bez zerwania)
+} fake_conn_t;
+
+static uint8_t s_image[IMAGE_LEN];
+static esp_partition_t *s_target;
+static fake_conn_t s_conns[CONN_MAX];
+static int s_opened;
+static uint32_t s_drop_next_range_at;       // Zerwanie pierwszego połączenia Range
+static size_t s_heap_free;
+static size_t s_heap_largest;
+
+static int64_t latest_clock_us(void)
+{
+    int64_t latest = 0;
+    for (int i = 0; i < CONN_MAX; i++) {
+        if (s_conns[i].used && s_conns[i].clock_us > latest) {
+            latest = s_conns[i].clock_us;
+        }
+    }
+    return latest;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    for (int i = 0; i < CONN_MAX; i++) {
+        if (!s_conns[i].used) {
+            memset(&s_conns[i], 0, sizeof(s_conns[i]));
+            s_conns[i].used = true;
+            s_conns[i].to = IMAGE_LEN - 1;
+            return (esp_http_client_handle_t)&s_conns[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    return ESP_OK;      // Zegar zostaje do końca pomiaru
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key,
+                                     const char *value)
+{
+    fake_conn_t *conn = (fake_conn_t *)client;
+    unsigned long from;
+    unsigned long to;
+    if (strcmp(key, "Range") == 0 && sscanf(value, "bytes=%lu-%lu", &from, &to) == 2) {
+        conn->from = from;
+        conn->to = to;
+        conn->ranged = true;
+    }
+    return ESP_OK;
+}
+
+// Zadania pomocnicze startują razem z pobieraniem; zadanie OTA otwiera połączenie
+// po zakończeniu wszystkich wcześniejszych (ponowienie segmentu)
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    fake_conn_t *conn = (fake_conn_t *)client;
+    int64_t start = fake_task_is_main() ? latest_clock_us() : 0;
+    conn->clock_us = start + HANDSHAKE_RTTS * RTT_US + SERVER_DELAY_US;
+    conn->pos = conn->from;
+    conn->status = conn->ranged ? 206 : 200;
+    if (conn->ranged && s_drop_next_range_at > 0) {
+        conn->drop_at = conn->from + s_drop_next_range_at;
+        s_drop_next_range_at = 0;
+    }
+    s_opened++;
+    return ESP_OK;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    fake_conn_t *conn = (fake_conn_t *)client;
+    return (int64_t)conn->to - conn->from + 1;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return ((fake_conn_t *)client)->status;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    fake_conn_t *conn = (fake_conn_t *)client;
+    uint32_t end = conn->drop_at > 0 ? conn->drop_at : conn->to + 1;
+    if (conn->pos >= end) {
+        return 0;
+    }
+    if (conn->window_left == 0) {
+        conn->clock_us += RTT_US;
+        conn->window_left = TCP_WINDOW;
+    }
+    uint32_t n = (uint32_t)len;
+    if (n > conn->window_left) {
+        n = conn->window_left;
+    }
+    if (n > end - conn->pos) {
+        n = end - conn->pos;
+    }
+    memcpy(buffer, s_image + conn->pos, n);
+    conn->pos += n;
+    conn->window_left -= n;
+    return (int)n;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    return ESP_OK;
+}
+
+bool rk_ota_dns_rewrite_url(const char *url, char *connect_url, size_t url_len,
+                            char *host, size_t host_len, char *authority, size_t authority_len)
+{
+    strncpy(connect_url, url, url_len - 1);
+    connect_url[url_len - 1] = '\0';
+    host[0] = '\0';
+    authority[0] = '\0';
+    return false;
+}
+
+void rk_ota_dns_evict(const char *host)
+{
+}
+
+void rk_ota_trust_apply(esp_http_client_config_t *http_config, bool use_bundle)
+{
+}
+
+void rk_ota_set_request_headers(esp_http_client_handle_t client, const char *authority,
+                                bool host_override, bool use_token)
+{
+}
+
+bool rk_ota_preerase_is_clean(const esp_partition_t *partition, uint32_t offset)
+{
+    return false;
+}
+
+bool rk_ota_cancel_requested(void)
+{
+    return false;
+}
+
+void rk_ota_set_progress(rk_ota_state_t state, uint32_t bytes, uint32_t total)
+{
+}
+
+void *rk_mem_alloc(size_t size, rk_mem_class_t mem_class)
+{
+    return malloc(size);
+}
+
+void rk_mem_free(void *ptr)
+{
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return s_heap_free;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return s_heap_largest;
+}
+
+static void download_reset(void)
+{
+    memset(s_conns, 0, sizeof(s_conns));
+    memset(&rk_ota_stats, 0, sizeof(rk_ota_stats));
+    s_opened = 0;
+    s_drop_next_range_at = 0;
+    esp_partition_erase_range(s_target, 0, PART_SIZE);
+}
+
+// Pobranie jak w zadaniu OTA: pierwsze połączenie bez Range, potem segmenty
+static esp_err_t download(int connections, int *received)
+{
+    esp_http_client_config_t config = {
+        .url = "https://example.com/fw.bin",
+    };
+    esp_http_client_handle_t first = esp_http_client_init(&config);
+    esp_http_client_open(first, 0);
+    
+    static uint8_t buffer[RK_OTA_BUFFER_SIZE];
+    return rk_ota_segments_download(first, config.url, false, false, s_target, IMAGE_LEN,
+                                    connections, buffer, sizeof(buffer), received);
+}
+
+static void test_throughput_scaling(void)
+{
+    uint32_t kbps[RK_OTA_SEGMENTS_MAX + 1] = {0};
+    
+    for (int connections = 1; connections <= RK_OTA_SEGMENTS_MAX; connections++) {
+        download_reset();
+        int received = 0;
+        CHECK_EQ(ESP_OK, download(connections, &received));
+        CHECK_EQ(IMAGE_LEN, received);
+        CHECK_EQ(connections, s_opened);
+        CHECK_EQ(0, rk_ota_stats.download_segment_retries);
+        CHECK_EQ(0, memcmp(fake_partition_data(s_target), s_image, IMAGE_LEN));
+        
+        int64_t elapsed_us = latest_clock_us();
+        kbps[connections] = (uint32_t)((int64_t)IMAGE_LEN * 1000000 / elapsed_us / 1024);
+        printf("  połączeń %d: %lld ms, %lu KB/s\n", connections, elapsed_us / 1000,
+               (unsigned long)kbps[connections]);
+    }
+    
+    // Strumień ograniczony oknem: przepustowość rośnie prawie liniowo,
+    // mniej o uzgodnienia nowych połączeń
+    CHECK(kbps[1] * 18 / 10 < kbps[2]);
+    CHECK(kbps[1] * 3 < kbps[RK_OTA_SEGMENTS_MAX]);
+    for (int connections = 2; connections <= RK_OTA_SEGMENTS_MAX; connections++) {
+        CHECK(kbps[connections - 1] < kbps[connections]);
+    }
+}
+
+// Zerwany segment pomocniczy dokańczany przez zadanie OTA od miejsca przerwania
+static void test_dropped_segment_resumed(void)
+{
+    download_reset();
+    s_drop_next_range_at = 70000;
+    
+    int received = 0;
+    CHECK_EQ(ESP_OK, download(RK_OTA_SEGMENTS_MAX, &received));
+    CHECK_EQ(IMAGE_LEN, received);
+    CHECK_EQ(1, rk_ota_stats.download_segment_retries);
+    CHECK_EQ(RK_OTA_SEGMENTS_MAX + 1, s_opened);
+    CHECK_EQ(0, memcmp(fake_partition_data(s_target), s_image, IMAGE_LEN));
+}
+
+static void test_plan_from_heap(void)
+{
+    s_heap_largest = 64 * 1024;
+    
+    s_heap_free = RK_OTA_SEGMENT_HEAP_RESERVE + 2 * RK_OTA_SEGMENT_HEAP_COST + 100;
+    CHECK_EQ(3, rk_ota_segments_plan(IMAGE_LEN));
+    
+    s_heap_free = 4 * 1024 * 1024;
+    CHECK_EQ(RK_OTA_SEGMENTS_MAX, rk_ota_segments_plan(IMAGE_LEN));
+    CHECK_EQ(1, rk_ota_segments_plan(RK_OTA_SEGMENTS_MIN_IMAGE - 1));
+    
+    s_heap_free = RK_OTA_SEGMENT_HEAP_RESERVE;
+    CHECK_EQ(1, rk_ota_segments_plan(IMAGE_LEN));
+    
+    s_heap_free = 4 * 1024 * 1024;
+    s_heap_largest = 8 * 1024;      // Sterta pofragmentowana - brak bloku na bufor TLS
+    CHECK_EQ(1, rk_ota_segments_plan(IMAGE_LEN));
+}
+
+int main(void)
+{
+    uint32_t seed = 12345;
+    for (uint32_t i = 0; i < IMAGE_LEN; i++) {
+        seed = seed * 1103515245u + 12345u;
+        s_image[i] = (uint8_t)(seed >> 16);
+    }
+    s_target = fake_partition_create("ota_1", 0x200000, PART_SIZE);
+    
+    RUN_TEST(test_throughput_scaling);
+    RUN_TEST(test_dropped_segment_resumed);
+    RUN_TEST(test_plan_from_heap);
+    
+    fake_partition_destroy(s_target);
+    return TEST_EXIT();
+}
@@ -0,0 +1,1203 @@
+#include "host_test.h"
+#include "rk_common.h"
+#include "rk_metrics.h"
+#include "rk_led.h"
+#include "rk_wifi.h"
+#include "rk_ota.h"
+#include "rk_ota_priv.h"
+#include "rk_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_heap_caps.h"
+#include "esp_ota_ops.h"
+#include "freertos/event_groups.h"
+#include <string.h>
+#include <time.h>
+
+// Test długotrwały: prawdziwe rk_common, rk_metrics, rk_led, rk_wifi i rk_ota przez kilka
+// symulowanych dni. Sterownik WiFi z pętlą zdarzeń (zrywanie łącza, awarie AP, nieudane
+// szybkie łączenie) i lokalny serwer HTTP wstrzykujący błędy (brak połączenia, timeout,
+// 404, 403, 5xx, ucięta treść, zawieszony odczyt). Aplikacja jak main.c: LED z callbacków,
+// cykliczne CHECK i FORCE, zatrzymanie i ponowny start zadań. Co okno kontrola dryfu:
+// sterta, zadania, kolejki, zasoby rk_res, klienci HTTP, uchwyty OTA i p95 opóźnień.
+
+#define SOAK_DAYS               4
+#define SOAK_WARMUP_S           (6 * 3600)
+#define SOAK_WINDOW_S           (6 * 3600)      // Kontrola dryfu co okno
+#define SOAK_EVENTS_MIN         1000000
+#define CHECK_PERIOD_S          300             // Jak OTA_CHECK_INTERVAL_MIN w main.c
+#define FORCE_PERIOD_S          (47 * 60)
+#define FLAP_PERIOD_S           (2 * 3600 + 600)    // rk_wifi_disconnect z aplikacji
+#define RESTART_PERIOD_S        (3 * 3600 + 1200)   // Zatrzymanie i start zadań
+#define PUBLISH_PERIOD_S        (19 * 3600)         // Nowa wersja obrazu na serwerze
+#define LED_ON_MS               250
+#define LED_OFF_MS              250
+
+// Sterownik WiFi i AP
+#define CONNECT_MIN_MS          700
+#define CONNECT_SPREAD_MS       600
+#define CONNECT_FAIL_PCT        8
+#define FAST_FAIL_PCT           10              // AP zmienił kanał - szybkie łączenie pada
+#define DROP_MIN_S              (20 * 60)
+#define DROP_SPREAD_S           (50 * 60)
+#define OUTAGE_MIN_S            (16 * 3600)
+#define OUTAGE_SPREAD_S         (16 * 3600)
+#define OUTAGE_LEN_MIN_S        120
+#define OUTAGE_LEN_SPREAD_S     480
+#define EVENT_QUEUE_LEN         32              // CONFIG_ESP_SYSTEM_EVENT_QUEUE_SIZE
+
+// Serwer HTTP i sterta
+#define HTTP_CLIENTS_MAX        4
+#define HTTP_OPEN_MS            400             // TCP + TLS
+#define HTTP_NO_ROUTE_MS        50
+#define HTTP_REFUSED_MS         3000
+#define HTTP_BYTES_PER_S        (160 * 1024)
+#define IMAGE_LEN               (320 * 1024)
+#define CONFIG_LEN              200
+#define HEAP_TOTAL              (280 * 1024)
+#define HEAP_HTTP_CLIENT        (5 * 1024)      // Klient z buforami nagłówków
+#define HEAP_TLS_SESSION        (40 * 1024)
+#define HEAP_OTA_HANDLE         1024
+
+typedef enum {
+    FAULT_NONE,
+    FAULT_CONNECT,      // Połączenie odrzucone
+    FAULT_TIMEOUT,      // Brak odpowiedzi do timeout_ms
+    FAULT_404,
+    FAULT_403,
+    FAULT_5XX,
+    FAULT_TRUNCATE,     // Serwer zamyka połączenie w połowie treści
+    FAULT_STALL,        // Treść przestaje płynąć - odczyt kończy się po timeout_ms
+    FAULT_COUNT
+} fault_t;
+
+// Udział błędów w zapytaniach [%]
+static const uint8_t s_fault_pct[FAULT_COUNT] = {74, 4, 3, 4, 3, 5, 4, 3};
+static const char *const s_fault_names[FAULT_COUNT] = {
+    "ok", "odrzucone", "timeout", "404", "403", "5xx", "ucięte", "zawieszone",
+};
+
+struct esp_http_client {
+    bool used;
+    bool connected;
+    bool config_file;           // config.json zamiast obrazu
+    http_event_handle_cb handler;
+    void *user_data;
+    int timeout_ms;
+    char if_none_match[48];
+    fault_t fault;
+    int status;
+    int length;
+    int sent;
+    int cut_at;                 // Koniec treści dla FAULT_TRUNCATE/FAULT_STALL (-1 - brak)
+    uint32_t link_epoch;        // Zerwanie łącza po otwarciu - odczyt kończy się błędem
+};
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+} sim_event_t;
+
+typedef struct {
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+} sim_handler_t;
+
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+
+static uint32_t s_rng = 0x2545F491;
+
+// Sterownik WiFi
+static sim_handler_t s_handlers[4];
+static int s_handler_count;
+static QueueHandle_t s_event_queue;
+static bool s_radio_started;
+static bool s_associated;
+static bool s_fast_config;          // Konfiguracja z BSSID i kanałem (szybkie łączenie)
+static int64_t s_connect_due_us;    // 0 - brak trwającego łączenia
+static int64_t s_next_drop_us;
+static int64_t s_next_outage_us;
+static int64_t s_ap_down_until_us;
+static uint32_t s_link_epoch;
+static uint32_t s_events_lost;
+static uint32_t s_link_drops;
+static uint32_t s_outages;
+
+// Serwer HTTP, sterta i partycja
+static struct esp_http_client s_clients[HTTP_CLIENTS_MAX];
+static int s_clients_live;
+static uint32_t s_requests;
+static uint32_t s_reads;
+static uint32_t s_faults[FAULT_COUNT];
+static char s_server_etag[32] = "\"fw-1\"";
+static const char *s_installed_etag = "\"fw-1\"";
+static size_t s_heap_used;
+static size_t s_heap_peak;
+static int s_ota_handles;
+static uint32_t s_ota_handle_seq;
+static uint32_t s_boot_switches;
+static esp_partition_t s_update_partition = {
+    .address = 0x190000,
+    .size = 0x180000,
+    .label = "ota_1",
+};
+
+// Aplikacja
+static const rk_task_config_t s_default_task_config = {.core = RK_TASK_CORE_ANY};
+static rk_ota_config_t s_ota_config;
+static bool s_ota_busy;
+static int64_t s_ota_started_us;
+static uint32_t s_ota_ok;
+static uint32_t s_ota_failed;
+static uint32_t s_led_messages;
+static uint32_t s_restarts;
+static bool s_ota_start_pending;        // Zatrzymane zadanie OTA jeszcze kończy pobieranie
+static int64_t s_link_lost_us;          // Pierwsze rozłączenie od ostatniego połączenia (0 - brak)
+static const uint32_t s_check_ms_bounds[] = {1000, 2000, 4000, 8000, 16000, 32000, 64000};
+static const uint32_t s_reconnect_ms_bounds[] = {1000, 2000, 4000, 8000, 16000, 64000, 256000};
+static rk_metric_t *s_metric_check_ms = NULL;
+static rk_metric_t *s_metric_reconnect_ms = NULL;
+
+static uint32_t rnd(uint32_t n)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng % n;
+}
+
+static int64_t now_us(void)
+{
+    return esp_timer_get_time();
+}
+
+static int64_t after_s(uint32_t min_s, uint32_t spread_s)
+{
+    return now_us() + ((int64_t)min_s + rnd(spread_s)) * 1000000;
+}
+
+// ===== Sterta =====
+
+static void heap_take(size_t bytes)
+{
+    s_heap_used += bytes;
+    if (s_heap_used > s_heap_peak) {
+        s_heap_peak = s_heap_used;
+    }
+}
+
+static void heap_give(size_t bytes)
+{
+    s_heap_used -= bytes;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return HEAP_TOTAL - s_heap_used;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return (HEAP_TOTAL - s_heap_used) * 3 / 4;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    return HEAP_TOTAL - s_heap_peak;
+}
+
+void *rk_mem_alloc(size_t size, rk_mem_class_t mem_class)
+{
+    size_t *block = malloc(sizeof(size_t) + size);
+    if (block == NULL) {
+        return NULL;
+    }
+    *block = size;
+    heap_take(size);
+    return block + 1;
+}
+
+void rk_mem_free(void *ptr)
+{
+    if (ptr != NULL) {
+        size_t *block = (size_t *)ptr - 1;
+        heap_give(*block);
+        free(block);
+    }
+}
+
+bool rk_mem_is_psram(const void *ptr)
+{
+    return false;
+}
+
+void rk_mem_get_report(rk_mem_report_t *report)
+{
+    memset(report, 0, sizeof(*report));
+}
+
+const char *rk_mem_region_name(rk_mem_region_t region)
+{
+    return "sram";
+}
+
+void rk_mem_measure(void)
+{
+}
+
+// ===== Pozostałe zależności komponentów =====
+
+void rk_log_write(esp_log_level_t level, rk_log_tag_t tag, rk_log_fmt_t fmt, int argc, ...)
+{
+}
+
+esp_err_t rk_shutdown_register(const char *name, rk_shutdown_fn_t fn)
+{
+    return ESP_OK;
+}
+
+void rk_shutdown_restart(const char *reason)
+{
+    // Tryb etapowy - pobrany obraz czeka, restart byłby błędem ścieżki OTA
+    fprintf(stderr, "rk_shutdown_restart(%s) w teście długotrwałym\n", reason);
+    abort();
+}
+
+const esp_app_desc_t *esp_app_get_description(void)
+{
+    static const esp_app_desc_t desc = {
+        .version = "1.0.0",
+    };
+    return &desc;
+}
+
+// ===== Sterownik WiFi z pętlą zdarzeń =====
+
+static void post_event(esp_event_base_t base, int32_t id)
+{
+    sim_event_t event = {.base = base, .id = id};
+    if (xQueueSend(s_event_queue, &event, 0) != pdTRUE) {
+        s_events_lost++;
+    }
+}
+
+// Pętla zdarzeń przelicza termin najbliższej akcji sterownika
+static void radio_kick(void)
+{
+    post_event(NULL, 0);
+}
+
+static void link_down(void)
+{
+    if (s_associated) {
+        s_associated = false;
+        s_link_epoch++;
+        post_event(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED);
+    }
+}
+
+esp_err_t esp_netif_init(void)
+{
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_create_default_wifi_sta(void)
+{
+    static int netif;
+    return (esp_netif_t *)&netif;
+}
+
+esp_err_t esp_netif_dhcpc_start(esp_netif_t *netif)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcpc_stop(esp_netif_t *netif)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_ip_info(esp_netif_t *netif, const esp_netif_ip_info_t *ip_info)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_set_dns_info(esp_netif_t *netif, esp_netif_dns_type_t type,
+                                 esp_netif_dns_info_t *dns)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_get_dns_info(esp_netif_t *netif, esp_netif_dns_type_t type,
+                                 esp_netif_dns_info_t *dns)
+{
+    dns->ip.u_addr.ip4.addr = 0x0101A8C0;
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_instance_register(esp_event_base_t base, int32_t id,
+                                              esp_event_handler_t handler, void *arg,
+                                              esp_event_handler_instance_t *instance)
+{
+    if (s_handler_count >= (int)(sizeof(s_handlers) / sizeof(s_handlers[0]))) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_handlers[s_handler_count] = (sim_handler_t){base, id, handler, arg};
+    *instance = &s_handlers[s_handler_count++];
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t interface, wifi_config_t *config)
+{
+    s_fast_config = config->sta.bssid_set;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    if (!s_radio_started) {
+        s_radio_started = true;
+        post_event(WIFI_EVENT, WIFI_EVENT_STA_START);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_stop(void)
+{
+    s_connect_due_us = 0;
+    link_down();
+    if (s_radio_started) {
+        s_radio_started = false;
+        post_event(WIFI_EVENT, WIFI_EVENT_STA_STOP);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    if (!s_radio_started) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!s_associated && s_connect_due_us == 0) {
+        s_connect_due_us = now_us() + (CONNECT_MIN_MS + rnd(CONNECT_SPREAD_MS)) * 1000;
+        radio_kick();
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_disconnect(void)
+{
+    s_connect_due_us = 0;
+    link_down();
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap)
+{
+    if (!s_associated) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memset(ap, 0, sizeof(*ap));
+    ap->primary = 6;
+    ap->rssi = -60;
+    return ESP_OK;
+}
+
+static int64_t earliest(int64_t a, int64_t b)
+{
+    return a == 0 || (b != 0 && b < a) ? b : a;
+}
+
+// Akcje sterownika i świata, którym minął termin
+static void radio_step(void)
+{
+    int64_t now = now_us();
+    
+    if (s_ap_down_until_us != 0 && now >= s_ap_down_until_us) {
+        s_ap_down_until_us = 0;
+    }
+    if (now >= s_next_outage_us) {
+        s_outages++;
+        s_ap_down_until_us = after_s(OUTAGE_LEN_MIN_S, OUTAGE_LEN_SPREAD_S);
+        s_next_outage_us = after_s(OUTAGE_MIN_S, OUTAGE_SPREAD_S);
+        link_down();
+    }
+    if (now >= s_next_drop_us) {
+        s_next_drop_us = after_s(DROP_MIN_S, DROP_SPREAD_S);
+        if (s_associated) {
+            s_link_drops++;
+        }
+        link_down();
+    }
+    
+    if (s_connect_due_us != 0 && now >= s_connect_due_us) {
+        s_connect_due_us = 0;
+        bool ok = s_ap_down_until_us == 0 && rnd(100) >= CONNECT_FAIL_PCT &&
+                  !(s_fast_config && rnd(100) < FAST_FAIL_PCT);
+        if (ok) {
+            s_associated = true;
+            post_event(WIFI_EVENT, WIFI_EVENT_STA_CONNECTED);
+            post_event(IP_EVENT, IP_EVENT_STA_GOT_IP);
+        } else {
+            post_event(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED);
+        }
+    }
+}
+
+static void dispatch(const sim_event_t *event)
+{
+    ip_event_got_ip_t got_ip = {
+        .ip_info = {.ip = {0x3201A8C0}, .netmask = {0x00FFFFFF}, .gw = {0x0101A8C0}},
+    };
+    for (int i = 0; i < s_handler_count; i++) {
+        const sim_handler_t *h = &s_handlers[i];
+        if (h->base == event->base && (h->id == ESP_EVENT_ANY_ID || h->id == event->id)) {
+            h->handler(h->arg, event->base, event->id,
+                       event->base == IP_EVENT ? &got_ip : NULL);
+        }
+    }
+}
+
+// Zadanie pętli zdarzeń (sys_evt) - obsługa zdarzeń i terminów sterownika
+static void event_loop_task(void *arg)
+{
+    for (;;) {
+        int64_t due = earliest(earliest(s_connect_due_us, s_next_drop_us),
+                               s_ap_down_until_us != 0 ? s_ap_down_until_us : s_next_outage_us);
+        int64_t wait_us = due - now_us();
+        int64_t tick_us = portTICK_PERIOD_MS * 1000;
+        TickType_t wait = wait_us > 0 ? (TickType_t)((wait_us + tick_us - 1) / tick_us) : 0;
+        
+        sim_event_t event;
+        if (xQueueReceive(s_event_queue, &event, wait) == pdTRUE) {
+            if (event.base != NULL) {
+                dispatch(&event);
+            }
+            continue;
+        }
+        radio_step();
+    }
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    s_event_queue = xQueueCreate(EVENT_QUEUE_LEN, sizeof(sim_event_t));
+    s_next_drop_us = after_s(DROP_MIN_S, DROP_SPREAD_S);
+    s_next_outage_us = after_s(OUTAGE_MIN_S, OUTAGE_SPREAD_S);
+    TaskHandle_t task;
+    return xTaskCreatePinnedToCore(event_loop_task, "sys_evt", 4096, NULL, 20, &task, 0) == pdPASS ?
+           ESP_OK : ESP_ERR_NO_MEM;
+}
+
+// ===== Serwer HTTP z błędami =====
+
+static fault_t pick_fault(void)
+{
+    uint32_t roll = rnd(100);
+    for (int f = 0; f < FAULT_COUNT; f++) {
+        if (roll < s_fault_pct[f]) {
+            return (fault_t)f;
+        }
+        roll -= s_fault_pct[f];
+    }
+    return FAULT_NONE;
+}
+
+static void fire(esp_http_client_handle_t client, esp_http_client_event_id_t id,
+                 const char *key, const char *value, int data_len)
+{
+    if (client->handler == NULL) {
+        return;
+    }
+    esp_http_client_event_t event = {
+        .event_id = id,
+        .client = client,
+        .data_len = data_len,
+        .user_data = client->user_data,
+        .header_key = (char *)key,
+        .header_value = (char *)value,
+    };
+    client->handler(&event);
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    for (int i = 0; i < HTTP_CLIENTS_MAX; i++) {
+        esp_http_client_handle_t client = &s_clients[i];
+        if (!client->used) {
+            memset(client, 0, sizeof(*client));
+            client->used = true;
+            client->config_file = strstr(config->url, "config.json") != NULL;
+            client->handler = config->event_handler;
+            client->user_data = config->user_data;
+            client->timeout_ms = config->timeout_ms > 0 ? config->timeout_ms : 5000;
+            client->cut_at = -1;
+            s_clients_live++;
+            heap_take(HEAP_HTTP_CLIENT);
+            return client;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key,
+                                     const char *value)
+{
+    if (strcmp(key, "If-None-Match") == 0) {
+        strncpy(client->if_none_match, value, sizeof(client->if_none_match) - 1);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_open(esp_http_client_handle_t client, int write_len)
+{
+    s_requests++;
+    uint32_t epoch = s_link_epoch;
+    if (!s_associated) {
+        vTaskDelay(pdMS_TO_TICKS(HTTP_NO_ROUTE_MS));
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    
+    client->fault = pick_fault();
+    s_faults[client->fault]++;
+    if (client->fault == FAULT_CONNECT) {
+        vTaskDelay(pdMS_TO_TICKS(HTTP_REFUSED_MS));
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    if (client->fault == FAULT_TIMEOUT) {
+        vTaskDelay(pdMS_TO_TICKS(client->timeout_ms));
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    
+    vTaskDelay(pdMS_TO_TICKS(HTTP_OPEN_MS));
+    if (epoch != s_link_epoch) {
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    client->connected = true;
+    client->link_epoch = epoch;
+    heap_take(HEAP_TLS_SESSION);
+    fire(client, HTTP_EVENT_ON_CONNECTED, NULL, NULL, 0);
+    fire(client, HTTP_EVENT_HEADER_SENT, NULL, NULL, 0);
+    
+    const char *etag = client->config_file ? "\"cfg-1\"" : s_server_etag;
+    switch (client->fault) {
+        case FAULT_404:
+            client->status = 404;
+            return ESP_OK;
+        case FAULT_403:
+            client->status = 403;
+            return ESP_OK;
+        case FAULT_5XX:
+            client->status = 500 + (int)rnd(4);
+            return ESP_OK;
+        default:
+            break;
+    }
+    
+    fire(client, HTTP_EVENT_ON_HEADER, "ETag", etag, 0);
+    if (strcmp(client->if_none_match, etag) == 0) {
+        client->status = 304;
+        return ESP_OK;
+    }
+    client->status = 200;
+    client->length = client->config_file ? CONFIG_LEN : IMAGE_LEN;
+    if (client->fault == FAULT_TRUNCATE || client->fault == FAULT_STALL) {
+        client->cut_at = (int)rnd((uint32_t)client->length);
+    }
+    return ESP_OK;
+}
+
+int64_t esp_http_client_fetch_headers(esp_http_client_handle_t client)
+{
+    return client->connected ? client->length : -1;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client->status;
+}
+
+int esp_http_client_read(esp_http_client_handle_t client, char *buffer, int len)
+{
+    if (!client->connected || client->link_epoch != s_link_epoch) {
+        return -1;      // Połączenie zerwane razem z łączem WiFi
+    }
+    if (client->sent >= client->length) {
+        return 0;
+    }
+    if (client->cut_at >= 0 && client->sent >= client->cut_at) {
+        if (client->fault == FAULT_STALL) {
+            vTaskDelay(pdMS_TO_TICKS(client->timeout_ms));
+            return -1;
+        }
+        return 0;       // Serwer zamknął połączenie przed końcem treści
+    }
+    
+    int end = client->cut_at >= 0 ? client->cut_at : client->length;
+    int n = end - client->sent < len ? end - client->sent : len;
+    vTaskDelay(pdMS_TO_TICKS((uint64_t)n * 1000 / HTTP_BYTES_PER_S) + 1);
+    if (client->link_epoch != s_link_epoch) {
+        return -1;
+    }
+    memset(buffer, 'x', n);
+    client->sent += n;
+    s_reads++;
+    fire(client, HTTP_EVENT_ON_DATA, NULL, NULL, n);
+    return n;
+}
+
+bool esp_http_client_is_complete_data_received(esp_http_client_handle_t client)
+{
+    return client->sent == client->length;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    if (client->connected) {
+        client->connected = false;
+        heap_give(HEAP_TLS_SESSION);
+        fire(client, HTTP_EVENT_DISCONNECTED, NULL, NULL, 0);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    esp_http_client_close(client);
+    client->used = false;
+    s_clients_live--;
+    heap_give(HEAP_HTTP_CLIENT);
+    return ESP_OK;
+}
+
+// ===== Partycja i zapis OTA =====
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    return &s_update_partition;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size,
+                        esp_ota_handle_t *out_handle)
+{
+    s_ota_handles++;
+    heap_take(HEAP_OTA_HANDLE);
+    *out_handle = ++s_ota_handle_seq;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    return ESP_OK;
+}
+
+static void ota_handle_release(void)
+{
+    s_ota_handles--;
+    heap_give(HEAP_OTA_HANDLE);
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    ota_handle_release();
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    ota_handle_release();
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    s_boot_switches++;
+    return ESP_OK;
+}
+
+// ===== Moduły rk_ota poza testem =====
+
+bool rk_ota_dns_rewrite_url(const char *url, char *connect_url, size_t url_len,
+                            char *host, size_t host_len, char *authority, size_t authority_len)
+{
+    strncpy(connect_url, url, url_len - 1);
+    connect_url[url_len - 1] = '\0';
+    host[0] = '\0';
+    authority[0] = '\0';
+    return false;
+}
+
+esp_err_t rk_ota_dns_init(void)
+{
+    return ESP_OK;
+}
+
+void rk_ota_dns_evict(const char *host)
+{
+}
+
+// Wbudowane CA, przy błędzie połączenia jedno ponowienie z pełnym bundle
+bool rk_ota_trust_starts_with_bundle(void)
+{
+    return false;
+}
+
+bool rk_ota_trust_can_fall_back(bool use_bundle)
+{
+    return !use_bundle;
+}
+
+void rk_ota_trust_apply(esp_http_client_config_t *http_config, bool use_bundle)
+{
+}
+
+void rk_ota_trust_record(bool use_bundle, uint32_t handshake_ms, uint32_t heap_bytes)
+{
+}
+
+void rk_ota_remote_init(void)
+{
+}
+
+// Konfiguracja zdalna przez prawdziwe rk_ota_fetch_file - zwykle 304
+esp_err_t rk_ota_remote_config_check(const rk_ota_config_t *config)
+{
+    static char etag[48];
+    char new_etag[48] = "";
+    char body[512];
+    bool modified = false;
+    esp_err_t err = rk_ota_fetch_file(config, "config.json", etag, new_etag, sizeof(new_etag),
+                                      body, sizeof(body), &modified);
+    if (err != ESP_OK || !modified) {
+        return err != ESP_OK ? err : ESP_ERR_INVALID_VERSION;
+    }
+    strncpy(etag, new_etag, sizeof(etag) - 1);
+    return ESP_OK;
+}
+
+const char *rk_ota_firmware_etag(rk_ota_source_t source)
+{
+    return s_installed_etag;
+}
+
+void rk_ota_firmware_etag_clear(void)
+{
+}
+
+void rk_ota_firmware_etag_stage(rk_ota_source_t source, const char *etag,
+                                const esp_partition_t *partition)
+{
+}
+
+esp_err_t rk_ota_stop_notify_channel(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t rk_ota_preerase_start(void)
+{
+    return ESP_OK;
+}
+
+void rk_ota_preerase_pause(void)
+{
+}
+
+void rk_ota_preerase_resume(bool written)
+{
+}
+
+bool rk_ota_diff_supported(const esp_partition_t *partition)
+{
+    return false;
+}
+
+esp_err_t rk_ota_diff_begin(const esp_partition_t *partition, uint32_t image_size)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t rk_ota_diff_write(const uint8_t *data, size_t len)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t rk_ota_diff_end(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void rk_ota_diff_abort(void)
+{
+}
+
+int rk_ota_segments_plan(int content_length)
+{
+    return 1;
+}
+
+esp_err_t rk_ota_segments_download(esp_http_client_handle_t first_client, const char *url,
+                                   bool use_bundle, bool use_token,
+                                   const esp_partition_t *partition, int content_length,
+                                   int connections, uint8_t *buffer, size_t buffer_len,
+                                   int *received)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t rk_ota_check_target(const esp_partition_t *partition)
+{
+    return ESP_OK;
+}
+
+esp_err_t rk_ota_verify_image(const esp_partition_t *partition)
+{
+    return ESP_OK;
+}
+
+esp_err_t rk_ota_bench_download(esp_http_client_handle_t client, const esp_partition_t *partition,
+                                int content_length, bool with_flash, bool signed_image,
+                                uint8_t *buffer, size_t buffer_len, rk_ota_bench_result_t *result)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+bool rk_ota_sign_available(void)
+{
+    return false;
+}
+
+esp_err_t rk_ota_sign_fetch(const char *image_url)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void rk_ota_sign_begin(void)
+{
+}
+
+void rk_ota_sign_update(const uint8_t *data, size_t len)
+{
+}
+
+void rk_ota_sign_abort(void)
+{
+}
+
+esp_err_t rk_ota_sign_check_version(const uint8_t *header, size_t len)
+{
+    return ESP_OK;
+}
+
+esp_err_t rk_ota_sign_verify(uint32_t *verify_ms)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t rk_ota_local_open(const rk_ota_local_source_t *source, uint32_t max_size,
+                            rk_ota_stream_t *stream, int *size)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void rk_ota_local_close(rk_ota_stream_t *stream, bool success)
+{
+}
+
+// ===== Aplikacja (jak main.c) =====
+
+static void send_led(rk_led_message_type_t type)
+{
+    rk_led_message_t msg = {
+        .type = type,
+        .on_time_ms = LED_ON_MS,
+        .off_time_ms = LED_OFF_MS,
+    };
+    if (rk_led_send_message(&msg) == ESP_OK) {
+        s_led_messages++;
+    }
+}
+
+// Czas ponownego połączenia liczony od pierwszego rozłączenia - kolejne nieudane próby
+// sterownika też wywołują callback z connected == false
+static void wifi_event_callback(bool connected)
+{
+    if (connected && s_link_lost_us != 0) {
+        rk_metrics_observe(s_metric_reconnect_ms, (uint32_t)((now_us() - s_link_lost_us) / 1000));
+        s_link_lost_us = 0;
+    } else if (!connected && s_link_lost_us == 0) {
+        s_link_lost_us = now_us();
+    }
+    send_led(connected ? RK_LED_MSG_WIFI_CONNECTED : RK_LED_MSG_WIFI_DISCONNECTED);
+}
+
+static void ota_event_callback(bool ota_started, bool ota_success)
+{
+    if (ota_started) {
+        s_ota_busy = true;
+        s_ota_started_us = now_us();
+        send_led(RK_LED_MSG_OTA_START);
+        return;
+    }
+    
+    s_ota_busy = false;
+    if (ota_success) {
+        // Opóźnienie tylko udanych sprawdzeń - błędy wstrzykiwane mają własne czasy
+        s_ota_ok++;
+        rk_metrics_observe(s_metric_check_ms, (uint32_t)((now_us() - s_ota_started_us) / 1000));
+    } else {
+        s_ota_failed++;
+    }
+    send_led(ota_success ? RK_LED_MSG_WIFI_CONNECTED : RK_LED_MSG_OTA_FAILED);
+}
+
+static void send_ota(rk_ota_message_type_t type)
+{
+    rk_ota_message_t msg = {.type = type};
+    rk_ota_send_message(&msg);
+}
+
+// Po zatrzymaniu w trakcie zablokowanego odczytu HTTP start jest ponawiany co sekundę
+static void start_ota(void)
+{
+    esp_err_t err = rk_ota_start_task(rk_wifi_get_event_group(), ota_event_callback,
+                                      &s_default_task_config);
+    CHECK(err == ESP_OK || err == ESP_ERR_INVALID_STATE);
+    s_ota_start_pending = err == ESP_ERR_INVALID_STATE;
+}
+
+static void start_tasks(void)
+{
+    CHECK_EQ(ESP_OK, rk_led_start_task(&s_default_task_config));
+    CHECK_EQ(ESP_OK, rk_wifi_start_task(wifi_event_callback, &s_default_task_config));
+    CHECK_EQ(ESP_OK, rk_wifi_connect("soak", "soak-pass"));
+    send_led(RK_LED_MSG_WIFI_CONNECTING);
+    start_ota();
+}
+
+// Kolejność jak w rk_shutdown: OTA, WiFi, LED - także w trakcie pobierania
+static void stop_tasks(void)
+{
+    rk_ota_stop_task();
+    rk_wifi_stop_task();
+    rk_led_stop_task();
+    s_restarts++;
+}
+
+// Histogram z przyrostu koszyków od poprzedniego okna
+static rk_metric_t window_of(const rk_metric_t *metric, rk_metric_t *last)
+{
+    rk_metric_t window = *metric;
+    window.value -= last->value;
+    for (int b = 0; b < RK_METRICS_HIST_BUCKETS; b++) {
+        window.buckets[b] -= last->buckets[b];
+    }
+    *last = *metric;
+    return window;
+}
+
+static uint32_t led_events(void)
+{
+    rk_led_stats_t stats;
+    rk_led_get_stats(&stats);
+    return stats.sw_edges + stats.timer_wakeups;
+}
+
+static uint32_t total_events(void)
+{
+    rk_wifi_event_stats_t wifi;
+    rk_wifi_get_event_stats(&wifi);
+    return led_events() + wifi.handler_calls + s_requests + s_reads + s_led_messages;
+}
+
+// Okno bez trwającego sprawdzenia OTA i z działającym zadaniem OTA - klienci HTTP
+// i uchwyty OTA zwolnione
+static void wait_ota_idle(void)
+{
+    for (int i = 0; i < 600 && (s_ota_busy || s_ota_start_pending); i++) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        if (s_ota_start_pending) {
+            start_ota();
+        }
+    }
+    CHECK(!s_ota_busy && !s_ota_start_pending);
+}
+
+typedef struct {
+    rk_metrics_soak_baseline_t soak;
+    UBaseType_t tasks;
+    UBaseType_t queues;
+    rk_metric_t check_last;
+    rk_metric_t reconnect_last;
+} baseline_t;
+
+static void take_baseline(baseline_t *base)
+{
+    wait_ota_idle();
+    CHECK(s_metric_check_ms->value > 0 && s_metric_reconnect_ms->value > 0);
+    rk_metrics_soak_baseline(&base->soak);
+    base->tasks = fake_task_live_count();
+    base->queues = fake_queue_live_count();
+    base->check_last = *s_metric_check_ms;
+    base->reconnect_last = *s_metric_reconnect_ms;
+}
+
+// Kontrola dryfu po oknie: true - bez dryfu. Opóźnienia ocenia rk_metrics_soak_check
+// (p95 od startu względem punktu odniesienia), p95/p99 okna tylko w raporcie.
+static bool check_window(baseline_t *base, uint32_t elapsed_s)
+{
+    wait_ota_idle();
+    rk_metrics_soak_report_t report;
+    bool ok = rk_metrics_soak_check(&base->soak, &report) == ESP_OK;
+    ok &= fake_task_live_count() == base->tasks;
+    ok &= fake_queue_live_count() == base->queues;
+    ok &= s_clients_live == 0 && s_ota_handles == 0;
+    
+    rk_metric_t check = window_of(s_metric_check_ms, &base->check_last);
+    rk_metric_t reconnect = window_of(s_metric_reconnect_ms, &base->reconnect_last);
+    printf("  %5.1f h: sterta %+ld B, zadania %u/%u, kolejki %u/%u, HTTP %d, OTA %d, "
+           "sprawdzenie p95/p99 %lu/%lu ms, ponowne łączenie p95/p99 %lu/%lu ms%s\n",
+           elapsed_s / 3600.0, (long)report.heap_drift_bytes,
+           (unsigned)fake_task_live_count(), (unsigned)base->tasks,
+           (unsigned)fake_queue_live_count(), (unsigned)base->queues,
+           s_clients_live, s_ota_handles,
+           (unsigned long)rk_metrics_percentile(&check, 95),
+           (unsigned long)rk_metrics_percentile(&check, 99),
+           (unsigned long)rk_metrics_percentile(&reconnect, 95),
+           (unsigned long)rk_metrics_percentile(&reconnect, 99),
+           ok ? "" : report.slow_metric != NULL ? " - DRYF opóźnień" : " - DRYF");
+    return ok;
+}
+
+static void test_soak(void)
+{
+    CHECK_EQ(ESP_OK, rk_metrics_init());
+    s_metric_check_ms = rk_metrics_histogram("soak.check_ms", s_check_ms_bounds,
+                                             sizeof(s_check_ms_bounds) / sizeof(s_check_ms_bounds[0]));
+    s_metric_reconnect_ms = rk_metrics_histogram("soak.reconnect_ms", s_reconnect_ms_bounds,
+                                                 sizeof(s_reconnect_ms_bounds) / sizeof(s_reconnect_ms_bounds[0]));
+    
+    strncpy(s_ota_config.github_user, "soak", sizeof(s_ota_config.github_user) - 1);
+    strncpy(s_ota_config.github_repo, "fw", sizeof(s_ota_config.github_repo) - 1);
+    strncpy(s_ota_config.github_branch, "main", sizeof(s_ota_config.github_branch) - 1);
+    strncpy(s_ota_config.firmware_file, "firmware.bin", sizeof(s_ota_config.firmware_file) - 1);
+    strncpy(s_ota_config.config_file, "config.json", sizeof(s_ota_config.config_file) - 1);
+    
+    CHECK_EQ(ESP_OK, rk_led_init());
+    CHECK_EQ(ESP_OK, rk_ota_init());
+    CHECK_EQ(ESP_OK, rk_wifi_init());
+    start_tasks();
+    CHECK_EQ(ESP_OK, rk_ota_set_config(&s_ota_config));
+    
+    // Tryb etapowy bez okna serwisowego - pobrany obraz czeka, urządzenie działa dalej
+    rk_ota_staging_t staging = {
+        .mode = RK_OTA_APPLY_STAGED,
+        .download_priority = 1,
+    };
+    CHECK_EQ(ESP_OK, rk_ota_set_staging(&staging));
+    
+    EventGroupHandle_t wifi_events = rk_wifi_get_event_group();
+    baseline_t base;
+    memset(&base, 0, sizeof(base));
+    uint32_t windows = 0;
+    uint32_t drifted = 0;
+    uint32_t flap_reconnect_s = 0;
+    
+    for (uint32_t s = 1; s <= SOAK_DAYS * 24 * 3600; s++) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        
+        // Jak monitor w main.c: ponowne łączenie po wyczerpaniu prób sterownika
+        if (xEventGroupGetBits(wifi_events) & RK_WIFI_FAIL_BIT) {
+            rk_wifi_connect("soak", "soak-pass");
+        }
+        if (s % CHECK_PERIOD_S == 0 && rk_wifi_is_connected()) {
+            send_ota(RK_OTA_MSG_CHECK_UPDATE);
+        }
+        if (s % FORCE_PERIOD_S == 0) {
+            send_ota(RK_OTA_MSG_FORCE_UPDATE);
+        }
+        if (s % PUBLISH_PERIOD_S == 0) {
+            snprintf(s_server_etag, sizeof(s_server_etag), "\"fw-%lu\"",
+                     (unsigned long)(s / PUBLISH_PERIOD_S + 1));
+        }
+        if (s % FLAP_PERIOD_S == 0) {
+            rk_wifi_disconnect();
+            flap_reconnect_s = s + 5;
+        }
+        if (s == flap_reconnect_s) {
+            rk_wifi_connect("soak", "soak-pass");
+        }
+        if (s % RESTART_PERIOD_S == 0) {
+            stop_tasks();
+            start_tasks();
+        } else if (s_ota_start_pending) {
+            start_ota();
+        }
+        
+        if (s == SOAK_WARMUP_S) {
+            take_baseline(&base);
+        } else if (s > SOAK_WARMUP_S && (s - SOAK_WARMUP_S) % SOAK_WINDOW_S == 0) {
+            windows++;
+            if (!check_window(&base, s)) {
+                drifted++;
+            }
+        }
+    }
+    
+    uint32_t events = total_events();
+    rk_wifi_event_stats_t wifi;
+    rk_wifi_get_event_stats(&wifi);
+    printf("  zdarzenia: %lu (LED %lu, WiFi %lu, HTTP %lu zapytań / %lu odczytów, "
+           "wiadomości LED %lu)\n", (unsigned long)events, (unsigned long)led_events(),
+           (unsigned long)wifi.handler_calls, (unsigned long)s_requests,
+           (unsigned long)s_reads, (unsigned long)s_led_messages);
+    printf("  łącze: zerwania %lu, awarie AP %lu, szybkie łączenie %lu (powroty %lu), "
+           "restarty zadań %lu, zgubione zdarzenia %lu\n",
+           (unsigned long)s_link_drops, (unsigned long)s_outages,
+           (unsigned long)wifi.fast_connects, (unsigned long)wifi.fast_connect_fallbacks,
+           (unsigned long)s_restarts, (unsigned long)s_events_lost);
+    printf("  OTA: udane %lu, nieudane %lu; błędy serwera:", (unsigned long)s_ota_ok,
+           (unsigned long)s_ota_failed);
+    for (int f = 1; f < FAULT_COUNT; f++) {
+        printf(" %s %lu", s_fault_names[f], (unsigned long)s_faults[f]);
+        CHECK(s_faults[f] > 0);
+    }
+    printf("\n");
+    
+    CHECK(events >= SOAK_EVENTS_MIN);
+    CHECK(windows >= 10);
+    CHECK_EQ(0, drifted);
+    CHECK_EQ(0, s_events_lost);
+    CHECK_EQ(0, s_boot_switches);       // Obraz etapowy bez okna - bez zmiany partycji
+    CHECK(s_link_drops > 0 && s_outages > 0 && wifi.fast_connect_fallbacks > 0);
+    CHECK(s_ota_ok > 0 && s_ota_failed > 0);
+    
+    // Czułość kontroli: porzucony klient HTTP to wyciek zasobu i sterty
+    esp_http_client_config_t config = {.url = "https://example.com/leak"};
+    esp_http_client_handle_t leaked = rk_ota_http_init(&config);
+    rk_metrics_soak_report_t report;
+    CHECK_EQ(ESP_FAIL, rk_metrics_soak_check(&base.soak, &report));
+    CHECK_EQ(1, report.res_drift[RK_RES_HTTP_CLIENT]);
+    CHECK(report.leak);
+    rk_ota_http_cleanup(leaked);
+    CHECK_EQ(ESP_OK, rk_metrics_soak_check(&base.soak, NULL));
+}
+
+int main(void)
+{
+    RUN_TEST(test_soak);
+    return TEST_EXIT();
+}
@@ -0,0 +1,77 @@
+#include "boot_profile.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+
+static const char *TAG = "BOOT";
+
+static const char *s_phase_names[BOOT_PHASE_COUNT] = {
+    [BOOT_PHASE_APP_MAIN]      = "app_main",
+    [BOOT_PHASE_NVS_READY]     = "NVS",
+    [BOOT_PHASE_LED_READY]     = "LED",
+    [BOOT_PHASE_OTA_INIT]      = "OTA init",
+    [BOOT_PHASE_WIFI_READY]    = "WiFi init",
+    [BOOT_PHASE_WIFI_CONNECT]  = "WiFi connect",
+    [BOOT_PHASE_OTA_READY]     = "OTA task",
+    [BOOT_PHASE_GOT_IP]        = "GOT_IP",
+    [BOOT_PHASE_OTA_CHECK]     = "OTA check",
+    [BOOT_PHASE_OTA_DECISION]  = "OTA decyzja",
+};
+
+static int64_t s_phase_us[BOOT_PHASE_COUNT] = {0};
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_reported = false;
+
+void boot_profile_mark(boot_phase_t phase)
+{
+    if (phase >= BOOT_PHASE_COUNT) {
+        return;
+    }
+    
+    int64_t now = esp_timer_get_time();
+    
+    portENTER_CRITICAL(&s_lock);
+    if (s_phase_us[phase] == 0) {
+        s_phase_us[phase] = now;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+int64_t boot_profile_get_us(boot_phase_t phase)
+{
+    if (phase >= BOOT_PHASE_COUNT) {
+        return 0;
+    }
+    return s_phase_us[phase];
+}
+
+void boot_profile_report(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool already = s_reported;
+    s_reported = true;
+    portEXIT_CRITICAL(&s_lock);
+    
+    if (already) {
+        return;
+    }
+    
+    ESP_LOGI(TAG, "=== PROFIL STARTU (od resetu) ===");
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        if (s_phase_us[i] == 0) {
+            ESP_LOGI(TAG, "%-12s: -", s_phase_names[i]);
+        } else {
+            ESP_LOGI(TAG, "%-12s: %6lld ms", s_phase_names[i], s_phase_us[i] / 1000);
+        }
+    }
+    
+    if (s_phase_us[BOOT_PHASE_GOT_IP] != 0 && s_phase_us[BOOT_PHASE_OTA_CHECK] != 0) {
+        ESP_LOGI(TAG, "GOT_IP -> OTA check: %lld ms",
+                 (s_phase_us[BOOT_PHASE_OTA_CHECK] - s_phase_us[BOOT_PHASE_GOT_IP]) / 1000);
+    }
+    if (s_phase_us[BOOT_PHASE_WIFI_CONNECT] != 0 && s_phase_us[BOOT_PHASE_GOT_IP] != 0) {
+        ESP_LOGI(TAG, "Połączenie WiFi (connect -> GOT_IP): %lld ms",
+                 (s_phase_us[BOOT_PHASE_GOT_IP] - s_phase_us[BOOT_PHASE_WIFI_CONNECT]) / 1000);
+    }
+}
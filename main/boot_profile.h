@@ -0,0 +1,47 @@
+#ifndef BOOT_PROFILE_H
+#define BOOT_PROFILE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Etapy startu mierzone od resetu
+typedef enum {
+    BOOT_PHASE_APP_MAIN,
+    BOOT_PHASE_NVS_READY,
+    BOOT_PHASE_LED_READY,
+    BOOT_PHASE_OTA_INIT,
+    BOOT_PHASE_WIFI_READY,
+    BOOT_PHASE_WIFI_CONNECT,
+    BOOT_PHASE_OTA_READY,
+    BOOT_PHASE_GOT_IP,
+    BOOT_PHASE_OTA_CHECK,
+    BOOT_PHASE_OTA_DECISION,
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+/**
+ * @brief Zapisanie znacznika czasu etapu startu (liczy się tylko pierwsze wywołanie)
+ * @param phase Etap startu
+ */
+void boot_profile_mark(boot_phase_t phase);
+
+/**
+ * @brief Czas etapu w mikrosekundach od resetu
+ * @param phase Etap startu
+ * @return Znacznik czasu lub 0 jeśli etap nie został osiągnięty
+ */
+int64_t boot_profile_get_us(boot_phase_t phase);
+
+/**
+ * @brief Wypisanie podsumowania startu (jednorazowo)
+ */
+void boot_profile_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_PROFILE_H
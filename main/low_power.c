@@ -0,0 +1,97 @@
+#include "low_power.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_sleep.h"
+#include "esp_attr.h"
+#include <string.h>
+
+static const char *TAG = "LOW_POWER";
+
+#define LOW_POWER_MAGIC 0x524C5031  // "RLP1"
+
+typedef struct {
+    uint32_t magic;
+    low_power_stats_t stats;
+} low_power_state_t;
+
+static RTC_DATA_ATTR low_power_state_t s_state;
+
+// Początek bieżącego cyklu - po uśpieniu głębokim esp_timer liczy od startu aplikacji
+// (bez czasu bootloadera), po płytkim od powrotu z esp_light_sleep_start
+static int64_t s_cycle_start_us = 0;
+
+static void ensure_state(void)
+{
+    if (s_state.magic != LOW_POWER_MAGIC) {
+        memset(&s_state, 0, sizeof(s_state));
+        s_state.magic = LOW_POWER_MAGIC;
+    }
+}
+
+bool low_power_woke_from_sleep(void)
+{
+    return esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER;
+}
+
+uint32_t low_power_cycle_end(bool check_ok, uint32_t interval_s)
+{
+    ensure_state();
+    low_power_stats_t *stats = &s_state.stats;
+    
+    uint32_t awake_ms = (uint32_t)((esp_timer_get_time() - s_cycle_start_us) / 1000);
+    stats->cycles++;
+    stats->awake_last_ms = awake_ms;
+    stats->awake_total_ms += awake_ms;
+    stats->awake_avg_ms = (uint32_t)(stats->awake_total_ms / stats->cycles);
+    if (awake_ms > stats->awake_max_ms) {
+        stats->awake_max_ms = awake_ms;
+    }
+    
+    // Błąd (brak sieci, serwer) - każdy kolejny podwaja uśpienie, by nie wyczerpać baterii
+    stats->failures = check_ok ? 0 : stats->failures + 1;
+    uint64_t sleep_s = interval_s;
+    for (uint32_t i = 0; i < stats->failures && sleep_s < LOW_POWER_BACKOFF_MAX_S; i++) {
+        sleep_s *= 2;
+    }
+    if (sleep_s > LOW_POWER_BACKOFF_MAX_S) {
+        sleep_s = LOW_POWER_BACKOFF_MAX_S;
+    }
+    stats->next_sleep_s = (uint32_t)sleep_s;
+    
+    ESP_LOGI(TAG, "Cykl %lu: czuwanie %lu ms (avg %lu, max %lu), %s, uśpienie %lu s",
+             stats->cycles, awake_ms, stats->awake_avg_ms, stats->awake_max_ms,
+             check_ok ? "sprawdzenie OK" : "sprawdzenie nieudane", stats->next_sleep_s);
+    if (stats->awake_total_ms + stats->sleep_total_ms > 0) {
+        ESP_LOGI(TAG, "Wypełnienie: czuwanie %llu ms / uśpienie %llu ms (%llu.%01llu%%)",
+                 stats->awake_total_ms, stats->sleep_total_ms,
+                 stats->awake_total_ms * 100 / (stats->awake_total_ms + stats->sleep_total_ms),
+                 stats->awake_total_ms * 1000 / (stats->awake_total_ms + stats->sleep_total_ms) % 10);
+    }
+    return stats->next_sleep_s;
+}
+
+void low_power_sleep(uint32_t sleep_s, bool deep)
+{
+    ensure_state();
+    s_state.stats.sleep_total_ms += (uint64_t)sleep_s * 1000;
+    esp_sleep_enable_timer_wakeup((uint64_t)sleep_s * 1000000);
+    
+    if (deep) {
+        ESP_LOGI(TAG, "Uśpienie głębokie na %lu s", sleep_s);
+        esp_deep_sleep_start();
+    }
+    
+    ESP_LOGI(TAG, "Uśpienie płytkie na %lu s", sleep_s);
+    esp_light_sleep_start();
+    s_cycle_start_us = esp_timer_get_time();
+}
+
+void low_power_get_stats(low_power_stats_t *stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    
+    ensure_state();
+    *stats = s_state.stats;
+}
@@ -0,0 +1,58 @@
+#ifndef LOW_POWER_H
+#define LOW_POWER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Najdłuższe uśpienie po kolejnych błędach sprawdzenia (odstęp podwajany)
+#ifndef LOW_POWER_BACKOFF_MAX_S
+#define LOW_POWER_BACKOFF_MAX_S (6 * 60 * 60)
+#endif
+
+// Statystyki cykli obudzenia - przetrwają uśpienie głębokie (RTC), zerowane przy zimnym starcie
+typedef struct {
+    uint32_t cycles;            // Zakończone cykle połącz-sprawdź-uśpij
+    uint32_t failures;          // Kolejne nieudane sprawdzenia (podstawa wydłużania uśpienia)
+    uint32_t awake_last_ms;     // Czas czuwania w ostatnim cyklu
+    uint32_t awake_avg_ms;
+    uint32_t awake_max_ms;
+    uint64_t awake_total_ms;    // Suma czasów czuwania - z sumą uśpień daje współczynnik wypełnienia
+    uint64_t sleep_total_ms;
+    uint32_t next_sleep_s;      // Zaplanowane uśpienie po bieżącym cyklu
+} low_power_stats_t;
+
+/**
+ * @brief Czy układ obudził się z uśpienia głębokiego (a nie z zimnego startu)
+ */
+bool low_power_woke_from_sleep(void);
+
+/**
+ * @brief Zakończenie cyklu: zapis czasu czuwania i wyliczenie uśpienia
+ * @param check_ok Sprawdzenie OTA zakończone (także "bez zmian")
+ * @param interval_s Zwykły odstęp sprawdzeń; po błędach podwajany do LOW_POWER_BACKOFF_MAX_S
+ * @return Czas uśpienia w sekundach
+ */
+uint32_t low_power_cycle_end(bool check_ok, uint32_t interval_s);
+
+/**
+ * @brief Uśpienie do następnego cyklu (głębokie nie wraca - start od app_main)
+ * @param sleep_s Czas uśpienia w sekundach
+ * @param deep true - uśpienie głębokie, false - płytkie (stan RAM zachowany)
+ */
+void low_power_sleep(uint32_t sleep_s, bool deep);
+
+/**
+ * @brief Pobranie statystyk cykli
+ * @param stats Struktura do wypełnienia
+ */
+void low_power_get_stats(low_power_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOW_POWER_H
@@ -1,20 +1,49 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_system.h"
 #include "esp_log.h"
 #include "esp_timer.h"  // <-- DODANE
+#include "esp_netif_sntp.h"
 #include "nvs_flash.h"
 
 #include "rk_wifi.h"
 #include "rk_led.h"
 #include "rk_ota.h"
+#include "rk_common.h"
+#include "rk_metrics.h"
+#include "rk_log.h"
+#include "rk_ctrl.h"
 
 #include "config.h"
+#include "boot_profile.h"
+#include "low_power.h"
 
 static const char *TAG = "MAIN";
 
+#define MONITOR_TASK_STACK 4096
+
+RK_TASK_BUFFER(monitor_task, MONITOR_TASK_STACK);
+
+// Umieszczenie zadań na rdzeniach: zadanie WiFi przy stosie WiFi/lwIP (rdzeń 0),
+// OTA z uzgadnianiem TLS i SHA-256 na rdzeniu 1. Pola zerowe - wartości domyślne
+// komponentu; na układach jednordzeniowych RK_TASK_CORE_1 oznacza brak przypięcia.
+static const rk_task_config_t s_led_task_config = {.core = RK_TASK_CORE_ANY};
+static const rk_task_config_t s_wifi_task_config = {.core = RK_TASK_CORE_0};
+static const rk_task_config_t s_ota_task_config = {.core = RK_TASK_CORE_1};
+static const rk_task_config_t s_monitor_task_config = {
+    .core = RK_TASK_CORE_ANY,
+    .priority = 1,              // Najniższy priorytet
+    .stack_bytes = MONITOR_TASK_STACK,
+};
+
+// Próbkowanie rywalizacji o CPU - raport w logu monitora i w GET /metrics. Diagnostyka
+// do strojenia rozmieszczenia zadań: włączać na czas pomiaru, nie w kompilacji produkcyjnej.
+#define TASK_CONTENTION_REPORT  0
+
 // Konfiguracja WiFi - zmień na swoje dane
 #ifdef HOME
 #define WIFI_SSID       "vodafoneBD2484"
@@ -34,20 +63,82 @@ static const char *TAG = "MAIN";
 #define GITHUB_FILE     "firmware.bin"
 #define GITHUB_BRANCH   "main"
 
+// Konfiguracja zdalna (JSON w repo obok obrazu) - LED, WiFi i harmonogram OTA bez nowego
+// obrazu; sprawdzana warunkowo (ETag) przy każdym sprawdzeniu OTA. Pusty - wyłączona.
+#define GITHUB_CONFIG_FILE      "config.json"
+#define OTA_CHECK_INTERVAL_MIN  5
+#define REMOTE_WIFI_TIMEOUT_MS  30000   // Bez połączenia z nową siecią - powrót do poprzedniej
+
+// Kanał powiadomień o nowej wersji (long-poll) - pusty wyłącza kanał
+#define OTA_NOTIFY_URL  ""
+
+// Lokalny mirror obrazu (np. "http://192.168.1.10:8070/firmware.bin") - pobierany bez TLS,
+// tylko gdy obok leży podpis firmware.bin.sig (tools/rk_ota_sign.py); pusty - tylko GitHub
+#define OTA_MIRROR_URL  ""
+
+// Aktualizacja lokalna przy starcie (linia produkcyjna, bez WiFi): 0 - wyłączona,
+// 1 - plik OTA_LOCAL_PATH (system plików montuje aplikacja: SPIFFS/FAT/SD),
+// 2 - ramki z tools/rk_ota_serial.py przez UART OTA_LOCAL_UART,
+// 3 - ramki przez urządzenie OTA_LOCAL_PATH (USB-CDC "/dev/usbserjtag")
+#define OTA_LOCAL_SOURCE    0
+#define OTA_LOCAL_PATH      "/sdcard/firmware.bin"
+#define OTA_LOCAL_UART      1
+#define OTA_LOCAL_TX_PIN    17
+#define OTA_LOCAL_RX_PIN    16
+#define OTA_LOCAL_BAUD      921600
+
+// Tryb etapowy OTA: pobranie w tle, przełączenie w oknie serwisowym (czas lokalny)
+// lub poleceniem POST /ota/apply. OTA_STAGED 0 - restart zaraz po pobraniu.
+#define OTA_STAGED              0
+#define OTA_BANDWIDTH_LIMIT_BPS (32 * 1024)
+#define OTA_WINDOW_START_HOUR   2
+#define OTA_WINDOW_END_HOUR     4
+#define OTA_TIMEZONE            "CET-1CEST,M3.5.0,M10.5.0/3"
+#define OTA_SNTP_SERVER         "pool.ntp.org"
+
+// Lokalny serwer HTTP do sterowania OTA i diagnostyki (0 - wyłączony).
+// Wymaga ustawienia RK_CTRL_TOKEN - z pustym tokenem serwer nie startuje.
+#define CTRL_ENABLED    0
+
+// Test długotrwały na urządzeniu: cykliczne testy łącza OTA i zrywanie WiFi, z kontrolą
+// wycieków sterty i zasobów (0 - wyłączony). Błędy serwera HTTP ćwiczy host_test/test_soak.c.
+#define SOAK_TEST               0
+#define SOAK_CYCLE_MS           (2 * 60 * 1000)
+#define SOAK_CHECK_EVERY        10      // Kontrola dryfu co tyle cykli
+#define SOAK_TASK_STACK         4096
+
+// Tryb bateryjny: zamiast stałego monitora cykl połącz-sprawdź-uśpij co s_ota_interval_min.
+// Dane szybkiego łączenia WiFi, ETag obrazu i odstęp po błędach przetrwają uśpienie (RTC).
+// Serwer sterowania i kanał powiadomień wymagają stałego połączenia - w tym trybie wyłączone.
+#define LOW_POWER_MODE          0
+#define LOW_POWER_DEEP_SLEEP    1       // 0 - uśpienie płytkie (RAM i zadania zachowane)
+#define LOW_POWER_AWAKE_MAX_MS  30000   // Limit na połączenie i sprawdzenie (bez pobierania obrazu)
+#define LOW_POWER_POLL_MS       50
+#define LOW_POWER_TASK_STACK    4096
+
 // Parametry mrugania LED - zmień te wartości dla testowania OTA!
 #define LED_ON_TIME_MS  500   // Czas świecenia - ZMIEŃ TO!
 #define LED_OFF_TIME_MS 500   // Czas wyłączenia - ZMIEŃ TO!
 
-// Callback dla zdarzeń WiFi
+// Bieżące parametry - wartości z makr lub z konfiguracji zdalnej (NVS, potem na żywo)
+static uint32_t s_led_on_ms = LED_ON_TIME_MS;
+static uint32_t s_led_off_ms = LED_OFF_TIME_MS;
+static uint16_t s_ota_interval_min = OTA_CHECK_INTERVAL_MIN;
+static char s_wifi_ssid[32] = WIFI_SSID;
+static char s_wifi_pass[64] = WIFI_PASS;
+static rk_ota_config_t s_ota_config;
+
+// Callback dla zdarzeń WiFi (wywoływany z zadania WiFi)
 void wifi_event_callback(bool connected)
 {
     rk_led_message_t led_msg;
     
     if (connected) {
+        boot_profile_mark(BOOT_PHASE_GOT_IP);
         ESP_LOGI(TAG, "WiFi połączone - ustawiam asymetryczne mruganie LED");
         led_msg.type = RK_LED_MSG_WIFI_CONNECTED;
-        led_msg.on_time_ms = LED_ON_TIME_MS;
-        led_msg.off_time_ms = LED_OFF_TIME_MS;
+        led_msg.on_time_ms = s_led_on_ms;
+        led_msg.off_time_ms = s_led_off_ms;
     } else {
         ESP_LOGI(TAG, "WiFi rozłączone - szybkie mruganie LED");
         led_msg.type = RK_LED_MSG_WIFI_DISCONNECTED;
@@ -63,63 +154,194 @@ void ota_event_callback(bool ota_started, bool ota_success)
 {
     rk_led_message_t led_msg;
     
+    rk_ota_progress_t progress;
+    rk_ota_get_progress(&progress);
+    
     if (ota_started) {
         ESP_LOGI(TAG, "OTA rozpoczęte - bardzo szybkie mruganie LED");
         led_msg.type = RK_LED_MSG_OTA_START;
+    } else if (ota_success && progress.state == RK_OTA_STATE_UP_TO_DATE) {
+        ESP_LOGI(TAG, "Obraz aktualny - powrót do normalnego mrugania LED");
+        led_msg.type = RK_LED_MSG_WIFI_CONNECTED;
+        led_msg.on_time_ms = s_led_on_ms;
+        led_msg.off_time_ms = s_led_off_ms;
+    } else if (ota_success && rk_ota_is_update_staged()) {
+        // Obraz czeka na okno serwisowe - urządzenie działa dalej normalnie
+        ESP_LOGI(TAG, "OTA przygotowane - powrót do normalnego mrugania LED");
+        led_msg.type = RK_LED_MSG_WIFI_CONNECTED;
+        led_msg.on_time_ms = s_led_on_ms;
+        led_msg.off_time_ms = s_led_off_ms;
     } else if (ota_success) {
         ESP_LOGI(TAG, "OTA zakończone pomyślnie - stałe świecenie LED");
         led_msg.type = RK_LED_MSG_OTA_SUCCESS;
     } else {
         ESP_LOGI(TAG, "OTA nie powiodło się - powrót do normalnego trybu");
         led_msg.type = RK_LED_MSG_OTA_FAILED;
-        led_msg.on_time_ms = LED_ON_TIME_MS;
-        led_msg.off_time_ms = LED_OFF_TIME_MS;
+        led_msg.on_time_ms = s_led_on_ms;
+        led_msg.off_time_ms = s_led_off_ms;
+    }
+    
+    if (!ota_started) {
+        // Pierwsza decyzja OTA zamyka pomiar ścieżki startu
+        boot_profile_mark(BOOT_PHASE_OTA_DECISION);
+        boot_profile_report();
     }
     
     rk_led_send_message(&led_msg);
 }
 
+// Przepisanie wartości z konfiguracji zdalnej (bez skutków ubocznych - także przy starcie)
+static void apply_remote_values(const rk_ota_remote_config_t *config)
+{
+    if (config->led_on_ms > 0) {
+        s_led_on_ms = config->led_on_ms;
+    }
+    if (config->led_off_ms > 0) {
+        s_led_off_ms = config->led_off_ms;
+    }
+    if (config->ota_interval_min > 0) {
+        s_ota_interval_min = config->ota_interval_min;
+    }
+    if (config->wifi_ssid[0] != '\0') {
+        strncpy(s_wifi_ssid, config->wifi_ssid, sizeof(s_wifi_ssid) - 1);
+        strncpy(s_wifi_pass, config->wifi_pass, sizeof(s_wifi_pass) - 1);
+    }
+    if (config->github_branch[0] != '\0') {
+        strncpy(s_ota_config.github_branch, config->github_branch, sizeof(s_ota_config.github_branch) - 1);
+    }
+    if (config->firmware_file[0] != '\0') {
+        strncpy(s_ota_config.firmware_file, config->firmware_file, sizeof(s_ota_config.firmware_file) - 1);
+    }
+}
+
+// Nowa wersja konfiguracji zdalnej (zadanie OTA) - zastosowanie na żywo, bez restartu
+static esp_err_t remote_config_callback(const rk_ota_remote_config_t *config)
+{
+    // Zmiana sieci najpierw i tylko z potwierdzeniem - inaczej urządzenie straciłoby
+    // jedyną drogę do poprawienia konfiguracji
+    if (config->wifi_ssid[0] != '\0' && (strcmp(config->wifi_ssid, s_wifi_ssid) != 0 ||
+                                         strcmp(config->wifi_pass, s_wifi_pass) != 0)) {
+        EventGroupHandle_t wifi_events = rk_wifi_get_event_group();
+        ESP_LOGI(TAG, "Konfiguracja zdalna: przełączenie na WiFi %s", config->wifi_ssid);
+        xEventGroupClearBits(wifi_events, RK_WIFI_CONNECTED_BIT);
+        rk_wifi_connect(config->wifi_ssid, config->wifi_pass);
+        
+        EventBits_t bits = xEventGroupWaitBits(wifi_events, RK_WIFI_CONNECTED_BIT, pdFALSE, pdTRUE,
+                                               pdMS_TO_TICKS(REMOTE_WIFI_TIMEOUT_MS));
+        if (!(bits & RK_WIFI_CONNECTED_BIT)) {
+            ESP_LOGE(TAG, "Brak połączenia z %s - powrót do %s", config->wifi_ssid, s_wifi_ssid);
+            rk_wifi_connect(s_wifi_ssid, s_wifi_pass);
+            return ESP_FAIL;
+        }
+    }
+    
+    apply_remote_values(config);
+    rk_ota_set_config(&s_ota_config);
+    ESP_LOGI(TAG, "Konfiguracja zdalna %lu: LED %lu/%lu ms, OTA co %u min, gałąź %s, plik %s",
+             config->version, s_led_on_ms, s_led_off_ms, s_ota_interval_min,
+             s_ota_config.github_branch, s_ota_config.firmware_file);
+    
+    if (rk_wifi_is_connected() && !rk_ota_is_update_staged()) {
+        rk_led_message_t led_msg = {
+            .type = RK_LED_MSG_WIFI_CONNECTED,
+            .on_time_ms = s_led_on_ms,
+            .off_time_ms = s_led_off_ms,
+        };
+        rk_led_send_message(&led_msg);
+    }
+    return ESP_OK;
+}
+
 // Zadanie monitorowania systemu
 void system_monitor_task(void *pvParameters)
 {
     ESP_LOGI(TAG, "Zadanie monitora systemu uruchomione");
     
-    // Poczekaj na inicjalizację innych komponentów
-    vTaskDelay(pdMS_TO_TICKS(5000));
-    
-    // Uruchom pierwsze sprawdzenie OTA po 10 sekundach
     rk_ota_message_t ota_msg = {
         .type = RK_OTA_MSG_CHECK_UPDATE
     };
     
-    // Konfiguracja OTA
-    strncpy(ota_msg.config.github_user, GITHUB_USER, sizeof(ota_msg.config.github_user) - 1);
-    strncpy(ota_msg.config.github_repo, GITHUB_REPO, sizeof(ota_msg.config.github_repo) - 1);
-    strncpy(ota_msg.config.github_branch, GITHUB_BRANCH, sizeof(ota_msg.config.github_branch) - 1);
-    strncpy(ota_msg.config.firmware_file, GITHUB_FILE, sizeof(ota_msg.config.firmware_file) - 1);
-    
-    ESP_LOGI(TAG, "Pierwsze sprawdzenie OTA za 10 sekund...");
-    vTaskDelay(pdMS_TO_TICKS(10000));
+    // Pierwsze sprawdzenie OTA zaraz po uzyskaniu adresu IP
+    ESP_LOGI(TAG, "Pierwsze sprawdzenie OTA po połączeniu WiFi...");
+    xEventGroupWaitBits(rk_wifi_get_event_group(), RK_WIFI_CONNECTED_BIT,
+                        pdFALSE, pdTRUE, portMAX_DELAY);
     
+    boot_profile_mark(BOOT_PHASE_OTA_CHECK);
     rk_ota_send_message(&ota_msg);
     
+    // Sieć działa - obraz uznany za poprawny, nieaktywna partycja może być kasowana w tle
+    rk_ota_confirm_boot();
+    
     while(1) {
         // Informacje o systemie co minutę
         ESP_LOGI(TAG, "=== STATUS SYSTEMU ===");
         ESP_LOGI(TAG, "Wersja firmware: %s", rk_ota_get_version());
         ESP_LOGI(TAG, "Wolna pamięć: %lu bytes", esp_get_free_heap_size());
+        
+        // Fragmentacja sterty - największy blok względem wolnej pamięci i trend od startu
+        rk_heap_sample_t heap;
+        rk_heap_report_t heap_report;
+        rk_heap_sample(&heap);
+        rk_heap_get_report(&heap_report);
+        ESP_LOGI(TAG, "Sterta: wolne=%lu B, największy blok=%lu B, fragmentacja=%u%% (start %u%%, max %u%%), min blok=%lu B, min wolne=%lu B",
+                 heap.free_bytes, heap.largest_block, heap.fragmentation_pct,
+                 heap_report.first.fragmentation_pct, heap_report.fragmentation_max_pct,
+                 heap_report.largest_block_min, heap.min_free_bytes);
         ESP_LOGI(TAG, "WiFi: %s", rk_wifi_is_connected() ? "Połączone" : "Rozłączone");
-        ESP_LOGI(TAG, "LED: ON=%dms, OFF=%dms", LED_ON_TIME_MS, LED_OFF_TIME_MS);
+        ESP_LOGI(TAG, "LED: ON=%lums, OFF=%lums", s_led_on_ms, s_led_off_ms);
         ESP_LOGI(TAG, "Uptime: %llu sekund", esp_timer_get_time() / 1000000);
         ESP_LOGI(TAG, "Liczba zadań: %d", uxTaskGetNumberOfTasks());
         
-        // Sprawdź OTA co 5 minut
+        rk_wifi_event_stats_t wifi_stats;
+        rk_wifi_get_event_stats(&wifi_stats);
+        ESP_LOGI(TAG, "Zdarzenia WiFi: %lu, obsługa max=%luus avg=%luus, callback max=%luus",
+                 wifi_stats.handler_calls, wifi_stats.handler_max_us,
+                 wifi_stats.handler_avg_us, wifi_stats.callback_max_us);
+        ESP_LOGI(TAG, "Powiadomienia WiFi: wysłane=%lu, scalone=%lu, odrzucone=%lu",
+                 wifi_stats.notifications_posted, wifi_stats.notifications_coalesced,
+                 wifi_stats.notifications_dropped);
+        
+        rk_led_stats_t led_stats;
+        rk_led_get_stats(&led_stats);
+        ESP_LOGI(TAG, "LED: wzorzec %s, zbocza CPU=%lu, wybudzenia timera=%lu, wzorce HW/SW=%lu/%lu",
+                 led_stats.hw_pattern_active ? "sprzętowy" : "programowy",
+                 led_stats.sw_edges, led_stats.timer_wakeups,
+                 led_stats.hw_patterns, led_stats.sw_patterns);
+        
+        rk_ota_stats_t ota_stats;
+        rk_ota_get_stats(&ota_stats);
+        ESP_LOGI(TAG, "OTA: sprawdzenia=%lu (z powiadomień %lu), long-poll=%lu, powiadomienia=%lu, błędy=%lu, kanał=%s",
+                 ota_stats.checks, ota_stats.checks_from_notify, ota_stats.notify_requests,
+                 ota_stats.notify_events, ota_stats.notify_errors,
+                 ota_stats.notify_channel_up ? "aktywny" : "nieaktywny");
+        ESP_LOGI(TAG, "DNS: zapytania=%lu, trafienia=%lu (przeterminowane %lu), chybienia=%lu, błędy=%lu, czas ost/avg/max=%lu/%lu/%lums",
+                 ota_stats.dns_lookups, ota_stats.dns_hits, ota_stats.dns_stale_hits,
+                 ota_stats.dns_misses, ota_stats.dns_failures, ota_stats.dns_resolve_last_ms,
+                 ota_stats.dns_resolve_avg_ms, ota_stats.dns_resolve_max_ms);
+        ESP_LOGI(TAG, "Pobieranie: %lu, ostatnie %lu B w %lu ms",
+                 ota_stats.downloads, ota_stats.download_bytes_last, ota_stats.download_last_ms);
+        ESP_LOGI(TAG, "Flash OTA: sektory pominięte=%lu, bez kasowania=%lu, kasowane=%lu (oszczędność ~%lu ms); w tle skasowano %lu sekt. (%lu ms), czyste %lu B",
+                 ota_stats.diff_sectors_skipped, ota_stats.diff_sectors_programmed,
+                 ota_stats.diff_sectors_written, ota_stats.diff_saved_ms,
+                 ota_stats.preerase_sectors, ota_stats.preerase_erase_ms,
+                 ota_stats.preerase_clean_bytes);
+        ESP_LOGI(TAG, "TLS wbudowane CA: %lu poł., avg=%lums, sterta max=%lu B; bundle: %lu poł., avg=%lums, sterta max=%lu B; fallback=%lu",
+                 ota_stats.tls_pinned.handshakes, ota_stats.tls_pinned.handshake_avg_ms,
+                 ota_stats.tls_pinned.heap_peak_bytes, ota_stats.tls_bundle.handshakes,
+                 ota_stats.tls_bundle.handshake_avg_ms, ota_stats.tls_bundle.heap_peak_bytes,
+                 ota_stats.tls_fallbacks);
+        
+        // Migawka metryk: CPU i zapas stosu zadań, sterta, liczniki i histogramy komponentów
+        rk_metrics_log();
+        
+        // Sprawdź OTA co s_ota_interval_min minut (domyślnie 5)
         static int ota_counter = 0;
         ota_counter++;
         
-        if (ota_counter >= 5) { // 5 minut (5 * 1 minuta)
+        if (ota_counter >= s_ota_interval_min) {
             ota_counter = 0;
-            if (rk_wifi_is_connected()) {
+            // Przy działającym kanale powiadomień cykliczne sprawdzanie jest zbędne
+            if (rk_wifi_is_connected() && !rk_ota_notify_channel_is_up()) {
                 ESP_LOGI(TAG, "Automatyczne sprawdzanie OTA...");
                 rk_ota_send_message(&ota_msg);
             }
@@ -129,11 +351,157 @@ void system_monitor_task(void *pvParameters)
     }
 }
 
+#if LOW_POWER_MODE
+RK_TASK_BUFFER(low_power_task, LOW_POWER_TASK_STACK);
+
+// Jedno sprawdzenie OTA (z konfiguracją zdalną): true gdy zakończone, także bez zmian.
+// Pobieranie nowego obrazu nie jest przerywane limitem - kończy się restartem.
+static bool low_power_check(void)
+{
+    rk_ota_message_t ota_msg = {.type = RK_OTA_MSG_CHECK_UPDATE};
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)LOW_POWER_AWAKE_MAX_MS * 1000;
+    
+    EventBits_t bits = xEventGroupWaitBits(rk_wifi_get_event_group(), RK_WIFI_CONNECTED_BIT,
+                                           pdFALSE, pdTRUE, pdMS_TO_TICKS(LOW_POWER_AWAKE_MAX_MS));
+    if (!(bits & RK_WIFI_CONNECTED_BIT)) {
+        ESP_LOGW(TAG, "Brak połączenia WiFi w %d ms", LOW_POWER_AWAKE_MAX_MS);
+        return false;
+    }
+    
+    boot_profile_mark(BOOT_PHASE_OTA_CHECK);
+    rk_ota_confirm_boot();
+    if (rk_ota_is_update_staged()) {
+        return true;    // Obraz czeka na okno serwisowe - sprawdzenie zbędne
+    }
+    
+    rk_ota_progress_t progress;
+    rk_ota_get_progress(&progress);
+    uint32_t seq = progress.seq;
+    rk_ota_send_message(&ota_msg);
+    
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(LOW_POWER_POLL_MS));
+        rk_ota_get_progress(&progress);
+        if (progress.seq != seq) {
+            switch (progress.state) {
+                case RK_OTA_STATE_UP_TO_DATE:
+                case RK_OTA_STATE_STAGED:
+                    return true;
+                case RK_OTA_STATE_FAILED:
+                case RK_OTA_STATE_CANCELLED:
+                    return false;
+                case RK_OTA_STATE_DOWNLOADING:
+                case RK_OTA_STATE_VERIFYING:
+                case RK_OTA_STATE_DONE:
+                    continue;   // Nowy obraz - zadanie OTA zakończy je restartem
+                default:
+                    break;
+            }
+        }
+        if (esp_timer_get_time() > deadline_us) {
+            ESP_LOGW(TAG, "Sprawdzenie OTA nie zakończyło się w %d ms", LOW_POWER_AWAKE_MAX_MS);
+            return false;
+        }
+    }
+}
+
+// Zadanie trybu bateryjnego - zastępuje monitor systemu
+static void low_power_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "Tryb bateryjny (%s), wybudzenie %s", LOW_POWER_DEEP_SLEEP ? "głęboki" : "płytki",
+             low_power_woke_from_sleep() ? "z uśpienia" : "po zimnym starcie");
+    
+    while (1) {
+        bool check_ok = low_power_check();
+        
+        rk_wifi_event_stats_t wifi_stats;
+        rk_wifi_get_event_stats(&wifi_stats);
+        ESP_LOGI(TAG, "WiFi: połączenie %lu ms (%s), szybkie %lu, powroty do pełnego %lu",
+                 wifi_stats.connect_last_ms, wifi_stats.fast_connect_last ? "szybkie" : "pełne",
+                 wifi_stats.fast_connects, wifi_stats.fast_connect_fallbacks);
+        
+        uint32_t sleep_s = low_power_cycle_end(check_ok, (uint32_t)s_ota_interval_min * 60);
+        rk_ota_prepare_sleep();
+        rk_wifi_prepare_sleep();
+        rk_led_blink_stop();
+        rk_led_off();
+        low_power_sleep(sleep_s, LOW_POWER_DEEP_SLEEP);
+        
+        // Tylko po uśpieniu płytkim - głębokie zaczyna od app_main
+        rk_wifi_connect(s_wifi_ssid, s_wifi_pass);
+    }
+}
+#endif
+
+#if SOAK_TEST
+RK_TASK_BUFFER(soak_task, SOAK_TASK_STACK);
+
+// Zadanie testu długotrwałego - po rozgrzewce test łącza co cykl, co trzeci cykl zerwanie WiFi
+static void soak_task(void *pvParameters)
+{
+    rk_ota_message_t bench_msg = {.type = RK_OTA_MSG_BENCHMARK};
+    rk_metrics_soak_baseline_t baseline;
+    EventGroupHandle_t wifi_events = rk_wifi_get_event_group();
+    uint32_t cycle = 0;
+    uint32_t failed_checks = 0;
+    
+    // Rozgrzewka: pierwszy test łącza alokuje wszystko, co później ma być stałe
+    xEventGroupWaitBits(wifi_events, RK_WIFI_CONNECTED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    rk_ota_send_message(&bench_msg);
+    vTaskDelay(pdMS_TO_TICKS(SOAK_CYCLE_MS));
+    rk_metrics_soak_baseline(&baseline);
+    
+    while (1) {
+        cycle++;
+        
+        if (cycle % 3 == 0) {
+            ESP_LOGW(TAG, "Soak %lu: zerwanie WiFi", cycle);
+            rk_wifi_disconnect();
+            vTaskDelay(pdMS_TO_TICKS(5000));
+            rk_wifi_connect(s_wifi_ssid, s_wifi_pass);
+            xEventGroupWaitBits(wifi_events, RK_WIFI_CONNECTED_BIT, pdFALSE, pdTRUE,
+                                pdMS_TO_TICKS(30000));
+        }
+        
+        rk_ota_send_message(&bench_msg);
+        vTaskDelay(pdMS_TO_TICKS(SOAK_CYCLE_MS));
+        
+        if (cycle % SOAK_CHECK_EVERY == 0) {
+            if (rk_metrics_soak_check(&baseline, NULL) != ESP_OK) {
+                failed_checks++;
+            }
+            ESP_LOGI(TAG, "Soak: %lu cykli, nieudane kontrole: %lu", cycle, failed_checks);
+        }
+    }
+}
+#endif
+
+// Inicjalizacja LED równolegle z NVS i WiFi
+static void init_led_task(void *pvParameters)
+{
+    TaskHandle_t main_task = (TaskHandle_t)pvParameters;
+    
+    ESP_ERROR_CHECK(rk_led_init());
+    ESP_ERROR_CHECK(rk_led_start_task(&s_led_task_config));
+    boot_profile_mark(BOOT_PHASE_LED_READY);
+    
+    xTaskNotifyGive(main_task);
+    rk_task_delete(NULL);
+}
+
 void app_main(void)
 {
+    boot_profile_mark(BOOT_PHASE_APP_MAIN);
+    rk_mem_init();
+    rk_metrics_init();
+    rk_log_init();
+    
     ESP_LOGI(TAG, "=== URUCHAMIANIE APLIKACJI OTA GITHUB ===");
     ESP_LOGI(TAG, "Wersja firmware: %s", rk_ota_get_version());
-    ESP_LOGI(TAG, "Parametry LED: ON=%d ms, OFF=%d ms", LED_ON_TIME_MS, LED_OFF_TIME_MS);
+    uint32_t shutdown_ms = rk_shutdown_last_ms();
+    if (shutdown_ms > 0) {
+        ESP_LOGI(TAG, "Poprzednie wyłączenie przed restartem: %lu ms", shutdown_ms);
+    }
     
     // Sprawdź czy dane WiFi są ustawione
     if (strlen(WIFI_SSID) == 0 || strcmp(WIFI_SSID, "TwojeWiFi") == 0) {
@@ -141,52 +509,142 @@ void app_main(void)
         ESP_LOGE(TAG, "Zmień WIFI_SSID i WIFI_PASS w main.c");
     }
     
-    // Inicjalizacja NVS
+    // Inicjalizacja komponentów
+    ESP_LOGI(TAG, "Inicjalizacja komponentów...");
+    
+    // 1. LED nie zależy od NVS ani WiFi - startuje w osobnym zadaniu
+    if (rk_task_create(init_led_task, "init_task", 4096, xTaskGetCurrentTaskHandle(), 5,
+                       NULL, NULL, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Nie można utworzyć zadania inicjalizacji");
+        abort();
+    }
+    
+    // 2. Inicjalizacja NVS (wymagana przez WiFi)
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
         ESP_ERROR_CHECK(nvs_flash_erase());
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    boot_profile_mark(BOOT_PHASE_NVS_READY);
     
-    // Inicjalizacja komponentów
-    ESP_LOGI(TAG, "Inicjalizacja komponentów...");
+    // OTA przed odczytem konfiguracji zdalnej - rk_ota_init instaluje alokator parsera JSON
+    ESP_ERROR_CHECK(rk_ota_init());
+    boot_profile_mark(BOOT_PHASE_OTA_INIT);
     
-    // 1. Inicjalizacja LED
-    ESP_ERROR_CHECK(rk_led_init());
-    ESP_ERROR_CHECK(rk_led_start_task());
+    // Konfiguracja OTA z makr, nadpisana ostatnią przyjętą konfiguracją zdalną z NVS
+    strncpy(s_ota_config.github_user, GITHUB_USER, sizeof(s_ota_config.github_user) - 1);
+    strncpy(s_ota_config.github_repo, GITHUB_REPO, sizeof(s_ota_config.github_repo) - 1);
+    strncpy(s_ota_config.github_branch, GITHUB_BRANCH, sizeof(s_ota_config.github_branch) - 1);
+    strncpy(s_ota_config.firmware_file, GITHUB_FILE, sizeof(s_ota_config.firmware_file) - 1);
+    strncpy(s_ota_config.mirror_url, OTA_MIRROR_URL, sizeof(s_ota_config.mirror_url) - 1);
+    strncpy(s_ota_config.config_file, GITHUB_CONFIG_FILE, sizeof(s_ota_config.config_file) - 1);
+    
+    rk_ota_remote_config_t remote_config;
+    if (rk_ota_remote_config_load(&remote_config) == ESP_OK) {
+        apply_remote_values(&remote_config);
+    }
+    ESP_LOGI(TAG, "Parametry LED: ON=%lu ms, OFF=%lu ms", s_led_on_ms, s_led_off_ms);
     
-    // 2. Inicjalizacja WiFi
+    // 3. Inicjalizacja WiFi
     ESP_ERROR_CHECK(rk_wifi_init());
-    ESP_ERROR_CHECK(rk_wifi_start_task(wifi_event_callback));
+    ESP_ERROR_CHECK(rk_wifi_start_task(wifi_event_callback, &s_wifi_task_config));
+    boot_profile_mark(BOOT_PHASE_WIFI_READY);
     
-    // 3. Inicjalizacja OTA
-    ESP_ERROR_CHECK(rk_ota_init());
-    ESP_ERROR_CHECK(rk_ota_start_task(rk_wifi_get_event_group(), ota_event_callback));
+    // Połącz z WiFi jak najwcześniej - sieć jest ścieżką krytyczną, LED nie blokuje
+    ESP_LOGI(TAG, "Łączenie z WiFi: %s", s_wifi_ssid);
+    rk_wifi_connect(s_wifi_ssid, s_wifi_pass);
+    boot_profile_mark(BOOT_PHASE_WIFI_CONNECT);
     
-    ESP_LOGI(TAG, "Wszystkie komponenty zainicjalizowane!");
+    // Poczekaj na LED (zwykle już gotowe)
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
     
-    // Sygnalizacja startu LED
-    rk_led_message_t led_msg = {.type = RK_LED_MSG_STARTUP};
+    // Kolejka LED istnieje dopiero teraz - połączenie zgłoszone wcześniej przez callback
+    // przepadło, więc po "łączeniu" stan połączenia jest wysyłany ponownie
+    rk_led_message_t led_msg = {.type = RK_LED_MSG_WIFI_CONNECTING};
     rk_led_send_message(&led_msg);
+    if (rk_wifi_is_connected()) {
+        led_msg.type = RK_LED_MSG_WIFI_CONNECTED;
+        led_msg.on_time_ms = s_led_on_ms;
+        led_msg.off_time_ms = s_led_off_ms;
+        rk_led_send_message(&led_msg);
+    }
     
-    // Połącz z WiFi
-    ESP_LOGI(TAG, "Łączenie z WiFi: %s", WIFI_SSID);
-    led_msg.type = RK_LED_MSG_WIFI_CONNECTING;
-    rk_led_send_message(&led_msg);
+    // 4. Zadanie OTA (potrzebuje Event Group WiFi)
+    ESP_ERROR_CHECK(rk_ota_start_task(rk_wifi_get_event_group(), ota_event_callback,
+                                      &s_ota_task_config));
+    boot_profile_mark(BOOT_PHASE_OTA_READY);
+    
+    // Konfiguracja OTA - rejestrowana raz, wiadomości niosą tylko typ
+    rk_ota_set_remote_config_callback(remote_config_callback);
+    rk_ota_set_config(&s_ota_config);
+    
+#if OTA_LOCAL_SOURCE
+    // Przed pierwszym sprawdzeniem GitHub - obraz lokalny kończy się restartem
+    rk_ota_local_source_t local_source = {
+        .type = OTA_LOCAL_SOURCE == 1 ? RK_OTA_LOCAL_FILE :
+                OTA_LOCAL_SOURCE == 2 ? RK_OTA_LOCAL_UART : RK_OTA_LOCAL_DEVICE,
+        .path = OTA_LOCAL_PATH,
+        .uart_port = OTA_LOCAL_UART,
+        .tx_pin = OTA_LOCAL_TX_PIN,
+        .rx_pin = OTA_LOCAL_RX_PIN,
+        .baud_rate = OTA_LOCAL_BAUD,
+    };
+    rk_ota_update_local(&local_source);
+#endif
     
-    rk_wifi_connect(WIFI_SSID, WIFI_PASS);
+#if OTA_STAGED
+    // Okno serwisowe wymaga czasu lokalnego - SNTP zsynchronizuje zegar po uzyskaniu IP
+    setenv("TZ", OTA_TIMEZONE, 1);
+    tzset();
+    esp_sntp_config_t sntp_config = ESP_NETIF_SNTP_DEFAULT_CONFIG(OTA_SNTP_SERVER);
+    esp_netif_sntp_init(&sntp_config);
+    
+    rk_ota_staging_t staging = {
+        .mode = RK_OTA_APPLY_STAGED,
+        .bandwidth_limit_bps = OTA_BANDWIDTH_LIMIT_BPS,
+        .download_priority = 1,
+        .window_start_hour = OTA_WINDOW_START_HOUR,
+        .window_end_hour = OTA_WINDOW_END_HOUR,
+    };
+    ESP_ERROR_CHECK(rk_ota_set_staging(&staging));
+#endif
+    
+#if !LOW_POWER_MODE
+    if (strlen(OTA_NOTIFY_URL) > 0) {
+        rk_ota_start_notify_channel(OTA_NOTIFY_URL);
+    }
+#endif
+    
+#if CTRL_ENABLED && !LOW_POWER_MODE
+    // Sterowanie OTA i metryki przez HTTP (np. curl -X POST -H "X-RK-Token: ..." http://<ip>/ota/check)
+    rk_ctrl_start();
+#endif
+    
+    ESP_LOGI(TAG, "Wszystkie komponenty zainicjalizowane!");
+    
+#if LOW_POWER_MODE
+    rk_task_create(low_power_task, "low_power_task", LOW_POWER_TASK_STACK, NULL, 1, NULL,
+                   RK_TASK_STATIC(low_power_task));
+#else
+#if TASK_CONTENTION_REPORT
+    if (rk_contention_start() != ESP_OK) {
+        ESP_LOGW(TAG, "Raport rywalizacji o CPU niedostępny");
+    }
+#endif
     
     // Uruchom zadanie monitorowania systemu
-    xTaskCreate(system_monitor_task, 
-               "monitor_task", 
-               4096,        // 4KB stosu
-               NULL, 
-               1,           // Najniższy priorytet
-               NULL);
+    rk_task_create_config(system_monitor_task, "monitor_task", NULL, NULL, &s_monitor_task_config,
+                          NULL, RK_TASK_STATIC_CFG(monitor_task));
+#endif
+    
+#if SOAK_TEST
+    rk_task_create(soak_task, "soak_task", SOAK_TASK_STACK, NULL, 2, NULL,
+                   RK_TASK_STATIC(soak_task));
+#endif
     
     ESP_LOGI(TAG, "Aplikacja uruchomiona - wszystkie zadania działają!");
     
     // Główne zadanie może się zakończyć - inne zadania będą działać
     vTaskDelete(NULL);
-}
\ No newline at end of file
+}
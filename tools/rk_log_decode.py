@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""Dekoder logu binarnego rk_log (RK_LOG_OUTPUT_BINARY=1).
+
+Czyta zapis z konsoli szeregowej (plik lub stdin) i zamienia linie
+"#RKL:<hex>" na tekst według tabel z components/rk_log/include/rk_log_ids.h.
+Pozostałe linie przechodzą bez zmian.
+
+Użycie:
+    idf.py monitor | python3 tools/rk_log_decode.py
+    python3 tools/rk_log_decode.py capture.log
+"""
+
+import os
+import re
+import struct
+import sys
+
+IDS_HEADER = os.path.join(os.path.dirname(__file__), "..", "components", "rk_log",
+                          "include", "rk_log_ids.h")
+LEVELS = {1: "E", 2: "W", 3: "I", 4: "D", 5: "V"}
+ENTRY_RE = re.compile(r'X\(\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+SPEC_RE = re.compile(r"%[-+ #0]*\d*(?:\.\d+)?(?:hh|h|ll|l|z)?([diuxXc%])")
+
+
+def load_table(text, macro):
+    start = text.index("#define " + macro)
+    lines = []
+    for line in text[start:].splitlines():
+        lines.append(line)
+        if not line.rstrip().endswith("\\"):
+            break
+    return [m.group(2).encode().decode("unicode_escape").encode("latin-1").decode("utf-8")
+            for m in ENTRY_RE.finditer("\n".join(lines))]
+
+
+def render(fmt, args):
+    values = iter(args)
+
+    def repl(m):
+        conv = m.group(1)
+        if conv == "%":
+            return "%"
+        value = next(values, 0)
+        if conv in "di":
+            value = value - (1 << 32) if value & 0x80000000 else value
+            return str(value)
+        if conv in "xX":
+            return format(value, conv)
+        if conv == "c":
+            return chr(value & 0xFF)
+        return str(value)
+
+    return SPEC_RE.sub(repl, fmt)
+
+
+def decode(hex_text, tags, formats):
+    raw = bytes.fromhex(hex_text)
+    time_ms, fmt_id, tag_id, level_argc = struct.unpack_from("<IHBB", raw)
+    argc = level_argc & 0x0F
+    args = struct.unpack_from("<%dI" % argc, raw, 8)
+    level = LEVELS.get(level_argc >> 4, "?")
+    tag = tags[tag_id] if tag_id < len(tags) else "tag#%d" % tag_id
+    if fmt_id >= len(formats):
+        return "%s (%d) %s: <format #%d> %s" % (level, time_ms, tag, fmt_id, list(args))
+    return "%s (%d) %s: %s" % (level, time_ms, tag, render(formats[fmt_id], args))
+
+
+def main():
+    with open(IDS_HEADER, encoding="utf-8") as f:
+        text = f.read()
+    tags = load_table(text, "RK_LOG_TAGS")
+    formats = load_table(text, "RK_LOG_FORMATS")
+
+    source = open(sys.argv[1], encoding="utf-8", errors="replace") if len(sys.argv) > 1 else sys.stdin
+    for line in source:
+        pos = line.find("#RKL:")
+        if pos < 0:
+            sys.stdout.write(line)
+            continue
+        try:
+            print(decode(line[pos + 5:].strip(), tags, formats))
+        except (ValueError, struct.error):
+            sys.stdout.write(line)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""Nadawca obrazu dla aktualizacji lokalnej rk_ota (rk_ota_update_local, OTA_LOCAL_SOURCE 2/3).
+
+Obraz idzie ramkami z CRC-32, każda potwierdzana przez urządzenie (protokół opisany
+w components/rk_ota/rk_ota_local.c). Bajty spoza odpowiedzi (np. log konsoli USB-CDC)
+są przepisywane na standardowe wyjście. Na końcu wypisywana jest przepustowość.
+
+Tryb "pty" tworzy pseudoterminal dla firmware uruchomionego na Linuksie
+(RK_OTA_LOCAL_DEVICE ze ścieżką wypisanego urządzenia) i nadaje przez niego obraz.
+
+Użycie:
+    python3 tools/rk_ota_serial.py send /dev/ttyUSB1 build/ota_github_project.bin [921600]
+    python3 tools/rk_ota_serial.py pty build/ota_github_project.bin
+"""
+
+import os
+import select
+import struct
+import sys
+import termios
+import time
+import tty
+import zlib
+
+MAGIC = b"\xa5RK"
+FRAME_MAX = 2048            # RK_OTA_SERIAL_FRAME_MAX
+REPLY_TIMEOUT_S = 2.0
+START_TIMEOUT_S = 30.0
+RETRIES = 8                 # RK_OTA_SERIAL_RETRIES
+
+
+class Link:
+    def __init__(self, fd):
+        self.fd = fd
+        self.pending = b""
+
+    def send_frame(self, kind, seq, payload):
+        fields = struct.pack("<cHH", kind, seq, len(payload))
+        os.write(self.fd, MAGIC + fields + payload + struct.pack("<I", zlib.crc32(fields + payload)))
+
+    def reply(self, timeout):
+        # Odpowiedź: znacznik, typ, numer - reszta strumienia to log urządzenia
+        deadline = time.monotonic() + timeout
+        while True:
+            pos = self.pending.find(MAGIC)
+            if pos >= 0 and len(self.pending) >= pos + 6:
+                sys.stdout.buffer.write(self.pending[:pos])
+                kind, seq = struct.unpack("<cH", self.pending[pos + 3:pos + 6])
+                self.pending = self.pending[pos + 6:]
+                return kind, seq
+            if pos < 0 and len(self.pending) > 2:
+                sys.stdout.buffer.write(self.pending[:-2])
+                self.pending = self.pending[-2:]
+            sys.stdout.flush()
+
+            left = deadline - time.monotonic()
+            if left <= 0 or not select.select([self.fd], [], [], left)[0]:
+                return None, None
+            try:
+                self.pending += os.read(self.fd, 4096)
+            except OSError:
+                return None, None       # pty bez drugiej strony
+
+
+def transfer(link, image):
+    deadline = time.monotonic() + START_TIMEOUT_S
+    while True:
+        link.send_frame(b"S", 0, struct.pack("<I", len(image)))
+        kind, seq = link.reply(1.0)
+        if kind == b"A" and seq == 0:
+            break
+        if kind == b"X":
+            sys.exit("Urządzenie odrzuciło obraz (%d B)" % len(image))
+        if time.monotonic() > deadline:
+            sys.exit("Brak odpowiedzi urządzenia")
+
+    start = time.monotonic()
+    retransmits = 0
+    offset = 0
+    seq = 1
+    while offset < len(image):
+        chunk = image[offset:offset + FRAME_MAX]
+        for _ in range(RETRIES):
+            link.send_frame(b"D", seq, chunk)
+            kind, reply_seq = link.reply(REPLY_TIMEOUT_S)
+            if kind == b"A" and reply_seq == seq:
+                break
+            if kind == b"X":
+                sys.exit("Urządzenie przerwało aktualizację po %d B" % offset)
+            retransmits += 1
+        else:
+            sys.exit("Ramka %d nie została potwierdzona" % seq)
+        offset += len(chunk)
+        seq = (seq + 1) & 0xFFFF
+
+    elapsed = time.monotonic() - start
+    print("\nWysłano %d B w %.2f s (%.0f B/s), ponowienia: %d" %
+          (len(image), elapsed, len(image) / elapsed if elapsed > 0 else 0, retransmits))
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+    attrs = termios.tcgetattr(fd)
+    speed = getattr(termios, "B%d" % baud, None)
+    if speed is None:
+        sys.exit("Nieobsługiwana prędkość: %d" % baud)
+    attrs[4] = attrs[5] = speed
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def main():
+    if len(sys.argv) in (4, 5) and sys.argv[1] == "send":
+        with open(sys.argv[3], "rb") as f:
+            image = f.read()
+        fd = open_port(sys.argv[2], int(sys.argv[4]) if len(sys.argv) == 5 else 921600)
+        transfer(Link(fd), image)
+    elif len(sys.argv) == 3 and sys.argv[1] == "pty":
+        with open(sys.argv[2], "rb") as f:
+            image = f.read()
+        master, slave = os.openpty()
+        tty.setraw(master)
+        print("Urządzenie dla RK_OTA_LOCAL_DEVICE: %s" % os.ttyname(slave))
+        transfer(Link(master), image)
+    else:
+        sys.exit(__doc__)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""Podpis obrazów dla lokalnego mirrora OTA (rk_ota, OTA_MIRROR_URL).
+
+Podpis to ECDSA P-256 w DER nad SHA-256 całego pliku, zapisany obok obrazu
+jako <obraz>.sig. Klucz publiczny trafia do components/rk_ota/certs/rk_ota_sign_pub.pem
+i jest wbudowywany w firmware; klucz prywatny nie powinien trafić do repozytorium.
+Wymaga programu openssl.
+
+Urządzenie przyjmuje z mirrora tylko obraz nowszy od działającego: wersja z
+esp_app_desc_t (PROJECT_VER, postaci 1.4.2) jest porównywana liczbowo, a
+secure_version nie może być mniejszy. Wersja z git describe (skrót commita)
+nie daje się porównać - takiego obrazu narzędzie nie podpisze.
+
+Użycie:
+    python3 tools/rk_ota_sign.py keygen ~/rk_ota_sign_key.pem
+    python3 tools/rk_ota_sign.py sign ~/rk_ota_sign_key.pem build/ota_github_project.bin
+    python3 tools/rk_ota_sign.py serve build 8070
+"""
+
+import functools
+import http.server
+import os
+import re
+import struct
+import subprocess
+import sys
+
+PUB_KEY = os.path.join(os.path.dirname(__file__), "..", "components", "rk_ota",
+                       "certs", "rk_ota_sign_pub.pem")
+
+
+def keygen(key_path):
+    if os.path.exists(key_path):
+        sys.exit("Klucz %s już istnieje" % key_path)
+    subprocess.run(["openssl", "ecparam", "-name", "prime256v1", "-genkey", "-noout",
+                    "-out", key_path], check=True)
+    os.chmod(key_path, 0o600)
+    subprocess.run(["openssl", "ec", "-in", key_path, "-pubout", "-out", PUB_KEY], check=True)
+    print("Klucz prywatny: %s\nKlucz publiczny: %s" % (key_path, os.path.normpath(PUB_KEY)))
+
+
+# esp_app_desc_t za nagłówkiem obrazu (24 B) i pierwszego segmentu (8 B)
+APP_DESC_OFFSET = 32
+APP_DESC_MAGIC = 0xABCD5432
+VERSION_RE = re.compile(r"^[vV]?\d+(\.\d+)*([-+ ].*)?$")
+
+
+def image_version(image_path):
+    with open(image_path, "rb") as f:
+        f.seek(APP_DESC_OFFSET)
+        desc = f.read(48)
+    if len(desc) < 48:
+        sys.exit("%s: za krótki na obraz aplikacji" % image_path)
+    magic, secure_version = struct.unpack_from("<II", desc)
+    if magic != APP_DESC_MAGIC:
+        sys.exit("%s: brak esp_app_desc_t" % image_path)
+    version = desc[16:48].split(b"\0", 1)[0].decode("ascii", "replace")
+    if not VERSION_RE.match(version):
+        sys.exit("%s: wersja \"%s\" nie jest liczbowa - ustaw PROJECT_VER" % (image_path, version))
+    return version, secure_version
+
+
+def sign(key_path, image_path):
+    version, secure_version = image_version(image_path)
+    sig_path = image_path + ".sig"
+    subprocess.run(["openssl", "dgst", "-sha256", "-sign", key_path, "-out", sig_path,
+                    image_path], check=True)
+    # Sprawdzenie tym samym kluczem publicznym, który jest w firmware
+    subprocess.run(["openssl", "dgst", "-sha256", "-verify", PUB_KEY, "-signature", sig_path,
+                    image_path], check=True)
+    print("Podpis: %s (%d B), wersja %s, secure_version %d" %
+          (sig_path, os.path.getsize(sig_path), version, secure_version))
+
+
+def serve(directory, port):
+    # Lokalny serwer zastępczy dla mirrora (zwykły HTTP, bez TLS)
+    handler = functools.partial(http.server.SimpleHTTPRequestHandler, directory=directory)
+    with http.server.ThreadingHTTPServer(("", port), handler) as server:
+        print("Mirror OTA: http://<adres>:%d/ z katalogu %s" % (port, directory))
+        server.serve_forever()
+
+
+def main():
+    if len(sys.argv) == 3 and sys.argv[1] == "keygen":
+        keygen(sys.argv[2])
+    elif len(sys.argv) == 4 and sys.argv[1] == "sign":
+        sign(sys.argv[2], sys.argv[3])
+    elif len(sys.argv) in (3, 4) and sys.argv[1] == "serve":
+        serve(sys.argv[2], int(sys.argv[3]) if len(sys.argv) == 4 else 8070)
+    else:
+        sys.exit(__doc__)
+
+
+if __name__ == "__main__":
+    main()